@@ -31,52 +31,30 @@
 #include "dMagnetic2_engine_shared.h"
 #include "dMagnetic2_engine_linea.h"
 #include "dMagnetic2_engine_vm68k.h"
+#include "dMagnetic2_engine_handle.h"
 #include <string.h>
 
-
-#define	MAGIC		0x28844
-
-
-typedef struct _tdMagnetic2_game_context
-{
-	tVM68k	vm68k;
-	tVMLineA linea;
-} tdMagnetic2_game_context;
-
-typedef struct _tdMagnetic2_engine_handle
-{
-	unsigned int magic;
-	char inputbuf[DMAGNETIC2_SIZE_INPUTBUF];
-	// add one byte for 0 termination
-	char outputbuf[DMAGNETIC2_SIZE_OUTPUTBUF+1];
-	char titlebuf[DMAGNETIC2_SIZE_TITLEBUF+1];
-	char picnamebuf[DMAGNETIC2_SIZE_PICNAMEBUF+1];
-	int picturenum;
-	char filenamebuf[DMAGNETIC2_SIZE_FILENAMEBUF+1];
-
-
-	
-
-
-
-	int inputlevel;
-	int outputlevel;
-	int titlelevel;
-	int picnamelevel;
-	int filenamelevel;
-
-	unsigned int status_flags;
-
-	tdMagnetic2_game_context	game_context;
-} tdMagnetic2_engine_handle;
-
 int dMagnetic2_engine_get_size(int *pBytes)
 {
 	if (pBytes==NULL)
 	{
 		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-	*pBytes=sizeof(tdMagnetic2_engine_handle);
+	*pBytes=sizeof(tdMagnetic2_engine_handle)+DMAGNETIC2_LINEA_DICTCOPY_SIZE;
+	return DMAGNETIC2_OK;
+}
+// the handle is followed by the private copy of the dictionary. its size depends on the game.
+int dMagnetic2_engine_get_size_for_mag(unsigned char* pMagBuf,int *pBytes)
+{
+	if (pMagBuf==NULL || pBytes==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pMagBuf[0]!='M' || pMagBuf[1]!='a' || pMagBuf[2]!='S' || pMagBuf[3]!='c')
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	*pBytes=sizeof(tdMagnetic2_engine_handle)+dMagnetic2_engine_linea_get_dictcopy_size(pMagBuf);
 	return DMAGNETIC2_OK;
 }
 
@@ -94,12 +72,28 @@ int dMagnetic2_engine_set_mag(void *pHandle,unsigned char* pMagBuf)
 {
 	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
 	int retval;
+	int dictcopysize;
 	if (pThis->magic!=MAGIC)
 	{
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
 	}
+	if (pMagBuf[0]!='M' || pMagBuf[1]!='a' || pMagBuf[2]!='S' || pMagBuf[3]!='c')
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	// the handle was sized for the first game. another one with a larger dictionary does not fit.
+	dictcopysize=dMagnetic2_engine_linea_get_dictcopy_size(pMagBuf);
+	if (pThis->pMagBuf==NULL)
+	{
+		pThis->dictcopycapacity=dictcopysize;
+	}
+	else if (dictcopysize>pThis->dictcopycapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 
 
+	pThis->pMagBuf=pMagBuf;
 	retval=dMagnetic2_engine_vm68k_init(&(pThis->game_context.vm68k),pMagBuf);
 	if (retval!=DMAGNETIC2_OK)
 	{
@@ -115,24 +109,94 @@ int dMagnetic2_engine_set_mag(void *pHandle,unsigned char* pMagBuf)
 		pThis->outputbuf,&(pThis->outputlevel),
 		pThis->titlebuf,&(pThis->titlelevel),
 		pThis->picnamebuf,&(pThis->picnamelevel),&(pThis->picturenum),
-		pThis->filenamebuf,&(pThis->filenamelevel)
+		pThis->filenamebuf,&(pThis->filenamelevel),
+		DICTCOPY(pThis)
 	);
 	return retval;
 	
 		
 }
 
+// the handle itself is free of pointers, except for the ones pointing into the mag buffer, and the ones 
+// pointing to its own communication buffers. after the handle has been moved (or mapped into a new process),
+// those have to be set again. the state of the game remains untouched.
+int dMagnetic2_engine_relink(void* pHandle,unsigned char* pMagBuf)
+{
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	int retval;
+	if (pThis->magic!=MAGIC)	// a hibernated handle is pointing to a buffer which might not exist anymore
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	pThis->pMagBuf=pMagBuf;
+	pThis->pHibernated=NULL;
+	pThis->hibernatedsize=0;
+	pThis->traps_a_hitcnt=0;	// the counts of an interrupted call are lost
+	memset(pThis->traps_a,0,sizeof(pThis->traps_a));
+	retval=dMagnetic2_engine_linea_link_communication(&(pThis->game_context.linea),&(pThis->game_context.vm68k),
+		pThis->inputbuf,&(pThis->inputlevel),
+		pThis->outputbuf,&(pThis->outputlevel),
+		pThis->titlebuf,&(pThis->titlelevel),
+		pThis->picnamebuf,&(pThis->picnamelevel),&(pThis->picturenum),
+		pThis->filenamebuf,&(pThis->filenamelevel),
+		DICTCOPY(pThis)
+	);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_engine_linea_relink(&(pThis->game_context.linea),pMagBuf);
+	return retval;
+}
+// the levels index the buffers of the handle. a handle which comes from outside has to be checked before it is used.
+int dMagnetic2_engine_check_levels(tdMagnetic2_engine_handle* pThis)
+{
+	if (pThis->inputlevel<0 || pThis->inputlevel>DMAGNETIC2_SIZE_INPUTBUF
+		|| pThis->outputlevel<0 || pThis->outputlevel>DMAGNETIC2_SIZE_OUTPUTBUF
+		|| pThis->titlelevel<0 || pThis->titlelevel>DMAGNETIC2_SIZE_TITLEBUF
+		|| pThis->picnamelevel<0 || pThis->picnamelevel>DMAGNETIC2_SIZE_PICNAMEBUF
+		|| pThis->filenamelevel<0 || pThis->filenamelevel>DMAGNETIC2_SIZE_FILENAMEBUF)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	return DMAGNETIC2_OK;
+}
+// to make sure that a stored state belongs to this game
+tVM68k_ulong dMagnetic2_engine_magchecksum(unsigned char* pMagBuf)
+{
+	tVM68k_ulong checksum;
+	int codesize;
+	int i;
+	codesize=READ_INT32BE(pMagBuf,14);
+	checksum=0;
+	for (i=0;i<42+codesize;i++)
+	{
+		checksum=(checksum*31)+pMagBuf[i];
+	}
+	return checksum;
+}
+
 int dMagnetic2_engine_new_input(void *pHandle,int len,char* pInput,int *pCnt)
 {
 	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
 	int i;
 	int cnt;
 
+	if (pThis->magic==MAGIC_HIBERNATED && pThis->pHibernated!=NULL)	// wake up first. this needs the full handle again.
+	{
+		int retval;
+		retval=dMagnetic2_engine_resume(pHandle,pThis->pMagBuf,pThis->hibernatedsize,pThis->pHibernated);
+		if (retval!=DMAGNETIC2_OK)
+		{
+			return retval;
+		}
+	}
 	if (pThis->magic!=MAGIC)
 	{
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
 	}
 
+	pThis->statehash_valid=0;
 	cnt=0;
 	for (i=0;i<len;i++)
 	{
@@ -223,21 +287,27 @@ int dMagnetic2_engine_get_filename(void *pHandle,char** ppFilename)
 	
 }
 
-int dMagnetic2_engine_process(void *pHandle,int singlestep,unsigned int *pStatus)
+// the main loop. it runs until the game waits for input, or one of the reasons in yieldmask occurs.
+// quantum is the maximum number of iterations, 0 means no limit.
+static int dMagnetic2_engine_run(tdMagnetic2_engine_handle* pThis,unsigned long long quantum,unsigned int yieldmask,unsigned int *pYield)
 {
 	int retval;
-	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
-	if (pThis->magic!=MAGIC)
-	{
-		return DMAGNETIC2_ERROR_WRONG_HANDLE;
-	}
-	*pStatus=(pThis->status_flags);
-	// check if the virtual machine is waiting for input, but nothing is available at the moment
-	if (((pThis->status_flags)&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT) && ((pThis->inputlevel)==0))
-	{
-		return DMAGNETIC2_OK;		// in that case: there is nothing to do
-	}
+	int outputlevel;
+	unsigned long long steps;
+	unsigned long long iterations;
+	unsigned int yield;
+	unsigned int traps_f;
+	unsigned int input_waits;
+	int i;
+
+	pThis->statehash_valid=0;
 	retval=DMAGNETIC2_OK;
+	outputlevel=pThis->outputlevel;
+	steps=0;
+	iterations=0;
+	traps_f=0;
+	input_waits=0;
+	yield=DMAGNETIC2_ENGINE_YIELD_NONE;
 	do
 	{
 		tVM68k_uword opcode;
@@ -246,18 +316,228 @@ int dMagnetic2_engine_process(void *pHandle,int singlestep,unsigned int *pStatus
 		{
 			if (dMagnetic2_engine_linea_istrap(&opcode))		// decide which of the two modules this opcode belongs to
 			{
+				unsigned int flags;
+				if ((opcode&0xf000)==0xa000)
+				{
+					if (pThis->traps_a[opcode&0xff]++==0)
+					{
+						pThis->traps_a_hit[pThis->traps_a_hitcnt++]=opcode&0xff;
+					}
+				} else {
+					traps_f++;
+				}
+				flags=pThis->status_flags;
 				retval=dMagnetic2_engine_linea_singlestep(&(pThis->game_context.linea),opcode,&(pThis->status_flags));
+				if (pThis->status_flags&~flags&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)	// only when it starts waiting
+				{
+					input_waits++;
+				}
+				// only the traps produce output
+				if ((yieldmask&DMAGNETIC2_ENGINE_YIELD_PICTURE) && (pThis->status_flags&~flags&(DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NUM|DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NAME)))
+				{
+					yield=DMAGNETIC2_ENGINE_YIELD_PICTURE;
+				}
+				if ((yieldmask&DMAGNETIC2_ENGINE_YIELD_OUTPUT) && pThis->outputlevel>=(DMAGNETIC2_SIZE_OUTPUTBUF-DMAGNETIC2_ENGINE_OUTPUT_RESERVE))
+				{
+					yield=DMAGNETIC2_ENGINE_YIELD_OUTPUT;
+				}
 			} else {
-				retval=dMagnetic2_engine_vm68k_singlestep(&(pThis->game_context.vm68k),opcode);
+				int instructions;
+				retval=dMagnetic2_engine_vm68k_singlestep(&(pThis->game_context.vm68k),opcode,&instructions);
+				steps+=instructions;
 			}
 		}
+		if (pThis->status_flags&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)
+		{
+			yield=DMAGNETIC2_ENGINE_YIELD_INPUT;
+		}
+		iterations++;
+		if (yield==DMAGNETIC2_ENGINE_YIELD_NONE && iterations==quantum)
+		{
+			yield=DMAGNETIC2_ENGINE_YIELD_QUANTUM;
+		}
 	}
-	while (	!singlestep
-		&& (retval==DMAGNETIC2_OK)
-		&& ((pThis->status_flags&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)==0));
-	
+	while (retval==DMAGNETIC2_OK && yield==DMAGNETIC2_ENGINE_YIELD_NONE);
+	// the counters are shared by all the threads. so they are only updated once per call
+	METRICS_ADD(dMagnetic2_engine_metrics.instructions,steps);
+	for (i=0;i<pThis->traps_a_hitcnt;i++)
+	{
+		int idx;
+		idx=pThis->traps_a_hit[i];
+		METRICS_ADD(dMagnetic2_engine_metrics.traps_a[idx],pThis->traps_a[idx]);
+		pThis->traps_a[idx]=0;
+	}
+	pThis->traps_a_hitcnt=0;
+	if (traps_f)
+	{
+		METRICS_ADD(dMagnetic2_engine_metrics.traps_f,traps_f);
+	}
+	METRICS_ADD(dMagnetic2_engine_metrics.output_bytes,pThis->outputlevel-outputlevel);
+	if (input_waits)
+	{
+		METRICS_ADD(dMagnetic2_engine_metrics.input_waits,input_waits);
+	}
+	*pYield=yield;
+	return retval;
+}
+int dMagnetic2_engine_process(void *pHandle,int singlestep,unsigned int *pStatus)
+{
+	int retval;
+	unsigned int yield;
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	if (pThis->magic==MAGIC_HIBERNATED)	// a hibernated session is always waiting for input
+	{
+		*pStatus=DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT;
+		return DMAGNETIC2_OK;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pStatus=(pThis->status_flags);
+	// check if the virtual machine is waiting for input, but nothing is available at the moment
+	if (((pThis->status_flags)&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT) && ((pThis->inputlevel)==0))
+	{
+		return DMAGNETIC2_OK;		// in that case: there is nothing to do
+	}
+	retval=dMagnetic2_engine_run(pThis,singlestep?1:0,DMAGNETIC2_ENGINE_YIELD_INPUT,&yield);
 
 	*pStatus=(pThis->status_flags);
 	return retval;
 }
+int dMagnetic2_engine_step(void *pHandle,int quantum,unsigned int *pYield,unsigned int *pStatus)
+{
+	int retval;
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	if (pThis==NULL || pYield==NULL || pStatus==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic==MAGIC_HIBERNATED)	// a hibernated session is always waiting for input
+	{
+		*pYield=DMAGNETIC2_ENGINE_YIELD_INPUT;
+		*pStatus=DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT;
+		return DMAGNETIC2_OK;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pStatus=(pThis->status_flags);
+	if (((pThis->status_flags)&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT) && ((pThis->inputlevel)==0))
+	{
+		*pYield=DMAGNETIC2_ENGINE_YIELD_INPUT;
+		return DMAGNETIC2_OK;
+	}
+	if (pThis->outputlevel>=(DMAGNETIC2_SIZE_OUTPUTBUF-DMAGNETIC2_ENGINE_OUTPUT_RESERVE))	// the text has not been picked up yet
+	{
+		*pYield=DMAGNETIC2_ENGINE_YIELD_OUTPUT;
+		return DMAGNETIC2_OK;
+	}
+	retval=dMagnetic2_engine_run(pThis,(quantum>0)?quantum:0,DMAGNETIC2_ENGINE_YIELD_ALL,pYield);
+
+	*pStatus=(pThis->status_flags);
+	return retval;
+}
+
+// the state hash covers everything that decides how the game continues: the memory, the registers,
+// the variables of the line-A traps, the dictionary (once it has been written), the current picture and the pending input. the output buffers are not part of it.
+// it is calculated in one pass, and remembered until the game makes progress.
+// the memory is hashed in four independent lanes, so that the multiplications do not have to wait for each other.
+// one pass over the 96 KB of memory takes about 20us (it was about 80us with a single lane), the dictionary copy
+// adds about 3us per 10 KB once the game has written to it. with the memo, this is paid once per turn, for the state after it.
+#define	STATEHASH_MUL	0x9e3779b97f4a7c15ULL
+#define	STATEHASH_MIX(h,x)	{(h)^=(unsigned long long)(x);(h)*=STATEHASH_MUL;(h)^=(h)>>29;}
+static unsigned long long dMagnetic2_engine_statehash_block(unsigned long long h,const unsigned char* pBlock,int len)
+{
+	unsigned long long h0,h1,h2,h3;
+	unsigned long long w0,w1,w2,w3;
+	int i;
 
+	h0=h;
+	h1=h^1;
+	h2=h^2;
+	h3=h^3;
+	// 8 bytes at a time. the byte order does not matter, as long as it is the same within one process.
+	for (i=0;i+32<=len;i+=32)
+	{
+		memcpy(&w0,&pBlock[i+ 0],8);
+		memcpy(&w1,&pBlock[i+ 8],8);
+		memcpy(&w2,&pBlock[i+16],8);
+		memcpy(&w3,&pBlock[i+24],8);
+		STATEHASH_MIX(h0,w0);
+		STATEHASH_MIX(h1,w1);
+		STATEHASH_MIX(h2,w2);
+		STATEHASH_MIX(h3,w3);
+	}
+	for (;i<len;i++)
+	{
+		STATEHASH_MIX(h0,pBlock[i]);
+	}
+	STATEHASH_MIX(h0,h1);
+	STATEHASH_MIX(h0,h2);
+	STATEHASH_MIX(h0,h3);
+	return h0;
+}
+int dMagnetic2_engine_get_statehash(void* pHandle,unsigned long long *pHash)
+{
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	tVM68k* pVM68k;
+	tVMLineA* pVMLineA;
+	unsigned long long h;
+	int i;
+
+	if (pHash==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->statehash_valid)
+	{
+		*pHash=pThis->statehash;
+		return DMAGNETIC2_OK;
+	}
+	pVM68k=&(pThis->game_context.vm68k);
+	pVMLineA=&(pThis->game_context.linea);
+	h=dMagnetic2_engine_statehash_block(0,pVM68k->memory,VM68K_MEMSIZE+VM68K_MEMGUARD);
+	STATEHASH_MIX(h,pVM68k->pcr);
+	STATEHASH_MIX(h,pVM68k->sr);
+	for (i=0;i<8;i++)
+	{
+		STATEHASH_MIX(h,((unsigned long long)pVM68k->a[i]<<32)|pVM68k->d[i]);
+	}
+	STATEHASH_MIX(h,pVMLineA->lastchar);
+	STATEHASH_MIX(h,pVMLineA->headlineflagged);
+	STATEHASH_MIX(h,pVMLineA->capital);
+	STATEHASH_MIX(h,pVMLineA->jinxterslide);
+	STATEHASH_MIX(h,(tVM68k_ulong)pVMLineA->random_state);
+	STATEHASH_MIX(h,pVMLineA->random_mode);
+	STATEHASH_MIX(h,pVMLineA->properties_offset);
+	STATEHASH_MIX(h,pVMLineA->linef_subroutine);
+	STATEHASH_MIX(h,pVMLineA->linef_tab);
+	STATEHASH_MIX(h,pVMLineA->linef_tabsize);
+	STATEHASH_MIX(h,pVMLineA->properties_tab);
+	STATEHASH_MIX(h,pVMLineA->properties_size);
+	STATEHASH_MIX(h,(tVM68k_ulong)pVMLineA->interrupted_byteidx);
+	STATEHASH_MIX(h,pVMLineA->interrupted_bitidx);
+	STATEHASH_MIX(h,pVMLineA->input_level);
+	STATEHASH_MIX(h,pVMLineA->input_used);
+	if (pVMLineA->dictcopy)
+	{
+		h=dMagnetic2_engine_statehash_block(h,pVMLineA->pDictCopy,pVMLineA->dictcopysize);
+	}
+	STATEHASH_MIX(h,pThis->picturenum);
+	STATEHASH_MIX(h,pThis->inputlevel);
+	for (i=0;i<pThis->inputlevel;i++)
+	{
+		STATEHASH_MIX(h,(unsigned char)pThis->inputbuf[i]);
+	}
+
+	pThis->statehash=h;
+	pThis->statehash_valid=1;
+	*pHash=h;
+	return DMAGNETIC2_OK;
+}
@@ -0,0 +1,109 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_ENGINE_HANDLE_H
+#define	DMAGNETIC2_ENGINE_HANDLE_H
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_shared.h"
+#include "dMagnetic2_engine_linea.h"
+#include "dMagnetic2_engine_vm68k.h"
+#include "dMagnetic2_metrics_shared.h"
+
+// the internal layout of the engine handle. it is shared between the files of the engine, but not with the frontends.
+
+#define	MAGIC			0x28844
+#define	MAGIC_HIBERNATED	0x28848		// the handle has been hibernated. only the first few members are valid.
+
+
+typedef struct _tdMagnetic2_game_context
+{
+	tVM68k	vm68k;
+	tVMLineA linea;
+} tdMagnetic2_game_context;
+
+typedef struct _tdMagnetic2_engine_handle
+{
+	unsigned int magic;
+	// those are still valid while the handle is hibernated. they fit into DMAGNETIC2_SIZE_HIBERNATED bytes.
+	unsigned char* pMagBuf;
+	void* pHibernated;
+	int hibernatedsize;
+
+	char inputbuf[DMAGNETIC2_SIZE_INPUTBUF];
+	// add one byte for 0 termination
+	char outputbuf[DMAGNETIC2_SIZE_OUTPUTBUF+1];
+	char titlebuf[DMAGNETIC2_SIZE_TITLEBUF+1];
+	char picnamebuf[DMAGNETIC2_SIZE_PICNAMEBUF+1];
+	int picturenum;
+	char filenamebuf[DMAGNETIC2_SIZE_FILENAMEBUF+1];
+
+
+	
+
+
+
+	int inputlevel;
+	int outputlevel;
+	int titlelevel;
+	int picnamelevel;
+	int filenamelevel;
+
+	unsigned int status_flags;
+	unsigned long long statehash;	// only valid when statehash_valid is set. cleared whenever the game makes progress
+	int statehash_valid;
+	int dictcopycapacity;		// the room for the copy of the dictionary. set by the first dMagnetic2_engine_set_mag()
+
+	// the trap counters of one dMagnetic2_engine_run(), before they go into the shared metrics.
+	// only the opcodes listed in traps_a_hit[] are non-zero, so only those have to be flushed.
+	unsigned int traps_a[256];
+	unsigned char traps_a_hit[256];
+	int traps_a_hitcnt;
+
+	tdMagnetic2_game_context	game_context;
+	// followed by the private copy of the dictionary, see dMagnetic2_engine_get_size_for_mag()
+} tdMagnetic2_engine_handle;
+#define	DICTCOPY(pThis)	(((tVM68k_ubyte*)(pThis))+sizeof(tdMagnetic2_engine_handle))
+
+// the counters for the whole process, see dMagnetic2_engine_metrics.c
+typedef struct _tdMagnetic2_engine_metrics_atomic
+{
+	atomic_ullong instructions;
+	atomic_ullong traps_a[256];
+	atomic_ullong traps_f;
+	atomic_ullong output_bytes;
+	atomic_ullong input_waits;
+} tdMagnetic2_engine_metrics_atomic;
+extern tdMagnetic2_engine_metrics_atomic dMagnetic2_engine_metrics;
+
+// internal helpers
+tVM68k_ulong dMagnetic2_engine_magchecksum(unsigned char* pMagBuf);
+int dMagnetic2_engine_relink(void* pHandle,unsigned char* pMagBuf);
+int dMagnetic2_engine_check_levels(tdMagnetic2_engine_handle* pThis);
+int dMagnetic2_engine_hibernate_get_variables(tdMagnetic2_engine_handle* pThis,unsigned char* pBuf,int size);
+int dMagnetic2_engine_hibernate_set_variables(tdMagnetic2_engine_handle* pThis,unsigned char* pBuf,int size);
+
+#endif
@@ -0,0 +1,345 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_shared.h"
+#include "dMagnetic2_engine_shared.h"
+#include "dMagnetic2_engine_handle.h"
+#include <string.h>
+
+// the purpose of this file is to put idle sessions to sleep.
+// the state is stored as the difference to a freshly loaded game: the registers, the persistent
+// variables of the line-A traps, the communication buffers and only those parts of the memory
+// that have changed. everything is stored big endian and without pointers, so the buffer can be
+// written to disk and resumed by another process. the pointers are relinked by dMagnetic2_engine_set_mag().
+// the dictionary is only stored when the game has written to it.
+//
+// @0   4 bytes "dM2H"
+// @4   4 bytes format version
+// @8   4 bytes total size
+// @12  4 bytes checksum of the mag header and code
+// @16  the variables, see dMagnetic2_engine_hibernate_variables()
+// @... the memory differences. 4 bytes offset, 2 bytes length, length bytes. terminated by a length of 0.
+
+#define	HIBERNATE_MAGIC		0x644d3248	// "dM2H"
+#define	HIBERNATE_VERSION	3		// 3: the dictionary copy is only as big as the dictionary
+#define	HIBERNATE_HEADERSIZE	16
+#define	HIBERNATE_MAXGAP	8		// unchanged bytes between two differences that are cheaper to store than a new record
+#define	HIBERNATE_MAXRUN	0xffff
+
+typedef struct _tdMagnetic2_engine_hibernate_stream
+{
+	unsigned char* pBuf;		// NULL when only counting
+	int size;
+	int idx;
+	int overflow;
+} tdMagnetic2_engine_hibernate_stream;
+
+static void dMagnetic2_engine_hibernate_putbytes(tdMagnetic2_engine_hibernate_stream* pStream,const void* pData,int n)
+{
+	if (pStream->pBuf!=NULL)
+	{
+		if (pStream->idx+n>pStream->size)
+		{
+			pStream->overflow=1;
+		} else {
+			memcpy(&pStream->pBuf[pStream->idx],pData,n);
+		}
+	}
+	pStream->idx+=n;
+}
+static void dMagnetic2_engine_hibernate_put32(tdMagnetic2_engine_hibernate_stream* pStream,tVM68k_ulong x)
+{
+	unsigned char tmp[4];
+	WRITE_INT32BE(tmp,0,x);
+	dMagnetic2_engine_hibernate_putbytes(pStream,tmp,4);
+}
+static void dMagnetic2_engine_hibernate_getbytes(tdMagnetic2_engine_hibernate_stream* pStream,void* pData,int n)
+{
+	if (n<0 || pStream->idx+n>pStream->size)
+	{
+		pStream->overflow=1;
+		memset(pData,0,(n<0)?0:n);
+	} else {
+		memcpy(pData,&pStream->pBuf[pStream->idx],n);
+	}
+	pStream->idx+=n;
+}
+static tVM68k_ulong dMagnetic2_engine_hibernate_get32(tdMagnetic2_engine_hibernate_stream* pStream)
+{
+	unsigned char tmp[4];
+	dMagnetic2_engine_hibernate_getbytes(pStream,tmp,4);
+	return READ_INT32BE(tmp,0);
+}
+
+// the memory of a freshly loaded game
+static tVM68k_ubyte dMagnetic2_engine_hibernate_pristine(unsigned char* pMagBuf,int codesize,int i)
+{
+	return (i<codesize)?pMagBuf[42+i]:0;
+}
+
+// the same order for storing and restoring. one of the two streams is NULL.
+#define	VAR(x)	\
+	if (pOut!=NULL) dMagnetic2_engine_hibernate_put32(pOut,(tVM68k_ulong)(x));	\
+	else (x)=dMagnetic2_engine_hibernate_get32(pIn);
+#define	BUF(x,len)	\
+	if (pOut!=NULL) dMagnetic2_engine_hibernate_putbytes(pOut,(x),(len));	\
+	else dMagnetic2_engine_hibernate_getbytes(pIn,(x),(len));
+static void dMagnetic2_engine_hibernate_variables(tdMagnetic2_engine_handle* pThis,tdMagnetic2_engine_hibernate_stream* pOut,tdMagnetic2_engine_hibernate_stream* pIn)
+{
+	tVM68k* pVM68k=&(pThis->game_context.vm68k);
+	tVMLineA* pVMLineA=&(pThis->game_context.linea);
+	int i;
+
+	// the engine
+	VAR(pThis->status_flags);
+	VAR(pThis->inputlevel);
+	VAR(pThis->outputlevel);
+	VAR(pThis->titlelevel);
+	VAR(pThis->picnamelevel);
+	VAR(pThis->filenamelevel);
+	VAR(pThis->picturenum);
+	if (pIn!=NULL && dMagnetic2_engine_check_levels(pThis)!=DMAGNETIC2_OK)	// do not trust the levels
+	{
+		pIn->overflow=1;
+		return;
+	}
+	BUF(pThis->inputbuf,pThis->inputlevel);
+	BUF(pThis->outputbuf,pThis->outputlevel+1);
+	BUF(pThis->titlebuf,pThis->titlelevel+1);
+	BUF(pThis->picnamebuf,sizeof(pThis->picnamebuf));
+	BUF(pThis->filenamebuf,sizeof(pThis->filenamebuf));
+
+	// the cpu
+	VAR(pVM68k->pcr);
+	VAR(pVM68k->sr);
+	for (i=0;i<8;i++)
+	{
+		VAR(pVM68k->a[i]);
+		VAR(pVM68k->d[i]);
+	}
+
+	// the line-A traps
+	VAR(pVMLineA->lastchar);
+	VAR(pVMLineA->headlineflagged);
+	VAR(pVMLineA->capital);
+	VAR(pVMLineA->jinxterslide);
+	VAR(pVMLineA->random_state);
+	VAR(pVMLineA->random_mode);
+	VAR(pVMLineA->properties_offset);
+	VAR(pVMLineA->linef_subroutine);
+	VAR(pVMLineA->linef_tab);
+	VAR(pVMLineA->linef_tabsize);
+	VAR(pVMLineA->properties_tab);
+	VAR(pVMLineA->properties_size);
+	VAR(pVMLineA->interrupted_byteidx);
+	VAR(pVMLineA->interrupted_bitidx);
+	VAR(pVMLineA->input_level);
+	VAR(pVMLineA->input_used);
+	if (pIn!=NULL && dMagnetic2_engine_linea_check(pVMLineA,pThis->pMagBuf)!=DMAGNETIC2_OK)	// nor the read positions of the traps
+	{
+		pIn->overflow=1;
+		return;
+	}
+
+	// the dictionary, in case the game has written to it
+	VAR(pVMLineA->dictcopy);
+	if (pVMLineA->dictcopy)
+	{
+		BUF(pVMLineA->pDictCopy,pVMLineA->dictcopysize);
+	}
+	if (pIn!=NULL)
+	{
+		dMagnetic2_engine_linea_relink(pVMLineA,pThis->pMagBuf);
+	}
+}
+#undef	VAR
+#undef	BUF
+// the variables alone, without the memory. returns the number of bytes, or -1 when pBuf is too small.
+int dMagnetic2_engine_hibernate_get_variables(tdMagnetic2_engine_handle* pThis,unsigned char* pBuf,int size)
+{
+	tdMagnetic2_engine_hibernate_stream out;
+	out.pBuf=pBuf;
+	out.size=size;
+	out.idx=0;
+	out.overflow=0;
+	dMagnetic2_engine_hibernate_variables(pThis,&out,NULL);
+	return out.overflow?-1:out.idx;
+}
+int dMagnetic2_engine_hibernate_set_variables(tdMagnetic2_engine_handle* pThis,unsigned char* pBuf,int size)
+{
+	tdMagnetic2_engine_hibernate_stream in;
+	in.pBuf=pBuf;
+	in.size=size;
+	in.idx=0;
+	in.overflow=0;
+	dMagnetic2_engine_hibernate_variables(pThis,NULL,&in);
+	return in.overflow?DMAGNETIC2_UNKNOWN_SOURCE:DMAGNETIC2_OK;
+}
+
+static void dMagnetic2_engine_hibernate_memory(tdMagnetic2_engine_handle* pThis,tdMagnetic2_engine_hibernate_stream* pOut)
+{
+	tVM68k* pVM68k=&(pThis->game_context.vm68k);
+	int codesize;
+	int start,end;
+	int i;
+
+	codesize=READ_INT32BE(pThis->pMagBuf,14);
+	i=0;
+	while (i<VM68K_MEMSIZE+VM68K_MEMGUARD)
+	{
+		if (pVM68k->memory[i]==dMagnetic2_engine_hibernate_pristine(pThis->pMagBuf,codesize,i))
+		{
+			i++;
+			continue;
+		}
+		// a difference starts here. it ends after HIBERNATE_MAXGAP unchanged bytes.
+		start=end=i;
+		while (i<VM68K_MEMSIZE+VM68K_MEMGUARD && i-end<HIBERNATE_MAXGAP && i-start<HIBERNATE_MAXRUN)
+		{
+			if (pVM68k->memory[i]!=dMagnetic2_engine_hibernate_pristine(pThis->pMagBuf,codesize,i))
+			{
+				end=i+1;
+			}
+			i++;
+		}
+		i=end;
+		dMagnetic2_engine_hibernate_put32(pOut,start);
+		dMagnetic2_engine_hibernate_putbytes(pOut,(unsigned char[2]){(end-start)>>8,(end-start)&0xff},2);
+		dMagnetic2_engine_hibernate_putbytes(pOut,&pVM68k->memory[start],end-start);
+	}
+	dMagnetic2_engine_hibernate_put32(pOut,0);
+	dMagnetic2_engine_hibernate_putbytes(pOut,(unsigned char[2]){0,0},2);
+}
+
+int dMagnetic2_engine_hibernate(void* pHandle,int *pSize,void* pBuf)
+{
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	tdMagnetic2_engine_hibernate_stream out;
+
+	if (pSize==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC || pThis->pMagBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	out.pBuf=(unsigned char*)pBuf;
+	out.size=*pSize;
+	out.idx=0;
+	out.overflow=0;
+	dMagnetic2_engine_hibernate_put32(&out,HIBERNATE_MAGIC);
+	dMagnetic2_engine_hibernate_put32(&out,HIBERNATE_VERSION);
+	dMagnetic2_engine_hibernate_put32(&out,0);	// the size is not known yet
+	dMagnetic2_engine_hibernate_put32(&out,dMagnetic2_engine_magchecksum(pThis->pMagBuf));
+	dMagnetic2_engine_hibernate_variables(pThis,&out,NULL);
+	dMagnetic2_engine_hibernate_memory(pThis,&out);
+	*pSize=out.idx;
+	if (pBuf==NULL)		// the caller just wanted to know the size
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (out.overflow)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	WRITE_INT32BE(out.pBuf,8,out.idx);
+
+	// from now on, the handle is only a stub. the caller may reuse everything after the first DMAGNETIC2_SIZE_HIBERNATED bytes.
+	pThis->magic=MAGIC_HIBERNATED;
+	pThis->pHibernated=pBuf;
+	pThis->hibernatedsize=out.idx;
+
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_engine_resume(void* pHandle,unsigned char* pMagBuf,int size,void* pBuf)
+{
+	tdMagnetic2_engine_handle* pThis=(tdMagnetic2_engine_handle*)pHandle;
+	tdMagnetic2_engine_hibernate_stream in;
+	tVM68k* pVM68k;
+	int retval;
+
+	if (pMagBuf==NULL || pBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	in.pBuf=(unsigned char*)pBuf;
+	in.size=size;
+	in.idx=0;
+	in.overflow=0;
+	if (size<HIBERNATE_HEADERSIZE || dMagnetic2_engine_hibernate_get32(&in)!=HIBERNATE_MAGIC || dMagnetic2_engine_hibernate_get32(&in)!=HIBERNATE_VERSION)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	if (dMagnetic2_engine_hibernate_get32(&in)>size)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (dMagnetic2_engine_hibernate_get32(&in)!=dMagnetic2_engine_magchecksum(pMagBuf))	// it was a different game
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+
+	// start with a freshly loaded game. this relinks all the pointers.
+	retval=dMagnetic2_engine_init(pHandle);
+	if (retval==DMAGNETIC2_OK) retval=dMagnetic2_engine_set_mag(pHandle,pMagBuf);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	dMagnetic2_engine_hibernate_variables(pThis,NULL,&in);
+
+	// apply the differences
+	pVM68k=&(pThis->game_context.vm68k);
+	while (!in.overflow)
+	{
+		tVM68k_ulong offset;
+		unsigned char tmp[2];
+		int len;
+		offset=dMagnetic2_engine_hibernate_get32(&in);
+		dMagnetic2_engine_hibernate_getbytes(&in,tmp,2);
+		len=READ_INT16BE(tmp,0);
+		if (len==0)
+		{
+			break;
+		}
+		if (offset>(tVM68k_ulong)(VM68K_MEMSIZE+VM68K_MEMGUARD) || (tVM68k_ulong)len>(tVM68k_ulong)(VM68K_MEMSIZE+VM68K_MEMGUARD)-offset)
+		{
+			in.overflow=1;
+		} else {
+			dMagnetic2_engine_hibernate_getbytes(&in,&pVM68k->memory[offset],len);
+		}
+	}
+	if (in.overflow)
+	{
+		pThis->magic=0;		// the handle is unusable now
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	return DMAGNETIC2_OK;
+}
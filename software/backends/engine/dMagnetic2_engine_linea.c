@@ -46,16 +46,23 @@ typedef struct _tProperties
 } tProperties;
 
 #define	MAGIC	0x42696e61      // ="Lina"
+// the size of the private copy of the dictionary. the original buffer continued with the undo section.
+int dMagnetic2_engine_linea_get_dictcopy_size(unsigned char *pMagBuf)
+{
+	int n;
+	n=READ_INT32BE(pMagBuf,26)+READ_INT32BE(pMagBuf,34);	// dictsize+undosize
+	if (n<0) n=0;
+	if (n>DMAGNETIC2_LINEA_DICTCOPY_SIZE) n=DMAGNETIC2_LINEA_DICTCOPY_SIZE;
+	return n;
+}
 int dMagnetic2_engine_linea_init(tVMLineA* pVMLineA,unsigned char *pMagBuf)
 {
-	int codesize;
 	int string1size;
 	int string2size;
 	int dictsize;
 	int decsize;
 	int undosize;
 	int undopc;
-	int idx;
 	int version;
 
 	memset(pVMLineA,0,sizeof(tVMLineA));
@@ -79,7 +86,6 @@ int dMagnetic2_engine_linea_init(tVMLineA* pVMLineA,unsigned char *pMagBuf)
 	}
 
 	version=pMagBuf[13];	
-	codesize=READ_INT32BE(pMagBuf,14);
 	string1size=READ_INT32BE(pMagBuf,18);
 	string2size=READ_INT32BE(pMagBuf,22);
 	dictsize=READ_INT32BE(pMagBuf,26);
@@ -89,35 +95,71 @@ int dMagnetic2_engine_linea_init(tVMLineA* pVMLineA,unsigned char *pMagBuf)
 
 	pVMLineA->version=version;
 
-	idx=42;
-	idx+=codesize;
-	pVMLineA->pStrings1=&pMagBuf[idx];
-	pVMLineA->pStringHuffman=&(pVMLineA->pStrings1[decsize]);
 	pVMLineA->string1size=string1size;
 	pVMLineA->string2size=string2size;
-	idx+=string1size;
-	idx+=string2size;
-	pVMLineA->pDict=&pMagBuf[idx];
 	pVMLineA->dictsize=dictsize;
-	idx+=dictsize;
-	
-	pVMLineA->pUndo=&pMagBuf[idx];
 	pVMLineA->undosize=undosize;
 	pVMLineA->undopc=undopc;
 	pVMLineA->decsize=decsize;
+	pVMLineA->dictcopysize=dMagnetic2_engine_linea_get_dictcopy_size(pMagBuf);
 
+	pVMLineA->random_state=12345;
 
-
+	return dMagnetic2_engine_linea_relink(pVMLineA,pMagBuf);
+}
+// the pointers to the interesting sections inside the mag buf. 
+// this is also being called when a session is re-attached to a (new) mag buf.
+int dMagnetic2_engine_linea_relink(tVMLineA* pVMLineA,unsigned char *pMagBuf)
+{
+	int idx;
+	if (pMagBuf[0]!='M' || pMagBuf[1]!='a' || pMagBuf[2]!='S' || pMagBuf[3]!='c')
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	pVMLineA->pMagBuf=pMagBuf;
+	idx=42;
+	idx+=READ_INT32BE(pMagBuf,14);	// codesize
+	pVMLineA->pStrings1=&pMagBuf[idx];
+	pVMLineA->pStringHuffman=&(pVMLineA->pStrings1[pVMLineA->decsize]);
+	idx+=pVMLineA->string1size;
+	idx+=pVMLineA->string2size;
+	pVMLineA->pDict=pVMLineA->dictcopy?pVMLineA->pDictCopy:&pMagBuf[idx];
+	idx+=pVMLineA->dictsize;
+	pVMLineA->pUndo=&pMagBuf[idx];
 
 	return DMAGNETIC2_OK;	
 }
+// a state which comes from outside (a hibernated blob, a slot in a store) has to belong to this mag buffer.
+// and the traps index their buffers with the read positions, so those have to be in range.
+int dMagnetic2_engine_linea_check(tVMLineA* pVMLineA,unsigned char *pMagBuf)
+{
+	if (pVMLineA->magic!=MAGIC || pVMLineA->version!=pMagBuf[13]
+		|| pVMLineA->string1size!=(tVM68k_ulong)READ_INT32BE(pMagBuf,18)
+		|| pVMLineA->string2size!=(tVM68k_ulong)READ_INT32BE(pMagBuf,22)
+		|| pVMLineA->dictsize!=(tVM68k_ulong)READ_INT32BE(pMagBuf,26)
+		|| pVMLineA->decsize!=(tVM68k_ulong)READ_INT32BE(pMagBuf,30)
+		|| pVMLineA->undosize!=(tVM68k_ulong)READ_INT32BE(pMagBuf,34)
+		|| pVMLineA->dictcopysize!=dMagnetic2_engine_linea_get_dictcopy_size(pMagBuf))
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	if (pVMLineA->input_level<0 || pVMLineA->input_level>DMAGNETIC2_SIZE_INPUTBUF
+		|| pVMLineA->input_used<0 || pVMLineA->input_used>=DMAGNETIC2_SIZE_INPUTBUF
+		|| pVMLineA->interrupted_byteidx<0 || (tVM68k_ulong)pVMLineA->interrupted_byteidx>pVMLineA->string1size+pVMLineA->string2size
+		|| pVMLineA->interrupted_bitidx>7)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	return DMAGNETIC2_OK;
+}
 int dMagnetic2_engine_linea_link_communication(tVMLineA* pVMLineA,
 	tVM68k* pVM68k,
 	char* inputbuf,int *pInputLevel,
 	char* textbuf,int *pTextLevel,
 	char* titlebuf,int *pTitleLevel,
 	char* picnamebuf,int *pPicnameLevel,int *pPictureNum,
-	char* filenamebuf,int *pFilenameLevel
+	char* filenamebuf,int *pFilenameLevel,
+	tVM68k_ubyte* dictcopy
 )
 {
 	pVMLineA->pVM68k=pVM68k;
@@ -137,12 +179,24 @@ int dMagnetic2_engine_linea_link_communication(tVMLineA* pVMLineA,
 
 	pVMLineA->pFilenameBuf=filenamebuf;
 	pVMLineA->pFilenameLevel=pFilenameLevel;
-
-	pVMLineA->random_state=12345;
+	pVMLineA->pDictCopy=dictcopy;
+	if (pVMLineA->dictcopy)
+	{
+		pVMLineA->pDict=dictcopy;
+	}
 
 	return DMAGNETIC2_OK;
 }
 
+// the readers of the dictionary stop at its end. beyond it, they find the end marker.
+static tVM68k_ubyte dMagnetic2_engine_linea_dictbyte(tVMLineA* pVMLineA,tVM68k_ulong idx)
+{
+	if (idx>=(tVM68k_ulong)pVMLineA->dictcopysize)
+	{
+		return 0x81;
+	}
+	return pVMLineA->pDict[idx];
+}
 int dMagnetic2_engine_linea_istrap(tVM68k_uword *pOpcode)
 {
 	tVM68k_uword inst;
@@ -285,18 +339,35 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 					i=0;
 					if (pVMLineA->input_level>pVMLineA->input_used)	// still characters in the buffer?
 					{
-						tVM68k_ubyte c;
+						tVM68k_ubyte* pSrc;
+						tVM68k_ulong dst;
+						int n;
+						pSrc=(tVM68k_ubyte*)&pVMLineA->pInputBuf[pVMLineA->input_used];
+						dst=pVM68k->a[1];
+						n=pVMLineA->input_level-pVMLineA->input_used;
+						if (n>DMAGNETIC2_SIZE_INPUTBUF)
+						{
+							n=DMAGNETIC2_SIZE_INPUTBUF;
+						}
+						// find the end of the line first
 						do
 						{
-							c=pVMLineA->pInputBuf[pVMLineA->input_used];
-							if (c==0)
+							i++;
+						} while (i<n && pSrc[i-1]!=0 && pSrc[i-1]!='\n');
+						if (dst<=pVM68k->memsize && (tVM68k_ulong)i<=pVM68k->memsize-dst)
+						{
+							memcpy(&pVM68k->memory[dst],pSrc,i);
+						} else {
+							for (n=0;n<i;n++)
 							{
-								c='\n';	// apparently, the virtual machine wants its strings CR terminated.
+								pVM68k->memory[VM68K_WRAP(pVM68k,dst+n)]=pSrc[n];
 							}
-							WRITE_INT8BE(pVM68k->memory,(pVM68k->a[1]+i),c);
-							pVMLineA->input_used++;					// increase the read pointer for the next time.
-							i++;
-						} while (i<DMAGNETIC2_SIZE_INPUTBUF  && pVMLineA->input_level>pVMLineA->input_used && c!='\n');
+						}
+						if (pSrc[i-1]==0)
+						{
+							pVM68k->memory[VM68K_WRAP(pVM68k,dst+i-1)]='\n';	// apparently, the virtual machine wants its strings CR terminated.
+						}
+						pVMLineA->input_used+=i;		// increase the read pointer for the next time.
 					}
 					if (pVMLineA->input_level==pVMLineA->input_used) 	// the input buffer has been fully read
 					{
@@ -330,16 +401,26 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 		case 0xa0ea:	// print a word from the dictionary. the beginning INDEX is stored in A1. the headline flag is signalled in D1.
 			{
 				unsigned char c;
-				tVM68k_ubyte*	dictptr;
+				unsigned char span[DMAGNETIC2_LINEA_SPAN_SIZE];
+				int spanlen;
 				tVM68k_uword	dictidx;
 
-				dictptr=pVMLineA->pDict;
 				dictidx=pVM68k->a[1]&0xffff;
+				spanlen=0;
 				do
 				{
-					c=dictptr[dictidx++];
-					dMagnetic2_engine_linea_newchar(pVMLineA,c,pVM68k->d[2]&0xff,pVM68k->d[1]&0xff,pStatus);
+					c=dMagnetic2_engine_linea_dictbyte(pVMLineA,dictidx++);
+					span[spanlen++]=c;
+					if (spanlen==DMAGNETIC2_LINEA_SPAN_SIZE)
+					{
+						dMagnetic2_engine_linea_newchars(pVMLineA,span,spanlen,pVM68k->d[2]&0xff,pVM68k->d[1]&0xff,pStatus);
+						spanlen=0;
+					}
 				} while (!(c&0x80));
+				if (spanlen)
+				{
+					dMagnetic2_engine_linea_newchars(pVMLineA,span,spanlen,pVM68k->d[2]&0xff,pVM68k->d[1]&0xff,pStatus);
+				}
 				pVM68k->a[1]&=0xffff0000;
 				pVM68k->a[1]|=dictidx;
 			}
@@ -384,7 +465,7 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 //				int datalen;
 				*pStatus|=DMAGNETIC2_ENGINE_STATUS_SAVE;
 				// the filename is stored at a[0]
-				nameptr=pVM68k->a[0]%pVM68k->memsize; // where in the memory is the filename?
+				nameptr=VM68K_WRAP(pVM68k,pVM68k->a[0]); // where in the memory is the filename?
 //				namelen=pVM68k->d[0];		// PROBABLY the filename is this long.
 				namelen=DMAGNETIC2_SIZE_FILENAMEBUF;	// but i am not sure
 				if (namelen>=DMAGNETIC2_SIZE_FILENAMEBUF) namelen=DMAGNETIC2_SIZE_FILENAMEBUF-1;
@@ -403,7 +484,7 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 //				int datalen;
 				*pStatus|=DMAGNETIC2_ENGINE_STATUS_LOAD;
 				// the filename is stored at a[0]
-				nameptr=pVM68k->a[0]%pVM68k->memsize; // where in the memory is the filename?
+				nameptr=VM68K_WRAP(pVM68k,pVM68k->a[0]); // where in the memory is the filename?
 				//namelen=pVM68k->d[0];		// PROBABLY the filename is this long.
 				namelen=DMAGNETIC2_SIZE_FILENAMEBUF;	// but i am not sure
 				if (namelen>=DMAGNETIC2_SIZE_FILENAMEBUF) namelen=DMAGNETIC2_SIZE_FILENAMEBUF-1;
@@ -433,8 +514,11 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 				tVM68k_ulong byteidx;
 				tVM68k_ubyte bitidx;
 				int retval;
+				unsigned char span[DMAGNETIC2_LINEA_SPAN_SIZE];
+				int spanlen;
 
 				char c;
+				spanlen=0;
 				if (!(pVM68k->sr&(1<<0)))	// cflag is in bit 0.
 				{
 					bitidx=0;
@@ -479,15 +563,26 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 					val&=0x7f;	// remove bit 7.
 					c=val;
 
-
-					retval=dMagnetic2_engine_linea_newchar(pVMLineA,c,pVM68k->d[2]&0xff,pVM68k->d[3]&0xff,pStatus);
+					span[spanlen++]=c;	// the characters are handed over in one go
+					if (spanlen==DMAGNETIC2_LINEA_SPAN_SIZE)
+					{
+						retval=dMagnetic2_engine_linea_newchars(pVMLineA,span,spanlen,pVM68k->d[2]&0xff,pVM68k->d[3]&0xff,pStatus);
+						if (retval!=DMAGNETIC2_OK)
+						{
+							return retval;
+						}
+						spanlen=0;
+					}
+				}
+				while (val!=0 && !(prevval==' ' && val=='@'));	// end markers for the string are \0 and " @"
+				if (spanlen)
+				{
+					retval=dMagnetic2_engine_linea_newchars(pVMLineA,span,spanlen,pVM68k->d[2]&0xff,pVM68k->d[3]&0xff,pStatus);
 					if (retval!=DMAGNETIC2_OK)
 					{
 						return retval;
 					}
-
 				}
-				while (val!=0 && !(prevval==' ' && val=='@'));	// end markers for the string are \0 and " @"
 				if (prevval==' ' && val=='@')		// extend the string next time this function is being called.
 				{
 					pVM68k->sr|=(1<<0);	// set the cflag. cflag=bit 0.
@@ -517,7 +612,7 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 		case 0xa0e4:
 			{
 					pVM68k->a[7]+=4;	// increase the stack pointer? maybe skip an entry or something?
-					pVM68k->pcr=READ_INT32BE(pVM68k->memory,pVM68k->a[7])%pVM68k->memsize;
+					pVM68k->pcr=VM68K_WRAP(pVM68k,READ_INT32BE(pVM68k->memory,pVM68k->a[7]));
 					pVM68k->a[7]+=4;
 			}
 			break;
@@ -535,7 +630,7 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 				if (opcode==0xa0e4 || opcode==0xa0e5 || opcode==0xa0e6)
 				{
 					// RTS: poplongfromstack(pcr);
-					pVM68k->pcr=READ_INT32BE(pVM68k->memory,pVM68k->a[7])%pVM68k->memsize;
+					pVM68k->pcr=VM68K_WRAP(pVM68k,READ_INT32BE(pVM68k->memory,pVM68k->a[7]));
 					pVM68k->a[7]+=4;
 				}
 			}
@@ -544,23 +639,53 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 			{	// strcpy a word from the dictionary into the memory.
 				// source is in A1
 				// destination is A0
-				tVM68k_ubyte tmp;
-				do
+				tVM68k_ulong n;
+				tVM68k_ulong dst;
+				tVM68k_ulong src;
+				src=pVM68k->a[1];
+				dst=pVM68k->a[0];
+				// the last character of the word has bit 7 set.
+				n=0;
+				while (!(dMagnetic2_engine_linea_dictbyte(pVMLineA,src+n++)&0x80));
+				if (dst<=pVM68k->memsize && n<=pVM68k->memsize-dst && src<(tVM68k_ulong)pVMLineA->dictcopysize && n<=(tVM68k_ulong)pVMLineA->dictcopysize-src)
 				{
-					tmp=pVMLineA->pDict[pVM68k->a[1]++];
-					pVM68k->memory[pVM68k->a[0]++]=tmp;
-				} while (!(tmp&0x80));
+					memcpy(&pVM68k->memory[dst],&pVMLineA->pDict[src],n);
+				} else {
+					tVM68k_ulong i;
+					for (i=0;i<n;i++)
+					{
+						pVM68k->memory[VM68K_WRAP(pVM68k,dst+i)]=dMagnetic2_engine_linea_dictbyte(pVMLineA,src+i);
+					}
+				}
+				pVM68k->a[1]+=n;
+				pVM68k->a[0]+=n;
 			}
 			break;
 		case 0xa0eb:	// write the byte stored in D1 into the dictionary at index A1
 			{
-				pVMLineA->pDict[pVM68k->a[1]&0xffff]=pVM68k->d[1]&0xff;
+				tVM68k_ulong idx;
+				if (!pVMLineA->dictcopy)	// do not write into the shared mag buffer
+				{
+					memcpy(pVMLineA->pDictCopy,pVMLineA->pDict,pVMLineA->dictcopysize);
+					pVMLineA->pDict=pVMLineA->pDictCopy;
+					pVMLineA->dictcopy=1;
+				}
+				idx=pVM68k->a[1]&0xffff;
+				if (idx<(tVM68k_ulong)pVMLineA->dictcopysize)	// the copy ends where the mag buffer did
+				{
+					pVMLineA->pDict[idx]=pVM68k->d[1]&0xff;
+				}
 			}
 			break;
 		case 0xa0ec:	// read one byte stored @A1 from the dictionary. write it into register D0.	(jinxter)
 			{
+				tVM68k_ulong idx;
+				idx=pVM68k->a[1]&0xffff;
 				pVM68k->d[1]&=0xffffff00;
-				pVM68k->d[1]|=pVMLineA->pDict[pVM68k->a[1]&0xffff]&0xff;
+				if (!pVMLineA->dictcopy || idx<(tVM68k_ulong)pVMLineA->dictcopysize)
+				{
+					pVM68k->d[1]|=pVMLineA->pDict[idx]&0xff;
+				}
 			}
 			break;
 		case 0xa0f1:
@@ -726,6 +851,7 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 		case 0xa0fb:
 			{	// skip D2 many words in the dictionary, that is pointed at by A1
 				tVM68k_ubyte*	dictptr;
+				tVM68k_ulong	dictbase;
 				tVM68k_uword	dictidx;
 				tVM68k_ubyte	cdict;
 				int i;
@@ -733,19 +859,19 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 
 
 				dictidx=0;
+				dictptr=NULL;
+				dictbase=pVM68k->a[1]&0xffff;
 				if (version==0 || pVMLineA->pDict==NULL || pVMLineA->dictsize==0) 
 				{
-					dictptr=&pVM68k->memory[pVM68k->a[1]&0xffff];
-				} else {
-					//dictptr=pVMLineA->pDict;
-					dictptr=&pVMLineA->pDict[pVM68k->a[1]&0xffff];
+					dictptr=&pVM68k->memory[dictbase];
 				}
 				n=(pVM68k->d[2]&0xffff);
 				for (i=0;i<n;i++)
 				{
 					do
 					{
-						cdict= READ_INT8BE(dictptr,dictidx++);
+						cdict=(dictptr!=NULL)?READ_INT8BE(dictptr,dictidx):dMagnetic2_engine_linea_dictbyte(pVMLineA,dictbase+dictidx);
+						dictidx++;
 					} while (!(cdict&0x80));	// until the end marker
 				}
 				pVM68k->d[2]&=0xffff0000;	// that was a counter
@@ -756,16 +882,17 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 			{
 				tVM68k_ubyte*	dictptr;
 				tVM68k_ubyte*	inputptr;
+				tVM68k_ulong	dictbase;
 				tVM68k_uword	dictidx;
 				tVM68k_uword	inputidx;
 				int i,n;
 				dictidx=0;
 				inputidx=0;
+				dictptr=NULL;
+				dictbase=pVM68k->a[0]&0xffff;
 				if (version==0 || pVMLineA->pDict==NULL || pVMLineA->dictsize==0) 
 				{
-					dictptr=&pVM68k->memory[pVM68k->a[0]&0xffff];	// TODO: version 0. 
-				} else {
-					dictptr=&pVMLineA->pDict[pVM68k->a[0]&0xffff];
+					dictptr=&pVM68k->memory[dictbase];	// TODO: version 0. 
 				}
 				inputptr=&pVM68k->memory[pVM68k->a[1]&0xffff];
 				n=(pVM68k->d[0])&0xffff;
@@ -774,7 +901,8 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 					tVM68k_ubyte cdebug;
 					do
 					{
-						cdebug=dictptr[dictidx++];
+						cdebug=(dictptr!=NULL)?dictptr[dictidx]:dMagnetic2_engine_linea_dictbyte(pVMLineA,dictbase+dictidx);
+						dictidx++;
 					}
 					while (!(cdebug&0x80));	// in the dictionary, the end marker is bit 7 being set.
 					do
@@ -855,6 +983,8 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 
 				{
 					tVM68k_ubyte* dtabptr;
+					tVM68k_ulong  dictbase;
+					tVM68k_ulong  dtabbase;
 					tVM68k_ubyte* inputptr;
 					tVM68k_ubyte* outputptr;
 					tVM68k_ubyte* dictptr;
@@ -884,14 +1014,13 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 					flag2=0;
 
 					inputptr  =&pVM68k->memory[pVM68k->a[6]];
+					dictbase=pVM68k->a[3]&0xffff;
+					dtabbase=pVM68k->a[5]&0xffff;	// version>0
+					dictptr=dtabptr=NULL;		// NULL: read from the dictionary, with bounds
 					if (version==0 || pVMLineA->pDict==NULL || pVMLineA->dictsize==0) 
 					{
-						dictptr=&pVM68k->memory[pVM68k->a[3]&0xffff];
-						dtabptr=&pVM68k->memory[pVM68k->a[5]&0xffff];	// version>0
-					} else {
-						dictptr=&pVMLineA->pDict[pVM68k->a[3]&0xffff];
-						dtabptr=&pVMLineA->pDict[pVM68k->a[5]&0xffff];	// version>0
-
+						dictptr=&pVM68k->memory[dictbase];
+						dtabptr=&pVM68k->memory[dtabbase];
 					}
 					outputptr =&pVM68k->memory[pVM68k->a[2]];
 					objectptr =&pVM68k->memory[pVM68k->a[1]];
@@ -913,7 +1042,8 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 					// 
 					while (cdict!=0x81)	// 0x81 is the end marker of the dictionary
 					{
-						cdict=dictptr[dictidx++];
+						cdict=(dictptr!=NULL)?dictptr[dictidx]:dMagnetic2_engine_linea_dictbyte(pVMLineA,dictbase+dictidx);
+						dictidx++;
 						if (cdict==0x82)	// bank separator
 						{
 							flag=0;
@@ -1011,7 +1141,14 @@ int dMagnetic2_engine_linea_trapa(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigne
 							if (bank==0x0b)
 							{
 								tVM68k_uword substword;
-								substword=READ_INT16BE(dtabptr,wordidx*2);		// TODO: version >1???
+								if (dtabptr!=NULL)
+								{
+									substword=READ_INT16BE(dtabptr,wordidx*2);		// TODO: version >1???
+								} else {
+									substword=dMagnetic2_engine_linea_dictbyte(pVMLineA,dtabbase+wordidx*2);
+									substword<<=8;
+									substword|=dMagnetic2_engine_linea_dictbyte(pVMLineA,dtabbase+wordidx*2+1);
+								}
 
 								// the lower 5 bits are the bank.
 								// the upper 11 bits in the substitute database are the actual word index.
@@ -1159,7 +1296,7 @@ int dMagnetic2_engine_linea_trapf(tVMLineA* pVMLineA,tVM68k_uword opcode)
 		WRITE_INT32BE(pVM68k->memory,pVM68k->a[7],pVM68k->pcr);
 
 		// jump to the preconfigured address
-		pVM68k->pcr=(pVMLineA->linef_subroutine)%pVM68k->memsize;
+		pVM68k->pcr=VM68K_WRAP(pVM68k,pVMLineA->linef_subroutine);
 	} else {
 		int idx;
 		int base;
@@ -1176,14 +1313,14 @@ int dMagnetic2_engine_linea_trapf(tVMLineA* pVMLineA,tVM68k_uword opcode)
 			idx=(opcode|0x0800);
 			idx^=0xffff;
 			base=(signed short)READ_INT16BE(pVM68k->memory,(pVMLineA->linef_tab+2*idx));
-			pVM68k->pcr=(pVMLineA->linef_tab+2*idx+base)%pVM68k->memsize;	// weird, but it works.
+			pVM68k->pcr=VM68K_WRAP(pVM68k,pVMLineA->linef_tab+2*idx+base);	// weird, but it works.
 		} else {
 			// push the PCR to the the stack
 			pVM68k->a[7]-=4;
 			WRITE_INT32BE(pVM68k->memory,pVM68k->a[7],pVM68k->pcr);
 
 			// jump to the preconfigured address
-			pVM68k->pcr=(pVMLineA->linef_subroutine)%pVM68k->memsize;
+			pVM68k->pcr=VM68K_WRAP(pVM68k,pVMLineA->linef_subroutine);
 		}
 	}
 	return DMAGNETIC2_OK;
@@ -31,6 +31,11 @@
 #include "dMagnetic2_shared.h"
 
 
+// the mag buffer is treated as read only, so several sessions can share it. the dictionary
+// is the only part which is written by the game. it gets copied once this happens. the copy
+// needs dictsize+undosize bytes, at most this many.
+#define	DMAGNETIC2_LINEA_DICTCOPY_SIZE	65536	// the index is 16 bit
+
 typedef	struct _tVMLineA
 {
 	unsigned int magic;
@@ -54,6 +59,8 @@ typedef	struct _tVMLineA
 	tVM68k_ubyte*	pUndo;
 	tVM68k_ulong	undosize;
 	tVM68k_slong	undopc;
+	tVM68k_ubyte*	pDictCopy;		// the private copy of the dictionary, for games writing to it
+	int		dictcopysize;		// the number of bytes in it
 
 ///////////// some pointers for the shared communication
 	tVM68k	*pVM68k;
@@ -85,6 +92,7 @@ typedef	struct _tVMLineA
 	tVM68k_uword	properties_size;			// version >2
 	tVM68k_slong	interrupted_byteidx;
 	tVM68k_ubyte	interrupted_bitidx;
+	int		dictcopy;		// set once pDict points to pDictCopy
 
 // input level reader
 	int input_level;
@@ -93,14 +101,18 @@ typedef	struct _tVMLineA
 } tVMLineA;
 
 
+int dMagnetic2_engine_linea_get_dictcopy_size(unsigned char *pMagBuf);
 int dMagnetic2_engine_linea_init(tVMLineA* pVMLineA,unsigned char *pMagBuf);
+int dMagnetic2_engine_linea_relink(tVMLineA* pVMLineA,unsigned char *pMagBuf);
+int dMagnetic2_engine_linea_check(tVMLineA* pVMLineA,unsigned char *pMagBuf);
 int dMagnetic2_engine_linea_link_communication(tVMLineA* pVMLineA,
 	tVM68k* pVM68k,
 	char* inputbuf,int *pInputLevel,
 	char* textbuf,int *pTextLevel,
 	char* titlebuf,int *pTitleLevel,
 	char* picnamebuf,int *pPicnameLevel,int *pPictureNum,
-	char* filenamebuf,int *pFilenameLevel
+	char* filenamebuf,int *pFilenameLevel,
+	tVM68k_ubyte* dictcopy
 );
 int dMagnetic2_engine_linea_istrap(tVM68k_uword *pOpcode);
 int dMagnetic2_engine_linea_singlestep(tVMLineA* pVMLineA,tVM68k_uword opcode,unsigned int *pStatus);
@@ -12,7 +12,7 @@
 // 2. Redistributions in binary form must reproduce the above copyright notice,
 //    this list of conditions and the following disclaimer in the documentation
 //    and/or other materials provided with the distribution.
-// 
+//
 // THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
 // AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
 // IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
@@ -27,6 +27,7 @@
 #include "dMagnetic2_errorcodes.h"
 #include "dMagnetic2_engine.h"
 #include "dMagnetic2_engine_linea.h"
+#include "dMagnetic2_engine_linea_textconversion.h"
 #include "dMagnetic2_engine_vm68k.h"
 #include "dMagnetic2_shared.h"
 #include <stdio.h>
@@ -37,171 +38,198 @@ int dMagnetic2_engine_linea_flush(tVMLineA* pVMLineA)
 	return DMAGNETIC2_OK;
 }
 
+// the character classes for the rules below. the highest bit has been removed at this point.
+#define	CC_ALPHA	(1<<0)		// a letter
+#define	CC_DIGIT	(1<<1)
+#define	CC_END		(1<<2)		// . ! : ?	a sentence is ending
+#define	CC_PAUSE	(1<<3)		// . ! : ? , ;	a space comes after it
+#define	CC_TIGHT	(1<<4)		// , ; . !	no space comes before it
+#define	CC_PRINT	(1<<5)		// printable, and the newline
+static const unsigned char dMagnetic2_engine_linea_charclass[128]={
+	0,0,0,0,0,0,0,0,0,0,CC_PRINT,0,0,0,0,0,	// 0x00
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,	// 0x10
+	CC_PRINT,CC_END|CC_PAUSE|CC_TIGHT|CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PAUSE|CC_TIGHT|CC_PRINT,CC_PRINT,CC_END|CC_PAUSE|CC_TIGHT|CC_PRINT,CC_PRINT,	// 0x20
+	CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_DIGIT|CC_PRINT,CC_END|CC_PAUSE|CC_PRINT,CC_PAUSE|CC_TIGHT|CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_END|CC_PAUSE|CC_PRINT,	// 0x30
+	0,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,	// 0x40
+	CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,	// 0x50
+	CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,	// 0x60
+	CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_ALPHA|CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,CC_PRINT,0,	// 0x70
+};
+
 int dMagnetic2_engine_linea_newchar(tVMLineA* pVMLineA,unsigned char c,unsigned char controlD2,unsigned char flag_headline,unsigned int *pStatus)
 {
+	return dMagnetic2_engine_linea_newchars(pVMLineA,&c,1,controlD2,flag_headline,pStatus);
+}
+
+// the decoded strings are handled as a whole. the levels of the output buffers are only read
+// and written once, the rules are applied character by character.
+int dMagnetic2_engine_linea_newchars(tVMLineA* pVMLineA,unsigned char* pChars,int n,unsigned char controlD2,unsigned char flag_headline,unsigned int *pStatus)
+{
+	unsigned char c;
 	unsigned char c2;
+	unsigned char cc;
+	unsigned char lastcc;
 	int textlevel;
 	int titlelevel;
+	int textlevel0;
+	int titlelevel0;
+	int written;
+	int i;
+	char* pTextBuf=pVMLineA->pTextBuf;
+	char* pTitleBuf=pVMLineA->pTitleBuf;
 
 
 	textlevel=*(pVMLineA->pTextLevel);
 	titlelevel=*(pVMLineA->pTitleLevel);
-	// one line, ending with a dash -
-	// is some kind of code for a "verbatim" mode.
-	// it is needed for a sliding puzzle in JINXTER.
-	if (pVMLineA->jinxterslide)
+	written=0;
+	for (i=0;i<n;i++)
 	{
-		if ((c>='a' && c<='z') || (c>='A' && c<='Z') || (c==0x5a && pVMLineA->lastchar=='\n'))
+		c=pChars[i];
+		textlevel0=textlevel;
+		titlelevel0=titlelevel;
+		// one line, ending with a dash -
+		// is some kind of code for a "verbatim" mode.
+		// it is needed for a sliding puzzle in JINXTER.
+		if (pVMLineA->jinxterslide)
 		{
-			// The sliding puzzle ends with the phrase "As the blocks slide into their final position". Or with two newlines.
-			pVMLineA->jinxterslide=0;
+			if ((c>='a' && c<='z') || (c>='A' && c<='Z') || (c==0x5a && pVMLineA->lastchar=='\n'))
+			{
+				// The sliding puzzle ends with the phrase "As the blocks slide into their final position". Or with two newlines.
+				pVMLineA->jinxterslide=0;
+			}
+		} else if (c==0x5e && pVMLineA->lastchar==0x2d) {
+			pVMLineA->jinxterslide=1;
 		}
-	} else if (c==0x5e && pVMLineA->lastchar==0x2d) {
-		pVMLineA->jinxterslide=1;
-	}
-	
-	// prevent double newlines
-//	if (pVMLineA->jinxterslide==0 && (c=='\n' || c==0x5e) && (pVMLineA->lastchar==0 || pVMLineA->lastchar=='\n'))
-//	{
-//		return DMAGNETIC2_OK;
-//	}
 
-
-	if (flag_headline && !pVMLineA->headlineflagged) 	// this starts a headline
-	{
-		*(pVMLineA->pTextLevel)=textlevel;
-		*(pVMLineA->pTitleLevel)=titlelevel;
-		dMagnetic2_engine_linea_flush(pVMLineA);	// make sure the output buffers are being flushed
-		titlelevel=0;
-	}
-	if (!flag_headline && pVMLineA->headlineflagged)	// after the headline ends, a new paragraph is beginning
-	{
-		int i;
-		pVMLineA->capital=1;	// obviously, this starts with a capital letter
-		for (i=0;i<titlelevel;i++)
+		if (flag_headline && !pVMLineA->headlineflagged) 	// this starts a headline
+		{
+			*(pVMLineA->pTextLevel)=textlevel;
+			*(pVMLineA->pTitleLevel)=titlelevel;
+			dMagnetic2_engine_linea_flush(pVMLineA);	// make sure the output buffers are being flushed
+			titlelevel=0;
+		}
+		if (!flag_headline && pVMLineA->headlineflagged)	// after the headline ends, a new paragraph is beginning
 		{
-			if (pVMLineA->pTitleBuf[i]<' ')
+			int j;
+			pVMLineA->capital=1;	// obviously, this starts with a capital letter
+			for (j=0;j<titlelevel;j++)
 			{
-				pVMLineA->pTitleBuf[i]=0;
-				titlelevel--;
+				if (pTitleBuf[j]<' ')
+				{
+					pTitleBuf[j]=0;
+					titlelevel--;
+				}
 			}
 		}
-	}
-	pVMLineA->headlineflagged=flag_headline;
+		pVMLineA->headlineflagged=flag_headline;
 
-	//newline=0;
-	if (c==0xff)	// mark the next letter as Capital
-	{
-		pVMLineA->capital=1;
-	} else {
-		c2=c&0x7f;	// the highest bit was an end marker for the hufman tree in the dictionary
-		// THE RULES FOR THE OUTPUT ARE:
-		// replace tabs and _ with space.
-		// the headline is printed in upper case letters.
-		// after a . there has to be a space.
-		// and after a . The next letter has to be uppercase.
-		// multiple spaces are to be reduced to a single one.
-		// the characters ~ and ^ are to be translated into line feeds.
-		// the caracter 0xff makes the next one upper case.
-		// after a second newline comes a capital letter.
-		// the special marker '@' is either an end marker, or must be substituted by an 's', so that "He thank@ you", and "It contain@ a key" become gramatically correct.
-		if (!(pVMLineA->jinxterslide))
+		if (c==0xff)	// mark the next letter as Capital
 		{
-			if (c2==9 || c2=='_') c2=' ';
-			if (flag_headline && (c2==0x5f || c2==0x40)) c2=' ';	// in a headline, those are the control codes for a space.
-			if (c2==0x40) 	// '@' is a special character
-			{
-				if (controlD2 || pVMLineA->lastchar==' ') return 0;	// When D2 is set, or the last character was a whitespace, it is an end marker
-				else c2='s';						// otherwise it must be substituted for an 's'. One example would be "It contain@ a key".
-			}
-			if (c2==0x5e || c2==0x7e) c2=0x0a;	// ~ or ^ is actually a line feed.
-			if (c2==0x0a && pVMLineA->lastchar==0x0a) 	// after two consequitive newlines comes a capital letter.
-			{
-				pVMLineA->capital=1;
-			}
-			if (c2=='.' || c2=='!' || c2==':' || c2=='?')	// a sentence is ending.
+			pVMLineA->capital=1;
+		} else {
+			c2=c&0x7f;	// the highest bit was an end marker for the hufman tree in the dictionary
+			// THE RULES FOR THE OUTPUT ARE:
+			// replace tabs and _ with space.
+			// the headline is printed in upper case letters.
+			// after a . there has to be a space.
+			// and after a . The next letter has to be uppercase.
+			// multiple spaces are to be reduced to a single one.
+			// the characters ~ and ^ are to be translated into line feeds.
+			// the caracter 0xff makes the next one upper case.
+			// after a second newline comes a capital letter.
+			// the special marker '@' is either an end marker, or must be substituted by an 's', so that "He thank@ you", and "It contain@ a key" become gramatically correct.
+			if (!(pVMLineA->jinxterslide))
 			{
-				pVMLineA->capital=1;
-			}
-			if (((c2>='a' && c2<='z') || (c2>='A' && c2<='Z')) && (pVMLineA->capital||flag_headline)) 	// the first letter must be written as uppercase. As well as the headline.
-			{
-				pVMLineA->capital=0;	// ONLY the first character
-				c2&=0x5f;	// upper case
-			}
-			//newline=0;
-			if (
-					(pVMLineA->lastchar=='.' || pVMLineA->lastchar=='!' || pVMLineA->lastchar==':' || pVMLineA->lastchar=='?'|| pVMLineA->lastchar==',' || pVMLineA->lastchar==';') 	// a sentence as ended
-					&&  ((c2>='A' && c2<='Z') ||(c2>='a' && c2<='z') ||(c2>='0' && c2<='9'))) 	// and a new one is beginning.
-			{
-				// after those letters comes an extra space.otherwise,it would look weird.
-				if (flag_headline) 
+				if (c2==9 || c2=='_') c2=' ';
+				if (flag_headline && c2==0x40) c2=' ';	// in a headline, those are the control codes for a space.
+				if (c2==0x40) 	// '@' is a special character
 				{
-					if (titlelevel<DMAGNETIC2_SIZE_TITLEBUF-1)
-						pVMLineA->pTitleBuf[titlelevel++]=' ';
-				} else {
-					if (textlevel<DMAGNETIC2_SIZE_OUTPUTBUF-1)
+					if (controlD2 || pVMLineA->lastchar==' ')	// When D2 is set, or the last character was a whitespace, it is an end marker
 					{
-						pVMLineA->pTextBuf[textlevel++]=' ';
+						textlevel=textlevel0;	// nothing of this character makes it into the buffers
+						titlelevel=titlelevel0;
+						continue;
 					}
+					else c2='s';						// otherwise it must be substituted for an 's'. One example would be "It contain@ a key".
 				}
-			}
-			if (textlevel>0 && pVMLineA->lastchar==' ' && (c2==',' || c2==';' || c2=='.' || c2=='!'))	// there have been some glitches with extra spaces, right before a komma. which , as you can see , looks weird.
-			{
-				textlevel--;
-			}
-			if (	//allow multiple spaces in certain scenarios
-					flag_headline || pVMLineA->lastchar!=' ' || c2!=' ')	// combine multiple spaces into a single one.
-			{
-				if (c2==0x0a || (c2>=32 && c2<127 && c2!='@')) 
+				if (c2==0x5e || c2==0x7e) c2=0x0a;	// ~ or ^ is actually a line feed.
+				cc=dMagnetic2_engine_linea_charclass[c2];
+				lastcc=dMagnetic2_engine_linea_charclass[pVMLineA->lastchar&0x7f];
+				if (c2==0x0a && pVMLineA->lastchar==0x0a) 	// after two consequitive newlines comes a capital letter.
+				{
+					pVMLineA->capital=1;
+				}
+				if (cc&CC_END)	// a sentence is ending.
+				{
+					pVMLineA->capital=1;
+				}
+				if ((cc&CC_ALPHA) && (pVMLineA->capital||flag_headline)) 	// the first letter must be written as uppercase. As well as the headline.
+				{
+					pVMLineA->capital=0;	// ONLY the first character
+					c2&=0x5f;	// upper case
+				}
+				if ((lastcc&CC_PAUSE) && (cc&(CC_ALPHA|CC_DIGIT))) 	// a sentence has ended, and a new one is beginning.
 				{
+					// after those letters comes an extra space.otherwise,it would look weird.
 					if (flag_headline) 
 					{
 						if (titlelevel<DMAGNETIC2_SIZE_TITLEBUF-1)
+							pTitleBuf[titlelevel++]=' ';
+					} else {
+						if (textlevel<DMAGNETIC2_SIZE_OUTPUTBUF-1)
 						{
-							if ((c2&0x7f)>=' ')
-							{
-								pVMLineA->pTitleBuf[titlelevel++]=c2&0x7f;
-							} else {
-								pVMLineA->pTitleBuf[titlelevel++]=0;
-							}
+							pTextBuf[textlevel++]=' ';
 						}
-					} else if (textlevel<DMAGNETIC2_SIZE_OUTPUTBUF-1) {
-						if (textlevel<DMAGNETIC2_SIZE_OUTPUTBUF-1)
+					}
+				}
+				if (textlevel>0 && pVMLineA->lastchar==' ' && (cc&CC_TIGHT))	// there have been some glitches with extra spaces, right before a komma. which , as you can see , looks weird.
+				{
+					textlevel--;
+				}
+				if (	//allow multiple spaces in certain scenarios
+						flag_headline || pVMLineA->lastchar!=' ' || c2!=' ')	// combine multiple spaces into a single one.
+				{
+					if (cc&CC_PRINT) 
+					{
+						if (flag_headline) 
 						{
-							pVMLineA->pTextBuf[textlevel++]=c2;
+							if (titlelevel<DMAGNETIC2_SIZE_TITLEBUF-1)
+							{
+								pTitleBuf[titlelevel++]=(c2>=' ')?c2:0;
+							}
+						} else if (textlevel<DMAGNETIC2_SIZE_OUTPUTBUF-1) {
+							pTextBuf[textlevel++]=c2;
 						}
-
-						//					if (c2=='\n') newline=1;
+						pVMLineA->lastchar=c2;
 					}
-					pVMLineA->lastchar=c2;
 				}
+			} else if (c2) {
+				if (c2==0x5e) c2='\n';
+				if (c2=='_') c2=' ';
+				pTextBuf[textlevel++]=c2;
+				pVMLineA->lastchar=c2;
 			}
-		} else if (c2) {
-			if (c2==0x5e) c2='\n';
-			if (c2=='_') c2=' ';
-			pVMLineA->pTextBuf[textlevel++]=c2;
-			pVMLineA->lastchar=c2;
+		}
+		written=1;
+		if (titlelevel>=(DMAGNETIC2_SIZE_TITLEBUF-1) || textlevel>=(DMAGNETIC2_SIZE_OUTPUTBUF-1))
+		{
+			pTitleBuf[titlelevel]=0;
+			pTextBuf[textlevel]=0;
+			*(pVMLineA->pTextLevel)=textlevel;
+			*(pVMLineA->pTitleLevel)=titlelevel;
+			dMagnetic2_engine_linea_flush(pVMLineA);	// the buffers are full, and flushing them is required
 		}
 	}
-	// make sure that the buffers are zero-terminated.
-	if (titlelevel>=0)
+	if (written)
 	{
+		// make sure that the buffers are zero-terminated.
 		*pStatus|=DMAGNETIC2_ENGINE_STATUS_NEW_TITLE;
-	}
-	if (textlevel>=0)
-	{
 		*pStatus|=DMAGNETIC2_ENGINE_STATUS_NEW_TEXT;
-	}
-	pVMLineA->pTitleBuf[titlelevel]=0;
-	pVMLineA->pTextBuf[textlevel]=0;
-	*(pVMLineA->pTextLevel)=textlevel;
-	*(pVMLineA->pTitleLevel)=titlelevel;
-	if (titlelevel>=(DMAGNETIC2_SIZE_TITLEBUF-1) || textlevel>=(DMAGNETIC2_SIZE_OUTPUTBUF-1))
-	{
-		dMagnetic2_engine_linea_flush(pVMLineA);	// the buffers are full, and flushing them is required
+		pTitleBuf[titlelevel]=0;
+		pTextBuf[textlevel]=0;
+		*(pVMLineA->pTextLevel)=textlevel;
+		*(pVMLineA->pTitleLevel)=titlelevel;
 	}
 
 	return DMAGNETIC2_OK;
 }
-
-
@@ -29,8 +29,11 @@
 
 #include "dMagnetic2_engine_linea.h"
 
+#define	DMAGNETIC2_LINEA_SPAN_SIZE	256	// the decoded strings are handed over in chunks of this size
+
 int dMagnetic2_engine_line_flush(tVMLineA* pVMLineA);
 int dMagnetic2_engine_linea_newchar(tVMLineA* pVMLineA,unsigned char c,unsigned char controlD2,unsigned char flag_headline,unsigned int *pStatus);
+int dMagnetic2_engine_linea_newchars(tVMLineA* pVMLineA,unsigned char* pChars,int n,unsigned char controlD2,unsigned char flag_headline,unsigned int *pStatus);
 
 
 #endif
@@ -0,0 +1,335 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_memo.h"
+#include "dMagnetic2_engine_handle.h"
+#include <string.h>
+
+// the purpose of this file is to remember the reaction of the game to an input line.
+// the key is the state hash of the session before the input, together with the input line itself.
+// the entry holds the variables afterwards (the registers, the line-A variables, the output text)
+// and the bytes of the memory which have been changed, as records of 4 bytes offset, 2 bytes length
+// and the new bytes. since the memory was the same before, applying them leads to the same memory.
+//
+// the buffer from the caller is split into the header, a hash table with the offsets of the
+// entries, and the arena holding them. there is no eviction of single entries. when the arena
+// (or the hash table) is full, everything is flushed.
+
+#define	MEMO_MAGIC		0x4d656d6f	// "Memo"
+#define	MEMO_MAXGAP		8		// unchanged bytes between two differences that are cheaper to store than a new record
+#define	MEMO_MAXRUN		0xffff
+#define	MEMO_BYTES_PER_BUCKET	512		// the expected size of an entry
+#define	MEMO_ALIGN(x)		(((x)+7)&~7)
+
+typedef struct _tdMagnetic2_engine_memo_entry
+{
+	unsigned long long prehash;
+	unsigned long long posthash;
+	int inputlen;
+	int varsize;
+	int deltasize;
+	unsigned int prestatus;		// the flags which have not been fetched yet
+	// followed by the input line, the variables and the memory records
+} tdMagnetic2_engine_memo_entry;
+
+typedef struct _tdMagnetic2_engine_memo_handle
+{
+	unsigned int magic;
+	int size;
+	tdMagnetic2_engine_memo_stats stats;
+	int nbuckets;		// power of 2
+	int* pBuckets;		// 0=empty. otherwise the offset of the entry within the arena+1
+	unsigned char* pArena;
+	int arenasize;
+	int arenaused;
+	tVM68k_ubyte shadow[VM68K_MEMSIZE+VM68K_MEMGUARD];	// the memory before the input, while recording
+} tdMagnetic2_engine_memo_handle;
+
+static unsigned int dMagnetic2_engine_memo_bucket(tdMagnetic2_engine_memo_handle* pThis,unsigned long long prehash,int len,char* pInput)
+{
+	unsigned long long h;
+	int i;
+	h=prehash;
+	for (i=0;i<len;i++)
+	{
+		h^=(unsigned char)pInput[i];
+		h*=0x100000001b3ULL;
+	}
+	h^=h>>32;
+	return ((unsigned int)h)&(pThis->nbuckets-1);
+}
+
+#define	MEMO_STICKY_FLAGS	(DMAGNETIC2_ENGINE_STATUS_SAVE|DMAGNETIC2_ENGINE_STATUS_LOAD|DMAGNETIC2_ENGINE_STATUS_RESTART|DMAGNETIC2_ENGINE_STATUS_QUIT)
+// only an idle session can be cached: waiting for input, and the buffers have been fetched.
+static int dMagnetic2_engine_memo_is_idle(tdMagnetic2_engine_handle* pEngine)
+{
+	return (pEngine->magic==MAGIC
+		&& (pEngine->status_flags&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)
+		&& (pEngine->status_flags&MEMO_STICKY_FLAGS)==0
+		&& pEngine->inputlevel==0
+		&& pEngine->outputlevel==0
+		&& pEngine->titlelevel==0
+		&& pEngine->filenamelevel==0);
+}
+
+// the memory records. with pOut==NULL, only the size is returned
+static int dMagnetic2_engine_memo_delta(tdMagnetic2_engine_memo_handle* pThis,tVM68k* pVM68k,unsigned char* pOut)
+{
+	int i;
+	int start,end;
+	int idx;
+	unsigned int offset;
+	unsigned short len;
+
+	idx=0;
+	i=0;
+	while (i<VM68K_MEMSIZE+VM68K_MEMGUARD)
+	{
+		if (pVM68k->memory[i]==pThis->shadow[i])
+		{
+			i++;
+			continue;
+		}
+		start=end=i;
+		while (i<VM68K_MEMSIZE+VM68K_MEMGUARD && i-end<MEMO_MAXGAP && i-start<MEMO_MAXRUN)
+		{
+			if (pVM68k->memory[i]!=pThis->shadow[i])
+			{
+				end=i+1;
+			}
+			i++;
+		}
+		i=end;
+		if (pOut!=NULL)
+		{
+			offset=start;
+			len=end-start;
+			memcpy(&pOut[idx],&offset,4);
+			memcpy(&pOut[idx+4],&len,2);
+			memcpy(&pOut[idx+6],&pVM68k->memory[start],len);
+		}
+		idx+=6+end-start;
+	}
+	return idx;
+}
+
+int dMagnetic2_engine_memo_flush(void* pMemo)
+{
+	tdMagnetic2_engine_memo_handle* pThis=(tdMagnetic2_engine_memo_handle*)pMemo;
+	if (pThis->magic!=MEMO_MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	memset(pThis->pBuckets,0,pThis->nbuckets*sizeof(int));
+	pThis->arenaused=0;
+	pThis->stats.entries=0;
+	pThis->stats.flushes++;
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_engine_memo_init(void* pMemo,int size)
+{
+	tdMagnetic2_engine_memo_handle* pThis=(tdMagnetic2_engine_memo_handle*)pMemo;
+	int headersize;
+	int remaining;
+	int nbuckets;
+
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (size<DMAGNETIC2_ENGINE_MEMO_MINSIZE)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	memset(pThis,0,sizeof(tdMagnetic2_engine_memo_handle));
+	headersize=MEMO_ALIGN(sizeof(tdMagnetic2_engine_memo_handle));
+	remaining=size-headersize;
+	nbuckets=16;
+	while (nbuckets*2*(MEMO_BYTES_PER_BUCKET+(int)sizeof(int))<=remaining)
+	{
+		nbuckets*=2;
+	}
+	pThis->magic=MEMO_MAGIC;
+	pThis->size=size;
+	pThis->nbuckets=nbuckets;
+	pThis->pBuckets=(int*)&((unsigned char*)pMemo)[headersize];
+	pThis->pArena=&((unsigned char*)pMemo)[headersize+MEMO_ALIGN(nbuckets*sizeof(int))];
+	pThis->arenasize=size-headersize-MEMO_ALIGN(nbuckets*sizeof(int));
+	memset(pThis->pBuckets,0,nbuckets*sizeof(int));
+	pThis->arenaused=0;
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_engine_memo_get_stats(void* pMemo,tdMagnetic2_engine_memo_stats* pStats)
+{
+	tdMagnetic2_engine_memo_handle* pThis=(tdMagnetic2_engine_memo_handle*)pMemo;
+	if (pStats==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MEMO_MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pStats=pThis->stats;
+	pStats->bytesused=pThis->arenaused;
+	pStats->bytesavailable=pThis->arenasize;
+	return DMAGNETIC2_OK;
+}
+
+static int dMagnetic2_engine_memo_passthrough(void* pHandle,int len,char* pInput,unsigned int* pStatus)
+{
+	int retval;
+	int cnt;
+	retval=dMagnetic2_engine_new_input(pHandle,len,pInput,&cnt);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	return dMagnetic2_engine_process(pHandle,0,pStatus);
+}
+
+int dMagnetic2_engine_memo_step(void* pMemo,void* pHandle,int len,char* pInput,unsigned int* pStatus)
+{
+	tdMagnetic2_engine_memo_handle* pThis=(tdMagnetic2_engine_memo_handle*)pMemo;
+	tdMagnetic2_engine_handle* pEngine=(tdMagnetic2_engine_handle*)pHandle;
+	tdMagnetic2_engine_memo_entry* pEntry;
+	tVM68k* pVM68k;
+	unsigned long long prehash;
+	unsigned int prestatus;
+	unsigned int bucket;
+	int entrysize;
+	int retval;
+	int i;
+
+	if (pInput==NULL || pStatus==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MEMO_MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	// exactly one line
+	if (len<=0 || len>DMAGNETIC2_SIZE_INPUTBUF || pInput[len-1]!='\n' || memchr(pInput,'\n',len-1)!=NULL || !dMagnetic2_engine_memo_is_idle(pEngine))
+	{
+		pThis->stats.bypassed++;
+		return dMagnetic2_engine_memo_passthrough(pHandle,len,pInput,pStatus);
+	}
+	pVM68k=&(pEngine->game_context.vm68k);
+	retval=dMagnetic2_engine_get_statehash(pHandle,&prehash);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+
+	pThis->stats.lookups++;
+	bucket=dMagnetic2_engine_memo_bucket(pThis,prehash,len,pInput);
+	while (pThis->pBuckets[bucket])
+	{
+		pEntry=(tdMagnetic2_engine_memo_entry*)&pThis->pArena[pThis->pBuckets[bucket]-1];
+		if (pEntry->prehash==prehash && pEntry->prestatus==pEngine->status_flags && pEntry->inputlen==len && memcmp(&pEntry[1],pInput,len)==0)
+		{
+			unsigned char* pVars;
+			unsigned char* pDelta;
+			// a hit. apply the recorded state
+			pVars=&((unsigned char*)&pEntry[1])[len];
+			pDelta=&pVars[pEntry->varsize];
+			retval=dMagnetic2_engine_hibernate_set_variables(pEngine,pVars,pEntry->varsize);
+			if (retval!=DMAGNETIC2_OK)
+			{
+				return retval;
+			}
+			i=0;
+			while (i<pEntry->deltasize)
+			{
+				unsigned int offset;
+				unsigned short n;
+				memcpy(&offset,&pDelta[i],4);
+				memcpy(&n,&pDelta[i+4],2);
+				memcpy(&pVM68k->memory[offset],&pDelta[i+6],n);
+				i+=6+n;
+			}
+			pEngine->statehash=pEntry->posthash;
+			pEngine->statehash_valid=1;
+			pThis->stats.hits++;
+			*pStatus=pEngine->status_flags;
+			return DMAGNETIC2_OK;
+		}
+		bucket=(bucket+1)&(pThis->nbuckets-1);
+	}
+
+	// a miss. run the game, and record the outcome
+	pThis->stats.misses++;
+	prestatus=pEngine->status_flags;
+	memcpy(pThis->shadow,pVM68k->memory,sizeof(pThis->shadow));
+	retval=dMagnetic2_engine_memo_passthrough(pHandle,len,pInput,pStatus);
+	if (retval!=DMAGNETIC2_OK 
+		|| ((*pStatus)&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)==0
+		|| ((*pStatus)&MEMO_STICKY_FLAGS)
+		|| pEngine->inputlevel!=0)
+	{
+		return retval;		// those need the frontend. do not remember them
+	}
+	{
+		int varsize;
+		int deltasize;
+		unsigned char* pData;
+
+		varsize=dMagnetic2_engine_hibernate_get_variables(pEngine,NULL,0);
+		deltasize=dMagnetic2_engine_memo_delta(pThis,pVM68k,NULL);
+		entrysize=MEMO_ALIGN(sizeof(tdMagnetic2_engine_memo_entry)+len+varsize+deltasize);
+		if (entrysize>pThis->arenasize)
+		{
+			return DMAGNETIC2_OK;	// would never fit
+		}
+		if (pThis->arenaused+entrysize>pThis->arenasize || (pThis->stats.entries+1)*2>pThis->nbuckets)
+		{
+			dMagnetic2_engine_memo_flush(pMemo);
+			bucket=dMagnetic2_engine_memo_bucket(pThis,prehash,len,pInput);
+		}
+		pEntry=(tdMagnetic2_engine_memo_entry*)&pThis->pArena[pThis->arenaused];
+		pEntry->prehash=prehash;
+		dMagnetic2_engine_get_statehash(pHandle,&pEntry->posthash);
+		pEntry->inputlen=len;
+		pEntry->varsize=varsize;
+		pEntry->deltasize=deltasize;
+		pEntry->prestatus=prestatus;
+		pData=(unsigned char*)&pEntry[1];
+		memcpy(pData,pInput,len);
+		dMagnetic2_engine_hibernate_get_variables(pEngine,&pData[len],varsize);
+		dMagnetic2_engine_memo_delta(pThis,pVM68k,&pData[len+varsize]);
+
+		pThis->pBuckets[bucket]=pThis->arenaused+1;
+		pThis->arenaused+=entrysize;
+		pThis->stats.entries++;
+		pThis->stats.recorded++;
+	}
+	return DMAGNETIC2_OK;
+}
@@ -0,0 +1,86 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_metrics.h"
+#include "dMagnetic2_metrics_shared.h"
+#include "dMagnetic2_engine_handle.h"
+#include <string.h>
+
+// the purpose of this file is to report the counters of the engine.
+
+tdMagnetic2_engine_metrics_atomic dMagnetic2_engine_metrics;
+
+int dMagnetic2_engine_get_metrics(tdMagnetic2_engine_metrics *pMetrics)
+{
+	int i;
+	if (pMetrics==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	pMetrics->instructions=METRICS_LOAD(dMagnetic2_engine_metrics.instructions);
+	for (i=0;i<256;i++)
+	{
+		pMetrics->traps_a[i]=METRICS_LOAD(dMagnetic2_engine_metrics.traps_a[i]);
+	}
+	pMetrics->traps_f=METRICS_LOAD(dMagnetic2_engine_metrics.traps_f);
+	pMetrics->output_bytes=METRICS_LOAD(dMagnetic2_engine_metrics.output_bytes);
+	pMetrics->input_waits=METRICS_LOAD(dMagnetic2_engine_metrics.input_waits);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_metrics_text(char* pBuf,int bufsize,int *pLen)
+{
+	tdMagnetic2_engine_metrics metrics;
+	int idx;
+	int i;
+	if (pBuf==NULL || pLen==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	dMagnetic2_engine_get_metrics(&metrics);
+	idx=0;
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_engine_instructions_total counter\n");
+	METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_engine_instructions_total %llu\n",metrics.instructions);
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_engine_traps_total counter\n");
+	for (i=0;i<256;i++)
+	{
+		if (metrics.traps_a[i])		// most of them are never used
+		{
+			METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_engine_traps_total{opcode=\"a0%02x\"} %llu\n",i,metrics.traps_a[i]);
+		}
+	}
+	METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_engine_traps_total{opcode=\"linef\"} %llu\n",metrics.traps_f);
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_engine_output_bytes_total counter\n");
+	METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_engine_output_bytes_total %llu\n",metrics.output_bytes);
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_engine_input_waits_total counter\n");
+	METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_engine_input_waits_total %llu\n",metrics.input_waits);
+	*pLen=idx;
+	if (idx>=bufsize)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	return DMAGNETIC2_OK;
+}
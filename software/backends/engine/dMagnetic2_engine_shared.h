@@ -76,6 +76,76 @@ typedef	enum _tVM68k_addrmode_ext {	VM68K_AMX_W=0,			// (xxx),W
 					VM68K_AMX_INDEX_PC=3} 		// (d8,PC,Xn)
 					tVM68k_addrmode_ext;
 
+// the memory layout.
+// the games themselves need no more than 98304 bytes. every address has to be wrapped around
+// with a modulo by this size.
+// when compiled with -DVM68K_MEMORY_FASTWRAP, the addresses which are already inside of the
+// memory are taken as they are, and only the others are being divided. a power-of-two mask
+// would be cheaper, but it maps the addresses above 98304 (and the negative ones) differently,
+// so the games would not run on the same machine anymore.
+// a few guard bytes at the end make sure that a multi byte access at the very last address does
+// not run beyond the memory.
+#define	VM68K_MEMSIZE_GAME	98304		// for wonderland
+#define	VM68K_MEMGUARD		4		// a LONG access at the last address touches 3 more bytes
+#define	VM68K_MEMSIZE		VM68K_MEMSIZE_GAME
+#ifdef	VM68K_MEMORY_FASTWRAP
+#define	VM68K_WRAP(pVM68k,addr)	(((tVM68k_ulong)(addr)<VM68K_MEMSIZE)?(tVM68k_ulong)(addr):((tVM68k_ulong)(addr)%VM68K_MEMSIZE))
+#else
+#define	VM68K_WRAP(pVM68k,addr)	((addr)%((pVM68k)->memsize))
+#endif
+
+// optional: host endian memory accesses.
+// the memory image itself stays big endian, so that the line-A traps and the savegames do not
+// notice any difference. only the WORD and LONG accesses from the CPU core are performed as a
+// single native load/store when compiled with -DVM68K_MEMORY_BSWAP. on little endian hosts,
+// the value is byte swapped afterwards.
+#if defined(VM68K_MEMORY_BSWAP) && defined(__GNUC__) && defined(__BYTE_ORDER__) && !defined(__sgi__)
+#include <string.h>
+static inline tVM68k_ulong dMagnetic2_engine_vm68k_read16(const tVM68k_ubyte* ptr)
+{
+	uint16_t x;
+	memcpy(&x,ptr,sizeof(x));
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+	x=__builtin_bswap16(x);
+#endif
+	return x;
+}
+static inline tVM68k_ulong dMagnetic2_engine_vm68k_read32(const tVM68k_ubyte* ptr)
+{
+	uint32_t x;
+	memcpy(&x,ptr,sizeof(x));
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+	x=__builtin_bswap32(x);
+#endif
+	return x;
+}
+static inline void dMagnetic2_engine_vm68k_write16(tVM68k_ubyte* ptr,tVM68k_ulong val)
+{
+	uint16_t x=(uint16_t)val;
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+	x=__builtin_bswap16(x);
+#endif
+	memcpy(ptr,&x,sizeof(x));
+}
+static inline void dMagnetic2_engine_vm68k_write32(tVM68k_ubyte* ptr,tVM68k_ulong val)
+{
+	uint32_t x=(uint32_t)val;
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+	x=__builtin_bswap32(x);
+#endif
+	memcpy(ptr,&x,sizeof(x));
+}
+#define	VM68K_READ16(ptr,idx)		dMagnetic2_engine_vm68k_read16(&((ptr)[(idx)]))
+#define	VM68K_READ32(ptr,idx)		dMagnetic2_engine_vm68k_read32(&((ptr)[(idx)]))
+#define	VM68K_WRITE16(ptr,idx,val)	dMagnetic2_engine_vm68k_write16(&((ptr)[(idx)]),(val));
+#define	VM68K_WRITE32(ptr,idx,val)	dMagnetic2_engine_vm68k_write32(&((ptr)[(idx)]),(val));
+#else
+#define	VM68K_READ16(ptr,idx)		READ_INT16BE(ptr,idx)
+#define	VM68K_READ32(ptr,idx)		READ_INT32BE(ptr,idx)
+#define	VM68K_WRITE16(ptr,idx,val)	WRITE_INT16BE(ptr,idx,val)
+#define	VM68K_WRITE32(ptr,idx,val)	WRITE_INT32BE(ptr,idx,val)
+#endif
+
 // the virtual machine state. 
 // the idea is, that this whole struct is self contained (no pointers), so that it can be used as a savegame.
 #define	VM68K_MAGIC		0x38366d76	// "vm68", little endian
@@ -87,8 +157,8 @@ typedef struct _tVM68k
 				// bit 0..4: CVZNX
 	tVM68k_ulong    a[8];   // address register
 	tVM68k_ulong    d[8];   // data register
-	tVM68k_ubyte    memory[98304];
-	tVM68k_ulong    memsize;        // TODO: check for violations.
+	tVM68k_ubyte    memory[VM68K_MEMSIZE+VM68K_MEMGUARD];
+	tVM68k_ulong    memsize;        // without the guard bytes
 
 	/////// VERSION PATCH
 	tVM68k_ubyte    version;        // game version. not the interpreter version
@@ -255,8 +325,8 @@ VM68K_INST_UNLK,	//0100111001011yyy
 	(pVM68k)->sr|=(tVM68k_uword)((transaction).xflag)<<4;
 
 #define	READEXTENSIONBYTE(pVM68k,pNext)	READ_INT8BE((pVM68k)->memory,(pNext)->pcr+1);(pNext)->pcr+=2;
-#define	READEXTENSIONWORD(pVM68k,pNext)	READ_INT16BE((pVM68k)->memory,(pNext)->pcr);(pNext)->pcr+=2;
-#define	READEXTENSIONLONG(pVM68k,pNext)	READ_INT32BE((pVM68k)->memory,(pNext)->pcr);(pNext)->pcr+=4;
+#define	READEXTENSIONWORD(pVM68k,pNext)	VM68K_READ16((pVM68k)->memory,(pNext)->pcr);(pNext)->pcr+=2;
+#define	READEXTENSIONLONG(pVM68k,pNext)	VM68K_READ32((pVM68k)->memory,(pNext)->pcr);(pNext)->pcr+=4;
 
 #define	READEXTENSION(pVM68k,pNext,datatype,operand)	\
 	switch (datatype)	\
@@ -278,8 +348,8 @@ VM68K_INST_UNLK,	//0100111001011yyy
 #define	PUSHWORDTOSTACK(pVM68k,pNext,x)	{(pNext)->a[7]-=2;(pNext)->mem_addr[(pNext)->mem_we]=(pNext)->a[7];(pNext)->mem_size=VM68K_WORD;(pNext)->mem_value[(pNext)->mem_we]=x;(pNext)->mem_we++;}
 #define	PUSHLONGTOSTACK(pVM68k,pNext,x)	{(pNext)->a[7]-=4;(pNext)->mem_addr[(pNext)->mem_we]=(pNext)->a[7];(pNext)->mem_size=VM68K_LONG;(pNext)->mem_value[(pNext)->mem_we]=x;(pNext)->mem_we++;}
 
-#define	POPWORDFROMSTACK(pVM68k,pNext,x)	{tVM68k_uword y;y=READ_INT16BE((pVM68k)->memory,(pNext)->a[7]);(pNext)->a[7]+=2;x=((x)&0xffff0000)|(y&0xffff);}
-#define	POPLONGFROMSTACK(pVM68k,pNext,x)	{x=READ_INT32BE((pVM68k)->memory,(pNext)->a[7]);(pNext)->a[7]+=4;}
+#define	POPWORDFROMSTACK(pVM68k,pNext,x)	{tVM68k_uword y;y=VM68K_READ16((pVM68k)->memory,(pNext)->a[7]);(pNext)->a[7]+=2;x=((x)&0xffff0000)|(y&0xffff);}
+#define	POPLONGFROMSTACK(pVM68k,pNext,x)	{x=VM68K_READ32((pVM68k)->memory,(pNext)->a[7]);(pNext)->a[7]+=4;}
 
 
 #define DATAREGADDR(addr)	(-((addr)+ 1))
@@ -326,6 +396,7 @@ VM68K_INST_UNLK,	//0100111001011yyy
 #define	VM68K_OK		DMAGNETIC2_OK
 #define	VM68K_NOK_UNKNOWN_INSTRUCTION	-1
 #define	VM68K_NOK_INVALID_PTR		-2
+#define	VM68K_NOK_NO_FASTPATH		-3	// the opcode is not covered by a specialized handler. use the generic path.
 
 
 
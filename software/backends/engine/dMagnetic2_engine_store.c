@@ -0,0 +1,344 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_store.h"
+#include "dMagnetic2_engine_handle.h"
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the purpose of this file is to keep the engine handles in a file which is mapped into memory.
+// the handle is free of pointers, except for the ones into the mag buffer and into its own buffers.
+// so the slots are being used in place. re-attaching after a restart only means setting those
+// pointers again, see dMagnetic2_engine_relink().
+//
+// the first page is the header, followed by the slots. each slot starts on a page boundary,
+// so that syncing one of them does not touch the others. the page size is the one of the system
+// which created the file, and it has to be the same when it is opened again.
+//
+// @0   4 bytes "dM2S"
+// @4   4 bytes format version
+// @8   4 bytes size of the engine handle, including the copy of the dictionary
+// @12  4 bytes size of one slot
+// @16  4 bytes number of slots
+// @20  4 bytes checksum of the mag header and code
+// @24  4 bytes build tag, a fingerprint of the handle layout. see dMagnetic2_engine_store_buildtag()
+// @28  4 bytes page size
+//
+// a slot is in use when it holds an initialized handle. the file is created with zeros, so every slot starts free.
+
+#define	STORE_HANDLE_MAGIC	0x53746f72	// "Stor"
+#define	STORE_MAGIC	0x644d3253	// "dM2S"
+#define	STORE_VERSION	3
+
+typedef struct _tdMagnetic2_engine_store_header
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int handlesize;
+	unsigned int slotsize;
+	unsigned int slotcnt;
+	unsigned int checksum;
+	unsigned int buildtag;
+	unsigned int pagesize;
+} tdMagnetic2_engine_store_header;
+
+typedef struct _tdMagnetic2_engine_store_handle
+{
+	unsigned int magic;
+	int fd;
+	unsigned char* pMap;
+	size_t mapsize;
+	int pagesize;
+	int slotsize;
+	int slotcnt;
+	unsigned char* pMagBuf;
+} tdMagnetic2_engine_store_handle;
+
+#define	SLOTSIZE(handlesize,pagesize)	(((handlesize)+(pagesize)-1)/(pagesize)*(pagesize))
+#define	SLOT(pThis,slot)	((tdMagnetic2_engine_handle*)&((pThis)->pMap[(pThis)->pagesize+(size_t)(slot)*(pThis)->slotsize]))
+
+// the sizes alone do not tell two builds apart. a member might have moved, the pointers might have
+// a different width, or the integers a different byte order. all of that goes into the tag.
+static unsigned int dMagnetic2_engine_store_buildtag(void)
+{
+	const unsigned int layout[]={
+		sizeof(tdMagnetic2_engine_handle),
+		sizeof(void*),
+		0x01020304,	// the byte order, as it is stored
+		offsetof(tdMagnetic2_engine_handle,status_flags),
+		offsetof(tdMagnetic2_engine_handle,game_context),
+		offsetof(tdMagnetic2_game_context,linea),
+		sizeof(tVM68k),
+		offsetof(tVM68k,memory),
+		offsetof(tVM68k,memsize),
+		sizeof(tVMLineA),
+		offsetof(tVMLineA,random_state),
+	};
+	const unsigned char* p=(const unsigned char*)layout;
+	unsigned int tag;
+	int i;
+
+	tag=2166136261u;	// fnv-1a
+	for (i=0;i<(int)sizeof(layout);i++)
+	{
+		tag^=p[i];
+		tag*=16777619u;
+	}
+	return tag;
+}
+
+int dMagnetic2_engine_store_get_size(int *pBytes)
+{
+	if (pBytes==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	*pBytes=sizeof(tdMagnetic2_engine_store_handle);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_init(void *pStore)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	memset(pThis,0,sizeof(tdMagnetic2_engine_store_handle));
+	pThis->magic=STORE_HANDLE_MAGIC;
+	pThis->fd=-1;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_open(void *pStore,char* filename,int slots,unsigned char* pMagBuf)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	tdMagnetic2_engine_store_header header;
+	struct stat st;
+	int fd;
+	unsigned char* pMap;
+	size_t mapsize;
+	int handlesize;
+	int pagesize;
+
+	if (pThis==NULL || filename==NULL || pMagBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap!=NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (dMagnetic2_engine_get_size_for_mag(pMagBuf,&handlesize)!=DMAGNETIC2_OK)	// the handles, including the copy of the dictionary
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	pagesize=(int)sysconf(_SC_PAGESIZE);
+	if (pagesize<(int)sizeof(header))
+	{
+		return DMAGNETIC2_ERROR_NO_RESOURCES;
+	}
+
+	fd=open(filename,O_RDWR|O_CREAT,0600);
+	if (fd<0 || fstat(fd,&st)!=0)
+	{
+		if (fd>=0) close(fd);
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+
+	if (st.st_size==0)	// a new file. write the header, the slots are zeros
+	{
+		if (slots<=0)
+		{
+			close(fd);
+			return DMAGNETIC2_ERROR_INVALID_SLOT;
+		}
+		memset(&header,0,sizeof(header));
+		header.magic=STORE_MAGIC;
+		header.version=STORE_VERSION;
+		header.handlesize=handlesize;
+		header.slotsize=SLOTSIZE(handlesize,pagesize);
+		header.slotcnt=slots;
+		header.checksum=dMagnetic2_engine_magchecksum(pMagBuf);
+		header.buildtag=dMagnetic2_engine_store_buildtag();
+		header.pagesize=pagesize;
+		mapsize=(size_t)pagesize+(size_t)slots*SLOTSIZE(handlesize,pagesize);
+		if (ftruncate(fd,mapsize)!=0 || pwrite(fd,&header,sizeof(header),0)!=sizeof(header))
+		{
+			close(fd);
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+	} else {
+		if (pread(fd,&header,sizeof(header),0)!=sizeof(header))
+		{
+			close(fd);
+			return DMAGNETIC2_ERROR_STORE_MISMATCH;
+		}
+		// the layout of the handle has to be the same. and it must have been the same game, on the same pages.
+		if (header.magic!=STORE_MAGIC || header.version!=STORE_VERSION 
+			|| header.handlesize!=(unsigned int)handlesize || header.slotsize!=(unsigned int)SLOTSIZE(handlesize,pagesize)
+			|| header.pagesize!=(unsigned int)pagesize
+			|| header.buildtag!=dMagnetic2_engine_store_buildtag()
+			|| header.checksum!=dMagnetic2_engine_magchecksum(pMagBuf))
+		{
+			close(fd);
+			return DMAGNETIC2_ERROR_STORE_MISMATCH;
+		}
+		mapsize=(size_t)pagesize+(size_t)header.slotcnt*SLOTSIZE(handlesize,pagesize);
+		if ((size_t)st.st_size<mapsize)
+		{
+			close(fd);
+			return DMAGNETIC2_ERROR_STORE_MISMATCH;
+		}
+	}
+
+	pMap=mmap(NULL,mapsize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	if (pMap==MAP_FAILED)
+	{
+		close(fd);
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	pThis->fd=fd;
+	pThis->pMap=pMap;
+	pThis->mapsize=mapsize;
+	pThis->pagesize=pagesize;
+	pThis->slotsize=SLOTSIZE(handlesize,pagesize);
+	pThis->slotcnt=header.slotcnt;
+	pThis->pMagBuf=pMagBuf;
+
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_get_slotcnt(void *pStore,int *pSlots)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pSlots=pThis->slotcnt;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_get_slotstate(void *pStore,int slot,int *pState)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (slot<0 || slot>=pThis->slotcnt)
+	{
+		return DMAGNETIC2_ERROR_INVALID_SLOT;
+	}
+	*pState=(SLOT(pThis,slot)->magic==0)?DMAGNETIC2_ENGINE_STORE_SLOT_FREE:DMAGNETIC2_ENGINE_STORE_SLOT_USED;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_attach(void *pStore,int slot,void **ppHandle)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	tdMagnetic2_engine_handle* pHandle;
+	int retval;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (slot<0 || slot>=pThis->slotcnt)
+	{
+		return DMAGNETIC2_ERROR_INVALID_SLOT;
+	}
+	pHandle=SLOT(pThis,slot);
+	if (pHandle->magic==0)	// a free slot: start a new game
+	{
+		retval=dMagnetic2_engine_init(pHandle);
+		if (retval==DMAGNETIC2_OK)
+		{
+			retval=dMagnetic2_engine_set_mag(pHandle,pThis->pMagBuf);
+		}
+		if (retval!=DMAGNETIC2_OK)
+		{
+			pHandle->magic=0;
+		}
+	} else {		// a game in progress: only the pointers have to be set. the file might have been damaged, though.
+		retval=dMagnetic2_engine_relink(pHandle,pThis->pMagBuf);
+		if (retval==DMAGNETIC2_OK)
+		{
+			retval=dMagnetic2_engine_check_levels(pHandle);
+		}
+		if (retval==DMAGNETIC2_OK)
+		{
+			retval=dMagnetic2_engine_linea_check(&(pHandle->game_context.linea),pThis->pMagBuf);
+		}
+	}
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	*ppHandle=pHandle;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_release(void *pStore,int slot)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (slot<0 || slot>=pThis->slotcnt)
+	{
+		return DMAGNETIC2_ERROR_INVALID_SLOT;
+	}
+	memset(SLOT(pThis,slot),0,pThis->slotsize);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_sync(void *pStore)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (msync(pThis->pMap,pThis->mapsize,MS_SYNC)!=0)
+	{
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_engine_store_close(void *pStore)
+{
+	tdMagnetic2_engine_store_handle* pThis=(tdMagnetic2_engine_store_handle*)pStore;
+	if (pThis->magic!=STORE_HANDLE_MAGIC || pThis->pMap==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	munmap(pThis->pMap,pThis->mapsize);
+	close(pThis->fd);
+	pThis->pMap=NULL;
+	pThis->fd=-1;
+	return DMAGNETIC2_OK;
+}
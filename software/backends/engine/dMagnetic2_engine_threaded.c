@@ -0,0 +1,507 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_threaded.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef	__linux__
+#include <sys/eventfd.h>
+#endif
+
+// the purpose of this file is to run the engine in a thread of its own.
+// the input and the output are passed through lock-free ring buffers. each of them has
+// exactly one producer and one consumer. the producer is the only one moving the head,
+// the consumer is the only one moving the tail. a file descriptor is used to wake up the
+// other side. on linux, this is an eventfd. elsewhere, it is a pipe.
+
+#define	MAGIC	0x54687264	// "Thrd"
+
+#define	RINGSIZE_INPUT		(1<<12)
+#define	RINGSIZE_OUTPUT		(1<<16)
+#define	STICKY_FLAGS		(DMAGNETIC2_ENGINE_STATUS_SAVE|DMAGNETIC2_ENGINE_STATUS_LOAD|DMAGNETIC2_ENGINE_STATUS_RESTART|DMAGNETIC2_ENGINE_STATUS_QUIT)
+
+typedef struct _tdMagnetic2_engine_ring
+{
+	_Alignas(64) atomic_uint head;		// written by the producer
+	_Alignas(64) atomic_uint tail;		// written by the consumer
+	unsigned int size;			// power of 2
+	unsigned char *pBuf;
+} tdMagnetic2_engine_ring;
+
+// every event in the output ring starts with this header, followed by len bytes of payload.
+typedef struct _tdMagnetic2_engine_eventheader
+{
+	unsigned int type;
+	int value;
+	int len;
+} tdMagnetic2_engine_eventheader;
+
+typedef struct _tdMagnetic2_engine_threaded_handle
+{
+	unsigned int magic;
+	pthread_t thread;
+	int running;
+	atomic_int stop;		// set by the frontend
+	atomic_int waiting_for_space;	// set by the engine thread, when the output ring is full
+
+	int fd_event[2];		// signalled by the engine thread. the frontend is waiting for it
+	int fd_wakeup[2];		// signalled by the frontend. the engine thread is waiting for it
+
+	tdMagnetic2_engine_ring	input;
+	tdMagnetic2_engine_ring	output;
+	unsigned char inputbuf[RINGSIZE_INPUT];
+	unsigned char outputbuf[RINGSIZE_OUTPUT];
+
+	void* pEngine;			// points into the same memory block, right after this structure
+} tdMagnetic2_engine_threaded_handle;
+
+#define	ENGINE_OFFSET	((sizeof(tdMagnetic2_engine_threaded_handle)+63)&~63)
+
+// helper functions for the ring buffers
+static void dMagnetic2_engine_threaded_ring_init(tdMagnetic2_engine_ring* pRing,unsigned char* pBuf,unsigned int size)
+{
+	atomic_init(&pRing->head,0);
+	atomic_init(&pRing->tail,0);
+	pRing->size=size;
+	pRing->pBuf=pBuf;
+}
+static unsigned int dMagnetic2_engine_threaded_ring_free(tdMagnetic2_engine_ring* pRing)	// producer side
+{
+	return pRing->size-(atomic_load_explicit(&pRing->head,memory_order_relaxed)-atomic_load_explicit(&pRing->tail,memory_order_acquire));
+}
+static unsigned int dMagnetic2_engine_threaded_ring_used(tdMagnetic2_engine_ring* pRing)	// consumer side
+{
+	return atomic_load_explicit(&pRing->head,memory_order_acquire)-atomic_load_explicit(&pRing->tail,memory_order_relaxed);
+}
+// copies n bytes into the ring, starting offs bytes after the head. the head itself is not moved.
+static void dMagnetic2_engine_threaded_ring_put(tdMagnetic2_engine_ring* pRing,unsigned int offs,const void* pSrc,unsigned int n)
+{
+	unsigned int idx;
+	unsigned int n1;
+	idx=(atomic_load_explicit(&pRing->head,memory_order_relaxed)+offs)&(pRing->size-1);
+	n1=pRing->size-idx;
+	if (n1>n) n1=n;
+	memcpy(&pRing->pBuf[idx],pSrc,n1);
+	memcpy(&pRing->pBuf[0],((const unsigned char*)pSrc)+n1,n-n1);
+}
+// copies n bytes out of the ring, starting offs bytes after the tail. the tail itself is not moved.
+static void dMagnetic2_engine_threaded_ring_get(tdMagnetic2_engine_ring* pRing,unsigned int offs,void* pDst,unsigned int n)
+{
+	unsigned int idx;
+	unsigned int n1;
+	idx=(atomic_load_explicit(&pRing->tail,memory_order_relaxed)+offs)&(pRing->size-1);
+	n1=pRing->size-idx;
+	if (n1>n) n1=n;
+	memcpy(pDst,&pRing->pBuf[idx],n1);
+	memcpy(((unsigned char*)pDst)+n1,&pRing->pBuf[0],n-n1);
+}
+static void dMagnetic2_engine_threaded_ring_commit_put(tdMagnetic2_engine_ring* pRing,unsigned int n)
+{
+	atomic_store_explicit(&pRing->head,atomic_load_explicit(&pRing->head,memory_order_relaxed)+n,memory_order_release);
+}
+static void dMagnetic2_engine_threaded_ring_commit_get(tdMagnetic2_engine_ring* pRing,unsigned int n)
+{
+	atomic_store_explicit(&pRing->tail,atomic_load_explicit(&pRing->tail,memory_order_relaxed)+n,memory_order_release);
+}
+
+// helper functions for the file descriptors
+static int dMagnetic2_engine_threaded_fd_open(int fds[2],int nonblock)
+{
+#ifdef	__linux__
+	fds[0]=fds[1]=eventfd(0,EFD_CLOEXEC|(nonblock?EFD_NONBLOCK:0));
+	if (fds[0]<0)
+	{
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+#else
+	if (pipe(fds)!=0)
+	{
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	fcntl(fds[1],F_SETFL,O_NONBLOCK);	// a full pipe is signalled enough
+	if (nonblock)
+	{
+		fcntl(fds[0],F_SETFL,O_NONBLOCK);
+	}
+#endif
+	return DMAGNETIC2_OK;
+}
+static void dMagnetic2_engine_threaded_fd_close(int fds[2])
+{
+	close(fds[0]);
+	if (fds[1]!=fds[0])
+	{
+		close(fds[1]);
+	}
+	fds[0]=fds[1]=-1;
+}
+static void dMagnetic2_engine_threaded_fd_signal(int fds[2])
+{
+	uint64_t one=1;
+#ifdef	__linux__
+	if (write(fds[1],&one,sizeof(one))) {}
+#else
+	if (write(fds[1],&one,1)) {}
+#endif
+}
+// blocking, when the file descriptor is. otherwise it just clears it.
+static void dMagnetic2_engine_threaded_fd_wait(int fds[2])
+{
+	uint64_t tmp[8];
+#ifdef	__linux__
+	if (read(fds[0],tmp,sizeof(uint64_t))) {}
+#else
+	if (read(fds[0],tmp,sizeof(tmp))) {}
+#endif
+}
+
+// the engine side
+static int dMagnetic2_engine_threaded_emit(tdMagnetic2_engine_threaded_handle* pThis,unsigned int type,int value,const char* pPayload)
+{
+	tdMagnetic2_engine_eventheader header;
+	unsigned int n;
+	header.type=type;
+	header.value=value;
+	header.len=(pPayload==NULL)?0:strlen(pPayload)+1;
+	n=sizeof(header)+header.len;
+	// wait until there is enough space in the output ring
+	while (dMagnetic2_engine_threaded_ring_free(&pThis->output)<n)
+	{
+		atomic_store(&pThis->waiting_for_space,1);
+		atomic_thread_fence(memory_order_seq_cst);	// the flag has to be visible before the tail is checked again
+		if (dMagnetic2_engine_threaded_ring_free(&pThis->output)>=n)	// the frontend might have been faster
+		{
+			atomic_store(&pThis->waiting_for_space,0);
+			break;
+		}
+		if (atomic_load(&pThis->stop))
+		{
+			return DMAGNETIC2_OK;
+		}
+		dMagnetic2_engine_threaded_fd_wait(pThis->fd_wakeup);
+	}
+	dMagnetic2_engine_threaded_ring_put(&pThis->output,0,&header,sizeof(header));
+	if (header.len)
+	{
+		dMagnetic2_engine_threaded_ring_put(&pThis->output,sizeof(header),pPayload,header.len);
+	}
+	dMagnetic2_engine_threaded_ring_commit_put(&pThis->output,n);
+	dMagnetic2_engine_threaded_fd_signal(pThis->fd_event);
+	return DMAGNETIC2_OK;
+}
+
+static void* dMagnetic2_engine_threaded_main(void* pArg)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pArg;
+	unsigned int status;
+	unsigned int reported;
+	int retval;
+
+	reported=0;
+	while (!atomic_load(&pThis->stop))
+	{
+		char* pBuf;
+		int picnum;
+
+		retval=dMagnetic2_engine_process(pThis->pEngine,0,&status);
+		if (retval!=DMAGNETIC2_OK)
+		{
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_THREADED_EVENT_ERROR,retval,NULL);
+			break;
+		}
+		if (status&DMAGNETIC2_ENGINE_STATUS_NEW_TITLE)
+		{
+			dMagnetic2_engine_get_title(pThis->pEngine,&pBuf);
+			if (pBuf[0])
+			{
+				dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_NEW_TITLE,0,pBuf);
+			}
+		}
+		if (status&DMAGNETIC2_ENGINE_STATUS_NEW_TEXT)
+		{
+			dMagnetic2_engine_get_text(pThis->pEngine,&pBuf);
+			if (pBuf[0])
+			{
+				dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_NEW_TEXT,0,pBuf);
+			}
+		}
+		if (status&DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NUM)
+		{
+			dMagnetic2_engine_get_picture_num(pThis->pEngine,&picnum);
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NUM,picnum,NULL);
+		}
+		if (status&DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NAME)
+		{
+			dMagnetic2_engine_get_picture_name(pThis->pEngine,&pBuf);
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NAME,0,pBuf);
+		}
+		// those flags are never cleared by the engine. report them only once.
+		if (status&~reported&DMAGNETIC2_ENGINE_STATUS_SAVE)
+		{
+			dMagnetic2_engine_get_filename(pThis->pEngine,&pBuf);
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_SAVE,0,pBuf);
+		}
+		if (status&~reported&DMAGNETIC2_ENGINE_STATUS_LOAD)
+		{
+			dMagnetic2_engine_get_filename(pThis->pEngine,&pBuf);
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_LOAD,0,pBuf);
+		}
+		if (status&~reported&DMAGNETIC2_ENGINE_STATUS_RESTART)
+		{
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_RESTART,0,NULL);
+		}
+		if (status&DMAGNETIC2_ENGINE_STATUS_QUIT)
+		{
+			dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_QUIT,0,NULL);
+			break;
+		}
+		reported|=status&STICKY_FLAGS;
+
+		if (status&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT)
+		{
+			char tmp[DMAGNETIC2_SIZE_INPUTBUF];
+			unsigned int n;
+			int cnt;
+
+			n=dMagnetic2_engine_threaded_ring_used(&pThis->input);
+			if (n==0)
+			{
+				dMagnetic2_engine_threaded_emit(pThis,DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT,0,NULL);
+				// sleep until the frontend delivers something
+				while (!atomic_load(&pThis->stop) && dMagnetic2_engine_threaded_ring_used(&pThis->input)==0)
+				{
+					dMagnetic2_engine_threaded_fd_wait(pThis->fd_wakeup);
+				}
+				n=dMagnetic2_engine_threaded_ring_used(&pThis->input);
+			}
+			if (n>sizeof(tmp))
+			{
+				n=sizeof(tmp);
+			}
+			if (n)
+			{
+				dMagnetic2_engine_threaded_ring_get(&pThis->input,0,tmp,n);
+				dMagnetic2_engine_new_input(pThis->pEngine,n,tmp,&cnt);
+				dMagnetic2_engine_threaded_ring_commit_get(&pThis->input,cnt);
+			}
+		}
+	}
+	return NULL;
+}
+
+// the API functions
+int dMagnetic2_engine_threaded_get_size(int *pBytes)
+{
+	int retval;
+	int bytes;
+	if (pBytes==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	retval=dMagnetic2_engine_get_size(&bytes);
+	*pBytes=ENGINE_OFFSET+bytes;
+	return retval;
+}
+
+int dMagnetic2_engine_threaded_init(void *pHandle)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	int retval;
+
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (((uintptr_t)pHandle)&(DMAGNETIC2_ENGINE_THREADED_ALIGNMENT-1))	// the ring indices would share their cache lines
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	memset(pThis,0,sizeof(tdMagnetic2_engine_threaded_handle));
+	pThis->pEngine=&((unsigned char*)pHandle)[ENGINE_OFFSET];
+	atomic_init(&pThis->stop,0);
+	atomic_init(&pThis->waiting_for_space,0);
+	dMagnetic2_engine_threaded_ring_init(&pThis->input,pThis->inputbuf,RINGSIZE_INPUT);
+	dMagnetic2_engine_threaded_ring_init(&pThis->output,pThis->outputbuf,RINGSIZE_OUTPUT);
+	pThis->fd_event[0]=pThis->fd_event[1]=-1;
+	pThis->fd_wakeup[0]=pThis->fd_wakeup[1]=-1;
+	retval=dMagnetic2_engine_threaded_fd_open(pThis->fd_event,1);
+	if (retval==DMAGNETIC2_OK) retval=dMagnetic2_engine_threaded_fd_open(pThis->fd_wakeup,0);
+	if (retval==DMAGNETIC2_OK) retval=dMagnetic2_engine_init(pThis->pEngine);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		if (pThis->fd_event[0]>=0) dMagnetic2_engine_threaded_fd_close(pThis->fd_event);
+		if (pThis->fd_wakeup[0]>=0) dMagnetic2_engine_threaded_fd_close(pThis->fd_wakeup);
+		return retval;
+	}
+	pThis->magic=MAGIC;
+
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_engine_threaded_set_mag(void *pHandle,unsigned char* pMagBuf)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->running)	// the engine belongs to the thread now
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	return dMagnetic2_engine_set_mag(pThis->pEngine,pMagBuf);
+}
+
+int dMagnetic2_engine_threaded_start(void *pHandle)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	if (pThis->magic!=MAGIC || pThis->running)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	atomic_store(&pThis->stop,0);
+	if (pthread_create(&pThis->thread,NULL,dMagnetic2_engine_threaded_main,pThis)!=0)
+	{
+		// just like after dMagnetic2_engine_threaded_stop(), the handle has to be initialized again.
+		dMagnetic2_engine_threaded_fd_close(pThis->fd_event);
+		dMagnetic2_engine_threaded_fd_close(pThis->fd_wakeup);
+		pThis->magic=0;
+		return DMAGNETIC2_ERROR_NO_RESOURCES;
+	}
+	pThis->running=1;
+	return DMAGNETIC2_OK;
+}
+
+// stops the thread and releases the file descriptors. afterwards, the handle has to be initialized again.
+int dMagnetic2_engine_threaded_stop(void *pHandle)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->running)
+	{
+		atomic_store(&pThis->stop,1);
+		dMagnetic2_engine_threaded_fd_signal(pThis->fd_wakeup);
+		pthread_join(pThis->thread,NULL);
+		pThis->running=0;
+	}
+	dMagnetic2_engine_threaded_fd_close(pThis->fd_event);
+	dMagnetic2_engine_threaded_fd_close(pThis->fd_wakeup);
+	pThis->magic=0;
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_engine_threaded_get_fd(void *pHandle,int *pFd)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pFd=pThis->fd_event[0];
+	return DMAGNETIC2_OK;
+}
+
+// the frontend side. this never waits for the engine thread.
+int dMagnetic2_engine_threaded_new_input(void *pHandle,int len,char* pInput,int *pCnt)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	unsigned int n;
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	n=dMagnetic2_engine_threaded_ring_free(&pThis->input);
+	if (len<0)
+	{
+		len=0;
+	}
+	if (n>(unsigned int)len)
+	{
+		n=len;
+	}
+	if (n)
+	{
+		dMagnetic2_engine_threaded_ring_put(&pThis->input,0,pInput,n);
+		dMagnetic2_engine_threaded_ring_commit_put(&pThis->input,n);
+		dMagnetic2_engine_threaded_fd_signal(pThis->fd_wakeup);
+	}
+	*pCnt=n;	// report back the number of character that have been read
+	return DMAGNETIC2_OK;
+}
+
+// returns the next event. *pType is DMAGNETIC2_ENGINE_STATUS_NONE when there are no more.
+int dMagnetic2_engine_threaded_get_event(void *pHandle,unsigned int *pType,int *pValue,char* pBuf,int bufsize)
+{
+	tdMagnetic2_engine_threaded_handle* pThis=(tdMagnetic2_engine_threaded_handle*)pHandle;
+	tdMagnetic2_engine_eventheader header;
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pType=DMAGNETIC2_ENGINE_STATUS_NONE;
+	*pValue=0;
+	if (dMagnetic2_engine_threaded_ring_used(&pThis->output)==0)
+	{
+		// clear the file descriptor first, then check again. an event that arrives afterwards signals it again.
+		dMagnetic2_engine_threaded_fd_wait(pThis->fd_event);
+		if (dMagnetic2_engine_threaded_ring_used(&pThis->output)==0)
+		{
+			return DMAGNETIC2_OK;
+		}
+	}
+	dMagnetic2_engine_threaded_ring_get(&pThis->output,0,&header,sizeof(header));
+	if (header.len>bufsize)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;	// the event stays in the ring
+	}
+	if (bufsize>0)
+	{
+		pBuf[0]=0;
+	}
+	if (header.len)
+	{
+		dMagnetic2_engine_threaded_ring_get(&pThis->output,sizeof(header),pBuf,header.len);
+	}
+	dMagnetic2_engine_threaded_ring_commit_get(&pThis->output,sizeof(header)+header.len);
+	*pType=header.type;
+	*pValue=header.value;
+	atomic_thread_fence(memory_order_seq_cst);	// the new tail has to be visible before the flag is checked
+	if (atomic_load(&pThis->waiting_for_space))
+	{
+		atomic_store(&pThis->waiting_for_space,0);
+		dMagnetic2_engine_threaded_fd_signal(pThis->fd_wakeup);
+	}
+	return DMAGNETIC2_OK;
+}
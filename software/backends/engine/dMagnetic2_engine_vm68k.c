@@ -27,6 +27,8 @@
 #include "dMagnetic2_errorcodes.h"
 #include "dMagnetic2_engine_vm68k.h"
 #include "dMagnetic2_engine_vm68k_decode.h"
+#include "dMagnetic2_engine_vm68k_fastpath.h"
+#include "dMagnetic2_engine_vm68k_fusion.h"
 #include "dMagnetic2_engine_vm68k_loadstore.h"
 #include "dMagnetic2_shared.h"
 #include <stdio.h>
@@ -79,7 +81,7 @@ int dMagnetic2_engine_vm68k_init(tVM68k* pVM68k,unsigned char *pMagBuf)
 //	undopc=READ_INT32BE(pMagBuf,38);
 
 	idx=42;
-	pVM68k->memsize=sizeof(pVM68k->memory);
+	pVM68k->memsize=VM68K_MEMSIZE;
 	memcpy(pVM68k->memory,&pMagBuf[idx],codesize);
 	pVM68k->magic=VM68K_MAGIC;
 	pVM68k->pcr=0;
@@ -89,7 +91,7 @@ int dMagnetic2_engine_vm68k_init(tVM68k* pVM68k,unsigned char *pMagBuf)
 		pVM68k->a[i]=0;
 		pVM68k->d[i]=0;
 	}
-	pVM68k->a[7]=pVM68k->memsize-4;	// the stack pointer goes to the end of the memory
+	pVM68k->a[7]=VM68K_MEMSIZE_GAME-4;	// the stack pointer goes to the end of the memory.
 	pVM68k->version=version;
 	return DMAGNETIC2_OK;
 }
@@ -261,7 +263,7 @@ void vm68k_get_instructionname(tVM68k_instruction instruction,char* name)
 int dMagnetic2_engine_vm68k_getNextOpcode(tVM68k* pVM68k,tVM68k_uword* opcode)
 {
 
-	*opcode=READ_INT16BE(pVM68k->memory,pVM68k->pcr);
+	*opcode=VM68K_READ16(pVM68k->memory,pVM68k->pcr);
 	pVM68k->pcr+=2;
 #ifdef	DEBUG_PRINT
 	{
@@ -304,7 +306,8 @@ int dMagnetic2_engine_vm68k_getNextOpcode(tVM68k* pVM68k,tVM68k_uword* opcode)
 
 
 
-int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
+// pInstructions returns the number of instructions retired by this step. 2 for a fused pair, 1 otherwise.
+int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode,int *pInstructions)
 {
 	tVM68k_instruction	instruction;
 	tVM68k_ubyte		addrmode;
@@ -324,8 +327,26 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 	int i;
 
 	retval=VM68K_NOK_UNKNOWN_INSTRUCTION;
+	*pInstructions=1;
 
 	instruction=dMagnetic2_engine_vm68k_decode(opcode);
+#ifndef	VM68K_NO_FUSION
+	// some instruction sequences are executed as one.
+	retval=dMagnetic2_engine_vm68k_fusion(pVM68k,instruction,opcode);
+	if (retval!=VM68K_NOK_NO_FASTPATH)
+	{
+		*pInstructions=2;
+		return retval;
+	}
+#endif
+#ifndef	VM68K_NO_FASTPATH
+	// the most common register-to-register instructions have specialized handlers.
+	retval=dMagnetic2_engine_vm68k_fastpath(pVM68k,instruction,opcode);
+	if (retval!=VM68K_NOK_NO_FASTPATH)
+	{
+		return retval;
+	}
+#endif
 	// decode the opcode
 	reg1=(opcode>>9)&0x7;
 	addrmode=(opcode>>3)&0x7;
@@ -620,7 +641,7 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 				switch (addrmode)
 				{
 					case VM68K_AM_INDIR:
-						next.pcr=operand2%pVM68k->memsize;
+						next.pcr=VM68K_WRAP(pVM68k,operand2);
 						break;
 					default:
 						next.pcr=operand2;	// wonderland
@@ -695,6 +716,31 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 				if (retval==VM68K_OK) retval=dMagnetic2_engine_vm68k_fetchoperand(pVM68k,0,datatype2,ea,&operand2);
 				if (retval==VM68K_OK) {bitmask=READEXTENSIONWORD(pVM68k,&next);}
 				if (retval==VM68K_OK)
+				{
+					tVM68k_ubyte block[16*4];
+					tVM68k_ulong bytes;
+
+					// assemble the registers in the order they end up in the memory: D0 is the lowest address,
+					// A7 the highest. when the block fits, it is written with a single memcpy.
+					bytes=0;
+					for (i=15;i>=0;i--)
+					{
+						if ((bitmask>>i)&1)
+						{
+							tVM68k_ulong x;
+							x=(i>=8)?pVM68k->d[15-i]:pVM68k->a[7-i];
+							if (datatype2==VM68K_WORD) {WRITE_INT16BE(block,bytes,x);bytes+=2;}
+							if (datatype2==VM68K_LONG) {WRITE_INT32BE(block,bytes,x);bytes+=4;}
+						}
+					}
+					if (next.a[7]>=bytes && next.a[7]<=pVM68k->memsize)
+					{
+						next.a[7]-=bytes;
+						memcpy(&(pVM68k->memory[next.a[7]]),block,bytes);
+						bitmask=0;	// nothing left for the queue below
+					}
+				}
+				if (retval==VM68K_OK)
 				{
 					for (i=0;i<8;i++)
 					{
@@ -730,6 +776,42 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 					for (i=0;i<8;i++) next.a[i]=pVM68k->a[i];
 				}
 				if (retval==VM68K_OK) {bitmask=READEXTENSIONWORD(pVM68k,&next);}
+				// when the block fits into the memory, the registers are read from it directly.
+				// restoring A7 itself is left to the slow path.
+				if (retval==VM68K_OK && !((bitmask>>15)&1))
+				{
+					tVM68k_ulong bytes;
+					bytes=0;
+					for (i=0;i<16;i++)
+					{
+						if ((bitmask>>i)&1) bytes+=(datatype2==VM68K_LONG)?4:2;
+					}
+					if (next.a[7]<=pVM68k->memsize && bytes<=pVM68k->memsize-next.a[7])
+					{
+						const tVM68k_ubyte* pBlock=&(pVM68k->memory[next.a[7]]);
+						bytes=0;
+						for (i=0;i<16;i++)
+						{
+							if ((bitmask>>i)&1)
+							{
+								tVM68k_ulong* pReg=(i<8)?&next.d[i]:&next.a[i-8];
+								if (datatype2==VM68K_WORD)
+								{
+									if (i<8) *pReg=((*pReg)&0xffff0000)|VM68K_READ16(pBlock,bytes);
+									else *pReg=VM68K_READ16(pBlock,bytes);
+									bytes+=2;
+								}
+								if (datatype2==VM68K_LONG)
+								{
+									*pReg=VM68K_READ32(pBlock,bytes);
+									bytes+=4;
+								}
+							}
+						}
+						next.a[7]+=bytes;
+						bitmask=0;	// nothing left for the slow path below
+					}
+				}
 				if (retval==VM68K_OK)
 				{
 					for (i=0;i<8;i++)
@@ -795,7 +877,7 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 			break;
 		case VM68K_INST_LEA:
 			retval=dMagnetic2_engine_vm68k_resolve_ea(pVM68k,&next,VM68K_LONG,addrmode,reg2,VM68K_LEGAL_CONTROLADDRESSING,&ea);
-			result=ea%(pVM68k->memsize);
+			result=VM68K_WRAP(pVM68k,ea);
 			if (retval==VM68K_OK) retval=dMagnetic2_engine_vm68k_storeresult(pVM68k,&next,VM68K_LONG,ADDRREGADDR(reg1),result);
 			break;
 		case VM68K_INST_NOP:
@@ -1082,8 +1164,8 @@ int dMagnetic2_engine_vm68k_singlestep(tVM68k* pVM68k,tVM68k_uword opcode)
 				switch(next.mem_size)
 				{
 					case 0:	WRITE_INT8BE(pVM68k->memory, next.mem_addr[i],next.mem_value[i]&      0xff);break;
-					case 1:	WRITE_INT16BE(pVM68k->memory,next.mem_addr[i],next.mem_value[i]&    0xffff);break;
-					case 2:	WRITE_INT32BE(pVM68k->memory,next.mem_addr[i],next.mem_value[i]&0xffffffff);break;
+					case 1:	VM68K_WRITE16(pVM68k->memory,next.mem_addr[i],next.mem_value[i]&    0xffff);break;
+					case 2:	VM68K_WRITE32(pVM68k->memory,next.mem_addr[i],next.mem_value[i]&0xffffffff);break;
 					default: retval=VM68K_NOK_UNKNOWN_INSTRUCTION;break;
 				}
 			}
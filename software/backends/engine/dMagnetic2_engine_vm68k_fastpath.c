@@ -0,0 +1,269 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_shared.h"
+#include "dMagnetic2_engine_vm68k_fastpath.h"
+#include <stddef.h>
+
+// the purpose of this file is to provide specialized handlers for the most common register-to-register
+// instructions. the generic path in dMagnetic2_engine_vm68k_singlestep() resolves the effective address,
+// fetches the operands and stores the result, switching on the addressing mode and the size every time.
+// the handlers in here are generated by the macros below, one for each combination of instruction, size
+// and addressing mode (Dn or An). the size and the register bank are known at compile time.
+//
+// the results, including the quirks of the flag calculation, have to be bit exact with the generic path.
+
+typedef int (*tVM68k_fastpath)(tVM68k* pVM68k,tVM68k_uword opcode);
+
+#define	FP_MASK_B	0x000000ffUL
+#define	FP_MASK_W	0x0000ffffUL
+#define	FP_MASK_L	0xffffffffUL
+#define	FP_BITS_B	8
+#define	FP_BITS_W	16
+#define	FP_BITS_L	32
+#define	FP_STYPE_B	tVM68k_sbyte
+#define	FP_STYPE_W	tVM68k_sword
+#define	FP_STYPE_L	tVM68k_slong
+
+#define	FP_NAME(inst,size,bank)	dMagnetic2_engine_vm68k_fastpath_##inst##_##size##_##bank
+
+#define	FP_SEXT(x,size)		((tVM68k_ulong)((tVM68k_slong)((FP_STYPE_##size)((x)&FP_MASK_##size))))
+#define	FP_MSB(x,size)		(((x)>>(FP_BITS_##size-1))&1)
+#define	FP_STORE(reg,x,size)	(reg)=((reg)&~FP_MASK_##size)|((x)&FP_MASK_##size)
+
+#define	FP_XFLAG(pVM68k)	(((pVM68k)->sr>>4)&1)
+#define	FP_ZFLAG(pVM68k)	(((pVM68k)->sr>>2)&1)
+#define	FP_SETFLAGS(pVM68k,c,v,z,n,x)	(pVM68k)->sr=((pVM68k)->sr&0xffe0)|((c)<<0)|((v)<<1)|((z)<<2)|((n)<<3)|((x)<<4)
+
+// the same formulas as in dMagnetic2_engine_vm68k_calculateflags2()
+#define	FP_CARRY_ADD(m1,m2,mr)		(((m1)&(m2))|((!(mr))&(m2))|((m1)&(!(mr))))
+#define	FP_OVERFLOW_ADD(m1,m2,mr)	(((m1)&(m2)&(!(mr)))|((!(m1))&(!(m2))&(mr)))
+#define	FP_CARRY_SUB(m1,m2,mr)		(((m1)&(!(m2)))|((mr)&(!(m2)))|((m1)&(mr)))
+#define	FP_OVERFLOW_SUB(m1,m2,mr)	(((!(m1))&(m2)&(!(mr)))|((m1)&(!(m2))&(mr)))
+
+
+// ADD/SUB/CMP <ea>,Dn
+// with a register as <ea>, direction=1 has already been decoded as ADDX/SUBX/EOR.
+#define	FP_GEN_ARITH(inst,size,bank,OP,KIND,STORE,KEEPX)	\
+static int FP_NAME(inst,size,bank)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ubyte reg1,reg2;	\
+	tVM68k_ulong operand1,operand2,result;	\
+	tVM68k_bool m1,m2,mr,cflag;	\
+	reg1=(opcode>>9)&0x7;	\
+	reg2=(opcode>>0)&0x7;	\
+	operand1=FP_SEXT(pVM68k->bank[reg2],size);	\
+	operand2=FP_SEXT(pVM68k->d[reg1],size);	\
+	result=operand2 OP operand1;	\
+	m1=FP_MSB(operand1,size);	\
+	m2=FP_MSB(operand2,size);	\
+	mr=FP_MSB(result,size);	\
+	cflag=FP_CARRY_##KIND(m1,m2,mr);	\
+	FP_SETFLAGS(pVM68k,cflag,FP_OVERFLOW_##KIND(m1,m2,mr),(result==0),mr,(KEEPX)?FP_XFLAG(pVM68k):cflag);	\
+	if (STORE) FP_STORE(pVM68k->d[reg1],result,size);	\
+	return VM68K_OK;	\
+}
+
+// ADDQ/SUBQ #<data>,<ea>
+#define	FP_GEN_QUICK(inst,size,bank,OP,KIND,ISADDQ)	\
+static int FP_NAME(inst,size,bank)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ubyte reg1,reg2;	\
+	tVM68k_ulong operand1,operand2,result;	\
+	tVM68k_bool m1,m2,mr,cflag,zflag;	\
+	reg1=(opcode>>9)&0x7;	\
+	reg2=(opcode>>0)&0x7;	\
+	operand1=(reg1==0)?8:reg1;	\
+	operand2=FP_SEXT(pVM68k->bank[reg2],size);	\
+	result=operand2 OP operand1;	\
+	m1=FP_MSB(operand1,size);	\
+	m2=FP_MSB(operand2,size);	\
+	mr=FP_MSB(result,size);	\
+	cflag=FP_CARRY_##KIND(m1,m2,mr);	\
+	zflag=(result==0);	\
+	if ((ISADDQ) && pVM68k->version>=3) zflag=FP_ZFLAG(pVM68k);	/* see the version 3 workaround in the generic path */	\
+	FP_SETFLAGS(pVM68k,cflag,FP_OVERFLOW_##KIND(m1,m2,mr),zflag,mr,cflag);	\
+	FP_STORE(pVM68k->bank[reg2],result,size);	\
+	return VM68K_OK;	\
+}
+
+// AND/OR <ea>,Dn
+// OR with direction=1 and a register as <ea> is not a legal instruction. the generic path reports it.
+#define	FP_GEN_LOGIC(inst,size,bank,OP)	\
+static int FP_NAME(inst,size,bank)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ubyte reg1,reg2;	\
+	tVM68k_ulong operand1,operand2,result;	\
+	if ((opcode>>8)&1) return VM68K_NOK_NO_FASTPATH;	\
+	reg1=(opcode>>9)&0x7;	\
+	reg2=(opcode>>0)&0x7;	\
+	operand2=pVM68k->bank[reg2]&FP_MASK_##size;	\
+	operand1=pVM68k->d[reg1]&FP_MASK_##size;	\
+	result=operand1 OP operand2;	\
+	FP_SETFLAGS(pVM68k,0,0,((result&FP_MASK_##size)==0),FP_MSB(result,size),FP_XFLAG(pVM68k));	\
+	FP_STORE(pVM68k->d[reg1],result,size);	\
+	return VM68K_OK;	\
+}
+
+// EOR Dn,Dm
+#define	FP_GEN_EOR(size)	\
+static int FP_NAME(EOR,size,d)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ubyte reg1,reg2;	\
+	tVM68k_ulong operand1,operand2,result;	\
+	reg1=(opcode>>9)&0x7;	\
+	reg2=(opcode>>0)&0x7;	\
+	operand2=pVM68k->d[reg2]&FP_MASK_##size;	\
+	operand1=pVM68k->d[reg1]&FP_MASK_##size;	\
+	result=operand1^operand2;	\
+	FP_SETFLAGS(pVM68k,0,0,((result&FP_MASK_##size)==0),FP_MSB(result,size),FP_XFLAG(pVM68k));	\
+	FP_STORE(pVM68k->d[reg2],result,size);	\
+	return VM68K_OK;	\
+}
+
+// TST Dn
+#define	FP_GEN_TST(size)	\
+static int FP_NAME(TST,size,d)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ulong result;	\
+	result=pVM68k->d[opcode&0x7]&FP_MASK_##size;	\
+	FP_SETFLAGS(pVM68k,0,0,(result==0),FP_MSB(result,size),FP_XFLAG(pVM68k));	\
+	return VM68K_OK;	\
+}
+
+// CLR Dn
+#define	FP_GEN_CLR(size)	\
+static int FP_NAME(CLR,size,d)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	FP_STORE(pVM68k->d[opcode&0x7],0,size);	\
+	FP_SETFLAGS(pVM68k,0,0,1,0,FP_XFLAG(pVM68k));	\
+	return VM68K_OK;	\
+}
+
+// MOVE <ea>,Dn
+#define	FP_GEN_MOVE(size,bank)	\
+static int FP_NAME(MOVE,size,bank)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ulong result;	\
+	if (((opcode>>6)&0x7)!=VM68K_AM_DATAREG) return VM68K_NOK_NO_FASTPATH;	/* the destination is not a register */	\
+	result=pVM68k->bank[opcode&0x7]&FP_MASK_##size;	\
+	FP_SETFLAGS(pVM68k,0,0,(result==0),FP_MSB(result,size),FP_XFLAG(pVM68k));	\
+	FP_STORE(pVM68k->d[(opcode>>9)&0x7],result,size);	\
+	return VM68K_OK;	\
+}
+
+// MOVEA <ea>,An. the flags are not affected.
+#define	FP_GEN_MOVEA(size,bank)	\
+static int FP_NAME(MOVEA,size,bank)(tVM68k* pVM68k,tVM68k_uword opcode)	\
+{	\
+	tVM68k_ulong result;	\
+	result=pVM68k->bank[opcode&0x7]&FP_MASK_##size;	\
+	FP_STORE(pVM68k->a[(opcode>>9)&0x7],result,size);	\
+	return VM68K_OK;	\
+}
+
+#define	FP_GEN_ALLSIZES(gen,...)	gen(B,__VA_ARGS__) gen(W,__VA_ARGS__) gen(L,__VA_ARGS__)
+#define	FP_GEN_ARITH_ALL(inst,OP,KIND,STORE,KEEPX)	\
+	FP_GEN_ARITH(inst,B,d,OP,KIND,STORE,KEEPX) FP_GEN_ARITH(inst,W,d,OP,KIND,STORE,KEEPX) FP_GEN_ARITH(inst,L,d,OP,KIND,STORE,KEEPX)	\
+	FP_GEN_ARITH(inst,B,a,OP,KIND,STORE,KEEPX) FP_GEN_ARITH(inst,W,a,OP,KIND,STORE,KEEPX) FP_GEN_ARITH(inst,L,a,OP,KIND,STORE,KEEPX)
+#define	FP_GEN_QUICK_ALL(inst,OP,KIND,ISADDQ)	\
+	FP_GEN_QUICK(inst,B,d,OP,KIND,ISADDQ) FP_GEN_QUICK(inst,W,d,OP,KIND,ISADDQ) FP_GEN_QUICK(inst,L,d,OP,KIND,ISADDQ)	\
+	FP_GEN_QUICK(inst,B,a,OP,KIND,ISADDQ) FP_GEN_QUICK(inst,W,a,OP,KIND,ISADDQ) FP_GEN_QUICK(inst,L,a,OP,KIND,ISADDQ)
+#define	FP_GEN_LOGIC_ALL(inst,OP)	\
+	FP_GEN_LOGIC(inst,B,d,OP) FP_GEN_LOGIC(inst,W,d,OP) FP_GEN_LOGIC(inst,L,d,OP)	\
+	FP_GEN_LOGIC(inst,B,a,OP) FP_GEN_LOGIC(inst,W,a,OP) FP_GEN_LOGIC(inst,L,a,OP)
+
+FP_GEN_ARITH_ALL(ADD,+,ADD,1,0)
+FP_GEN_ARITH_ALL(SUB,-,SUB,1,0)
+FP_GEN_ARITH_ALL(CMP,-,SUB,0,1)
+FP_GEN_QUICK_ALL(ADDQ,+,ADD,1)
+FP_GEN_QUICK_ALL(SUBQ,-,SUB,0)
+FP_GEN_LOGIC_ALL(AND,&)
+FP_GEN_LOGIC_ALL(OR,|)
+FP_GEN_EOR(B) FP_GEN_EOR(W) FP_GEN_EOR(L)
+FP_GEN_TST(B) FP_GEN_TST(W) FP_GEN_TST(L)
+FP_GEN_CLR(B) FP_GEN_CLR(W) FP_GEN_CLR(L)
+FP_GEN_MOVE(B,d) FP_GEN_MOVE(W,d) FP_GEN_MOVE(L,d)
+FP_GEN_MOVE(B,a) FP_GEN_MOVE(W,a) FP_GEN_MOVE(L,a)
+FP_GEN_MOVEA(B,d) FP_GEN_MOVEA(W,d) FP_GEN_MOVEA(L,d)
+FP_GEN_MOVEA(B,a) FP_GEN_MOVEA(W,a) FP_GEN_MOVEA(L,a)
+
+// the lookup table: [instruction][size][addressing mode Dn/An]
+#define	FP_ROW(inst)	{	\
+	{FP_NAME(inst,B,d),FP_NAME(inst,B,a)},	\
+	{FP_NAME(inst,W,d),FP_NAME(inst,W,a)},	\
+	{FP_NAME(inst,L,d),FP_NAME(inst,L,a)},	\
+	{NULL,NULL}}
+#define	FP_ROW_DATAREG(inst)	{	\
+	{FP_NAME(inst,B,d),NULL},	\
+	{FP_NAME(inst,W,d),NULL},	\
+	{FP_NAME(inst,L,d),NULL},	\
+	{NULL,NULL}}
+
+static const tVM68k_fastpath dMagnetic2_engine_vm68k_fastpath_tab[VM68K_INST_UNLK+1][4][2]=
+{
+	[VM68K_INST_ADD]=	FP_ROW(ADD),
+	[VM68K_INST_SUB]=	FP_ROW(SUB),
+	[VM68K_INST_CMP]=	FP_ROW(CMP),
+	[VM68K_INST_ADDQ]=	FP_ROW(ADDQ),
+	[VM68K_INST_SUBQ]=	FP_ROW(SUBQ),
+	[VM68K_INST_AND]=	FP_ROW(AND),
+	[VM68K_INST_OR]=	FP_ROW(OR),
+	[VM68K_INST_EOR]=	FP_ROW_DATAREG(EOR),
+	[VM68K_INST_TST]=	FP_ROW_DATAREG(TST),
+	[VM68K_INST_CLR]=	FP_ROW_DATAREG(CLR),
+	[VM68K_INST_MOVE]=	FP_ROW(MOVE),
+	[VM68K_INST_MOVEA]=	FP_ROW(MOVEA),
+};
+
+// returns VM68K_NOK_NO_FASTPATH when the opcode has to be handled by the generic path.
+int dMagnetic2_engine_vm68k_fastpath(tVM68k* pVM68k,tVM68k_instruction instruction,tVM68k_uword opcode)
+{
+	static const tVM68k_ubyte movesize[4]={VM68K_UNKNOWN,VM68K_BYTE,VM68K_LONG,VM68K_WORD};	// MOVE encodes the size differently
+	tVM68k_fastpath handler;
+	tVM68k_ubyte addrmode;
+	tVM68k_ubyte size;
+
+	addrmode=(opcode>>3)&0x7;
+	if (addrmode>VM68K_AM_ADDRREG)
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	if (instruction==VM68K_INST_MOVE || instruction==VM68K_INST_MOVEA)
+	{
+		size=movesize[(opcode>>12)&0x3];
+	} else {
+		size=(opcode>>6)&0x3;
+	}
+	handler=dMagnetic2_engine_vm68k_fastpath_tab[instruction][size][addrmode];
+	if (handler==NULL)
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	return handler(pVM68k,opcode);
+}
+
@@ -0,0 +1,190 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_shared.h"
+#include "dMagnetic2_engine_vm68k.h"
+#include "dMagnetic2_engine_vm68k_fastpath.h"
+#include "dMagnetic2_engine_vm68k_fusion.h"
+#include <stddef.h>
+
+// the purpose of this file is to execute a few hot instruction sequences as one "superinstruction".
+// the first opcode has already been fetched. its handler peeks at the opcodes following it, and when
+// they form one of the idioms below, the whole sequence is executed in one go:
+//
+// MOVE.B (An)+,(Am)+ / DBcc Dk,<back to the MOVE>	the string copy loop. one iteration at a time.
+// CMP.x <Dn/An>,Dm / Bcc					compare and branch
+// TST.x Dn / Bcc						test and branch
+//
+// otherwise, VM68K_NOK_NO_FASTPATH is returned BEFORE anything has been modified, and the opcode is
+// executed on its own. the results have to be bit exact with executing the instructions one by one.
+// compile with -DVM68K_NO_FUSION to compare. a fused step always retires two instructions.
+
+typedef int (*tVM68k_fusion)(tVM68k* pVM68k,tVM68k_uword opcode);
+
+// MOVE.B (An)+,(Am)+
+// DBcc Dk,*-2
+// one iteration per call, so that a step never runs away. the callers rely on it for the single stepping and the quantum.
+static int dMagnetic2_engine_vm68k_fusion_copyloop(tVM68k* pVM68k,tVM68k_uword opcode)
+{
+	tVM68k_uword opcode2;
+	tVM68k_ulong pcr_loop;
+	tVM68k_ulong src,dst;
+	tVM68k_uword counter;
+	tVM68k_ubyte regsrc,regdst,regcnt;
+	tVM68k_ubyte condition;
+	tVM68k_ubyte value;
+
+	if ((opcode&0xf1f8)!=0x10d8)	// only MOVE.B (An)+,(Am)+
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	regsrc=(opcode>>0)&0x7;
+	regdst=(opcode>>9)&0x7;
+	if (regsrc==regdst)		// MOVE.B (An)+,(An)+ increments the register twice. not worth it.
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	pcr_loop=pVM68k->pcr-2;
+	opcode2=VM68K_READ16(pVM68k->memory,pVM68k->pcr);
+	if ((opcode2&0xf0f8)!=0x50c8 || (tVM68k_sword)VM68K_READ16(pVM68k->memory,pVM68k->pcr+2)!=-4)	// DBcc, jumping back to the MOVE
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	condition=(opcode2>>8)&0xf;
+	regcnt=(opcode2>>0)&0x7;
+
+	src=pVM68k->a[regsrc];
+	dst=pVM68k->a[regdst];
+	// addresses outside of the memory are wrapped around by the generic path. leave it to that one.
+	// the same goes for a copy which overwrites the DBcc.
+	if (src>=pVM68k->memsize || dst>=pVM68k->memsize || (dst>=pcr_loop && dst<pcr_loop+6))
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	// MOVE.B (An)+,(Am)+
+	value=pVM68k->memory[src];
+	pVM68k->memory[dst]=value;
+	pVM68k->a[regsrc]=src+1;
+	pVM68k->a[regdst]=dst+1;
+	pVM68k->sr&=0xfff0;	// C=0, V=0, X is not affected
+	pVM68k->sr|=(value==0)<<2;
+	pVM68k->sr|=((value>>7)&1)<<3;
+
+	// DBcc Dk
+	pVM68k->pcr=pcr_loop+6;		// after the DBcc
+	if (!dMagnetic2_engine_checkcondition(pVM68k,condition))
+	{
+		counter=pVM68k->d[regcnt]&0xffff;
+		counter--;
+		pVM68k->d[regcnt]&=0xffff0000;
+		pVM68k->d[regcnt]|=counter;
+		if ((tVM68k_sword)counter>=0)
+		{
+			pVM68k->pcr=pcr_loop;	// back to the top of the loop
+		}
+	}
+
+	return VM68K_OK;
+}
+
+// <instruction> / Bcc
+// the first instruction has to be one with a specialized handler.
+static int dMagnetic2_engine_vm68k_fusion_branch(tVM68k* pVM68k,tVM68k_instruction instruction,tVM68k_uword opcode)
+{
+	tVM68k_uword opcode2;
+	tVM68k_ulong pcr;
+	tVM68k_ubyte condition;
+	tVM68k_sword displacement;
+	int retval;
+
+	opcode2=VM68K_READ16(pVM68k->memory,pVM68k->pcr);
+	condition=(opcode2>>8)&0xf;
+	if ((opcode2&0xf000)!=0x6000 || condition==1)	// Bcc, but not BSR
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+#ifdef	VM68K_NO_FASTPATH
+	// the first instruction is executed by its specialized handler, which has been compiled out.
+	retval=VM68K_NOK_NO_FASTPATH;
+#else
+	retval=dMagnetic2_engine_vm68k_fastpath(pVM68k,instruction,opcode);
+#endif
+	if (retval!=VM68K_OK)
+	{
+		return retval;
+	}
+	pVM68k->pcr+=2;
+	pcr=pVM68k->pcr;
+	displacement=(tVM68k_sword)((tVM68k_sbyte)(opcode2&0xff));
+	if (displacement==0)
+	{
+		displacement=VM68K_READ16(pVM68k->memory,pcr);
+		pcr+=2;
+	}
+	if (dMagnetic2_engine_checkcondition(pVM68k,condition))
+	{
+		pcr=pVM68k->pcr+displacement;
+	}
+	pVM68k->pcr=pcr;
+
+	return VM68K_OK;
+}
+
+// CMP.x <Dn/An>,Dm
+// Bcc
+static int dMagnetic2_engine_vm68k_fusion_cmp_bcc(tVM68k* pVM68k,tVM68k_uword opcode)
+{
+	return dMagnetic2_engine_vm68k_fusion_branch(pVM68k,VM68K_INST_CMP,opcode);
+}
+
+// TST.x Dn
+// Bcc
+static int dMagnetic2_engine_vm68k_fusion_tst_bcc(tVM68k* pVM68k,tVM68k_uword opcode)
+{
+	return dMagnetic2_engine_vm68k_fusion_branch(pVM68k,VM68K_INST_TST,opcode);
+}
+
+// the lookup table: which idiom could start with this instruction?
+static const tVM68k_fusion dMagnetic2_engine_vm68k_fusion_tab[VM68K_INST_UNLK+1]=
+{
+	[VM68K_INST_MOVE]=	dMagnetic2_engine_vm68k_fusion_copyloop,
+	[VM68K_INST_CMP]=	dMagnetic2_engine_vm68k_fusion_cmp_bcc,
+	[VM68K_INST_TST]=	dMagnetic2_engine_vm68k_fusion_tst_bcc,
+};
+
+// returns VM68K_NOK_NO_FASTPATH when the opcode has to be executed on its own.
+int dMagnetic2_engine_vm68k_fusion(tVM68k* pVM68k,tVM68k_instruction instruction,tVM68k_uword opcode)
+{
+	tVM68k_fusion handler;
+
+	handler=dMagnetic2_engine_vm68k_fusion_tab[instruction];
+	if (handler==NULL)
+	{
+		return VM68K_NOK_NO_FASTPATH;
+	}
+	return handler(pVM68k,opcode);
+}
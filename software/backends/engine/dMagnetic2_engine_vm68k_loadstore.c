@@ -115,7 +115,7 @@ int dMagnetic2_engine_vm68k_resolve_ea(tVM68k* pVM68k,tVM68k_next *pNext,tVM68k_
 						break;
 			case VM68K_AM_INDIR:	if (legal&VM68K_LEGAL_AM_INDIR)
 						{
-							*ea=(pVM68k->a[reg])%pVM68k->memsize;
+							*ea=VM68K_WRAP(pVM68k,pVM68k->a[reg]);
 							retval=VM68K_OK;
 						}
 						break;
@@ -185,13 +185,13 @@ int dMagnetic2_engine_vm68k_fetchoperand(tVM68k* pVM68k,tVM68k_bool extendsign,t
 	op=0;
 	if (ea>=0)	// memory address
 	{
-		ea%=pVM68k->memsize;	// just to be safe...
+		ea=VM68K_WRAP(pVM68k,ea);	// just to be safe...
 		retval=VM68K_OK;
 		switch (size)
 		{
 			case VM68K_BYTE: op= READ_INT8BE(pVM68k->memory,ea);break;
-			case VM68K_WORD: op=READ_INT16BE(pVM68k->memory,ea);break;
-			case VM68K_LONG: op=READ_INT32BE(pVM68k->memory,ea);break;
+			case VM68K_WORD: op=VM68K_READ16(pVM68k->memory,ea);break;
+			case VM68K_LONG: op=VM68K_READ32(pVM68k->memory,ea);break;
 			default: retval=VM68K_NOK_INVALID_PTR;break;
 		}
 	} else {	// register address
@@ -329,7 +329,7 @@ int dMagnetic2_engine_vm68k_storeresult(tVM68k* pVM68k,tVM68k_next* pNext,tVM68k
 	if (ea>=0)	// memory address
 	{
 		retval=VM68K_OK;
-		ea%=pVM68k->memsize;	// just to be safe...
+		ea=VM68K_WRAP(pVM68k,ea);	// just to be safe...
 		pNext->mem_size=size;
 		pNext->mem_addr[pNext->mem_we]=ea;
 		pNext->mem_value[pNext->mem_we]=result&lowermask;
@@ -154,6 +154,10 @@ int dMagnetic2_graphics_animation_nxtframe(void* pHandle,int *pIsLast,tdMagnetic
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
 	}
 	retval=dMagnetic2_animations_magwin_render_frame(&(pThis->hAnimations),pIsLast,pSmall,pLarge);
+	if (retval==DMAGNETIC2_OK)
+	{
+		METRICS_ADD(dMagnetic2_graphics_metrics.animation_frames,1);
+	}
 	return retval;
 }
 int dMagnetic2_graphics_getpicname(void* pHandle,char* picname,int picnum)
@@ -0,0 +1,78 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_metrics.h"
+#include "dMagnetic2_metrics_shared.h"
+#include "dMagnetic2_pictures.h"
+
+// the purpose of this file is to report the counters of the graphics.
+
+tdMagnetic2_graphics_metrics_atomic dMagnetic2_graphics_metrics;
+
+static const char* dMagnetic2_graphics_metrics_names[DMAGNETIC2_METRICS_FORMATS]={"none","gfx1","gfx2","msdos","magwin","c64","amstrad_cpc","atari_xl","apple_ii"};
+
+int dMagnetic2_graphics_get_metrics(tdMagnetic2_graphics_metrics *pMetrics)
+{
+	int i;
+	if (pMetrics==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	for (i=0;i<DMAGNETIC2_METRICS_FORMATS;i++)
+	{
+		dMagnetic2_metrics_histogram_get(&dMagnetic2_graphics_metrics.decode[i],&pMetrics->decode[i]);
+	}
+	pMetrics->animation_frames=METRICS_LOAD(dMagnetic2_graphics_metrics.animation_frames);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_graphics_metrics_text(char* pBuf,int bufsize,int *pLen)
+{
+	tdMagnetic2_graphics_metrics metrics;
+	char label[32];
+	int idx;
+	int i;
+	if (pBuf==NULL || pLen==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	dMagnetic2_graphics_get_metrics(&metrics);
+	idx=0;
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_graphics_decode_duration_us histogram\n");
+	for (i=1;i<DMAGNETIC2_METRICS_FORMATS;i++)	// nothing is being decoded without a format
+	{
+		snprintf(label,sizeof(label),"format=\"%s\"",dMagnetic2_graphics_metrics_names[i]);
+		idx=dMagnetic2_metrics_histogram_text(pBuf,bufsize,idx,"dmagnetic2_graphics_decode_duration_us",label,&metrics.decode[i]);
+	}
+	METRICS_PRINTF(pBuf,bufsize,idx,"# TYPE dmagnetic2_graphics_animation_frames_total counter\n");
+	METRICS_PRINTF(pBuf,bufsize,idx,"dmagnetic2_graphics_animation_frames_total %llu\n",metrics.animation_frames);
+	*pLen=idx;
+	if (idx>=bufsize)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	return DMAGNETIC2_OK;
+}
@@ -86,6 +86,7 @@ int dMagnetic2_pictures_set_gfx(tdMagnetic2_picture_handle *pThis,unsigned char*
 int dMagnetic2_pictures_decode_by_picnum(tdMagnetic2_picture_handle *pThis,int picnum,tdMagnetic2_canvas_small *pSmall,tdMagnetic2_canvas_large *pLarge)
 {
 	int retval;
+	unsigned long long t0;
 	if (pThis->magic!=MAGIC)
 	{
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
@@ -96,6 +97,7 @@ int dMagnetic2_pictures_decode_by_picnum(tdMagnetic2_picture_handle *pThis,int p
 	}
 
 	retval=DMAGNETIC2_OK;
+	t0=METRICS_NOW();
 	switch (pThis->format)
 	{
 		case DMAGNETIC2_FORMAT_GFX1:		retval=dMagnetic2_gfxloader_gfx1(pThis->pGfxBuf,pThis->gfxsize,picnum,pSmall,pLarge);	break;
@@ -108,12 +110,14 @@ int dMagnetic2_pictures_decode_by_picnum(tdMagnetic2_picture_handle *pThis,int p
 			retval=DMAGNETIC2_OK;
 			
 	}
+	METRICS_HISTOGRAM(&dMagnetic2_graphics_metrics.decode[pThis->format],METRICS_NOW()-t0);
 	return retval;
 }
 
 int dMagnetic2_pictures_decode_by_picname(tdMagnetic2_picture_handle *pThis,char* picname,int vga0ega1,tdMagnetic2_canvas_small *pSmall,tdMagnetic2_canvas_large *pLarge)
 {
 	int retval;
+	unsigned long long t0;
 	if (pThis->magic!=MAGIC)
 	{
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
@@ -123,6 +127,7 @@ int dMagnetic2_pictures_decode_by_picname(tdMagnetic2_picture_handle *pThis,char
 		return DMAGNETIC2_OK;	// nothing loaded? nothing to do
 	}
 
+	t0=METRICS_NOW();
 	switch (pThis->format)
 	{
 		case DMAGNETIC2_FORMAT_GFX2:		retval=dMagnetic2_gfxloader_gfx2(pThis->pGfxBuf,pThis->gfxsize,picname,pSmall,pLarge);	break;
@@ -131,6 +136,7 @@ int dMagnetic2_pictures_decode_by_picname(tdMagnetic2_picture_handle *pThis,char
 			retval=DMAGNETIC2_OK;
 			
 	}
+	METRICS_HISTOGRAM(&dMagnetic2_graphics_metrics.decode[pThis->format],METRICS_NOW()-t0);
 	return retval;
 }
 
@@ -28,6 +28,7 @@
 #define	DMAGNETIC2_PICTURES_H
 
 #include "dMagnetic2_graphics.h"	// for the datatypes
+#include "dMagnetic2_metrics_shared.h"
 
 typedef	enum _tGraphic_format
 {
@@ -57,6 +58,14 @@ int dMagnetic2_pictures_decode_by_picnum(tdMagnetic2_picture_handle *pThis,int p
 int dMagnetic2_pictures_decode_by_picname(tdMagnetic2_picture_handle *pThis,char* picname,int vga0ega1,tdMagnetic2_canvas_small *pSmall,tdMagnetic2_canvas_large *pLarge);
 int dMagnetic2_pictures_getpicname(tdMagnetic2_picture_handle *pThis,char* picname,int picnum);		// helper function
 
+// the counters for the whole process, see dMagnetic2_graphics_metrics.c
+typedef struct _tdMagnetic2_graphics_metrics_atomic
+{
+	tdMagnetic2_metrics_histogram_atomic decode[DMAGNETIC2_METRICS_FORMATS];	// by tGraphic_format
+	atomic_ullong animation_frames;
+} tdMagnetic2_graphics_metrics_atomic;
+extern tdMagnetic2_graphics_metrics_atomic dMagnetic2_graphics_metrics;
+
 #endif
 
 
@@ -0,0 +1,292 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_graphics.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_instance.h"
+#include <stdint.h>
+#include <string.h>
+
+// the purpose of this file is to put everything one game needs into one arena.
+//
+// while loading:
+//   [instance][loader handle][loader tmpbuf][mag][gfx]
+// afterwards:
+//   [instance][engine handle][graphics handle][graphics tmpbuf][mag][gfx]
+// every region starts on a cache line. the mag and the gfx buffer have the probed sizes, or the
+// maximum sizes without a probe. the engine handle gets the size for this mag, once it has been loaded.
+
+#define	MAGIC		0x496e7374	// "Inst"
+#define	ALIGN(x)	(((x)+DMAGNETIC2_INSTANCE_ALIGNMENT-1)&~(DMAGNETIC2_INSTANCE_ALIGNMENT-1))
+
+typedef struct _tdMagnetic2_instance_handle
+{
+	unsigned int magic;
+	int size;
+	int loaded;
+	int engineoffset;
+	int graphicsoffset;
+	int graphicstmpoffset;
+	int magoffset;
+	int gfxoffset;
+	int gfxsize;
+	int used;
+	tdMagnetic2_game_meta meta;
+} tdMagnetic2_instance_handle;
+
+// the arena for both layouts. the mag is not known yet, so the engine handle is counted with its largest size.
+static int dMagnetic2_instance_needed(int magsize,int gfxsize)
+{
+	int size_loaderhandle;
+	int size_loadertmp;
+	int size_engine;
+	int size_graphicshandle;
+	int size_graphicstmp;
+	int size_loading;
+	int size_running;
+
+	dMagnetic2_loader_getsize(&size_loaderhandle,&size_loadertmp);
+	dMagnetic2_engine_get_size(&size_engine);
+	dMagnetic2_graphics_getsize(&size_graphicshandle,&size_graphicstmp);
+	size_loading=ALIGN(sizeof(tdMagnetic2_instance_handle))+ALIGN(size_loaderhandle)+ALIGN(size_loadertmp)+ALIGN(magsize)+ALIGN(gfxsize);
+	size_running=ALIGN(sizeof(tdMagnetic2_instance_handle))+ALIGN(size_engine)+ALIGN(size_graphicshandle)+ALIGN(size_graphicstmp)+ALIGN(magsize)+ALIGN(gfxsize);
+	return (size_loading>size_running)?size_loading:size_running;
+}
+int dMagnetic2_instance_getsize(int *pSize_probe,int *pSize_load)
+{
+	if (pSize_probe==NULL || pSize_load==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	*pSize_probe=dMagnetic2_instance_needed(0,0);
+	*pSize_load=dMagnetic2_instance_needed(DMAGNETIC2_MAX_MAGSIZE,DMAGNETIC2_MAX_GFXSIZE);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_instance_init(void *pArena,int size)
+{
+	tdMagnetic2_instance_handle* pThis=(tdMagnetic2_instance_handle*)pArena;
+	int needed;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (((uintptr_t)pArena)&(DMAGNETIC2_INSTANCE_ALIGNMENT-1))
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	needed=dMagnetic2_instance_needed(0,0);
+	if (size<needed)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	memset(pThis,0,sizeof(tdMagnetic2_instance_handle));
+	pThis->magic=MAGIC;
+	pThis->size=size;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_instance_probe(void *pArena,char* filename1,char* filename2,char* filename3,int nodoc,tdMagnetic2_game_meta *pProbed,int *pSize_arena)
+{
+	tdMagnetic2_instance_handle* pThis=(tdMagnetic2_instance_handle*)pArena;
+	unsigned char* pBase=(unsigned char*)pArena;
+	int size_loaderhandle;
+	int size_loadertmp;
+	int loaderoffset;
+	int loadertmpoffset;
+	int retval;
+
+	if (pThis==NULL || pProbed==NULL || pSize_arena==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC || pThis->loaded)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	dMagnetic2_loader_getsize(&size_loaderhandle,&size_loadertmp);
+	loaderoffset=ALIGN(sizeof(tdMagnetic2_instance_handle));
+	loadertmpoffset=loaderoffset+ALIGN(size_loaderhandle);
+	retval=dMagnetic2_loader_init(&pBase[loaderoffset],&pBase[loadertmpoffset]);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader_probe(&pBase[loaderoffset],filename1,filename2,filename3,pProbed,nodoc);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	if (pProbed->real_magsize<=0 || pProbed->real_magsize>DMAGNETIC2_MAX_MAGSIZE || pProbed->real_gfxsize<0 || pProbed->real_gfxsize>DMAGNETIC2_MAX_GFXSIZE)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	*pSize_arena=dMagnetic2_instance_needed(pProbed->real_magsize,pProbed->real_gfxsize);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_instance_load(void *pArena,char* filename1,char* filename2,char* filename3,int nodoc,tdMagnetic2_game_meta *pProbed,int *pUsed)
+{
+	tdMagnetic2_instance_handle* pThis=(tdMagnetic2_instance_handle*)pArena;
+	unsigned char* pBase=(unsigned char*)pArena;
+	int size_loaderhandle;
+	int size_loadertmp;
+	int size_engine;
+	int size_graphicshandle;
+	int size_graphicstmp;
+	int loaderoffset;
+	int loadertmpoffset;
+	int stagingmagoffset;
+	int staginggfxoffset;
+	int stagingmagsize;
+	int staginggfxsize;
+	int magsize;
+	int retval;
+
+	if (pThis==NULL || pUsed==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC || pThis->loaded)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	stagingmagsize=DMAGNETIC2_MAX_MAGSIZE;
+	staginggfxsize=DMAGNETIC2_MAX_GFXSIZE;
+	if (pProbed!=NULL)
+	{
+		if (pProbed->real_magsize<=0 || pProbed->real_magsize>DMAGNETIC2_MAX_MAGSIZE || pProbed->real_gfxsize<0 || pProbed->real_gfxsize>DMAGNETIC2_MAX_GFXSIZE)
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+		stagingmagsize=pProbed->real_magsize;
+		staginggfxsize=pProbed->real_gfxsize;
+	}
+	if (pThis->size<dMagnetic2_instance_needed(stagingmagsize,staginggfxsize))
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	dMagnetic2_loader_getsize(&size_loaderhandle,&size_loadertmp);
+	dMagnetic2_graphics_getsize(&size_graphicshandle,&size_graphicstmp);
+
+	// the loading layout
+	loaderoffset=ALIGN(sizeof(tdMagnetic2_instance_handle));
+	loadertmpoffset=loaderoffset+ALIGN(size_loaderhandle);
+	stagingmagoffset=loadertmpoffset+ALIGN(size_loadertmp);
+	staginggfxoffset=stagingmagoffset+ALIGN(stagingmagsize);
+
+	retval=dMagnetic2_loader_init(&pBase[loaderoffset],&pBase[loadertmpoffset]);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader(&pBase[loaderoffset],filename1,filename2,filename3,&pBase[stagingmagoffset],stagingmagsize,&pBase[staginggfxoffset],staginggfxsize,&(pThis->meta),nodoc);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	magsize=pThis->meta.real_magsize;
+	if (magsize<=0)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	// the files have shrunk since the probe. had they grown, the loader would not have fit them into the staging buffers.
+	if (pProbed!=NULL && (magsize!=pProbed->real_magsize || pThis->meta.real_gfxsize!=pProbed->real_gfxsize))
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	retval=dMagnetic2_engine_get_size_for_mag(&pBase[stagingmagoffset],&size_engine);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+
+	// the running layout. the loader is not needed anymore
+	pThis->engineoffset=ALIGN(sizeof(tdMagnetic2_instance_handle));
+	pThis->graphicsoffset=pThis->engineoffset+ALIGN(size_engine);
+	pThis->graphicstmpoffset=pThis->graphicsoffset+ALIGN(size_graphicshandle);
+	pThis->magoffset=pThis->graphicstmpoffset+ALIGN(size_graphicstmp);
+	pThis->gfxoffset=pThis->magoffset+ALIGN(magsize);
+	pThis->gfxsize=pThis->meta.real_gfxsize;
+	pThis->used=pThis->gfxoffset+ALIGN(pThis->gfxsize);
+
+	// the handles might be larger than the loader, at least in theory. 
+	if (pThis->magoffset<=stagingmagoffset)
+	{
+		memmove(&pBase[pThis->magoffset],&pBase[stagingmagoffset],magsize);
+		memmove(&pBase[pThis->gfxoffset],&pBase[staginggfxoffset],pThis->gfxsize);
+	} else {
+		memmove(&pBase[pThis->gfxoffset],&pBase[staginggfxoffset],pThis->gfxsize);
+		memmove(&pBase[pThis->magoffset],&pBase[stagingmagoffset],magsize);
+	}
+
+	retval=dMagnetic2_engine_init(&pBase[pThis->engineoffset]);
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_engine_set_mag(&pBase[pThis->engineoffset],&pBase[pThis->magoffset]);
+	}
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_graphics_init(&pBase[pThis->graphicsoffset],&pBase[pThis->graphicstmpoffset]);
+	}
+	if (retval==DMAGNETIC2_OK && pThis->gfxsize>0)
+	{
+		retval=dMagnetic2_graphics_set_gfx(&pBase[pThis->graphicsoffset],&pBase[pThis->gfxoffset],pThis->gfxsize);
+	}
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	pThis->loaded=1;
+	*pUsed=pThis->used;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_instance_get_handles(void *pArena,void** ppEngine,void** ppGraphics,tdMagnetic2_game_meta *pMeta)
+{
+	tdMagnetic2_instance_handle* pThis=(tdMagnetic2_instance_handle*)pArena;
+	unsigned char* pBase=(unsigned char*)pArena;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC || !pThis->loaded)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	// every pointer is optional
+	if (ppEngine!=NULL)
+	{
+		*ppEngine=&pBase[pThis->engineoffset];
+	}
+	if (ppGraphics!=NULL)
+	{
+		*ppGraphics=(pThis->gfxsize>0)?&pBase[pThis->graphicsoffset]:NULL;
+	}
+	if (pMeta!=NULL)
+	{
+		*pMeta=pThis->meta;
+	}
+	return DMAGNETIC2_OK;
+}
@@ -0,0 +1,231 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_catalog.h"
+#include <string.h>
+
+// the purpose of this file is to load the games once per process.
+// every game is decoded once into the temporary buffer, and then copied into the catalog with its real sizes.
+// the mag buffer is never written to by the engine, so one copy is enough for every session.
+//
+// the temporary buffer holds the loader handle, the temporary buffer of the loader, and the mag and gfx buffers
+// for the worst case.
+
+#define	MAGIC		0x43617461	// "Cata"
+#define	ALIGN(x)	(((x)+15)&~15)
+
+typedef struct _tdMagnetic2_catalog_game
+{
+	tdMagnetic2_game_meta meta;
+	int magoffset;
+	int gfxoffset;		// -1 if there are no pictures
+} tdMagnetic2_catalog_game;
+
+typedef struct _tdMagnetic2_catalog_handle
+{
+	unsigned int magic;
+	int size;
+	int used;
+	unsigned char *pTmpBuf;
+	int gamecnt;
+	tdMagnetic2_catalog_game games[DMAGNETIC2_CATALOG_MAX_GAMES];
+} tdMagnetic2_catalog_handle;
+
+int dMagnetic2_catalog_getsize(int *pSize_handle,int *pSize_tmpbuf)
+{
+	int size_loaderhandle;
+	int size_loadertmp;
+	if (pSize_handle==NULL || pSize_tmpbuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	dMagnetic2_loader_getsize(&size_loaderhandle,&size_loadertmp);
+	*pSize_handle=ALIGN(sizeof(tdMagnetic2_catalog_handle));
+	*pSize_tmpbuf=ALIGN(size_loaderhandle)+ALIGN(size_loadertmp)+ALIGN(DMAGNETIC2_MAX_MAGSIZE)+ALIGN(DMAGNETIC2_MAX_GFXSIZE);
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_catalog_init(void *pHandle,int size,void *pTmpBuf)
+{
+	tdMagnetic2_catalog_handle* pThis=(tdMagnetic2_catalog_handle*)pHandle;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (size<(int)ALIGN(sizeof(tdMagnetic2_catalog_handle)))
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	memset(pThis,0,sizeof(tdMagnetic2_catalog_handle));
+	pThis->magic=MAGIC;
+	pThis->size=size;
+	pThis->used=ALIGN(sizeof(tdMagnetic2_catalog_handle));
+	pThis->pTmpBuf=(unsigned char*)pTmpBuf;
+	pThis->gamecnt=0;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_catalog_add(void *pHandle,char* filename1,char* filename2,char* filename3,int nodoc,int *pId)
+{
+	tdMagnetic2_catalog_handle* pThis=(tdMagnetic2_catalog_handle*)pHandle;
+	tdMagnetic2_catalog_game* pGame;
+	int size_loaderhandle;
+	int size_loadertmp;
+	unsigned char* pLoaderHandle;
+	unsigned char* pLoaderTmp;
+	unsigned char* pStagingMag;
+	unsigned char* pStagingGfx;
+	int needed;
+	int retval;
+
+	if (pThis==NULL || pId==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC || pThis->pTmpBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->gamecnt>=DMAGNETIC2_CATALOG_MAX_GAMES)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	dMagnetic2_loader_getsize(&size_loaderhandle,&size_loadertmp);
+	pLoaderHandle=pThis->pTmpBuf;
+	pLoaderTmp=&pLoaderHandle[ALIGN(size_loaderhandle)];
+	pStagingMag=&pLoaderTmp[ALIGN(size_loadertmp)];
+	pStagingGfx=&pStagingMag[ALIGN(DMAGNETIC2_MAX_MAGSIZE)];
+
+	pGame=&(pThis->games[pThis->gamecnt]);
+	memset(pGame,0,sizeof(tdMagnetic2_catalog_game));
+	retval=dMagnetic2_loader_init(pLoaderHandle,pLoaderTmp);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	// a probe would decode the images as well. so the game is decoded only once, into the staging buffers.
+	retval=dMagnetic2_loader(pLoaderHandle,filename1,filename2,filename3,pStagingMag,DMAGNETIC2_MAX_MAGSIZE,pStagingGfx,DMAGNETIC2_MAX_GFXSIZE,&(pGame->meta),nodoc);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	if (pGame->meta.real_magsize<=0)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+
+	needed=ALIGN(pGame->meta.real_magsize)+ALIGN(pGame->meta.real_gfxsize);
+	if (pThis->used+needed>pThis->size)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	pGame->magoffset=pThis->used;
+	memcpy(&((unsigned char*)pHandle)[pGame->magoffset],pStagingMag,pGame->meta.real_magsize);
+	pThis->used+=ALIGN(pGame->meta.real_magsize);
+	pGame->gfxoffset=-1;
+	if (pGame->meta.real_gfxsize>0)
+	{
+		pGame->gfxoffset=pThis->used;
+		memcpy(&((unsigned char*)pHandle)[pGame->gfxoffset],pStagingGfx,pGame->meta.real_gfxsize);
+		pThis->used+=ALIGN(pGame->meta.real_gfxsize);
+	}
+	*pId=pThis->gamecnt;
+	pThis->gamecnt++;
+	return DMAGNETIC2_OK;
+}
+
+int dMagnetic2_catalog_get_count(void *pHandle,int *pCnt)
+{
+	tdMagnetic2_catalog_handle* pThis=(tdMagnetic2_catalog_handle*)pHandle;
+	if (pThis==NULL || pCnt==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	*pCnt=pThis->gamecnt;
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_catalog_find(void *pHandle,edMagnetic2_game game,int *pId)
+{
+	tdMagnetic2_catalog_handle* pThis=(tdMagnetic2_catalog_handle*)pHandle;
+	int i;
+	if (pThis==NULL || pId==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	for (i=0;i<pThis->gamecnt;i++)
+	{
+		if (pThis->games[i].meta.game==game)
+		{
+			*pId=i;
+			return DMAGNETIC2_OK;
+		}
+	}
+	return DMAGNETIC2_MISSING_IMAGE;
+}
+int dMagnetic2_catalog_get_game(void *pHandle,int id,unsigned char** ppMagBuf,unsigned char** ppGfxBuf,int *pGfxSize,tdMagnetic2_game_meta *pMeta)
+{
+	tdMagnetic2_catalog_handle* pThis=(tdMagnetic2_catalog_handle*)pHandle;
+	tdMagnetic2_catalog_game* pGame;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (id<0 || id>=pThis->gamecnt)
+	{
+		return DMAGNETIC2_MISSING_IMAGE;
+	}
+	pGame=&(pThis->games[id]);
+	// every pointer is optional
+	if (ppMagBuf!=NULL)
+	{
+		*ppMagBuf=&((unsigned char*)pHandle)[pGame->magoffset];
+	}
+	if (ppGfxBuf!=NULL)
+	{
+		*ppGfxBuf=(pGame->gfxoffset<0)?NULL:&((unsigned char*)pHandle)[pGame->gfxoffset];
+	}
+	if (pGfxSize!=NULL)
+	{
+		*pGfxSize=pGame->meta.real_gfxsize;
+	}
+	if (pMeta!=NULL)
+	{
+		*pMeta=pGame->meta;
+	}
+	return DMAGNETIC2_OK;
+}
@@ -26,12 +26,14 @@
 
 #include "dMagnetic2_loader.h"
 #include "dMagnetic2_loader_shared.h"
+#include "dMagnetic2_metrics_shared.h"
 
 
 #include "dMagnetic2_loader_appleii.h"
 #include "dMagnetic2_loader_archimedes.h"
 #include "dMagnetic2_loader_atarixl.h"
 #include "dMagnetic2_loader_c64.h"
+#include "dMagnetic2_loader_cache.h"
 #include "dMagnetic2_loader_dsk.h"
 #include "dMagnetic2_loader_maggfx.h"
 #include "dMagnetic2_loader_msdos.h"
@@ -69,10 +71,13 @@ typedef struct _tdMagnetic2_loader_handle
 {
 	unsigned int magic;
 	unsigned char *pTmpBuf;
+	char *pCacheDir;		// NULL when the converted images are not cached
 } tdMagnetic2_loader_handle;
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "dMagnetic2_errorcodes.h"
 #include "dMagnetic2_loader.h"
 
@@ -139,9 +144,8 @@ int dMagnetic2_loader_init(void *pHandle,void* pTmpBuf)
 
 	return DMAGNETIC2_OK;
 }
-int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filename3,unsigned char* pMagBuf,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta,int nodoc)
+int dMagnetic2_loader_set_cachedir(void *pHandle,char* cachedir)
 {
-	int retval;
 	tdMagnetic2_loader_handle* pThis=(tdMagnetic2_loader_handle*)pHandle;
 	if (pThis==NULL)
 	{
@@ -151,48 +155,138 @@ int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filena
 	{
 		return DMAGNETIC2_ERROR_WRONG_HANDLE;
 	}
-	// the idea here is some sort of autodetection.
-	// there are several loaders. each one is tried, and one of them should return with a valid loaded game.
-
-
-	retval=DMAGNETIC2_UNKNOWN_SOURCE;
-
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
-	{
-		retval=dMagnetic2_loader_appleii(filename1,filename2,filename3,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,nodoc);
-	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
-	{
-		retval=dMagnetic2_loader_archimedes(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,nodoc);
-	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
-	{
-		retval=dMagnetic2_loader_atarixl(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,nodoc);
-	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+	pThis->pCacheDir=cachedir;
+	return DMAGNETIC2_OK;
+}
+// collect the sizes and the first bytes of the input files. this is all the sub-loaders need
+// to decide whether they can rule themselves out, so only the matching one reads the whole images.
+static int dMagnetic2_loader_sniff(tdMagnetic2_loader_sniff* pSniff,char* filename1,char* filename2,char* filename3)
+{
+	int i;
+	memset(pSniff,0,sizeof(tdMagnetic2_loader_sniff));
+	pSniff->filename[0]=filename1;
+	pSniff->filename[1]=filename2;
+	pSniff->filename[2]=filename3;
+	for (i=0;i<DMAGNETIC2_LOADER_SNIFF_FILES;i++)
 	{
-		retval=dMagnetic2_loader_c64(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,nodoc);
+		struct stat st;
+		pSniff->size[i]=-1;
+		pSniff->headerlen[i]=-1;
+		if (pSniff->filename[i]==NULL)
+		{
+			continue;
+		}
+		pSniff->present[i]=1;
+		if (stat(pSniff->filename[i],&st)!=0)
+		{
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+		if (S_ISDIR(st.st_mode))
+		{
+			pSniff->isdir[i]=1;
+			pSniff->size[i]=0;
+			pSniff->headerlen[i]=0;
+		} else if (S_ISREG(st.st_mode)) {	// pipes and devices can only be read once. the loaders have to find out for themselves.
+			FILE *f;
+			f=fopen(pSniff->filename[i],"rb");
+			if (f==NULL)
+			{
+				return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+			}
+			pSniff->size[i]=(st.st_size>0x7fffffff)?0x7fffffff:(int)st.st_size;
+			pSniff->headerlen[i]=fread(pSniff->header[i],sizeof(char),DMAGNETIC2_LOADER_SNIFF_HEADERSIZE,f);
+			fclose(f);
+		}
 	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+	return DMAGNETIC2_OK;
+}
+// the same as dMagnetic2_loader_sniff(), for images which are already in memory.
+static void dMagnetic2_loader_sniff_images(tdMagnetic2_loader_sniff* pSniff,tdMagnetic2_loader_image* pImages)
+{
+	int i;
+	memset(pSniff,0,sizeof(tdMagnetic2_loader_sniff));
+	for (i=0;i<DMAGNETIC2_LOADER_SNIFF_FILES;i++)
 	{
-		retval=dMagnetic2_loader_dsk(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,0,nodoc);
+		pSniff->size[i]=-1;
+		pSniff->headerlen[i]=-1;
+		if (pImages[i].pData==NULL)
+		{
+			continue;
+		}
+		pSniff->present[i]=1;
+		pSniff->size[i]=pImages[i].len;
+		pSniff->headerlen[i]=(pImages[i].len<DMAGNETIC2_LOADER_SNIFF_HEADERSIZE)?pImages[i].len:DMAGNETIC2_LOADER_SNIFF_HEADERSIZE;
+		memcpy(pSniff->header[i],pImages[i].pData,pSniff->headerlen[i]);
 	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+}
+// the key for the cache, over the contents of the files. only regular files are hashed: a pipe could be read
+// only once, and the other files in the directories of the MS-DOS and Magnetic Windows releases would not be covered.
+static int dMagnetic2_loader_filekey(tdMagnetic2_loader_handle* pThis,tdMagnetic2_loader_sniff* pSniff,int nodoc,tdMagnetic2_loader_cache_key *pKey,int* pImagelens)
+{
+	tdMagnetic2_loader_image image;
+	int i;
+	int retval;
+	dMagnetic2_loader_cache_key_start(pKey,nodoc);
+	for (i=0;i<DMAGNETIC2_LOADER_SNIFF_FILES;i++)
 	{
-		retval=dMagnetic2_loader_dsk(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,1,nodoc);
+		pImagelens[i]=-1;
+		if (pSniff->present[i] && (pSniff->isdir[i] || pSniff->size[i]<0 || pSniff->size[i]>MAX_TMP_SIZE))
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+		// one file after the other, since they might have to be read into the tmp buffer
+		retval=dMagnetic2_loader_shared_openimage(&image,pSniff->filename[i],pThis->pTmpBuf,MAX_TMP_SIZE);
+		if (retval!=DMAGNETIC2_OK)
+		{
+			return retval;
+		}
+		if (image.pData!=NULL)
+		{
+			pImagelens[i]=image.len;
+		}
+		dMagnetic2_loader_cache_key_add(pKey,&image);
+		dMagnetic2_loader_shared_closeimage(&image);
+		if (pImagelens[i]!=-1 && pImagelens[i]!=pSniff->size[i])	// the file has changed in the meantime
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
 	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+	dMagnetic2_loader_cache_key_finish(pKey);
+	return DMAGNETIC2_OK;
+}
+// .mag/.gfx files are already what the cache would hold, and the other files of the MS-DOS and
+// Magnetic Windows releases are not part of the key.
+static int dMagnetic2_loader_cacheable(tdMagnetic2_loader_handle* pThis,tdMagnetic2_loader_sniff* pSniff)
+{
+	return pThis->pCacheDir!=NULL && !dMagnetic2_loader_maggfx_sniff(pSniff);
+}
+static void dMagnetic2_loader_cachestore(tdMagnetic2_loader_handle* pThis,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc,unsigned char* pMagBuf,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta)
+{
+	if (pMeta->source==DMAGNETIC2_SOURCE_MSDOS || pMeta->source==DMAGNETIC2_SOURCE_MW || pMeta->source==DMAGNETIC2_SOURCE_MAGGFX)
 	{
-		retval=dMagnetic2_loader_maggfx(filename1,filename2,pMagBuf,pGfxBuf,pMeta);
+		return;
 	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+	if (pMagBuf==NULL || pGfxBuf==NULL)
 	{
-		retval=dMagnetic2_loader_msdos(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta,nodoc);
+		return;		// only the sizes have been probed. an entry without the data would answer the next full load.
 	}
-	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
+	// the cache is only a shortcut. when the entry can not be written, the game has been loaded anyway.
+	dMagnetic2_loader_cache_store(pThis->pCacheDir,pKey,pImagelens,nodoc,pMagBuf,pGfxBuf,pMeta);
+}
+// every attempt of a sub-loader ends up in the histograms
+static void dMagnetic2_loader_measure(edMagnetic2_metrics_loader loader,unsigned long long t0,int retval)
+{
+#ifndef	DMAGNETIC2_NO_METRICS
+	METRICS_HISTOGRAM(&dMagnetic2_loader_metrics.attempts[loader],METRICS_NOW()-t0);
+	if (retval==DMAGNETIC2_OK)
 	{
-		retval=dMagnetic2_loader_mw(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,pGfxBuf,pMeta);
+		METRICS_ADD(dMagnetic2_loader_metrics.loaded[loader],1);
 	}
+#endif
+}
+// fill in the readable names for the game and its source
+static void dMagnetic2_loader_names(tdMagnetic2_game_meta *pMeta)
+{
 	switch(pMeta->game)
 	{
 		case DMAGNETIC2_GAME_NONE:		strncpy(pMeta->game_name,"UNKNOWN",32);break;
@@ -219,7 +313,238 @@ int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filena
 		case DMAGNETIC2_SOURCE_APPLEII:		strncpy(pMeta->source_name,"Apple II",32);break;
 		default:				strncpy(pMeta->source_name,"TODO",32);break;
 	}
+}
+int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filename3,unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta,int nodoc)
+{
+	int retval;
+	unsigned long long t0;
+	tdMagnetic2_loader_cache_key key;
+	int imagelens[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int usecache;
+	tdMagnetic2_loader_sniff sniff;
+	tdMagnetic2_loader_handle* pThis=(tdMagnetic2_loader_handle*)pHandle;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pMeta==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	pMeta->game=DMAGNETIC2_GAME_NONE;
+	pMeta->source=DMAGNETIC2_SOURCE_NONE;
+	pMeta->version=-1;
+	pMeta->real_magsize=0;
+	pMeta->real_gfxsize=0;
+	// the idea here is some sort of autodetection.
+	// there are several loaders. the ones which can not rule themselves out by the sizes and headers of the
+	// files are tried, and one of them should return with a valid loaded game.
+	retval=dMagnetic2_loader_sniff(&sniff,filename1,filename2,filename3);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	usecache=0;
+	if (dMagnetic2_loader_cacheable(pThis,&sniff) && dMagnetic2_loader_filekey(pThis,&sniff,nodoc,&key,imagelens)==DMAGNETIC2_OK)
+	{
+		usecache=1;
+		retval=dMagnetic2_loader_cache_lookup(pThis->pCacheDir,&key,imagelens,nodoc,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta);
+		if (retval==DMAGNETIC2_OK || retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
+		{
+			dMagnetic2_loader_names(pMeta);
+			return retval;
+		}
+	}
+
+	retval=DMAGNETIC2_UNKNOWN_SOURCE;
+
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_appleii_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_appleii(filename1,filename2,filename3,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_APPLEII,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_archimedes_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_archimedes(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_ARCHIMEDES,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_atarixl_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_atarixl(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_ATARIXL,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_c64_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_c64(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_C64,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_dsk_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_dsk(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,0,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_DSK_AMSTRAD,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_dsk_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_dsk(filename1,filename2,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,1,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_DSK_SPECTRUM,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_maggfx_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_maggfx(filename1,filename2,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_MAGGFX,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_msdos_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_msdos(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_MSDOS,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_mw_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_mw(filename1,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_MW,t0,retval);
+	}
+	if (usecache && retval==DMAGNETIC2_OK)
+	{
+		dMagnetic2_loader_cachestore(pThis,&key,imagelens,nodoc,pMagBuf,pGfxBuf,pMeta);
+	}
+	dMagnetic2_loader_names(pMeta);
 	
 	return retval;
 
 }
+// every sub-loader counts the bytes it would have written into a missing output buffer.
+int dMagnetic2_loader_probe(void *pHandle,char* filename1,char* filename2,char* filename3,tdMagnetic2_game_meta *pMeta,int nodoc)
+{
+	return dMagnetic2_loader(pHandle,filename1,filename2,filename3,NULL,0,NULL,0,pMeta,nodoc);
+}
+// the in-memory version of dMagnetic2_loader(). the buffers are only read, and they stay with the caller.
+// the MS-DOS and the Magnetic Windows releases consist of several named files in a directory, so they can not be loaded from buffers.
+int dMagnetic2_loader_buffers(void *pHandle,
+		const unsigned char* pBuf1,int len1,
+		const unsigned char* pBuf2,int len2,
+		const unsigned char* pBuf3,int len3,
+		unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta,int nodoc)
+{
+	int i;
+	int retval;
+	unsigned long long t0;
+	tdMagnetic2_loader_cache_key key;
+	int imagelens[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int usecache;
+	tdMagnetic2_loader_sniff sniff;
+	tdMagnetic2_loader_image images[DMAGNETIC2_LOADER_SNIFF_FILES];
+	tdMagnetic2_loader_handle* pThis=(tdMagnetic2_loader_handle*)pHandle;
+	if (pThis==NULL)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pThis->magic!=MAGIC)
+	{
+		return DMAGNETIC2_ERROR_WRONG_HANDLE;
+	}
+	if (pMeta==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	pMeta->game=DMAGNETIC2_GAME_NONE;
+	pMeta->source=DMAGNETIC2_SOURCE_NONE;
+	pMeta->version=-1;
+	pMeta->real_magsize=0;
+	pMeta->real_gfxsize=0;
+
+	memset(images,0,sizeof(images));
+	images[0].pData=pBuf1;images[0].len=len1;
+	images[1].pData=pBuf2;images[1].len=len2;
+	images[2].pData=pBuf3;images[2].len=len3;
+	for (i=0;i<DMAGNETIC2_LOADER_SNIFF_FILES;i++)
+	{
+		if (images[i].pData!=NULL && images[i].len<0)
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+	}
+	dMagnetic2_loader_sniff_images(&sniff,images);
+	usecache=0;
+	if (dMagnetic2_loader_cacheable(pThis,&sniff))
+	{
+		usecache=1;
+		dMagnetic2_loader_cache_key_start(&key,nodoc);
+		for (i=0;i<DMAGNETIC2_LOADER_SNIFF_FILES;i++)
+		{
+			dMagnetic2_loader_cache_key_add(&key,&images[i]);
+			imagelens[i]=(images[i].pData==NULL)?-1:images[i].len;
+		}
+		dMagnetic2_loader_cache_key_finish(&key);
+		retval=dMagnetic2_loader_cache_lookup(pThis->pCacheDir,&key,imagelens,nodoc,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta);
+		if (retval==DMAGNETIC2_OK || retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
+		{
+			dMagnetic2_loader_names(pMeta);
+			return retval;
+		}
+	}
+
+	retval=DMAGNETIC2_UNKNOWN_SOURCE;
+
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_appleii_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_appleii_images(images,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_APPLEII,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_archimedes_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_archimedes_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_ARCHIMEDES,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_atarixl_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_atarixl_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_ATARIXL,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_c64_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_c64_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_C64,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_dsk_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_dsk_images(images,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,0,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_DSK_AMSTRAD,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_dsk_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_dsk_images(images,pThis->pTmpBuf,MAX_TMP_SIZE,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,1,nodoc);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_DSK_SPECTRUM,t0,retval);
+	}
+	if (retval==DMAGNETIC2_UNKNOWN_SOURCE && dMagnetic2_loader_maggfx_sniff(&sniff))
+	{
+		t0=METRICS_NOW();
+		retval=dMagnetic2_loader_maggfx_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta);
+		dMagnetic2_loader_measure(DMAGNETIC2_METRICS_LOADER_MAGGFX,t0,retval);
+	}
+	if (usecache && retval==DMAGNETIC2_OK)
+	{
+		dMagnetic2_loader_cachestore(pThis,&key,imagelens,nodoc,pMagBuf,pGfxBuf,pMeta);
+	}
+	dMagnetic2_loader_names(pMeta);
+
+	return retval;
+}
@@ -94,30 +94,51 @@ int dMagnetic2_loader_appleii_decode_addrbuf(unsigned char* pAddrBuf,unsigned ch
 	return check;
 }
 
+// finds the next preamble within the track, starting at ridx. returns its position, or -1 if there is none before ridxend.
+static int dMagnetic2_loader_appleii_findpreamble(const unsigned char* pTrackBuf,int ridx,int ridxend,unsigned char third)
+{
+	while (ridx<ridxend)
+	{
+		const unsigned char* p;
+		p=memchr(&pTrackBuf[ridx],0xD5,ridxend-ridx);
+		if (p==NULL)
+		{
+			return -1;
+		}
+		ridx=p-pTrackBuf;
+		if (p[1]==0xAA && p[2]==third)
+		{
+			return ridx;
+		}
+		ridx++;
+	}
+	return -1;
+}
+// the track buffer holds the track twice, so that a sector which wraps around the end of the track can be read in one go.
 int dMagnetic2_loader_appleii_decodenibtrack(unsigned char* pTrackBuf,int track,unsigned char* pTmpBuf)
 {
 #define	PREAMBLESIZE	3
-#define	DECODEROFFS	0x96
 #define	SECTORLSB	86
-	const	unsigned char dMagnetic2_loader_appleii_addr_preamble[PREAMBLESIZE]={0xD5,0xAA,0x96};
-	const	unsigned char dMagnetic2_loader_appleii_data_preamble[PREAMBLESIZE]={0xD5,0xAA,0xAD};
-	//const	unsigned char loader_appleii_epilog[PREAMBLESIZE]={0xDE,0xAA,0xEB};
-
-	const	unsigned char dMagnetic2_loader_appleii_translatetab[106]={
-		0x00,0x01,0xFF,0xFF,0x02,0x03,0xFF,0x04,
-		0x05,0x06,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
-		0x07,0x08,0xFF,0xFF,0xFF,0x09,0x0A,0x0B,
-		0x0C,0x0D,0xFF,0xFF,0x0E,0x0F,0x10,0x11,
-		0x12,0x13,0xFF,0x14,0x15,0x16,0x17,0x18,
-		0x19,0x1A,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
-		0xFF,0xFF,0xFF,0xFF,0xFF,0x1B,0xFF,0x1C,
-		0x1D,0x1E,0xFF,0xFF,0xFF,0x1F,0xFF,0xFF,
-		0x20,0x21,0xFF,0x22,0x23,0x24,0x25,0x26,
-		0x27,0x28,0xFF,0xFF,0xFF,0xFF,0xFF,0x29,
-		0x2A,0x2B,0xFF,0x2C,0x2D,0x2E,0x2F,0x30,
-		0x31,0x32,0xFF,0xFF,0x33,0x34,0x35,0x36,
-		0x37,0x38,0xFF,0x39,0x3A,0x3B,0x3C,0x3D,
-		0x3E,0x3F};
+#define	RIDXEND		(NIBTRACKSIZE+SECTORBYTES+SECTORLSB+1+9*PREAMBLESIZE)
+	// the 6-and-2 nibbles are in the range 0x96..0xff. invalid ones are being translated into 0xff.
+	const	unsigned char dMagnetic2_loader_appleii_translatetab[256]={
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 00
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 10
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 20
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 30
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 40
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 50
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 60
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 70
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,	// 80
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x00,0x01,0xFF,0xFF,0x02,0x03,0xFF,0x04,0x05,0x06,	// 90
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x07,0x08,0xFF,0xFF,0xFF,0x09,0x0A,0x0B,0x0C,0x0D,	// A0
+		0xFF,0xFF,0x0E,0x0F,0x10,0x11,0x12,0x13,0xFF,0x14,0x15,0x16,0x17,0x18,0x19,0x1A,	// B0
+		0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x1B,0xFF,0x1C,0x1D,0x1E,	// C0
+		0xFF,0xFF,0xFF,0x1F,0xFF,0xFF,0x20,0x21,0xFF,0x22,0x23,0x24,0x25,0x26,0x27,0x28,	// D0
+		0xFF,0xFF,0xFF,0xFF,0xFF,0x29,0x2A,0x2B,0xFF,0x2C,0x2D,0x2E,0x2F,0x30,0x31,0x32,	// E0
+		0xFF,0xFF,0x33,0x34,0x35,0x36,0x37,0x38,0xFF,0x39,0x3A,0x3B,0x3C,0x3D,0x3E,0x3F	// F0
+	};
 
 
 	unsigned char addr_track=0;
@@ -126,105 +147,97 @@ int dMagnetic2_loader_appleii_decodenibtrack(unsigned char* pTrackBuf,int track,
 	unsigned char addr_checksum=0;
 	int volumeid;
 	int ridx;
-	int state;
 
 	volumeid=-1;
 	ridx=0;
-	state=0;
-	while (ridx<(NIBTRACKSIZE+SECTORBYTES+SECTORLSB+1+9*PREAMBLESIZE))
+	// the search goes a little bit beyond the end of the track, to catch the sector which wraps around.
+	while (ridx<RIDXEND)
 	{
-		switch(state)
+		const unsigned char* pData;
+		unsigned char lsbbuf[SECTORLSB];
+		unsigned char* pOut;
+		unsigned char accu;
+		int j,k;
+
+		// find the ADDR preamble
+		ridx=dMagnetic2_loader_appleii_findpreamble(pTrackBuf,ridx,RIDXEND,0x96);
+		if (ridx<0)
 		{
-			case 0:		// find the ADDR preamble
-				{
-					if ( pTrackBuf[(ridx+0)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_addr_preamble[0] && pTrackBuf[(ridx+1)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_addr_preamble[1] && pTrackBuf[(ridx+2)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_addr_preamble[2])
-					{
-						ridx+=PREAMBLE_SIZE;
-						state=1;
-					} else {
-						ridx++;
-					}
-				}
-				break;
-			case 1:		// decode the ADDR data
-				{
-					unsigned char addrbuf[ADDRBUF_SIZE];
-					int i;
-					for (i=0;i<ADDRBUF_SIZE;i++)
-					{
-						addrbuf[i]=pTrackBuf[(ridx++)%NIBTRACKSIZE];
-					}
-					dMagnetic2_loader_appleii_decode_addrbuf(addrbuf,&addr_volume,&addr_track,&addr_sector,&addr_checksum);
-					if (volumeid==-1 || volumeid==addr_volume)
-					{
-						volumeid=addr_volume;
-					} else {
-//						printf("volumeid mismatch\n");
-						return -1;
-					}
-					if (addr_track!=track)
-					{
-//						printf("track mismatch %d vs %d\n",addr_track,track);
-						return -1;
-					}
-					ridx+=PREAMBLESIZE;	// skip over the epilogue
-					state=2;	// start looking for data
-				}
-				break;
-			case 2:		// find the DATA preamble
-				{
-					if ( pTrackBuf[(ridx+0)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_data_preamble[0] && pTrackBuf[(ridx+1)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_data_preamble[1] && pTrackBuf[(ridx+2)%NIBTRACKSIZE]==dMagnetic2_loader_appleii_data_preamble[2])
-					{
-						ridx+=PREAMBLE_SIZE;
-						state=3;
-					} else ridx++;
-				}
-				break;
-			case 3:		// decode the DATA
-				{
-					unsigned char lsbbuf[SECTORLSB];
-					unsigned char accu;
-					int j;
-					accu=0;
-					for (j=0;j<SECTORLSB;j++)
-					{
-						accu^=dMagnetic2_loader_appleii_translatetab[pTrackBuf[ridx%NIBTRACKSIZE]-DECODEROFFS];
-						lsbbuf[j]=accu;
-						ridx++;
-					}
-					for (j=0;j<SECTORBYTES;j++)
-					{
-						int widx;
-						accu^=dMagnetic2_loader_appleii_translatetab[pTrackBuf[ridx%NIBTRACKSIZE]-DECODEROFFS];
-						widx=j+SECTORBYTES*addr_sector;
-						pTmpBuf[widx]=accu;
-						pTmpBuf[widx]<<=1;pTmpBuf[widx]|=(1&lsbbuf[j%SECTORLSB]);lsbbuf[j%SECTORLSB]>>=1;
-						pTmpBuf[widx]<<=1;pTmpBuf[widx]|=(1&lsbbuf[j%SECTORLSB]);lsbbuf[j%SECTORLSB]>>=1;
-						ridx++;
-					}
-					ridx+=PREAMBLESIZE;	// skip over the epilogue
-					state=0;		// search for the next ADDR preamble
-				}
-				break;
+			break;
+		}
+		ridx+=PREAMBLE_SIZE;
+		if (ridx>=RIDXEND)
+		{
+			break;
 		}
+		// decode the ADDR data
+		dMagnetic2_loader_appleii_decode_addrbuf(&pTrackBuf[ridx],&addr_volume,&addr_track,&addr_sector,&addr_checksum);
+		if (volumeid==-1 || volumeid==addr_volume)
+		{
+			volumeid=addr_volume;
+		} else {
+			return -1;
+		}
+		if (addr_track!=track)
+		{
+			return -1;
+		}
+		ridx+=ADDRBUF_SIZE+PREAMBLESIZE;	// skip over the epilogue
 
+		// find the DATA preamble
+		ridx=dMagnetic2_loader_appleii_findpreamble(pTrackBuf,ridx,RIDXEND,0xAD);
+		if (ridx<0)
+		{
+			break;
+		}
+		ridx+=PREAMBLE_SIZE;
+		if (ridx>=RIDXEND)
+		{
+			break;
+		}
+		// decode the DATA. the first 86 nibbles hold the lower 2 bits of every byte, the next 256 the upper 6.
+		pData=&pTrackBuf[ridx];
+		pOut=&pTmpBuf[SECTORBYTES*addr_sector];
+		accu=0;
+		for (j=0;j<SECTORLSB;j++)
+		{
+			accu^=dMagnetic2_loader_appleii_translatetab[pData[j]];
+			lsbbuf[j]=accu;
+		}
+		k=0;
+		for (j=0;j<SECTORBYTES;j++)
+		{
+			accu^=dMagnetic2_loader_appleii_translatetab[pData[SECTORLSB+j]];
+			pOut[j]=(accu<<2)|((lsbbuf[k]&1)<<1)|((lsbbuf[k]>>1)&1);
+			lsbbuf[k]>>=2;
+			k++;
+			if (k==SECTORLSB)
+			{
+				k=0;
+			}
+		}
+		ridx+=SECTORLSB+SECTORBYTES+PREAMBLESIZE;	// skip over the epilogue
 	}
 	return volumeid;
 }
 
 
 
-int dMagnetic2_loader_appleii_woz_parseheader(unsigned char* pWozBuf,int wozsize,tWozInfo *pWozInfo)
+int dMagnetic2_loader_appleii_woz_parseheader(const unsigned char* pWozBuf,int wozsize,tWozInfo *pWozInfo)
 {
 	int idx;
 	int len;
 	unsigned char donemask;
 	idx=0;
 	donemask=0;
-	while (idx<wozsize && donemask!=3)
+	while (idx+8<=wozsize && donemask!=3)
 	{
 		if (memcmp(&pWozBuf[idx],"WOZ2",4)==0)
 		{
+			if (idx+12>wozsize)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
 			if (pWozBuf[idx+4]!=0xff || pWozBuf[idx+5]!=0xa || pWozBuf[idx+6]!=0xd || pWozBuf[idx+7]!=0xa)
 			{
 //				fprintf(stderr,"       WOZ2 eader corruption? Expected FF 0A 0D 0A, got %02X %02X %02X %02X \n",pWozBuf[idx+4],pWozBuf[idx+5],pWozBuf[idx+6],pWozBuf[idx+7]);
@@ -245,6 +258,10 @@ int dMagnetic2_loader_appleii_woz_parseheader(unsigned char* pWozBuf,int wozsize
 			int i;
 			len=READ_INT32LE(pWozBuf,idx+4);
 			idx+=8;
+			if (idx+WOZ_MAXQUARTERTRACKS>wozsize)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
 			for (i=0;i<WOZ_MAXQUARTERTRACKS;i++)
 			{
 				unsigned char x;
@@ -264,6 +281,10 @@ int dMagnetic2_loader_appleii_woz_parseheader(unsigned char* pWozBuf,int wozsize
 			len=READ_INT32LE(pWozBuf,idx+4);
 			idx+=8;
 			idx2=idx;
+			if (idx+WOZ_MAXQUARTERTRACKS*8>wozsize)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
 			for (i=0;i<WOZ_MAXQUARTERTRACKS;i++)
 			{
 				pWozInfo->trackStart[i]=WOZ_BLOCKSIZE*READ_INT16LE(pWozBuf,idx2);idx2+=2;
@@ -295,8 +316,31 @@ int dMagnetic2_loader_appleii_woz_parseheader(unsigned char* pWozBuf,int wozsize
 	return DMAGNETIC2_OK;
 }
 
+// the bits of a woz track are being read into a window, MSB first. they wrap around at the end of the track.
+static void dMagnetic2_loader_appleii_woz_refill(const unsigned char* wozbuf,int len,int* pBitpos,unsigned long long* pWindow,int* pWindowbits)
+{
+	while (*pWindowbits<=56)
+	{
+		int n;
+		int bitpos;
+		bitpos=*pBitpos;
+		n=8-(bitpos&7);		// the rest of the current byte
+		if (n>len-bitpos)
+		{
+			n=len-bitpos;
+		}
+		*pWindow|=((unsigned long long)((wozbuf[bitpos>>3]>>(8-(bitpos&7)-n))&((1<<n)-1)))<<(64-*pWindowbits-n);
+		*pWindowbits+=n;
+		bitpos+=n;
+		if (bitpos==len)
+		{
+			bitpos=0;
+		}
+		*pBitpos=bitpos;
+	}
+}
 // when the woz bit stream is synchronized, it can be interpreted as a nib stream.
-int dMagnetic2_loader_appleii_woz_synchronize(unsigned char* trackbuf,unsigned char* wozbuf,int len)
+int dMagnetic2_loader_appleii_woz_synchronize(unsigned char* trackbuf,const unsigned char* wozbuf,int len)
 {
 	unsigned char byte;
 	unsigned int reg;
@@ -304,6 +348,10 @@ int dMagnetic2_loader_appleii_woz_synchronize(unsigned char* trackbuf,unsigned c
 	int datacnt;
 	int part_cnt;
 	int outidx;
+	unsigned long long window;
+	int windowbits;
+	int bitpos;
+	int bitsleft;
 	int i;
 
 
@@ -315,47 +363,64 @@ int dMagnetic2_loader_appleii_woz_synchronize(unsigned char* trackbuf,unsigned c
 	part_cnt=0;
 	outidx=0;
 	for (i=0;i<NIBTRACKSIZE;i++) trackbuf[i]=0xff;	// initialize
-	while (outidx<NIBTRACKSIZE && i<(len*2) && (part_cnt!=0 || addrcnt!=MAXSECTORS || datacnt!=MAXSECTORS))
-	{
-		int wozbyte;
-		int wozbit;
-		int bit;
-
-		wozbyte=(i%len)/8;
-		wozbit=(i%len)%8;
-		bit=(wozbuf[wozbyte]>>(7-wozbit))&1;
-		byte<<=1;
-		byte|=bit;
-		if (byte&0x80)	// byte is synchronized when the highest bit is set.
-		{
-			reg<<=8;
-			reg|=((unsigned int)byte)&0xff;
-			reg&=0x00ffffff;
-			if (part_cnt==0)
+	if (len<=0)
+	{
+		return DMAGNETIC2_OK;
+	}
+	// the search starts NIBTRACKSIZE bits into the track, and stops after it went around it twice.
+	bitpos=i%len;
+	bitsleft=len*2-i;
+	window=0;
+	windowbits=0;
+	while (outidx<NIBTRACKSIZE && bitsleft>0 && (part_cnt!=0 || addrcnt!=MAXSECTORS || datacnt!=MAXSECTORS))
+	{
+		// a byte is synchronized when the highest bit is set.
+		// so skip the zeros before it, and the next 8 bits are the byte.
+		dMagnetic2_loader_appleii_woz_refill(wozbuf,len,&bitpos,&window,&windowbits);
+		while (!(window>>63) && bitsleft>0)
+		{
+			window<<=1;
+			windowbits--;
+			bitsleft--;
+			if (windowbits<8)
 			{
-				if (reg==0xD5AA96)	// addr preamble found
-				{
-					addrcnt++;
-					trackbuf[outidx++]=0xD5;		// write the preamble
-					trackbuf[outidx++]=0xAA;
-					trackbuf[outidx++]=0x96;
-					part_cnt=ADDRBUF_SIZE+EPILOGUE_SIZE;	// collect 11 bytes 
-				}
-				if (reg==0xD5AAAD)	// data preamble found
-				{
-					datacnt++;
-					trackbuf[outidx++]=0xD5;		// write the preamble
-					trackbuf[outidx++]=0xAA;
-					trackbuf[outidx++]=0xAD;
-					part_cnt=DATABUF_SIZE+EPILOGUE_SIZE;	// collect 346 bytes
-				}
-			} else {
-				trackbuf[outidx++]=byte;
-				part_cnt--;
+				dMagnetic2_loader_appleii_woz_refill(wozbuf,len,&bitpos,&window,&windowbits);
 			}
-			byte=0;
 		}
-		i++;
+		if (bitsleft<8)
+		{
+			break;
+		}
+		byte=window>>56;
+		window<<=8;
+		windowbits-=8;
+		bitsleft-=8;
+
+		reg<<=8;
+		reg|=((unsigned int)byte)&0xff;
+		reg&=0x00ffffff;
+		if (part_cnt==0)
+		{
+			if (reg==0xD5AA96)	// addr preamble found
+			{
+				addrcnt++;
+				trackbuf[outidx++]=0xD5;		// write the preamble
+				trackbuf[outidx++]=0xAA;
+				trackbuf[outidx++]=0x96;
+				part_cnt=ADDRBUF_SIZE+EPILOGUE_SIZE;	// collect 11 bytes 
+			}
+			if (reg==0xD5AAAD)	// data preamble found
+			{
+				datacnt++;
+				trackbuf[outidx++]=0xD5;		// write the preamble
+				trackbuf[outidx++]=0xAA;
+				trackbuf[outidx++]=0xAD;
+				part_cnt=DATABUF_SIZE+EPILOGUE_SIZE;	// collect 346 bytes
+			}
+		} else {
+			trackbuf[outidx++]=byte;
+			part_cnt--;
+		}
 	}
 	// at this point, the trackbuf contains the NIB stream, even though there is no padding between the sectors.
 	// the nib decoder will be able to handle it, even though a physical drive might not be able to.
@@ -373,8 +438,9 @@ typedef	 struct _tSection
 	int scrambled;
 	int rle;
 } tSection;
-int dMagnetic2_loader_appleii_readsection(unsigned char* pOut,tSection section,unsigned char* pDskBuf,int diskcnt,int* pDskOffs,int pivot)
+int dMagnetic2_loader_appleii_readsection(unsigned char* pOut,int maxlen,tSection section,const unsigned char** pDisks,int diskcnt,int pivot)
 {
+	const unsigned char* pDisk;
 	int idx;
 	int outidx;
 	int firstsector;
@@ -387,20 +453,25 @@ int dMagnetic2_loader_appleii_readsection(unsigned char* pOut,tSection section,u
 	rle=section.rle;
 	outidx=0;
 	firstsector=1;
-	idx=(section.track*MAXSECTORS+section.sector)*SECTORBYTES+pDskOffs[section.disk];
+	idx=(section.track*MAXSECTORS+section.sector)*SECTORBYTES;
 	lc=0xff;
+	pDisk=NULL;
+	if (section.disk>=0 && section.disk<MAXDISKS)
+	{
+		pDisk=pDisks[section.disk];
+	}
 
-	while (outidx<section.len)
+	while (outidx<section.len && pDisk!=NULL && idx+SECTORBYTES<=DSKSIZE)
 	{
 		int ridx;
 		int removeendmarker;
-		memcpy(tmp,&pDskBuf[idx],SECTORBYTES);
+		memcpy(tmp,&pDisk[idx],SECTORBYTES);
 		idx+=SECTORBYTES;
 		ridx=0;
 		removeendmarker=0;
 		if (section.scrambled)
 		{
-			dMagnetic2_loader_shared_descramble(tmp,tmp,pivot,NULL,0);
+			dMagnetic2_loader_shared_descramble(tmp,tmp,SECTORBYTES,pivot,NULL,0);
 			pivot=(pivot+1)%8;
 			if (firstsector && rle)
 			{
@@ -425,7 +496,11 @@ int dMagnetic2_loader_appleii_readsection(unsigned char* pOut,tSection section,u
 			}
 			for (i=0;i<n;i++)
 			{
-				pOut[outidx++]=c;
+				if (pOut!=NULL && outidx<section.len && outidx<maxlen)	// the section is cut off at its length. without an output, it is only being counted.
+				{
+					pOut[outidx]=c;
+				}
+				outidx++;
 			}
 			rlecutoff--;
 			if (rle && rlecutoff==0)
@@ -444,7 +519,7 @@ int dMagnetic2_loader_appleii_readsection(unsigned char* pOut,tSection section,u
 	return outidx;
 }
 
-int dMagnetic2_loader_appleii_mkmag(unsigned char* magbuf,int* magsize, edMagnetic2_game game,unsigned char* pDskBuf,int diskcnt,int* pDskOffs)
+int dMagnetic2_loader_appleii_mkmag(unsigned char* magbuf,int magcapacity,int* magsize,int* version,edMagnetic2_game game,const unsigned char** pDisks,int diskcnt)
 {
 	int magidx;
 	int codesize;
@@ -546,7 +621,7 @@ int dMagnetic2_loader_appleii_mkmag(unsigned char* magbuf,int* magsize, edMagnet
 //		printf("[");
 //		while (i<0x2c && c!=0xa9)
 //		{
-//			c=pDskBuf[pDskOffs[0]+offs];
+//			c=pDisks[0][offs];
 //			i++;
 //			offs++;
 //			if (c>=' ' && c<127) printf("%c",c);
@@ -554,18 +629,28 @@ int dMagnetic2_loader_appleii_mkmag(unsigned char* magbuf,int* magsize, edMagnet
 //		printf("]\n");
 //	}
 
+	*version=dMagnetic2_loader_appleii_gameInfo[gameid].version;
 	magidx=42;
-	codesize=dMagnetic2_loader_appleii_readsection(&magbuf[magidx],dMagnetic2_loader_appleii_gameInfo[gameid].code_section,pDskBuf,diskcnt,pDskOffs,0);
-	codesize+=dMagnetic2_loader_appleii_readsection(&magbuf[magidx+codesize],dMagnetic2_loader_appleii_gameInfo[gameid].code2_section,pDskBuf,diskcnt,pDskOffs,dMagnetic2_loader_appleii_gameInfo[gameid].pivot_code2);
+	codesize=dMagnetic2_loader_appleii_readsection(OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),dMagnetic2_loader_appleii_gameInfo[gameid].code_section,pDisks,diskcnt,0);
+	codesize+=dMagnetic2_loader_appleii_readsection(OUTPUT_AT(magbuf,magidx+codesize),OUTPUT_ROOM(magidx+codesize,magcapacity),dMagnetic2_loader_appleii_gameInfo[gameid].code2_section,pDisks,diskcnt,dMagnetic2_loader_appleii_gameInfo[gameid].pivot_code2);
 	magidx+=codesize;
 
 	stringidx0=magidx;
-	string1size=dMagnetic2_loader_appleii_readsection(&magbuf[magidx],dMagnetic2_loader_appleii_gameInfo[gameid].string1_section,pDskBuf,diskcnt,pDskOffs,0);
+	string1size=dMagnetic2_loader_appleii_readsection(OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),dMagnetic2_loader_appleii_gameInfo[gameid].string1_section,pDisks,diskcnt,0);
 	magidx+=string1size;
-	string2size=dMagnetic2_loader_appleii_readsection(&magbuf[magidx],dMagnetic2_loader_appleii_gameInfo[gameid].string2_section,pDskBuf,diskcnt,pDskOffs,0);
+	string2size=dMagnetic2_loader_appleii_readsection(OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),dMagnetic2_loader_appleii_gameInfo[gameid].string2_section,pDisks,diskcnt,0);
 	magidx+=string2size;
-	dictsize=dMagnetic2_loader_appleii_readsection(&magbuf[magidx],dMagnetic2_loader_appleii_gameInfo[gameid].dict_section,pDskBuf,diskcnt,pDskOffs,0);
+	dictsize=dMagnetic2_loader_appleii_readsection(OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),dMagnetic2_loader_appleii_gameInfo[gameid].dict_section,pDisks,diskcnt,0);
 	magidx+=dictsize;
+	*magsize=magidx;
+	if (magbuf==NULL)	// just the size
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (magidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 
 
 	{
@@ -586,14 +671,13 @@ int dMagnetic2_loader_appleii_mkmag(unsigned char* magbuf,int* magsize, edMagnet
 		}
 	}
 
-	if (gameid==GAME_CORRUPTION) for (i=0x212a;i<0x232a;i++) magbuf[i]=0;	// finishing touches on corruption
+	if (gameid==GAME_CORRUPTION && magidx>=0x232a) for (i=0x212a;i<0x232a;i++) magbuf[i]=0;	// finishing touches on corruption
 
 	dMagnetic2_loader_shared_addmagheader(magbuf,magidx,dMagnetic2_loader_appleii_gameInfo[gameid].version,codesize,string1size,string2size,dictsize,huffmantreeidx);
-	*magsize=magidx;
 	return DMAGNETIC2_OK;
 }
 
-int dMagnetic2_loader_appleii_mkgfx(unsigned char *gfxbuf,int* gfxsize,edMagnetic2_game game,int diskcnt,unsigned char *pTmpBuf,int *diskoffs,int *decodedlens)
+int dMagnetic2_loader_appleii_mkgfx(unsigned char *gfxbuf,int gfxcapacity,int* gfxsize,edMagnetic2_game game,int diskcnt,const unsigned char** pDecoded,int *decodedlens)
 {
 #define	PICTURE_HOTFIX1		0x80000000
 #define	PICTURE_HOTFIX2		0x40000000
@@ -625,11 +709,23 @@ int dMagnetic2_loader_appleii_mkgfx(unsigned char *gfxbuf,int* gfxsize,edMagneti
 	for (i=0;i<diskcnt;i++)
 	{
 		newdiskoffs[i]=idx;
-		memcpy(&gfxbuf[idx],&pTmpBuf[diskoffs[i]],decodedlens[i]);
 		idx+=decodedlens[i];
 	}
-	// now they are in the correct order
 	*gfxsize=idx;	
+	if (gfxbuf==NULL)	// just the size
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (idx>gfxcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	for (i=0;i<diskcnt;i++)
+	{
+		memcpy(&gfxbuf[newdiskoffs[i]],pDecoded[i],decodedlens[i]);
+	}
+	// now they are in the correct order
+	memset(&gfxbuf[4],0,4*32);	// the index is not filled completely. the buffer might not have been cleared.
 	{
 		// the directory for the pictures is packed
 		unsigned char mask;
@@ -667,6 +763,10 @@ int dMagnetic2_loader_appleii_mkgfx(unsigned char *gfxbuf,int* gfxsize,edMagneti
 
 			if (mask==0x00)
 			{
+				if (bitidx>=idx)	// the buffer has its exact size now. a damaged directory must not run past it.
+				{
+					return DMAGNETIC2_UNKNOWN_SOURCE;
+				}
 				mask=0x80;
 				byte=gfxbuf[bitidx++];
 			}
@@ -731,36 +831,232 @@ int dMagnetic2_loader_appleii_mkgfx(unsigned char *gfxbuf,int* gfxsize,edMagneti
 #define	SIZE_2MGIMAGE	143424
 #define	SIZE_DSKIMAGE	143360
 #define	MAX_IMAGEFILESIZE	(SIZE_WOZIMAGE)
+// the tmp buffer: a track buffer for every disk, followed by the room for the decoded images.
+// the track buffers hold every track twice, so that the decoder does not have to wrap around.
+#define	TRACKBUFSIZE		(2*NIBTRACKSIZE)
+#define	TRACKBUFOFFS(disk)	((disk)*TRACKBUFSIZE)
+#define	IMAGEOFFS(slot)		(MAXDISKS*TRACKBUFSIZE+(slot)*MAX_IMAGEFILESIZE)
+#define	TMPSIZE			(IMAGEOFFS(MAXDISKS)+1)
 
 int dMagnetic2_loader_appleii_getsize(int *pBytes)
 {
 // should be large enough for three disk images. and a spare byte for a trick to determine the correct file size
-	*pBytes=NIBTRACKSIZE+3*MAX_IMAGEFILESIZE+1;
+	*pBytes=TMPSIZE;
 	return DMAGNETIC2_OK;
 }
-int dMagnetic2_loader_appleii(
-		char* filename1,char* filename2,char* filename3,
+// every given file has to be one of the disk image sizes. a .woz file also needs its header.
+int dMagnetic2_loader_appleii_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	int i;
+	int cnt;
+	cnt=0;
+	for (i=0;i<MAXDISKS;i++)
+	{
+		if (pSniff->present[i])
+		{
+			if (pSniff->size[i]>=0 && pSniff->size[i]!=SIZE_NIBIMAGE && pSniff->size[i]!=SIZE_2MGIMAGE && pSniff->size[i]!=SIZE_DSKIMAGE && pSniff->size[i]!=SIZE_WOZIMAGE)
+			{
+				return 0;
+			}
+			if (pSniff->size[i]==SIZE_WOZIMAGE && !SNIFF_HEADER_IS(pSniff,i,"WOZ2",4))
+			{
+				return 0;
+			}
+			cnt++;
+		}
+	}
+	return (cnt!=0);
+}
+// one disk image. it has its own track buffer, so that all of them can be decoded at the same time.
+typedef struct _tdMagnetic2_loader_appleii_disk
+{
+	const unsigned char* pEncoded;
+	int len;
+	unsigned char* pTrackBuf;
+	unsigned char* pOut;		// the decoded tracks go here
+	const unsigned char* pDecoded;
+	int decodedlen;
+	int volumeid;
+} tdMagnetic2_loader_appleii_disk;
+static int dMagnetic2_loader_appleii_decodejob(void* pArg)
+{
+	tdMagnetic2_loader_appleii_disk* pDisk=(tdMagnetic2_loader_appleii_disk*)pArg;
+	int offs;
+	int lastvolumeid;
+	if (pDisk->len==SIZE_NIBIMAGE)		// NIB images are raw, encoded image files.
+	{
+		int j;
+		lastvolumeid=-1;
+		
+		pDisk->pDecoded=pDisk->pOut;
+		pDisk->decodedlen=MAXTRACKS*MAXSECTORS*SECTORBYTES;
+		offs=0;
+		for (j=0;j<MAXTRACKS;j++)
+		{
+			int volumeid;
+			// when the image could not be mapped, this process overwrites the loaded image.
+			// since a decoded track has less bytes than an encoded one, it can be done in place.
+			memcpy(&pDisk->pTrackBuf[0],&pDisk->pEncoded[j*NIBTRACKSIZE],NIBTRACKSIZE);
+			memcpy(&pDisk->pTrackBuf[NIBTRACKSIZE],&pDisk->pEncoded[j*NIBTRACKSIZE],NIBTRACKSIZE);
+			volumeid=dMagnetic2_loader_appleii_decodenibtrack(pDisk->pTrackBuf,j,&pDisk->pOut[offs]);
+			offs+=MAXSECTORS*SECTORBYTES;
+			if (lastvolumeid==-1)
+			{
+				lastvolumeid=volumeid;
+			}
+			if (lastvolumeid!=volumeid)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
+		}
+		pDisk->volumeid=lastvolumeid;
+	}
+	else if (pDisk->len==SIZE_2MGIMAGE)	// 2MG Files are already decoded. They come with a header.
+	{
+		// read in the header. https://apple2.org.za/gswv/a2zine/Docs/DiskImage_2MG_Info.txt
+		pDisk->volumeid=pDisk->pEncoded[0x10];	// the volume id is stored in byte 0x10
+		pDisk->pDecoded=&pDisk->pEncoded[0x40];	// skip the header. the rest can be used directly.
+		pDisk->decodedlen=SIZE_2MGIMAGE-0x40;	// 
+	}
+	else 	// must be a .woz file
+	{
+		int j;
+		if (pDisk->pEncoded[0]=='W' && pDisk->pEncoded[1]=='O' && pDisk->pEncoded[2]=='Z' && pDisk->pEncoded[3]=='2' )
+		{
+			tWozInfo wozInfo;
+			int lastvolumeid=-1;
+			// the file is a .woz file, basically an unsynchronized .nib file with a header.
+			// the idea is to synchronize the tracks and treat it as a NIB file.
+
+			// first, the wo header needs to be parsed, to find the tracks within the diskfile
+			if (dMagnetic2_loader_appleii_woz_parseheader(pDisk->pEncoded,pDisk->len,&wozInfo)!=DMAGNETIC2_OK)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
+			// at this point, the header information has been read. the tracks can be found, and the WOZ can be decoded		
+			offs=0;
+			pDisk->pDecoded=pDisk->pOut;
+			pDisk->decodedlen=MAXTRACKS*MAXSECTORS*SECTORBYTES;
+			for (j=0;j<MAXTRACKS;j++)
+			{
+				int start;
+				int len;
+				int quarterTrack;
+
+				quarterTrack=j;
+				start=wozInfo.trackStart[quarterTrack];
+				len=wozInfo.trackBits[quarterTrack];
+
+				if (start)
+				{
+					int volumeid;
+					if (start<0 || len<0 || start+(len+7)/8>pDisk->len)	// the track has to be inside of the image
+					{
+						return DMAGNETIC2_UNKNOWN_SOURCE;
+					}
+					// Synchronize the bit stream in the .woz to make it a .nib stream						
+					dMagnetic2_loader_appleii_woz_synchronize(pDisk->pTrackBuf,&pDisk->pEncoded[start],len);
+					memcpy(&pDisk->pTrackBuf[NIBTRACKSIZE],&pDisk->pTrackBuf[0],NIBTRACKSIZE);
+					volumeid=dMagnetic2_loader_appleii_decodenibtrack(pDisk->pTrackBuf,j,&pDisk->pOut[offs]);
+					offs+=MAXSECTORS*SECTORBYTES;
+					if (lastvolumeid==-1)
+					{
+						lastvolumeid=volumeid;
+					}
+					if (lastvolumeid!=volumeid)
+					{
+						return DMAGNETIC2_UNKNOWN_SOURCE;
+					}
+				}
+			}
+			pDisk->volumeid=lastvolumeid;
+		} else {
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+	}
+	return DMAGNETIC2_OK;
+}
+typedef struct _tdMagnetic2_loader_appleii_job
+{
+	unsigned char* pMagBuf;
+	int magcapacity;
+	unsigned char* pGfxBuf;
+	int gfxcapacity;
+	tdMagnetic2_game_meta *pMeta;
+	const unsigned char** pDisks;
+	const unsigned char** pDecoded;
+	int *decodedlens;
+	int diskcnt;
+	int nodoc;
+} tdMagnetic2_loader_appleii_job;
+static int dMagnetic2_loader_appleii_magjob(void* pArg)
+{
+	tdMagnetic2_loader_appleii_job* pJob=(tdMagnetic2_loader_appleii_job*)pArg;
+	unsigned char* pMagBuf=pJob->pMagBuf;
+	int magsize;
+	int version;
+	int retval;
+	retval=dMagnetic2_loader_appleii_mkmag(pMagBuf,pJob->magcapacity,&magsize,&version,pJob->pMeta->game,pJob->pDisks,pJob->diskcnt);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		if (retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
+		{
+			pJob->pMeta->real_magsize=magsize;
+		}
+		return retval;
+	}
+	pJob->pMeta->real_magsize=magsize;	
+	pJob->pMeta->version=version;
+	if (pJob->nodoc && pMagBuf!=NULL)
+	{
+		int i;
+		unsigned char* ptr=(unsigned char*)&pMagBuf[0];
+		for (i=0;i<magsize-4;i++)
+		{
+			if (ptr[i+0]==0x62 && ptr[i+1]==0x02 && ptr[i+2]==0xa2 && ptr[i+3]==0x00) {ptr[i+0]=0x4e;ptr[i+1]=0x71;}
+			if (ptr[i+0]==0xa4 && ptr[i+1]==0x06 && ptr[i+2]==0xaa && ptr[i+3]==0xdf) {ptr[i+0]=0x4e;ptr[i+1]=0x71;}
+		}
+	}
+	return DMAGNETIC2_OK;
+}
+static int dMagnetic2_loader_appleii_gfxjob(void* pArg)
+{
+	tdMagnetic2_loader_appleii_job* pJob=(tdMagnetic2_loader_appleii_job*)pArg;
+	int gfxsize;
+	int retval;
+	retval=dMagnetic2_loader_appleii_mkgfx(pJob->pGfxBuf,pJob->gfxcapacity,&gfxsize,pJob->pMeta->game,pJob->diskcnt,pJob->pDecoded,pJob->decodedlens);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		if (retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
+		{
+			pJob->pMeta->real_gfxsize=gfxsize;
+		}
+		return retval;
+	}
+	pJob->pMeta->real_gfxsize=gfxsize;	
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_loader_appleii_images(
+		tdMagnetic2_loader_image* pImages,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc)
 {
-	int diskoffs[MAXDISKS]={0};
-	int disklens[MAXDISKS]={0};
-	int decodedoffs[MAXDISKS]={0};
+	tdMagnetic2_loader_appleii_disk disks[MAXDISKS];
+	const unsigned char* pDecoded[MAXDISKS]={NULL};
+	const unsigned char* pDisks[MAXDISKS]={NULL};
 	int decodedlens[MAXDISKS]={0};
 	int volumeids[MAXDISKS]={0};
+	tdMagnetic2_loader_appleii_job job;
+	tdMagnetic2_loader_job jobs[MAXDISKS];
+	int retval;
 	int i;
 	int diskcnt;
-	int n;
-	int offs;
-	FILE *f;
-	char *filenames[]={filename1,filename2,filename3};
-	unsigned char *pTrackBuf;
 
 	// check the important output buffers
-	if (tmpsize<NIBTRACKSIZE+3*MAX_IMAGEFILESIZE+1)	// should be large enough for three disk images. and a spare byte for a trick to determine the correct file size
+	if (tmpsize<TMPSIZE)	// the track buffers, and room for three decoded disk images
 	{
 		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
 	}
@@ -775,126 +1071,42 @@ int dMagnetic2_loader_appleii(
 	pMeta->real_gfxsize=0;
 
 
-	pTrackBuf=&pTmpBuf[0];	// leave a litte buffer at the beginning of the file for the track buffer
-	offs=NIBTRACKSIZE;	// load the images after some space for a track buffer
+	memset(disks,0,sizeof(disks));
 	diskcnt=0;
 	for (i=0;i<MAXDISKS;i++)
 	{
-		if (filenames[i]!=NULL)
+		if (pImages[i].pData!=NULL)
 		{
-			f=fopen(filenames[i],"rb");
-			if (!f)
-			{
-				return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-			}
-			n=fread(&pTmpBuf[offs],sizeof(char),MAX_IMAGEFILESIZE+1,f);
-			fclose(f);
+			int n;
+			n=pImages[i].len;
 			if (n!=SIZE_NIBIMAGE && n!=SIZE_2MGIMAGE && n!=SIZE_DSKIMAGE && n!=SIZE_WOZIMAGE)
 			{
-//				if (pTmpBuf[offs+0]!='W' || pTmpBuf[offs+1]!='O' || pTmpBuf[offs+2]!='Z' || pTmpBufs[offs+2]=='2')
-				{
-					return DMAGNETIC2_UNKNOWN_SOURCE;
-				}
+				return DMAGNETIC2_UNKNOWN_SOURCE;
 			}
-			diskoffs[i]=offs;
-			disklens[i]=n;
-			offs+=n;
+			disks[diskcnt].pEncoded=pImages[i].pData;
+			disks[diskcnt].len=n;
+			disks[diskcnt].pTrackBuf=&pTmpBuf[TRACKBUFOFFS(diskcnt)];
+			// the decoded tracks go into the tmp buffer, the same part of it a non-mappable image would have been read into.
+			disks[diskcnt].pOut=&pTmpBuf[IMAGEOFFS(i)];
+			jobs[diskcnt].pFunc=dMagnetic2_loader_appleii_decodejob;
+			jobs[diskcnt].pArg=&disks[diskcnt];
 			diskcnt++;
 		}
 	}
-	// at this point, all the images have been loaded into the tmp buffer.
-	// the data is encoded. before it can be used, it needs to be decoded.
+	// at this point, all the images are in memory.
+	// the data is encoded. before it can be used, it needs to be decoded. the disks do not depend on each other.
+	retval=dMagnetic2_loader_shared_runjobs(jobs,diskcnt);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
 	for (i=0;i<diskcnt;i++)
 	{
-		int lastvolumeid;
-		if (disklens[i]==SIZE_NIBIMAGE)		// NIB images are raw, encoded image files.
-		{
-			int j;
-			lastvolumeid=-1;
-			
-			decodedoffs[i]=diskoffs[i];
-			decodedlens[i]=MAXTRACKS*MAXSECTORS*SECTORBYTES;
-			offs=diskoffs[i];	
-			for (j=0;j<MAXTRACKS;j++)
-			{
-				int volumeid;
-				// to conserve memory, this process overwrites the loaded image. 
-				// since a decoded track has less bytes than an encoded one, it can be done in place.
-				memcpy(pTrackBuf,&pTmpBuf[diskoffs[i]+j*NIBTRACKSIZE],NIBTRACKSIZE);
-				volumeid=dMagnetic2_loader_appleii_decodenibtrack(pTrackBuf,j,&pTmpBuf[offs]);
-				offs+=MAXSECTORS*SECTORBYTES;
-				if (lastvolumeid==-1)
-				{
-					lastvolumeid=volumeid;
-				}
-				if (lastvolumeid!=volumeid)
-				{
-					return DMAGNETIC2_UNKNOWN_SOURCE;
-				}
-			}
-			volumeids[i]=lastvolumeid;
-		}
-		else if (disklens[i]==SIZE_2MGIMAGE)	// 2MG Files are already decoded. They come with a header.
-		{
-			// read in the header. https://apple2.org.za/gswv/a2zine/Docs/DiskImage_2MG_Info.txt
-			volumeids[i]=pTmpBuf[diskoffs[i]+0x10];	// the volume id is stored in byte 0x10
-			decodedoffs[i]=diskoffs[i]+0x40;	// skip the header. 
-			decodedlens[i]=SIZE_2MGIMAGE-0x40;	// 
-		}
-		else 	// must be a .woz file
-		{
-			int j;
-			offs=diskoffs[i];
-			if (pTmpBuf[offs+0]=='W' && pTmpBuf[offs+1]=='O' && pTmpBuf[offs+2]=='Z' && pTmpBuf[offs+3]=='2' )
-			{
-				tWozInfo wozInfo;
-				int lastvolumeid=-1;
-				// the file is a .woz file, basically an unsynchronized .nib file with a header.
-				// the idea is to synchronize the tracks and treat it as a NIB file.
-
-				// first, the wo header needs to be parsed, to find the tracks within the diskfile
-				if (dMagnetic2_loader_appleii_woz_parseheader(&pTmpBuf[offs],disklens[i],&wozInfo)!=DMAGNETIC2_OK)
-				{
-					return DMAGNETIC2_UNKNOWN_SOURCE;
-				}
-				// at this point, the header information has been read. the tracks can be found, and the WOZ can be decoded		
-				offs=diskoffs[i];
-				decodedoffs[i]=offs;
-				decodedlens[i]=MAXTRACKS*MAXSECTORS*SECTORBYTES;
-				for (j=0;j<MAXTRACKS;j++)
-				{
-					int start;
-					int len;
-					int quarterTrack;
-
-					quarterTrack=j;
-					start=wozInfo.trackStart[quarterTrack];
-					len=wozInfo.trackBits[quarterTrack];
-
-					if (start)
-					{
-						int volumeid;
-						// Synchronize the bit stream in the .woz to make it a .nib stream						
-						dMagnetic2_loader_appleii_woz_synchronize(pTrackBuf,&pTmpBuf[diskoffs[i]+start],len);
-						volumeid=dMagnetic2_loader_appleii_decodenibtrack(pTrackBuf,j,&pTmpBuf[offs]);
-						offs+=MAXSECTORS*SECTORBYTES;
-						if (lastvolumeid==-1)
-						{
-							lastvolumeid=volumeid;
-						}
-						if (lastvolumeid!=volumeid)
-						{
-							return DMAGNETIC2_UNKNOWN_SOURCE;
-						}
-					}
-				}
-				volumeids[i]=lastvolumeid;
-			} else {
-				return DMAGNETIC2_UNKNOWN_SOURCE;
-			}
-		}
+		pDecoded[i]=disks[i].pDecoded;
+		decodedlens[i]=disks[i].decodedlen;
+		volumeids[i]=disks[i].volumeid;
 	}
-	// at this point, the disk images have been decoded and are available in the tmpbuf.
+	// at this point, the disk images have been decoded.
 	// with the volumeid, it is now possible to detect the game which disk it is
 	pMeta->game=DMAGNETIC2_GAME_NONE;
 	for (i=0;i<diskcnt;i++)
@@ -927,43 +1139,72 @@ int dMagnetic2_loader_appleii(
 			// game detection ambiguous
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
-		diskoffs[disknum]=decodedoffs[i];
+		pDisks[disknum]=pDecoded[i];
 	}
 	if (pMeta->game==DMAGNETIC2_GAME_NONE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 	pMeta->source=DMAGNETIC2_SOURCE_APPLEII;
-	// at this point, the game is known
-	if (pMagBuf!=NULL)
+	// at this point, the game is known. the .mag and the .gfx can be built at the same time.
+	job.pMagBuf=pMagBuf;
+	job.magcapacity=magcapacity;
+	job.pGfxBuf=pGfxBuf;
+	job.gfxcapacity=gfxcapacity;
+	job.pMeta=pMeta;
+	job.pDisks=pDisks;
+	job.pDecoded=pDecoded;
+	job.decodedlens=decodedlens;
+	job.diskcnt=diskcnt;
+	job.nodoc=nodoc;
+	// a missing output buffer is not written. its size is being reported anyway.
+	jobs[0].pFunc=dMagnetic2_loader_appleii_magjob;
+	jobs[0].pArg=&job;
+	jobs[1].pFunc=dMagnetic2_loader_appleii_gfxjob;
+	jobs[1].pArg=&job;
+	return dMagnetic2_loader_shared_runjobs(jobs,2);
+}
+
+int dMagnetic2_loader_appleii(
+		char* filename1,char* filename2,char* filename3,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc)
+{
+	tdMagnetic2_loader_image images[MAXDISKS];
+	char *filenames[]={filename1,filename2,filename3};
+	int retval;
+	int i;
+
+	// check the important output buffers
+	if (tmpsize<TMPSIZE)	// should be large enough for three disk images. and a spare byte for a trick to determine the correct file size
 	{
-		int magsize;
-		if (dMagnetic2_loader_appleii_mkmag(pMagBuf,&magsize,pMeta->game,pTmpBuf,diskcnt,diskoffs)!=DMAGNETIC2_OK)
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;
-		}
-		pMeta->real_magsize=magsize;	
-		pMeta->version=pMagBuf[13];
-		if (nodoc)
-		{
-			int i;
-			unsigned char* ptr=(unsigned char*)&pMagBuf[0];
-			for (i=0;i<magsize-4;i++)
-			{
-				if (ptr[i+0]==0x62 && ptr[i+1]==0x02 && ptr[i+2]==0xa2 && ptr[i+3]==0x00) {ptr[i+0]=0x4e;ptr[i+1]=0x71;}
-				if (ptr[i+0]==0xa4 && ptr[i+1]==0x06 && ptr[i+2]==0xaa && ptr[i+3]==0xdf) {ptr[i+0]=0x4e;ptr[i+1]=0x71;}
-			}
-		}
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (pMeta==NULL || pTmpBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-	if (pGfxBuf!=NULL)
+	// map the images. when that is not possible, they are being read into the tmp buffer after the track buffers.
+	retval=DMAGNETIC2_OK;
+	for (i=0;i<MAXDISKS;i++)
 	{
-		int gfxsize;
-		if (dMagnetic2_loader_appleii_mkgfx(pGfxBuf,&gfxsize,pMeta->game,diskcnt,pTmpBuf,decodedoffs,decodedlens)!=DMAGNETIC2_OK)
+		if (retval==DMAGNETIC2_OK)
 		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;
+			retval=dMagnetic2_loader_shared_openimage(&images[i],filenames[i],&pTmpBuf[IMAGEOFFS(i)],MAX_IMAGEFILESIZE);
+		} else {
+			memset(&images[i],0,sizeof(tdMagnetic2_loader_image));
 		}
-		pMeta->real_gfxsize=gfxsize;	
 	}
-	return DMAGNETIC2_OK;
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_appleii_images(images,pTmpBuf,tmpsize,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+	}
+	for (i=0;i<MAXDISKS;i++)
+	{
+		dMagnetic2_loader_shared_closeimage(&images[i]);
+	}
+	return retval;
 }
-
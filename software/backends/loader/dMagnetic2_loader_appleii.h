@@ -29,12 +29,22 @@
 
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_appleii_getsize(int *pBytes);
+int dMagnetic2_loader_appleii_sniff(tdMagnetic2_loader_sniff* pSniff);
+// the disk images have already been opened
+int dMagnetic2_loader_appleii_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc);
 int dMagnetic2_loader_appleii(
 		char* filename1,char* filename2,char* filename3,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc);
 
@@ -92,7 +92,7 @@ const tGames dMagnetic2_loader_archimedes_cGames[MAXGAMES]={
 			.pictureorder={0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31}
 		}
 };
-int dMagnetic2_loader_archimedes_findoffset(unsigned char* map,int mapsize,int sectorsize,int indicator,int indlen,int bytespermapbit,int* pStart)
+int dMagnetic2_loader_archimedes_findoffset(const unsigned char* map,int mapsize,int sectorsize,int indicator,int indlen,int bytespermapbit,int* pStart)
 {
 	int i;
 	int status;
@@ -150,7 +150,7 @@ int dMagnetic2_loader_archimedes_findoffset(unsigned char* map,int mapsize,int s
 	}
 	return DMAGNETIC2_OK;	// did not find the indicator
 }
-int dMagnetic2_loader_archimedes_recursivedir(unsigned char* dskimg,int recursivettl,char* dirname,int hugo0nick1,int sectorsize,int indlen,int bytespermapbit,int diridx, int* pGameId,int *pOffsets,int* pLengths)
+int dMagnetic2_loader_archimedes_recursivedir(const unsigned char* dskimg,int recursivettl,const char* dirname,int hugo0nick1,int sectorsize,int indlen,int bytespermapbit,int diridx, int* pGameId,int *pOffsets,int* pLengths)
 {
 	int dirsize[2]={0x4cc-5,0x7dd-5};	// Hugo/Nick have different sizes for the directory
 	int i;
@@ -159,6 +159,7 @@ int dMagnetic2_loader_archimedes_recursivedir(unsigned char* dskimg,int recursiv
 	int found;
 
 	if (recursivettl==-1) return DMAGNETIC2_OK;	// too many recursions. something when wrong
+	if (diridx<0 || diridx+5+dirsize[hugo0nick1]+26>ADFS_IMAGESIZE) return DMAGNETIC2_OK;	// the directory would be outside of the image
 
 	retval=0;
 	i=0;
@@ -201,7 +202,7 @@ int dMagnetic2_loader_archimedes_recursivedir(unsigned char* dskimg,int recursiv
 
 			if ((dirtype&0x8)==0x8)	// incase it is another directory
 			{
-				retval=dMagnetic2_loader_archimedes_recursivedir(dskimg,recursivettl-1,(char*)&dskimg[diridx+i+0],hugo0nick1,sectorsize,indlen,bytespermapbit,offset,pGameId,pOffsets,pLengths);
+				retval=dMagnetic2_loader_archimedes_recursivedir(dskimg,recursivettl-1,(const char*)&dskimg[diridx+i+0],hugo0nick1,sectorsize,indlen,bytespermapbit,offset,pGameId,pOffsets,pLengths);
 			} else {
 				if (name[0]=='F' || name[0]=='f' || name[0]=='c' )	// when the filename starts with an 'f' or 'F'. For "corruption", it is a lower case 'c'. those are the files we are looking for
 				{
@@ -251,7 +252,7 @@ int dMagnetic2_loader_archimedes_recursivedir(unsigned char* dskimg,int recursiv
 	}
 	return retval;
 }
-int dMagnetic2_loader_archimedes_findfiles(unsigned char* dskimg,
+int dMagnetic2_loader_archimedes_findfiles(const unsigned char* dskimg,
 	int *pGameId,int* pOffsets,int* pLengths,
 	tdMagnetic2_game_meta *pMeta
 	)		// pOffsets are pointers to the files F6 (code), F7 (dict), f8 (string2), f9(string1), F10 (pictures). IN THAT ORDER. the same goes for the lengths
@@ -262,6 +263,7 @@ int dMagnetic2_loader_archimedes_findfiles(unsigned char* dskimg,
 	int bytespermapbit;
 	int diridx;
 	unsigned int filemask;
+	int i;
 
 	// step 1: find out, if the disk image contains a file system in the 'Hugo' or 'Nick' format.
 	hugo0nick1=-1;
@@ -331,6 +333,14 @@ int dMagnetic2_loader_archimedes_findfiles(unsigned char* dskimg,
 //			fprintf(stderr,"insufficient files on the disk. sorry\n");
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
+		for (i=0;i<=MAXFILENAMENUM;i++)
+		{
+			// the files are being read from the image directly. they have to be inside of it.
+			if (((1<<i)&dMagnetic2_loader_archimedes_cGames[*pGameId].expectedmask) && (pOffsets[i]<0 || pLengths[i]<0 || pLengths[i]>ADFS_IMAGESIZE-pOffsets[i]))
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
+		}
 		pMeta->game=dMagnetic2_loader_archimedes_cGames[*pGameId].game;
 		pMeta->source=DMAGNETIC2_SOURCE_ARCHIMEDES;
 		pMeta->version=dMagnetic2_loader_archimedes_cGames[*pGameId].version;
@@ -340,7 +350,7 @@ int dMagnetic2_loader_archimedes_findfiles(unsigned char* dskimg,
 	}
 	return DMAGNETIC2_UNKNOWN_SOURCE;
 }
-int dMagnetic2_loader_archimedes_mkmag(unsigned char *dskimg,unsigned char* magbuf,int* magsize,
+int dMagnetic2_loader_archimedes_mkmag(const unsigned char *dskimg,unsigned char* magbuf,int magcapacity,int* magsize,
 		int gameId,int* offsets,int *lengths,int nodoc)
 {
 	int magidx;
@@ -349,25 +359,38 @@ int dMagnetic2_loader_archimedes_mkmag(unsigned char *dskimg,unsigned char* magb
 	int string2size;
 	int dictsize;
 
+	// without a buffer, only the size is being calculated.
 	magidx=42;
 	// the game code is stored in F6, it is packed
-	codesize=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F6CODE]],lengths[F6CODE],&magbuf[magidx]);
+	codesize=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F6CODE]],lengths[F6CODE],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity));
 	magidx+=codesize;
 	// the string1 is stored in F9
-	memcpy(&magbuf[magidx],&dskimg[offsets[F9STRING1]],lengths[F9STRING1]);
+	if (OUTPUT_FITS(magbuf,magidx,lengths[F9STRING1],magcapacity)!=NULL)
+	{
+		memcpy(&magbuf[magidx],&dskimg[offsets[F9STRING1]],lengths[F9STRING1]);
+	}
 	string1size=lengths[F9STRING1];
 	magidx+=string1size;
 	// string2 is in F8, it is packed
-	string2size=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F8STRING2]],lengths[F8STRING2],&magbuf[magidx]);
+	string2size=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F8STRING2]],lengths[F8STRING2],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity));
 	magidx+=string2size;
 	if (dMagnetic2_loader_archimedes_cGames[gameId].version)	// the pawn did not have a dictionary file.
 	{
 		// the dict is stored in F7, it is packed
-		dictsize=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F7DICT]],lengths[F7DICT],&magbuf[magidx]);
+		dictsize=dMagnetic2_loader_shared_unhuffer(&dskimg[offsets[F7DICT]],lengths[F7DICT],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity));
 		magidx+=dictsize;
 	} else {
 		dictsize=0;
 	}
+	*magsize=magidx;
+	if (magbuf==NULL)
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (magidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 
 	if (nodoc)
 	{
@@ -382,13 +405,11 @@ int dMagnetic2_loader_archimedes_mkmag(unsigned char *dskimg,unsigned char* magb
 
 	dMagnetic2_loader_shared_addmagheader(magbuf,magidx,dMagnetic2_loader_archimedes_cGames[gameId].version,codesize,string1size,string2size,dictsize,-1);
 
-	*magsize=magidx;
-
 	return DMAGNETIC2_OK;
 }
 // the archimedes basically uses the same graphic format as the Amiga and the Atari.
 // all that is needed is to find the offsets to the pictures.
-int dMagnetic2_loader_archimedes_mkgfx(unsigned char *dskimg,unsigned char* gfxbuf,int* gfxsize,
+int dMagnetic2_loader_archimedes_mkgfx(const unsigned char *dskimg,unsigned char* gfxbuf,int gfxcapacity,int* gfxsize,
 		int gameId,int* offsets,int *lengths)
 {
 
@@ -397,14 +418,23 @@ int dMagnetic2_loader_archimedes_mkgfx(unsigned char *dskimg,unsigned char* gfxb
 	int length;
 #define	GFX_HEADER_SIZE	(4+4+32*4)	
 #define	PICTURE_HEADER_SIZE	48
+	length=lengths[F10PICTURES]+GFX_HEADER_SIZE;
+	*gfxsize=length;
+	if (gfxbuf==NULL)	// just the size
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (length>gfxcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 	gfxbuf[0]='M';gfxbuf[1]='a';gfxbuf[2]='P';gfxbuf[3]='i';
+	memset(&gfxbuf[4],0,GFX_HEADER_SIZE-4);	// the pictures which are not found stay at offset 0. the buffer might not have been cleared.
 	gfxcnt=0;
 
-	length=lengths[F10PICTURES]+GFX_HEADER_SIZE;
 	// copy the picture "file" from the disk image into the gfx buffer
 	// todo: this will leave some junk in the gfx buffer. 
 	memcpy(&gfxbuf[GFX_HEADER_SIZE],&dskimg[offsets[F10PICTURES]],lengths[F10PICTURES]);
-	*gfxsize=length;
 	idx=GFX_HEADER_SIZE;
 	while (idx<(length-PICTURE_HEADER_SIZE))
 	{
@@ -433,80 +463,118 @@ int dMagnetic2_loader_archimedes_getsize(int *pBytes)
 	*pBytes=ADFS_IMAGESIZE+1;
 	return DMAGNETIC2_OK;
 }
+int dMagnetic2_loader_archimedes_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	return pSniff->present[0] && SNIFF_SIZE_IS(pSniff,0,ADFS_IMAGESIZE);
+}
 
-int dMagnetic2_loader_archimedes(
-		char* filename1,
-		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+typedef struct _tdMagnetic2_loader_archimedes_job
+{
+	const unsigned char* pImage;
+	unsigned char* pMagBuf;
+	int magcapacity;
+	unsigned char* pGfxBuf;
+	int gfxcapacity;
+	tdMagnetic2_game_meta *pMeta;
+	int gameId;
+	int* offsets;
+	int* lengths;
+	int nodoc;
+} tdMagnetic2_loader_archimedes_job;
+static int dMagnetic2_loader_archimedes_magjob(void* pArg)
+{
+	tdMagnetic2_loader_archimedes_job* pJob=(tdMagnetic2_loader_archimedes_job*)pArg;
+	return dMagnetic2_loader_archimedes_mkmag(pJob->pImage,pJob->pMagBuf,pJob->magcapacity,&pJob->pMeta->real_magsize,pJob->gameId,pJob->offsets,pJob->lengths,pJob->nodoc);
+}
+static int dMagnetic2_loader_archimedes_gfxjob(void* pArg)
+{
+	tdMagnetic2_loader_archimedes_job* pJob=(tdMagnetic2_loader_archimedes_job*)pArg;
+	return dMagnetic2_loader_archimedes_mkgfx(pJob->pImage,pJob->pGfxBuf,pJob->gfxcapacity,&pJob->pMeta->real_gfxsize,pJob->gameId,pJob->offsets,pJob->lengths);
+}
+int dMagnetic2_loader_archimedes_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc)
-		
 {
-
 	int offsets[MAXFILENAMENUM+1]={0};
 	int lengths[MAXFILENAMENUM+1]={0};
 	int gameId=-1;
+	const unsigned char* pImage;
+	tdMagnetic2_loader_archimedes_job job;
+	tdMagnetic2_loader_job jobs[2];
 
-	int n;
-	FILE *f;
-	// check the important output buffers
-	if (pMeta==NULL || pTmpBuf==NULL)
+	if (pMeta==NULL)
 	{
 		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-	if (tmpsize<ADFS_IMAGESIZE+1)	
-	{
-		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
-	}
-
 	pMeta->game=DMAGNETIC2_GAME_NONE;
 	pMeta->source=DMAGNETIC2_SOURCE_NONE;
 	pMeta->version=-1;
 	pMeta->real_magsize=0;
 	pMeta->real_gfxsize=0;
 
-
-	if (filename1!=NULL)
+	pImage=pImages[0].pData;
+	if (pImage==NULL || pImages[0].len!=ADFS_IMAGESIZE)
 	{
-		// check if the file starts with the correct magic word(s)
-		f=fopen(filename1,"rb");
-		if (!f)
-		{
-			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-		}
-		n=fread(pTmpBuf,sizeof(char),ADFS_IMAGESIZE+1,f);	// read the image file. plus 1 byte to check if the size will match.
-		fclose(f);
-		if (n!=ADFS_IMAGESIZE)
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;
-		}
+		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 
 	// at this point, the diskiamge has been loaded.
-	if (dMagnetic2_loader_archimedes_findfiles(pTmpBuf,&gameId,offsets,lengths,pMeta)!=DMAGNETIC2_OK)
+	if (dMagnetic2_loader_archimedes_findfiles(pImage,&gameId,offsets,lengths,pMeta)!=DMAGNETIC2_OK)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 
-	if (pMagBuf!=NULL)
+	// the .mag and the .gfx come from different files on the disk. they can be built at the same time.
+	job.pImage=pImage;
+	job.pMagBuf=pMagBuf;
+	job.magcapacity=magcapacity;
+	job.pGfxBuf=pGfxBuf;
+	job.gfxcapacity=gfxcapacity;
+	job.pMeta=pMeta;
+	job.gameId=gameId;
+	job.offsets=offsets;
+	job.lengths=lengths;
+	job.nodoc=nodoc;
+	// a missing output buffer is not written. its size is being reported anyway.
+	jobs[0].pFunc=dMagnetic2_loader_archimedes_magjob;
+	jobs[0].pArg=&job;
+	jobs[1].pFunc=dMagnetic2_loader_archimedes_gfxjob;
+	jobs[1].pArg=&job;
+	return dMagnetic2_loader_shared_runjobs(jobs,2);
+}
+
+int dMagnetic2_loader_archimedes(
+		char* filename1,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc)
+		
+{
+	tdMagnetic2_loader_image images[1];
+	int retval;
+	// check the important output buffers
+	if (pMeta==NULL || pTmpBuf==NULL)
 	{
-		if (dMagnetic2_loader_archimedes_mkmag(pTmpBuf,pMagBuf,&pMeta->real_magsize,gameId,offsets,lengths,nodoc)!=DMAGNETIC2_OK)
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;
-		}
+		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-	if (pGfxBuf!=NULL)
+	if (tmpsize<ADFS_IMAGESIZE+1)	
 	{
-		if (dMagnetic2_loader_archimedes_mkgfx(pTmpBuf,pGfxBuf,&pMeta->real_gfxsize,gameId,offsets,lengths)!=DMAGNETIC2_OK)
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;
-		}
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
 	}
-	
-
-	return DMAGNETIC2_OK;	
 
+	// map the image file. at most 1 byte more than expected, to check if the size will match.
+	retval=dMagnetic2_loader_shared_openimage(&images[0],filename1,pTmpBuf,ADFS_IMAGESIZE);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader_archimedes_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+	dMagnetic2_loader_shared_closeimage(&images[0]);
 
+	return retval;	
 }
-
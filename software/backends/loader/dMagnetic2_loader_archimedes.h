@@ -28,14 +28,23 @@
 #define	DMAGNETIC2_LOADER_ARCHIMEDES_H
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_archimedes_getsize(int *pBytes);
+int dMagnetic2_loader_archimedes_sniff(tdMagnetic2_loader_sniff* pSniff);
+// the disk image has already been opened
+int dMagnetic2_loader_archimedes_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc);
 
 
 int dMagnetic2_loader_archimedes(
 		char* filename1,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc);
 
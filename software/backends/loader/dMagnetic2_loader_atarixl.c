@@ -121,8 +121,14 @@ const tGameInfo	dMagnetic2_loader_atarixl_cGameInfo[GAMENUM]={
 		idx=(offset); \
 		if ((idx)&DISK1_FLAG) idx=((idx)&DISK_OFFSETMASK)+(disk1offs); \
 		if ((idx)&DISK2_FLAG) idx=((idx)&DISK_OFFSETMASK)+(disk2offs);
-
-int dMagnetic2_loader_atarixl_detectgame(unsigned char* diskbuf,int* disk1offs,int* disk2offs)
+// the two disk images are separate. disk1offs and disk2offs (0 or DISK_SIZE) tell which file holds which disk.
+#define	GETDISK(pDisk,idx,offset,pFiles,disk1offs,disk2offs) \
+		idx=(offset)&DISK_OFFSETMASK; \
+		pDisk=(pFiles)[((((offset)&DISK1_FLAG)?(disk1offs):(disk2offs))>=DISK_SIZE)?1:0];
+// the scrambled blocks are being read from the images directly
+#define	BLOCK_INSIDE(idx)	((idx)>=0 && (idx)+BLOCKSIZE<=DISK_SIZE)
+
+int dMagnetic2_loader_atarixl_detectgame(const unsigned char** pFiles,int* disk1offs,int* disk2offs)
 {
 	int d1,d2;
 	int found;
@@ -142,7 +148,7 @@ int dMagnetic2_loader_atarixl_detectgame(unsigned char* diskbuf,int* disk1offs,i
 	{
 		unsigned char lc;
 		lc=0xff;
-		dMagnetic2_loader_shared_descramble(&diskbuf[d1+(DISK_OFFSETMASK&dMagnetic2_loader_atarixl_cGameInfo[i].offs_code1)],tmp,0,&lc,0);
+		dMagnetic2_loader_shared_descramble(&pFiles[d1?1:0][DISK_OFFSETMASK&dMagnetic2_loader_atarixl_cGameInfo[i].offs_code1],tmp,sizeof(tmp),0,&lc,0);
 		if (tmp[ 0]==0x49 && tmp[ 1]==0xfa && tmp[ 2]==0xff && tmp[ 3]==0xfe) found=i;
 		if (tmp[2+ 0]==0x49 && tmp[2+ 1]==0xfa && tmp[2+ 2]==0xff && tmp[2+ 3]==0xfe) found=i;
 	}
@@ -155,13 +161,41 @@ int dMagnetic2_loader_atarixl_detectgame(unsigned char* diskbuf,int* disk1offs,i
 	{
 		unsigned char lc;
 		lc=0xff;
-		dMagnetic2_loader_shared_descramble(&diskbuf[d2+(DISK_OFFSETMASK&dMagnetic2_loader_atarixl_cGameInfo[i].offs_code1)],tmp,0,&lc,0);
+		dMagnetic2_loader_shared_descramble(&pFiles[d2?1:0][DISK_OFFSETMASK&dMagnetic2_loader_atarixl_cGameInfo[i].offs_code1],tmp,sizeof(tmp),0,&lc,0);
 		if (tmp[ 0]==0x49 && tmp[ 1]==0xfa && tmp[ 2]==0xff && tmp[ 3]==0xfe) found=i;
 		if (tmp[2+ 0]==0x49 && tmp[2+ 1]==0xfa && tmp[2+ 2]==0xff && tmp[2+ 3]==0xfe) found=i;
 	}
 	return found;
 }
-int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk1offs,int disk2offs,unsigned char* magbuf,int *magbufsize,const tGameInfo *pGameInfo)
+// the first two bytes of the run length encoded code. they are the size of it.
+static int dMagnetic2_loader_atarixl_codeleft(const unsigned char* pBlock)
+{
+	unsigned char tmp[BLOCKSIZE];
+	unsigned char out[2]={0};
+	unsigned char lc;
+	int outcnt;
+	int i;
+	int j;
+
+	dMagnetic2_loader_shared_descramble(pBlock,tmp,sizeof(tmp),0,NULL,0);
+	lc=0xff;
+	outcnt=0;
+	for (i=0;i<BLOCKSIZE && outcnt<2;i++)
+	{
+		if (lc==0)
+		{
+			for (j=0;j<tmp[i]-1 && outcnt<2;j++)
+			{
+				out[outcnt++]=0;
+			}
+		} else {
+			out[outcnt++]=tmp[i];
+		}
+		lc=tmp[i];
+	}
+	return READ_INT16BE(out,0);
+}
+int dMagnetic2_loader_atarixl_mkmag(const unsigned char** pFiles,int disk1offs,int disk2offs,unsigned char* magbuf,int magcapacity,int *magbufsize,const tGameInfo *pGameInfo)
 {
 	int magidx;
 	int code1size;
@@ -178,6 +212,7 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 	code1size=0;
 	code2size=0;
 	{
+		const unsigned char* pDisk;
 		int idx;
 		unsigned char lc;
 		int n;
@@ -195,11 +230,19 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 
 		pivot=0;
 		lc=0xff;
-		GETIDX(idx,pGameInfo->offs_code1,disk1offs,disk2offs);
-		n=dMagnetic2_loader_shared_descramble(&diskbuf[idx],&magbuf[magidx],pivot,&lc,rle);
+		GETDISK(pDisk,idx,pGameInfo->offs_code1,pFiles,disk1offs,disk2offs);
+		if (!BLOCK_INSIDE(idx)) return DMAGNETIC2_UNKNOWN_SOURCE;
+		n=dMagnetic2_loader_shared_descramble(&pDisk[idx],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),pivot,&lc,rle);
+		if (n<2) return DMAGNETIC2_UNKNOWN_SOURCE;
 		if (pGameInfo->version!=0)
 		{
-			codeleft=READ_INT16BE(magbuf,magidx);
+			// the first two bytes are the size of the packed code. without a .mag buffer, they are being unpacked on their own.
+			if (OUTPUT_FITS(magbuf,magidx,2,magcapacity)!=NULL)
+			{
+				codeleft=READ_INT16BE(magbuf,magidx);
+			} else {
+				codeleft=dMagnetic2_loader_atarixl_codeleft(&pDisk[idx]);
+			}
 		}
 		code1size+=n;
 		idx+=BLOCKSIZE;
@@ -207,7 +250,8 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 		while (codeleft>=BLOCKSIZE)
 		{
 			pivot=(pivot+1)%MAXPIVOT;
-			n=dMagnetic2_loader_shared_descramble(&diskbuf[idx],&magbuf[magidx],pivot,&lc,rle);
+			if (!BLOCK_INSIDE(idx)) return DMAGNETIC2_UNKNOWN_SOURCE;
+			n=dMagnetic2_loader_shared_descramble(&pDisk[idx],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),pivot,&lc,rle);
 			codeleft-=BLOCKSIZE;
 			idx+=BLOCKSIZE;
 			magidx+=n;
@@ -219,12 +263,13 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 			code1size-=(codeleft+2);
 			magidx-=codeleft;
 		}
-		GETIDX(idx,pGameInfo->offs_code2,disk1offs,disk2offs);
+		GETDISK(pDisk,idx,pGameInfo->offs_code2,pFiles,disk1offs,disk2offs);
 		codeleft=0x10000-code1size;
 		while (codeleft>0)
 		{
 			pivot=(pivot+1)%MAXPIVOT;
-			n=dMagnetic2_loader_shared_descramble(&diskbuf[idx],&magbuf[magidx],pivot,&lc,0);
+			if (!BLOCK_INSIDE(idx)) return DMAGNETIC2_UNKNOWN_SOURCE;
+			n=dMagnetic2_loader_shared_descramble(&pDisk[idx],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),pivot,&lc,0);
 			codeleft-=BLOCKSIZE;
 			idx+=BLOCKSIZE;
 			magidx+=n;
@@ -237,34 +282,40 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 	string1size=0;
 	string2size=0;
 	{
+		const unsigned char* pDisk1;
+		const unsigned char* pDisk2;
 		int idx1;
 		int idx2;
-		int nxtdisk;
 		int magidx0;
 
 
 		magidx0=magidx;
-		GETIDX(idx1,pGameInfo->offs_string1,disk1offs,disk2offs);
-		GETIDX(idx2,pGameInfo->offs_string2,disk1offs,disk2offs);
-		nxtdisk=disksize;
-		if (idx1<disk1offs) nxtdisk=disk1offs;
-		if (idx1<disk2offs) nxtdisk=disk2offs;
+		GETDISK(pDisk1,idx1,pGameInfo->offs_string1,pFiles,disk1offs,disk2offs);
+		GETDISK(pDisk2,idx2,pGameInfo->offs_string2,pFiles,disk1offs,disk2offs);
 
-		while (idx1<idx2 && idx1<nxtdisk)
+		// string1 ends where string2 begins, or at the end of its disk.
+		string1size=DISK_SIZE-idx1;
+		if (pDisk1==pDisk2 && idx2<DISK_SIZE)
+		{
+			string1size=idx2-idx1;
+		}
+		if (string1size<0)
 		{
-			magbuf[magidx++]=diskbuf[idx1++];
-			string1size++;
+			string1size=0;
 		}
 		// TODO: string2 is waaay too big.
-		nxtdisk=disksize;
-		if (idx2<disk1offs) nxtdisk=disk1offs;
-		if (idx2<disk2offs) nxtdisk=disk2offs;
-		while (idx2<nxtdisk)
+		string2size=(idx2<DISK_SIZE)?DISK_SIZE-idx2:0;
+		if (OUTPUT_FITS(magbuf,magidx,string1size+string2size,magcapacity)!=NULL)
 		{
-			magbuf[magidx++]=diskbuf[idx2++];
-			string2size++;
+			memcpy(&magbuf[magidx],&pDisk1[idx1],string1size);
+			memcpy(&magbuf[magidx+string1size],&pDisk2[idx2],string2size);
 		}
-		if (pGameInfo->version==0)
+		magidx+=string1size+string2size;
+		if (magbuf==NULL || magidx>magcapacity)	// the huffman tree is only needed for the header
+		{
+			huffmantreeidx=0;
+		}
+		else if (pGameInfo->version==0)
 		{
 			huffmantreeidx=string1size;
 		} else {
@@ -293,16 +344,18 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 	dictsize=0;
 	if (pGameInfo->offs_dict!=0)
 	{
+		const unsigned char* pDisk;
 		int n;
 		int idx;
 		int pivot;
 		unsigned char lc;
-		GETIDX(idx,pGameInfo->offs_dict,disk1offs,disk2offs);
+		GETDISK(pDisk,idx,pGameInfo->offs_dict,pFiles,disk1offs,disk2offs);
 		pivot=0;
 		while (dictsize<8704)	// TODO: magic number
 		{
 			lc=0xff;
-			n=dMagnetic2_loader_shared_descramble(&diskbuf[idx],&magbuf[magidx],pivot,&lc,0);
+			if (!BLOCK_INSIDE(idx)) return DMAGNETIC2_UNKNOWN_SOURCE;
+			n=dMagnetic2_loader_shared_descramble(&pDisk[idx],OUTPUT_AT(magbuf,magidx),OUTPUT_ROOM(magidx,magcapacity),pivot,&lc,0);
 
 			magidx+=n;
 			dictsize+=n;
@@ -310,13 +363,20 @@ int dMagnetic2_loader_atarixl_mkmag(unsigned char* diskbuf,int disksize,int disk
 			idx+=BLOCKSIZE;
 		}
 	}
-	dMagnetic2_loader_shared_addmagheader(magbuf,magidx,pGameInfo->version,code1size+code2size,string1size,string2size,dictsize,huffmantreeidx);
 	*magbufsize=magidx;
+	if (magbuf!=NULL && magidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (magbuf!=NULL)
+	{
+		dMagnetic2_loader_shared_addmagheader(magbuf,magidx,pGameInfo->version,code1size+code2size,string1size,string2size,dictsize,huffmantreeidx);
+	}
 
 
 	return DMAGNETIC2_OK;
 }
-int dMagnetic2_loader_atarixl_mkgfx(unsigned char* pTmpBuf,unsigned char* gfxbuf,int *gfxbufsize,int disk1offs,int disk2offs,const tGameInfo* pGameInfo)
+int dMagnetic2_loader_atarixl_mkgfx(const unsigned char** pFiles,unsigned char* gfxbuf,int gfxcapacity,int *gfxbufsize,int disk1offs,int disk2offs,const tGameInfo* pGameInfo)
 {
 	// i am lazy
 	// just translate the pre-determined offsets into the gfx buffer index.
@@ -327,8 +387,17 @@ int dMagnetic2_loader_atarixl_mkgfx(unsigned char* pTmpBuf,unsigned char* gfxbuf
 	int gfxidx;
 
 	*gfxbufsize=LEGACY_OFFSET+2*DISK_SIZE;
+	if (gfxbuf==NULL)	// just the size
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (*gfxbufsize>gfxcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 	memset(gfxbuf,0,*gfxbufsize);
-	memcpy(&gfxbuf[LEGACY_OFFSET],pTmpBuf,2*DISK_SIZE);
+	memcpy(&gfxbuf[LEGACY_OFFSET],pFiles[0],DISK_SIZE);
+	memcpy(&gfxbuf[LEGACY_OFFSET+DISK_SIZE],pFiles[1],DISK_SIZE);
 	gfxidx=0;
 
 	gfxbuf[gfxidx++]='M';
@@ -350,75 +419,51 @@ int dMagnetic2_loader_atarixl_getsize(int *pBytes)
 	*pBytes=2*DISK_SIZE+1;// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
 	return DMAGNETIC2_OK;
 }
+int dMagnetic2_loader_atarixl_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	return pSniff->present[0] && pSniff->present[1] && SNIFF_SIZE_IS(pSniff,0,DISK_SIZE) && SNIFF_SIZE_IS(pSniff,1,DISK_SIZE);
+}
 
 
 
-int dMagnetic2_loader_atarixl(
-		char* filename1,char* filename2,
-		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+int dMagnetic2_loader_atarixl_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc)
 {
-	FILE *f;
-	int n;
+	const unsigned char* pFiles[2];
 	int gameidx;
 	int disk1offs;
 	int disk2offs;
-	
-	// check the important output buffers
-	if (tmpsize<2*DISK_SIZE+1)	
-	{
-		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
-	}
-	if (pMeta==NULL || pTmpBuf==NULL)
+	int retval;
+
+	if (pMeta==NULL)
 	{
 		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-
 	pMeta->game=DMAGNETIC2_GAME_NONE;
 	pMeta->source=DMAGNETIC2_SOURCE_NONE;
 	pMeta->version=-1;
 	pMeta->real_magsize=0;
 	pMeta->real_gfxsize=0;
 
-	if (filename1==NULL || filename2==NULL)
+	// check if the files have the expected size
+	if (pImages[0].pData==NULL || pImages[1].pData==NULL || pImages[0].len!=DISK_SIZE || pImages[1].len!=DISK_SIZE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
-	// check if the file has the expected size
-	f=fopen(filename1,"rb");
-	if (!f)
-	{
-		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-	}
-	n=fread(&pTmpBuf[0],sizeof(char),DISK_SIZE+1,f);
-	fclose(f);
-	if (n!=DISK_SIZE)
-	{
-		return DMAGNETIC2_UNKNOWN_SOURCE;
-	}
-	// check if the file has the expected size
-	f=fopen(filename2,"rb");
-	if (!f)
-	{
-		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-	}
-	n=fread(&pTmpBuf[DISK_SIZE],sizeof(char),DISK_SIZE+1,f);
-	fclose(f);
-	if (n!=DISK_SIZE)
-	{
-		return DMAGNETIC2_UNKNOWN_SOURCE;
-	}
-	// at this point, the diskimages are both in the tmpbuf.
+	pFiles[0]=pImages[0].pData;
+	pFiles[1]=pImages[1].pData;
+	// at this point, the diskimages are both in memory.
 	// time to detect the game and the order of the disks
 
 
 	// TODO: there is a sanity check missing. it is possible that one image is the valid game, whilst the second disk is something else.
 	disk1offs=0;
 	disk2offs=DISK_SIZE;
-	gameidx=dMagnetic2_loader_atarixl_detectgame(pTmpBuf,&disk1offs,&disk2offs);
+	gameidx=dMagnetic2_loader_atarixl_detectgame(pFiles,&disk1offs,&disk2offs);
 	if (gameidx==-1)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
@@ -427,16 +472,16 @@ int dMagnetic2_loader_atarixl(
 	pMeta->source=DMAGNETIC2_SOURCE_ATARIXL;
 	pMeta->version=dMagnetic2_loader_atarixl_cGameInfo[gameidx].version;
 
-	if (pMagBuf!=NULL)
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	retval=DMAGNETIC2_OK;
 	{
-		int retval;
 		int magbufsize;
-		retval=dMagnetic2_loader_atarixl_mkmag(pTmpBuf,2*DISK_SIZE,disk1offs,disk2offs,pMagBuf,&magbufsize,&dMagnetic2_loader_atarixl_cGameInfo[gameidx]);
-		if (retval!=DMAGNETIC2_OK)
+		retval=dMagnetic2_loader_atarixl_mkmag(pFiles,disk1offs,disk2offs,pMagBuf,magcapacity,&magbufsize,&dMagnetic2_loader_atarixl_cGameInfo[gameidx]);
+		if (retval!=DMAGNETIC2_OK && retval!=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
 		{
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
-		if (nodoc)
+		if (retval==DMAGNETIC2_OK && nodoc && pMagBuf!=NULL)
 		{
 			int i;
 			unsigned char* ptr=(unsigned char*)&pMagBuf[0];
@@ -448,18 +493,62 @@ int dMagnetic2_loader_atarixl(
 		}
 		pMeta->real_magsize=magbufsize;
 	}
-	if (pGfxBuf!=NULL)
 	{
-		int retval;
+		int gfxretval;
 		int gfxbufsize;
-		retval=dMagnetic2_loader_atarixl_mkgfx(pTmpBuf,pGfxBuf,&gfxbufsize,disk1offs,disk2offs,&dMagnetic2_loader_atarixl_cGameInfo[gameidx]);
-		if (retval!=DMAGNETIC2_OK)
+		gfxretval=dMagnetic2_loader_atarixl_mkgfx(pFiles,pGfxBuf,gfxcapacity,&gfxbufsize,disk1offs,disk2offs,&dMagnetic2_loader_atarixl_cGameInfo[gameidx]);
+		if (gfxretval!=DMAGNETIC2_OK && gfxretval!=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
 		{
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
 		pMeta->real_gfxsize=gfxbufsize;
+		if (retval==DMAGNETIC2_OK)
+		{
+			retval=gfxretval;
+		}
 	}
 
 
-	return DMAGNETIC2_OK;
+	return retval;
+}
+
+int dMagnetic2_loader_atarixl(
+		char* filename1,char* filename2,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc)
+{
+	tdMagnetic2_loader_image images[2];
+	int retval;
+	
+	// check the important output buffers
+	if (tmpsize<2*DISK_SIZE+1)	
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (pMeta==NULL || pTmpBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+
+	if (filename1==NULL || filename2==NULL)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	// map the images. the tmpbuf is only needed when that is not possible.
+	retval=dMagnetic2_loader_shared_openimage(&images[0],filename1,&pTmpBuf[0],DISK_SIZE);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader_shared_openimage(&images[1],filename2,&pTmpBuf[DISK_SIZE],DISK_SIZE);
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_atarixl_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_shared_closeimage(&images[1]);
+	}
+	dMagnetic2_loader_shared_closeimage(&images[0]);
+	return retval;
 }
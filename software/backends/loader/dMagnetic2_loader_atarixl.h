@@ -28,12 +28,21 @@
 #define	DMAGNETIC2_LOADER_ATARIXL_H
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_atarixl_getsize(int *pBytes);
+int dMagnetic2_loader_atarixl_sniff(tdMagnetic2_loader_sniff* pSniff);
+// the disk images have already been opened
+int dMagnetic2_loader_atarixl_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc);
 int dMagnetic2_loader_atarixl(
 		char* filename1,char* filename2,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc);
 
@@ -36,6 +36,8 @@
 
 // the purpose of this loader is to load the game from .D64 image files.
 #define D64_IMAGESIZE   174848
+// the two disk images are separate. offsets behind the first image are on the second one.
+#define	D64_DISK(d64images,offset)	((d64images)[((offset)>=D64_IMAGESIZE)?1:0])
 #define D64_TRACKNUM    40
 #define D64_SECTORSIZE  256
 #define D64_MAXENTRIES  64
@@ -134,7 +136,7 @@ const tGameInfo dMagnetic2_loader_c64_gameinfo[6]=
 	}
 };
 
-edMagnetic2_game dMagnetic2_loader_c64_detectgame(unsigned char* diskram,tdMagnetic2_game_meta *pMeta,int *pSidecnt_expected,const int **ppPictureorder)
+edMagnetic2_game dMagnetic2_loader_c64_detectgame(const unsigned char* diskram,tdMagnetic2_game_meta *pMeta,int *pSidecnt_expected,const int **ppPictureorder)
 {
 
 	// find the magic word
@@ -164,7 +166,7 @@ edMagnetic2_game dMagnetic2_loader_c64_detectgame(unsigned char* diskram,tdMagne
 
 	return DMAGNETIC2_UNKNOWN_SOURCE;
 }
-int dMagnetic2_loader_c64_readEntries(unsigned char* d64image,int d64size,tFileEntry* pEntries,int* pEntrynum)
+int dMagnetic2_loader_c64_readEntries(const unsigned char* d64image,int d64size,tFileEntry* pEntries,int* pEntrynum)
 {
 // this function is reading the "directory" 
 	int i;
@@ -216,7 +218,7 @@ int dMagnetic2_loader_c64_readEntries(unsigned char* d64image,int d64size,tFileE
 	*pEntrynum=cnt;
 	return DMAGNETIC2_OK;
 }
-void dMagnetic2_loader_c64_readSector(unsigned char* d64image,int track,int sect,unsigned char* buf)
+void dMagnetic2_loader_c64_readSector(const unsigned char* d64image,int track,int sect,unsigned char* buf)
 {
 	int i;
 	int offset;
@@ -236,7 +238,7 @@ void dMagnetic2_loader_c64_readSector(unsigned char* d64image,int track,int sect
 
 
 
-void dMagnetic2_loader_c64_identifyEntries(unsigned char* d64image,tFileEntry* pEntries,int entryNum,int diskcnt)
+void dMagnetic2_loader_c64_identifyEntries(const unsigned char** d64images,tFileEntry* pEntries,int entryNum,int diskcnt)
 {
 	int i;
 	unsigned char tmp1[256]={0};
@@ -250,10 +252,10 @@ void dMagnetic2_loader_c64_identifyEntries(unsigned char* d64image,tFileEntry* p
 	// first: find the code block
 	for (i=0;i<entryNum;i++)
 	{
-		dMagnetic2_loader_c64_readSector(&d64image[0],pEntries[i].track,pEntries[i].sector,tmp1);		// read from the first image
+		dMagnetic2_loader_c64_readSector(d64images[0],pEntries[i].track,pEntries[i].sector,tmp1);		// read from the first image
 		if (diskcnt==2)
 		{
-			dMagnetic2_loader_c64_readSector(&d64image[D64_IMAGESIZE],pEntries[i].track,pEntries[i].sector,tmp2);	// and from the second one
+			dMagnetic2_loader_c64_readSector(d64images[1],pEntries[i].track,pEntries[i].sector,tmp2);	// and from the second one
 		}
 
 		if (tmp1[0]==0x49 && tmp1[1]==0xfa)	// 0x49fa is ALWAYS the first instruction.
@@ -270,8 +272,8 @@ void dMagnetic2_loader_c64_identifyEntries(unsigned char* d64image,tFileEntry* p
 			pEntries[i+1].fileType=TYPE_DICTIONARY;
 			sideoffsets[pEntries[i].side]=D64_IMAGESIZE;
 		} else {
-			dMagnetic2_loader_shared_descramble(tmp1,tmp1,0,NULL,0);
-			dMagnetic2_loader_shared_descramble(tmp2,tmp2,0,NULL,0);
+			dMagnetic2_loader_shared_descramble(tmp1,tmp1,sizeof(tmp1),0,NULL,0);
+			dMagnetic2_loader_shared_descramble(tmp2,tmp2,sizeof(tmp2),0,NULL,0);
 			if ((tmp1[0]==0x49 || tmp1[2]==0x49) && (tmp1[1]==0xfa || tmp1[3]==0xfa))	// 0x49fa is ALWAYS the first instruction. run level encoded files start with a 2 byte header.
 			{
 				pEntries[i].fileType=TYPE_CODE1_ENCRYPTED;
@@ -303,7 +305,7 @@ void dMagnetic2_loader_c64_identifyEntries(unsigned char* d64image,tFileEntry* p
 		pEntries[i].offset+=sideoffsets[pEntries[i].side];
 		if (pEntries[i].fileType==TYPE_UNKNOWN)
 		{
-			dMagnetic2_loader_c64_readSector(&d64image[sideoffsets[pEntries[i].side]],pEntries[i].track,pEntries[i].sector,tmp1);
+			dMagnetic2_loader_c64_readSector(D64_DISK(d64images,sideoffsets[pEntries[i].side]),pEntries[i].track,pEntries[i].sector,tmp1);
 			if ((tmp1[0]==0x3d || tmp1[0]==0x3e) && tmp1[1]==0x82 && tmp1[2]==0x81) pEntries[i].fileType=TYPE_PICTURE;
 		}
 	}
@@ -329,7 +331,7 @@ void dMagnetic2_loader_c64_advanceSector(int *pTrack,int *pSector)
 
 
 // The "code" section of the game is broken into two parts on the C64: The first one is being kept in memory.
-int dMagnetic2_loader_c64_readCode1(unsigned char* d64image,tFileEntry *pEntries,int entryNum,unsigned char* pCode1Buf,int* pCode1Size)
+int dMagnetic2_loader_c64_readCode1(const unsigned char** d64images,tFileEntry *pEntries,int entryNum,unsigned char* pCode1Buf,int maxlen,int* pCode1Size)
 {
 	int i;
 	int j;
@@ -366,12 +368,12 @@ int dMagnetic2_loader_c64_readCode1(unsigned char* d64image,tFileEntry *pEntries
 	for (i=0;i<len;i++)
 	{
 		int start;
-		dMagnetic2_loader_c64_readSector(&d64image[offset],track,sect,tmp);
+		dMagnetic2_loader_c64_readSector(D64_DISK(d64images,offset),track,sect,tmp);
 		dMagnetic2_loader_c64_advanceSector(&track,&sect);
 		start=0;
 		if (encrypted)
 		{
-			dMagnetic2_loader_shared_descramble(tmp,tmp,i,NULL,0);	// the first part of the game is "encrypted"
+			dMagnetic2_loader_shared_descramble(tmp,tmp,sizeof(tmp),i,NULL,0);	// the first part of the game is "encrypted"
 		}
 		if (i==0)
 		{
@@ -389,10 +391,15 @@ int dMagnetic2_loader_c64_readCode1(unsigned char* d64image,tFileEntry *pEntries
 			if (rle==2)
 			{
 				int k;
-				for (k=0;k<tmp[j]-1;k++) pCode1Buf[outcnt++]=0;
+				for (k=0;k<tmp[j]-1;k++)
+				{
+					if (pCode1Buf!=NULL && outcnt<maxlen) pCode1Buf[outcnt]=0;
+					outcnt++;
+				}
 				rle=1;
 			} else {
-				pCode1Buf[outcnt++]=tmp[j];
+				if (pCode1Buf!=NULL && outcnt<maxlen) pCode1Buf[outcnt]=tmp[j];
+				outcnt++;
 			}
 			if (tmp[j]==0x00 && rle==1)
 			{
@@ -405,7 +412,7 @@ int dMagnetic2_loader_c64_readCode1(unsigned char* d64image,tFileEntry *pEntries
 }
 
 // The "code" section of the game is broken into two parts on the C64: The second one was "swapped in" when it was needed.
-int dMagnetic2_loader_c64_readCode2(unsigned char* d64image,tFileEntry *pEntries,int entryNum,unsigned char* pCode2Buf,int* pCode2Size)
+int dMagnetic2_loader_c64_readCode2(const unsigned char** d64images,tFileEntry *pEntries,int entryNum,unsigned char* pCode2Buf,int maxlen,int* pCode2Size)
 {
 	int i;
 	int j;
@@ -440,12 +447,13 @@ int dMagnetic2_loader_c64_readCode2(unsigned char* d64image,tFileEntry *pEntries
 	outcnt=0;
 	for (i=0;i<len;i++)
 	{
-		dMagnetic2_loader_c64_readSector(&d64image[offset],track,sect,tmp);
-		if (encrypted) dMagnetic2_loader_shared_descramble(tmp,tmp,i+scrambleoffs,NULL,0);
+		dMagnetic2_loader_c64_readSector(D64_DISK(d64images,offset),track,sect,tmp);
+		if (encrypted) dMagnetic2_loader_shared_descramble(tmp,tmp,sizeof(tmp),i+scrambleoffs,NULL,0);
 		dMagnetic2_loader_c64_advanceSector(&track,&sect);
 		for (j=0;j<256;j++)
 		{
-			pCode2Buf[outcnt++]=tmp[j];
+			if (pCode2Buf!=NULL && outcnt<maxlen) pCode2Buf[outcnt]=tmp[j];
+			outcnt++;
 		}
 	}
 	*pCode2Size=outcnt;
@@ -453,7 +461,7 @@ int dMagnetic2_loader_c64_readCode2(unsigned char* d64image,tFileEntry *pEntries
 }
 
 
-int dMagnetic2_loader_c64_readStrings(unsigned char* d64image,tFileEntry* pEntries,int entryNum,unsigned char* pStringBuf,int* string1size,int* string2size,int* dictsize)
+int dMagnetic2_loader_c64_readStrings(const unsigned char** d64images,tFileEntry* pEntries,int entryNum,unsigned char* pStringBuf,int maxlen,int* string1size,int* string2size,int* dictsize)
 {
 	int i;
 	int j;
@@ -489,12 +497,13 @@ int dMagnetic2_loader_c64_readStrings(unsigned char* d64image,tFileEntry* pEntri
 
 			for (j=0;j<len;j++)
 			{
-				dMagnetic2_loader_c64_readSector(&d64image[offset],track,sect,tmp);
-				if (encrypted) dMagnetic2_loader_shared_descramble(tmp,tmp,j,NULL,0);
+				dMagnetic2_loader_c64_readSector(D64_DISK(d64images,offset),track,sect,tmp);
+				if (encrypted) dMagnetic2_loader_shared_descramble(tmp,tmp,sizeof(tmp),j,NULL,0);
 				dMagnetic2_loader_c64_advanceSector(&track,&sect);
 				for (k=0;k<256;k++)
 				{
-					pStringBuf[outcnt++]=tmp[k];
+					if (pStringBuf!=NULL && outcnt<maxlen) pStringBuf[outcnt]=tmp[k];
+					outcnt++;
 				}
 				cnt[number]+=256;
 			}
@@ -512,87 +521,60 @@ int dMagnetic2_loader_c64_getsize(int *pBytes)
 	*pBytes=2*D64_IMAGESIZE+1;// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
 	return DMAGNETIC2_OK;
 }
+int dMagnetic2_loader_c64_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	return pSniff->present[0] && SNIFF_SIZE_IS(pSniff,0,D64_IMAGESIZE) && (!pSniff->present[1] || SNIFF_SIZE_IS(pSniff,1,D64_IMAGESIZE));
+}
 
-int dMagnetic2_loader_c64(
-		char* filename1,char* filename2,
-		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+int dMagnetic2_loader_c64_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc)
 {
 	int i;
-	int l;
-	unsigned char *d64image;
+	const unsigned char *d64images[2];
 	int sidecnt_is;
 	int sidecnt_expected;
 	int entryNum;
 	int retval;
 	tFileEntry entries[D64_MAXENTRIES];
-	FILE *f;
 	int code1size,code2size,string1size,string2size,dictsize;
 	const int *pPictureorder;
 
-
-	// check the important output buffers
-	if (tmpsize<2*D64_IMAGESIZE+1)	// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
-	{
-		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
-	}
-	if (pMeta==NULL || pTmpBuf==NULL)
+	if (pMeta==NULL)
 	{
 		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-
 	pMeta->game=DMAGNETIC2_GAME_NONE;
 	pMeta->source=DMAGNETIC2_SOURCE_NONE;
 	pMeta->version=-1;
 	pMeta->real_magsize=0;
 	pMeta->real_gfxsize=0;
 
-
-
-	d64image=(unsigned char*)&pTmpBuf[0];
-	if (filename1==NULL)
+	// in case there were more or less bytes in the file than the exact size of a .D64 image,
+	// it cannot be a .D64 file. So not a C64 game.
+	if (pImages[0].pData==NULL || pImages[0].len!=D64_IMAGESIZE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
+	d64images[0]=pImages[0].pData;
+	d64images[1]=pImages[0].pData;	// so that a stray offset on a single disk game stays inside of an image.
 	sidecnt_is=2;		// most games have two sides
-	// load the first image
-	{
-		f=fopen(filename1,"rb");
-		if (!f)
-		{
-			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-		}
-		l=fread(&d64image[0*D64_IMAGESIZE],sizeof(char),D64_IMAGESIZE+1,f);	// this is a trick to read the buffer AND to check if the filesize is correct
-		fclose(f);
-		if (l!=D64_IMAGESIZE)	// in case there were more or less bytes in the file than the exact size of a .D64 image,
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;	// it cannot be a .D64 file. So not a C64 game.
-		}
-	}
-
-	// load the second image
-	if (filename2==NULL)	
+	if (pImages[1].pData==NULL)
 	{
 		sidecnt_is=1;// Myth has actually just one disk image.
 	} else {
-		f=fopen(filename2,"rb");
-		if (!f)
+		if (pImages[1].len!=D64_IMAGESIZE)
 		{
-			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-		}
-		l=fread(&d64image[1*D64_IMAGESIZE],sizeof(char),D64_IMAGESIZE+1,f);	// this is a trick to read the buffer AND to check if the filesize is correct
-		fclose(f);
-		if (l!=D64_IMAGESIZE)	// in case there were more or less bytes in the file than the exact size of a .D64 image,
-		{
-			return DMAGNETIC2_UNKNOWN_SOURCE;	// it cannot be a .D64 file. So not a C64 game.
+			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
+		d64images[1]=pImages[1].pData;
 	}
 	// now the images are in memory. now we can parse them.
 	// first, find out which game it is
-	retval=dMagnetic2_loader_c64_detectgame(d64image,pMeta,&sidecnt_expected,&pPictureorder);
+	retval=dMagnetic2_loader_c64_detectgame(d64images[0],pMeta,&sidecnt_expected,&pPictureorder);
 	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
@@ -604,26 +586,37 @@ int dMagnetic2_loader_c64(
 	}
 
 	// then, find the entries in the file list
-	retval=dMagnetic2_loader_c64_readEntries(d64image,D64_IMAGESIZE,entries,&entryNum);
+	retval=dMagnetic2_loader_c64_readEntries(d64images[0],D64_IMAGESIZE,entries,&entryNum);
 	if (retval==DMAGNETIC2_UNKNOWN_SOURCE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 
-	dMagnetic2_loader_c64_identifyEntries(d64image,entries,entryNum,sidecnt_is);	// and figure out if they are code, pictures or something else
+	dMagnetic2_loader_c64_identifyEntries(d64images,entries,entryNum,sidecnt_is);	// and figure out if they are code, pictures or something else
 
 
-	if (pMagBuf!=NULL)
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	retval=DMAGNETIC2_OK;
 	{
-		int huffmantreeidx;
 		int magidx;
 		////////////////// LOAD THE MAG BUFFER /////////////////
 		magidx=42;	// leave some room for the header
-		dMagnetic2_loader_c64_readCode1(d64image,entries,entryNum,(unsigned char*)&pMagBuf[magidx],&code1size);
+		dMagnetic2_loader_c64_readCode1(d64images,entries,entryNum,OUTPUT_AT(pMagBuf,magidx),OUTPUT_ROOM(magidx,magcapacity),&code1size);
 		magidx+=code1size;
-		dMagnetic2_loader_c64_readCode2(d64image,entries,entryNum,(unsigned char*)&pMagBuf[magidx],&code2size);
+		dMagnetic2_loader_c64_readCode2(d64images,entries,entryNum,OUTPUT_AT(pMagBuf,magidx),OUTPUT_ROOM(magidx,magcapacity),&code2size);
 		magidx+=code2size;
-		dMagnetic2_loader_c64_readStrings(d64image,entries,entryNum,(unsigned char*)&pMagBuf[magidx],&string1size,&string2size,&dictsize);
+		dMagnetic2_loader_c64_readStrings(d64images,entries,entryNum,OUTPUT_AT(pMagBuf,magidx),OUTPUT_ROOM(magidx,magcapacity),&string1size,&string2size,&dictsize);
+		pMeta->real_magsize=magidx+string1size+string2size+dictsize;
+		if (pMagBuf!=NULL && pMeta->real_magsize>magcapacity)
+		{
+			retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
+	}
+	if (pMagBuf!=NULL && retval==DMAGNETIC2_OK)
+	{
+		int huffmantreeidx;
+		int magidx;
+		magidx=42+code1size+code2size;	// the strings start here
 		huffmantreeidx=0;
 
 		// within the string buffer, there is the beginning of the huffman tree
@@ -656,12 +649,9 @@ int dMagnetic2_loader_c64(
 			}
 		}
 		if (pMeta->game==DMAGNETIC2_GAME_MYTH && pMagBuf[0x3080]==0x66) pMagBuf[0x3080]=0x60;	// final touch
-
-		pMeta->real_magsize=magidx;
 		/////////// MAG IS FINISHED ////////////////////////////////
 	}
 
-	if (pGfxBuf!=NULL)
 	{
 		unsigned int picoffs[32]={0};
 		int side;
@@ -699,7 +689,10 @@ int dMagnetic2_loader_c64(
 				picoffs[piccnt]=gfxidx;
 				for (j=0;j<len && track<36;j++)
 				{
-					dMagnetic2_loader_c64_readSector(&d64image[offset],track,sector,(unsigned char*)&pGfxBuf[gfxidx]);
+					if (OUTPUT_FITS(pGfxBuf,gfxidx,D64_SECTORSIZE,gfxcapacity)!=NULL)
+					{
+						dMagnetic2_loader_c64_readSector(D64_DISK(d64images,offset),track,sector,(unsigned char*)&pGfxBuf[gfxidx]);
+					}
 					dMagnetic2_loader_c64_advanceSector(&track,&sector);
 					gfxidx+=D64_SECTORSIZE;
 				}
@@ -708,6 +701,14 @@ int dMagnetic2_loader_c64(
 		}
 
 		pMeta->real_gfxsize=gfxidx;
+		if (pGfxBuf==NULL)	// just the size
+		{
+			return retval;
+		}
+		if (gfxidx>gfxcapacity)
+		{
+			return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
 
 		gfxidx=0;
 		// now the buffer is complete. write the header.
@@ -725,7 +726,46 @@ int dMagnetic2_loader_c64(
 		pGfxBuf[4+4*32]=pMeta->version;
 		/////////// GFX is finished ///////////////
 	}
-	return DMAGNETIC2_OK;
+	return retval;
 }
 
+int dMagnetic2_loader_c64(
+		char* filename1,char* filename2,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int nodoc)
+{
+	tdMagnetic2_loader_image images[2];
+	int retval;
 
+	// check the important output buffers
+	if (tmpsize<2*D64_IMAGESIZE+1)	// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (pMeta==NULL || pTmpBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (filename1==NULL)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+
+	// map the images. the tmpbuf is only needed when that is not possible.
+	retval=dMagnetic2_loader_shared_openimage(&images[0],filename1,&pTmpBuf[0*D64_IMAGESIZE],D64_IMAGESIZE);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader_shared_openimage(&images[1],filename2,&pTmpBuf[1*D64_IMAGESIZE],D64_IMAGESIZE);
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_c64_images(images,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,nodoc);
+		dMagnetic2_loader_shared_closeimage(&images[1]);
+	}
+	dMagnetic2_loader_shared_closeimage(&images[0]);
+	return retval;
+}
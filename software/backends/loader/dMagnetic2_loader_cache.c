@@ -0,0 +1,377 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
+#include "dMagnetic2_loader_cache.h"
+#include "dMagnetic2_metrics_shared.h"
+
+// the purpose of this file is to remember the result of a conversion. the platform loaders
+// are decoding GCR tracks, descrambling and unhuffing the files every time. with the cache,
+// this is done once, and the following starts are just mapping the result.
+//
+// every entry is one file, named after the key. the key is a SHA-256 over the images: with a weaker hash,
+// a collision would silently load the wrong game. it is in the native format of the machine.
+//
+// @0   4 bytes "dM2C"
+// @4   4 bytes format version
+// @8   3x4 bytes the lengths of the input images (-1 when not given)
+// @20  4 bytes nodoc
+// @24  4 bytes game
+// @28  4 bytes source
+// @32  4 bytes version of the virtual machine
+// @36  4 bytes size of the .mag data
+// @40  4 bytes size of the .gfx data
+// @44  32 bytes the key
+// @76  the .mag data, followed by the .gfx data
+//
+// new entries are written under a temporary name and then renamed. so several processes can share
+// the same directory, and a reader never sees half an entry.
+
+#define	CACHE_MAGIC	0x43324d64	// "dM2C"
+#define	CACHE_VERSION	2		// increase this when a loader produces different output for the same images
+#define	CACHE_PATHLEN	1024
+
+typedef struct _tdMagnetic2_loader_cache_header
+{
+	unsigned int magic;
+	unsigned int version;
+	int imagelens[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int nodoc;
+	int game;
+	int source;
+	int vmversion;
+	int magsize;
+	int gfxsize;
+	unsigned char digest[DMAGNETIC2_LOADER_CACHE_DIGESTSIZE];
+} tdMagnetic2_loader_cache_header;
+
+// SHA-256, as in FIPS 180-4
+static const unsigned int dMagnetic2_loader_cache_k[64]={
+	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+#define	ROR32(x,n)	((((x)>>(n))|((x)<<(32-(n))))&0xffffffff)
+static void dMagnetic2_loader_cache_block(unsigned int* pState,const unsigned char* pBlock)
+{
+	unsigned int w[64];
+	unsigned int a,b,c,d,e,f,g,h;
+	unsigned int t1,t2;
+	int i;
+	for (i=0;i<16;i++)
+	{
+		w[i]=((unsigned int)pBlock[4*i+0]<<24)|((unsigned int)pBlock[4*i+1]<<16)|((unsigned int)pBlock[4*i+2]<<8)|((unsigned int)pBlock[4*i+3]);
+	}
+	for (i=16;i<64;i++)
+	{
+		t1=ROR32(w[i-2],17)^ROR32(w[i-2],19)^(w[i-2]>>10);
+		t2=ROR32(w[i-15],7)^ROR32(w[i-15],18)^(w[i-15]>>3);
+		w[i]=(t1+w[i-7]+t2+w[i-16])&0xffffffff;
+	}
+	a=pState[0];b=pState[1];c=pState[2];d=pState[3];
+	e=pState[4];f=pState[5];g=pState[6];h=pState[7];
+	for (i=0;i<64;i++)
+	{
+		t1=(h+(ROR32(e,6)^ROR32(e,11)^ROR32(e,25))+((e&f)^(~e&g))+dMagnetic2_loader_cache_k[i]+w[i])&0xffffffff;
+		t2=((ROR32(a,2)^ROR32(a,13)^ROR32(a,22))+((a&b)^(a&c)^(b&c)))&0xffffffff;
+		h=g;g=f;f=e;
+		e=(d+t1)&0xffffffff;
+		d=c;c=b;b=a;
+		a=(t1+t2)&0xffffffff;
+	}
+	pState[0]+=a;pState[1]+=b;pState[2]+=c;pState[3]+=d;
+	pState[4]+=e;pState[5]+=f;pState[6]+=g;pState[7]+=h;
+}
+static void dMagnetic2_loader_cache_hash(tdMagnetic2_loader_cache_key *pKey,const unsigned char* pData,int len)
+{
+	int n;
+	pKey->bytes+=len;
+	while (len>0)
+	{
+		if (pKey->fill==0 && len>=64)	// whole blocks straight from the image
+		{
+			dMagnetic2_loader_cache_block(pKey->state,pData);
+			pData+=64;
+			len-=64;
+		} else {
+			n=64-pKey->fill;
+			if (n>len)
+			{
+				n=len;
+			}
+			memcpy(&pKey->block[pKey->fill],pData,n);
+			pKey->fill+=n;
+			pData+=n;
+			len-=n;
+			if (pKey->fill==64)
+			{
+				dMagnetic2_loader_cache_block(pKey->state,pKey->block);
+				pKey->fill=0;
+			}
+		}
+	}
+}
+static void dMagnetic2_loader_cache_hashint(tdMagnetic2_loader_cache_key *pKey,int x)
+{
+	unsigned char tmp[4];
+	tmp[0]=((unsigned int)x>>24)&0xff;
+	tmp[1]=((unsigned int)x>>16)&0xff;
+	tmp[2]=((unsigned int)x>> 8)&0xff;
+	tmp[3]=((unsigned int)x>> 0)&0xff;
+	dMagnetic2_loader_cache_hash(pKey,tmp,4);
+}
+void dMagnetic2_loader_cache_key_start(tdMagnetic2_loader_cache_key *pKey,int nodoc)
+{
+	static const unsigned int init[8]={0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19};
+	memset(pKey,0,sizeof(tdMagnetic2_loader_cache_key));
+	memcpy(pKey->state,init,sizeof(init));
+	dMagnetic2_loader_cache_hashint(pKey,CACHE_VERSION);
+	dMagnetic2_loader_cache_hashint(pKey,(nodoc!=0));
+}
+void dMagnetic2_loader_cache_key_add(tdMagnetic2_loader_cache_key *pKey,tdMagnetic2_loader_image* pImage)
+{
+	// the lengths are part of the key, so that the same bytes split differently into the files do not collide
+	dMagnetic2_loader_cache_hashint(pKey,(pImage->pData==NULL)?-1:pImage->len);
+	if (pImage->pData!=NULL)
+	{
+		dMagnetic2_loader_cache_hash(pKey,pImage->pData,pImage->len);
+	}
+}
+void dMagnetic2_loader_cache_key_finish(tdMagnetic2_loader_cache_key *pKey)
+{
+	unsigned char pad[72];
+	unsigned long long bits;
+	int n;
+	int i;
+	bits=pKey->bytes*8;
+	n=(pKey->fill<56)?(56-pKey->fill):(120-pKey->fill);
+	memset(pad,0,sizeof(pad));
+	pad[0]=0x80;
+	for (i=0;i<8;i++)
+	{
+		pad[n+i]=(bits>>(56-8*i))&0xff;
+	}
+	dMagnetic2_loader_cache_hash(pKey,pad,n+8);
+	for (i=0;i<8;i++)
+	{
+		pKey->digest[4*i+0]=(pKey->state[i]>>24)&0xff;
+		pKey->digest[4*i+1]=(pKey->state[i]>>16)&0xff;
+		pKey->digest[4*i+2]=(pKey->state[i]>> 8)&0xff;
+		pKey->digest[4*i+3]=(pKey->state[i]>> 0)&0xff;
+	}
+}
+static int dMagnetic2_loader_cache_path(char* pPath,char* cachedir,tdMagnetic2_loader_cache_key *pKey,const char* suffix)
+{
+	char hex[2*DMAGNETIC2_LOADER_CACHE_DIGESTSIZE+1];
+	int i;
+	int n;
+	for (i=0;i<DMAGNETIC2_LOADER_CACHE_DIGESTSIZE;i++)
+	{
+		snprintf(&hex[2*i],3,"%02x",pKey->digest[i]);
+	}
+	n=snprintf(pPath,CACHE_PATHLEN,"%s/%s%s",cachedir,hex,suffix);
+	if (n<0 || n>=CACHE_PATHLEN)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	return DMAGNETIC2_OK;
+}
+static void dMagnetic2_loader_cache_fillheader(tdMagnetic2_loader_cache_header* pHeader,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc)
+{
+	memset(pHeader,0,sizeof(tdMagnetic2_loader_cache_header));
+	pHeader->magic=CACHE_MAGIC;
+	pHeader->version=CACHE_VERSION;
+	memcpy(pHeader->imagelens,pImagelens,sizeof(pHeader->imagelens));
+	pHeader->nodoc=(nodoc!=0);
+	memcpy(pHeader->digest,pKey->digest,sizeof(pHeader->digest));
+}
+int dMagnetic2_loader_cache_lookup(char* cachedir,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc,unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta)
+{
+	char path[CACHE_PATHLEN];
+	tdMagnetic2_loader_cache_header expected;
+	tdMagnetic2_loader_cache_header header;
+	struct stat st;
+	unsigned char* pMap;
+	int fd;
+	int retval;
+
+	if (cachedir==NULL || pKey==NULL || pImagelens==NULL || pMeta==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	retval=dMagnetic2_loader_cache_path(path,cachedir,pKey,".dm2c");
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	fd=open(path,O_RDONLY);
+	if (fd<0)
+	{
+		METRICS_ADD(dMagnetic2_loader_metrics.cache_misses,1);
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	if (fstat(fd,&st)!=0 || (size_t)st.st_size<sizeof(header))
+	{
+		close(fd);
+		METRICS_ADD(dMagnetic2_loader_metrics.cache_misses,1);
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	pMap=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if (pMap==MAP_FAILED)
+	{
+		METRICS_ADD(dMagnetic2_loader_metrics.cache_misses,1);
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	memcpy(&header,pMap,sizeof(header));
+	dMagnetic2_loader_cache_fillheader(&expected,pKey,pImagelens,nodoc);
+	// the entry has to be from this format, and for the same images. the name alone could have been copied around.
+	if (header.magic!=expected.magic || header.version!=expected.version || header.nodoc!=expected.nodoc
+		|| memcmp(header.imagelens,expected.imagelens,sizeof(expected.imagelens))!=0
+		|| memcmp(header.digest,expected.digest,sizeof(expected.digest))!=0
+		|| header.magsize<0 || header.magsize>DMAGNETIC2_MAX_MAGSIZE
+		|| header.gfxsize<0 || header.gfxsize>DMAGNETIC2_MAX_GFXSIZE
+		|| (size_t)st.st_size!=sizeof(header)+header.magsize+header.gfxsize)
+	{
+		munmap(pMap,st.st_size);
+		METRICS_ADD(dMagnetic2_loader_metrics.cache_misses,1);
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	retval=DMAGNETIC2_OK;
+	if ((pMagBuf!=NULL && header.magsize>magcapacity) || (pGfxBuf!=NULL && header.gfxsize>gfxcapacity))
+	{
+		pMagBuf=NULL;
+		pGfxBuf=NULL;
+		retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (header.magsize && pMagBuf!=NULL)
+	{
+		memcpy(pMagBuf,&pMap[sizeof(header)],header.magsize);
+	}
+	if (header.gfxsize && pGfxBuf!=NULL)
+	{
+		memcpy(pGfxBuf,&pMap[sizeof(header)+header.magsize],header.gfxsize);
+	}
+	munmap(pMap,st.st_size);
+	pMeta->game=(edMagnetic2_game)header.game;
+	pMeta->source=(edMagnetic2_source)header.source;
+	pMeta->version=header.vmversion;
+	pMeta->real_magsize=header.magsize;
+	pMeta->real_gfxsize=header.gfxsize;
+	METRICS_ADD(dMagnetic2_loader_metrics.cache_hits,1);
+	return retval;
+}
+static int dMagnetic2_loader_cache_write(int fd,const unsigned char* pData,int len)
+{
+	while (len>0)
+	{
+		ssize_t n;
+		n=write(fd,pData,len);
+		if (n<=0)
+		{
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+		pData+=n;
+		len-=n;
+	}
+	return DMAGNETIC2_OK;
+}
+int dMagnetic2_loader_cache_store(char* cachedir,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc,unsigned char* pMagBuf,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta)
+{
+	char path[CACHE_PATHLEN];
+	char tmppath[CACHE_PATHLEN];
+	tdMagnetic2_loader_cache_header header;
+	int fd;
+	int retval;
+
+	if (cachedir==NULL || pKey==NULL || pImagelens==NULL || pMeta==NULL || pMagBuf==NULL || pGfxBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (pMeta->real_magsize<0 || pMeta->real_magsize>DMAGNETIC2_MAX_MAGSIZE || pMeta->real_gfxsize<0 || pMeta->real_gfxsize>DMAGNETIC2_MAX_GFXSIZE)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	retval=dMagnetic2_loader_cache_path(path,cachedir,pKey,".dm2c");
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_cache_path(tmppath,cachedir,pKey,".XXXXXX");
+	}
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	dMagnetic2_loader_cache_fillheader(&header,pKey,pImagelens,nodoc);
+	header.game=pMeta->game;
+	header.source=pMeta->source;
+	header.vmversion=pMeta->version;
+	header.magsize=pMeta->real_magsize;
+	header.gfxsize=pMeta->real_gfxsize;
+
+	fd=mkstemp(tmppath);	// a unique name, also for other threads storing the same key
+	if (fd<0)
+	{
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	fchmod(fd,0644);
+	retval=dMagnetic2_loader_cache_write(fd,(const unsigned char*)&header,sizeof(header));
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_cache_write(fd,pMagBuf,header.magsize);
+	}
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_cache_write(fd,pGfxBuf,header.gfxsize);
+	}
+	if (close(fd)!=0 && retval==DMAGNETIC2_OK)
+	{
+		retval=DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	if (retval==DMAGNETIC2_OK && rename(tmppath,path)!=0)
+	{
+		retval=DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	if (retval!=DMAGNETIC2_OK)
+	{
+		unlink(tmppath);
+	}
+	return retval;
+}
@@ -0,0 +1,55 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef	DMAGNETIC2_LOADER_CACHE_H
+#define	DMAGNETIC2_LOADER_CACHE_H
+
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
+
+// the converted .mag and .gfx files are kept in a directory, one file per set of input images.
+// the key is a SHA-256 over the contents of the images, so renamed or moved images are found again.
+// the images are added one after the other, all three slots in their order. so only one of them has to be in memory at a time.
+#define	DMAGNETIC2_LOADER_CACHE_DIGESTSIZE	32
+typedef struct _tdMagnetic2_loader_cache_key
+{
+	unsigned int state[8];
+	unsigned long long bytes;
+	int fill;
+	unsigned char block[64];
+	unsigned char digest[DMAGNETIC2_LOADER_CACHE_DIGESTSIZE];
+} tdMagnetic2_loader_cache_key;
+void dMagnetic2_loader_cache_key_start(tdMagnetic2_loader_cache_key *pKey,int nodoc);
+void dMagnetic2_loader_cache_key_add(tdMagnetic2_loader_cache_key *pKey,tdMagnetic2_loader_image* pImage);
+void dMagnetic2_loader_cache_key_finish(tdMagnetic2_loader_cache_key *pKey);
+// the lengths of the three images are stored with the entry, -1 for a missing one.
+// DMAGNETIC2_OK on a hit, DMAGNETIC2_UNKNOWN_SOURCE on a miss. a hit which does not fit into the buffers
+// writes neither of them, reports the sizes and returns DMAGNETIC2_ERROR_BUFFER_TOO_SMALL.
+int dMagnetic2_loader_cache_lookup(char* cachedir,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc,unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta);
+// both output buffers have to be there. an entry from a probe would lack the data.
+int dMagnetic2_loader_cache_store(char* cachedir,tdMagnetic2_loader_cache_key *pKey,int* pImagelens,int nodoc,unsigned char* pMagBuf,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta);
+
+#endif
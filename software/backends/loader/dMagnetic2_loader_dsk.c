@@ -39,6 +39,7 @@
 
 #define	DSK_MIN_IMAGESIZE	194816	// disksize without any extended meta data
 #define	DSK_MAX_IMAGESIZE	195635	// TODO: check	
+#define	TODOSIZE	65536		// Some files are packed and need to be unhuffed. They are being loaded into the tmpbuffer
 
 #define	MAXFILENAMELEN	(8+1)	// filenames in CPM are 8 bytes long
 #define	EXTENDLEN	4	// extension is 4 bytes long
@@ -46,7 +47,6 @@
 
 #define	MAXBLOCKSIZE	1024	// one pointer is pointing towards 1 kByte
 #define	MINSECTORSIZE	128	// the smallest number of bytes in a sector
-#define	MAXOFFSETSPERENTRY	((MAXBLOCKSIZE/MINSECTORSIZE)*MAXBLOCKS)
 
 #define	SIZE_FILEHEADER	256
 #define	SIZE_TRACKHEADER	256
@@ -81,16 +81,18 @@ typedef struct _tDirEntry
 	unsigned char blocks[MAXBLOCKS];// block identifier
 
 	int fileID;		// the "filename" without the prefix.
-	int offsetscnt;
-	int offsets[MAXOFFSETSPERENTRY];	// translated offsets
 } tDirEntry;
 
+// the sector map is being built in one pass over the track headers: the sectors are numbered in the order
+// track, side and sector id. the blocks from the directory are being resolved through it when a file is read.
 typedef struct _tNewDskInfo
 {
-	int baseoffset;		// actually the offset inside the disk image in memory
 	int sectorsize;
 	int size;
-	int offsets[MAX_SECTORNUMPERDISK];
+	int sectorcnt;
+	int offsets[MAX_SECTORNUMPERDISK];	// the offsets of the sectors within this disk image
+	int directorysector;	// the first sector of the directory. the blocks are counted from here
+	int sectorsperblock;
 
 	int entrycnt;
 	tDirEntry direntries[MAX_DIRENTRIES];
@@ -147,7 +149,9 @@ const tGames dMagnetic2_loader_dsk_knownGames[NUM_GAMES]={
 	}
 };
 
-int dMagnetic2_loader_dsk_readfile(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int fileID,unsigned char* pOutput)
+// reads all the blocks of a file, from all the disks. the sectors which follow each other in the image are being copied at once.
+// without an output buffer, the bytes are only being counted. so are the bytes beyond maxlen.
+int dMagnetic2_loader_dsk_readfile(const unsigned char** pImages,tNewDskInfo* pDskInfo,int fileID,unsigned char* pOutput,int maxlen)
 {
 	int i;
 	int outputidx;
@@ -157,7 +161,13 @@ int dMagnetic2_loader_dsk_readfile(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,
 	{
 		int j;
 		int sectorsize;
+		int n;
+		int runoffs;
+		int runlen;
 		sectorsize=pDskInfo[i].sectorsize;
+		n=pDskInfo[i].sectorsperblock;
+		runoffs=0;
+		runlen=0;
 		for (j=0;j<pDskInfo[i].entrycnt;j++)	// in all the directories
 		{
 			tDirEntry *pDir;
@@ -165,23 +175,51 @@ int dMagnetic2_loader_dsk_readfile(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,
 			if (pDir->fileID==fileID)	// for the matching fileid
 			{
 				int k;
-				for (k=0;k<pDir->offsetscnt;k++)	// copy all the sectors from this entry
+				for (k=0;k<MAXBLOCKS;k++)	// copy all the sectors from this entry
 				{
-					int offset;
-					offset=pDir->offsets[k];
-					if (offset!=-1)		// only copy the valid ones
+					int m;
+					if (pDir->blocks[k]==0)	// only copy the valid ones
 					{
-						memcpy(&pOutput[outputidx],&pTmpBuf[offset],sectorsize);
-						outputidx+=sectorsize;
+						continue;
+					}
+					for (m=0;m<n;m++)
+					{
+						int sector;
+						int offset;
+						sector=pDir->blocks[k]*n+m+pDskInfo[i].directorysector;
+						if (sector>=pDskInfo[i].sectorcnt)	// not on this disk
+						{
+							continue;
+						}
+						offset=pDskInfo[i].offsets[sector];
+						if (runlen==0 || offset!=runoffs+runlen)
+						{
+							if (runlen && pOutput!=NULL && outputidx<maxlen)
+							{
+								memcpy(&pOutput[outputidx],&pImages[i][runoffs],(outputidx+runlen<=maxlen)?runlen:(maxlen-outputidx));
+							}
+							if (runlen)
+							{
+								outputidx+=runlen;
+							}
+							runoffs=offset;
+							runlen=0;
+						}
+						runlen+=sectorsize;
 					}
 				}
 			}
 		}
+		if (runlen && pOutput!=NULL && outputidx<maxlen)
+		{
+			memcpy(&pOutput[outputidx],&pImages[i][runoffs],(outputidx+runlen<=maxlen)?runlen:(maxlen-outputidx));
+		}
+		outputidx+=runlen;
 	}
 	return outputidx;
 }
 
-int dMagnetic2_loader_dsk_spectrum_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pMagBuf,tdMagnetic2_game_meta *pMeta,int nodoc)
+int dMagnetic2_loader_dsk_spectrum_mag(const unsigned char** pImages,unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pMagBuf,int magcapacity,tdMagnetic2_game_meta *pMeta,int nodoc)
 {
 	int outputidx;
 	int version;
@@ -198,17 +236,17 @@ int dMagnetic2_loader_dsk_spectrum_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskI
 	version=dMagnetic2_loader_dsk_knownGames[gameidx].version;
 
 	// start with the code in FILE1, which is huffman encoded
-	size_code=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX1,pTmpPtr);
-	if (size_code==0)
+	size_code=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX1,pTmpPtr,TODOSIZE);
+	if (size_code==0 || size_code>TODOSIZE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
-	size_code=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_code,&pMagBuf[outputidx]);
+	size_code=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_code,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	outputidx+=size_code;
 	
 
 	// the string1 section is in FILE3
-	size_string1=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX3,&pMagBuf[outputidx]);
+	size_string1=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX3,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	if (size_string1==0)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
@@ -216,22 +254,31 @@ int dMagnetic2_loader_dsk_spectrum_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskI
 	outputidx+=size_string1;
 
 	// the string2 section is in FILE2, hufmanned
-	size_string2=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX2,pTmpPtr);
-	if (size_string2==0)
+	size_string2=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX2,pTmpPtr,TODOSIZE);
+	if (size_string2==0 || size_string2>TODOSIZE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
-	size_string2=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_string2,&pMagBuf[outputidx]);
+	size_string2=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_string2,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	outputidx+=size_string2;
 
 	// the dict section is in FILE4, hufmanned
-	size_dict=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX4,pTmpPtr);
-	if (size_dict==0)
+	size_dict=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX4,pTmpPtr,TODOSIZE);
+	if (size_dict==0 || size_dict>TODOSIZE)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
-	size_dict=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_dict,&pMagBuf[outputidx]);
+	size_dict=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_dict,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	outputidx+=size_dict;
+	pMeta->real_magsize=outputidx;
+	if (pMagBuf==NULL)	// only the size was requested
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (outputidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 
 	if (nodoc)
 	{
@@ -244,14 +291,13 @@ int dMagnetic2_loader_dsk_spectrum_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskI
 		}
 	}
 	if (version==3 && pMagBuf[0x2836]==0x66) pMagBuf[0x2836]=0x60;	// final patch for myth
-	pMeta->real_magsize=outputidx;
 
 	retval=dMagnetic2_loader_shared_addmagheader(pMagBuf,outputidx,version,size_code,size_string1,size_string2,size_dict,-1);
 	return retval;
 }
 
 
-int dMagnetic2_loader_dsk_amstrad_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pMagBuf,tdMagnetic2_game_meta *pMeta,int nodoc)
+int dMagnetic2_loader_dsk_amstrad_mag(const unsigned char** pImages,unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pMagBuf,int magcapacity,tdMagnetic2_game_meta *pMeta,int nodoc)
 {
 	int outputidx;
 	int size_code1;
@@ -270,12 +316,12 @@ int dMagnetic2_loader_dsk_amstrad_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 	if (game==DMAGNETIC2_GAME_PAWN)
 	{
 		// in THE PAWN, the code section is packed	
-		size_code1=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX1,pTmpPtr);
-		if (size_code1==0)
+		size_code1=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX1,pTmpPtr,TODOSIZE);
+		if (size_code1==0 || size_code1>TODOSIZE)
 		{
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
-		size_code1=dMagnetic2_loader_shared_unhuffer(pTmpBuf,size_code1,&pMagBuf[outputidx]);
+		size_code1=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_code1,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 		outputidx+=size_code1;
 		size_code2=0;
 	} else {
@@ -283,39 +329,51 @@ int dMagnetic2_loader_dsk_amstrad_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 #define	MAGIC_INCREMENT		0x29
 		int i;
 		// in other games, it is spread out over two files: FILE1 and FILE6
-		size_code1=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX1,&pMagBuf[outputidx]);
-		retval=dMagnetic2_loader_shared_prbs_descrambler(&pMagBuf[outputidx],size_code1,MAGIC_STARTVALUE,MAGIC_INCREMENT);	// the first part is PRBS scrambled different than the second one
+		size_code1=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX1,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
+		if (OUTPUT_FITS(pMagBuf,outputidx,size_code1,magcapacity)!=NULL)
+		{
+			retval=dMagnetic2_loader_shared_prbs_descrambler(&pMagBuf[outputidx],size_code1,MAGIC_STARTVALUE,MAGIC_INCREMENT);	// the first part is PRBS scrambled different than the second one
+		}
 		outputidx+=size_code1;
 
 
-		size_code2=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX6,&pMagBuf[outputidx]);
+		size_code2=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX6,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 		// in the second part, each 128 byte block has its own start value
-		for (i=0;i<size_code2;i+=128)
+		for (i=0;i<size_code2 && OUTPUT_FITS(pMagBuf,outputidx+i,128,magcapacity)!=NULL;i+=128)
 		{
 			retval=dMagnetic2_loader_shared_prbs_descrambler(&pMagBuf[outputidx+i],128,size_code1+i,MAGIC_INCREMENT);
 		}
 	}
 	outputidx+=size_code2;
 	
-	size_string1=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX3,&pMagBuf[outputidx]);
+	size_string1=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX3,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	outputidx+=size_string1;
 	if (game==DMAGNETIC2_GAME_PAWN)
 	{
 		// in THE PAWN, the string2 section is packed
-		size_string2=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX2,pTmpPtr);
-		if (size_string2==0)
+		size_string2=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX2,pTmpPtr,TODOSIZE);
+		if (size_string2==0 || size_string2>TODOSIZE)
 		{
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
-		size_string2=dMagnetic2_loader_shared_unhuffer(pTmpBuf,size_string2,&pMagBuf[outputidx]);
+		size_string2=dMagnetic2_loader_shared_unhuffer(pTmpPtr,size_string2,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	} else {
-		size_string2=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX2,&pMagBuf[outputidx]);
+		size_string2=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX2,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	}
 	outputidx+=size_string2;
 	// some games have a file with the suffix 8, and this is for the dict.
-	size_dict=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX8,&pMagBuf[outputidx]);
-	retval=dMagnetic2_loader_shared_prbs_descrambler(&pMagBuf[outputidx],size_dict,MAGIC_STARTVALUE,MAGIC_INCREMENT);
+	size_dict=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX8,OUTPUT_AT(pMagBuf,outputidx),OUTPUT_ROOM(outputidx,magcapacity));
 	outputidx+=size_dict;
+	pMeta->real_magsize=outputidx;
+	if (pMagBuf==NULL)	// only the size was requested
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (outputidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	retval=dMagnetic2_loader_shared_prbs_descrambler(&pMagBuf[outputidx-size_dict],size_dict,MAGIC_STARTVALUE,MAGIC_INCREMENT);
 	if (nodoc)
 	{
 		int i;
@@ -326,12 +384,11 @@ int dMagnetic2_loader_dsk_amstrad_mag(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 			if (ptr[i+0]==0xa4 && ptr[i+1]==0x06 && ptr[i+2]==0xaa && ptr[i+3]==0xdf) {ptr[i+0]=0x4e;ptr[i+1]=0x71;}
 		}
 	}
-	pMeta->real_magsize=outputidx;
 
 	retval=dMagnetic2_loader_shared_addmagheader(pMagBuf,outputidx,dMagnetic2_loader_dsk_knownGames[gameidx].version,size_code1+size_code2,size_string1,size_string2,size_dict,-1);
 	return retval;
 }
-int dMagnetic2_loader_dsk_amstrad_gfx(unsigned char* pTmpBuf,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta)
+int dMagnetic2_loader_dsk_amstrad_gfx(const unsigned char** pImages,tNewDskInfo* pDskInfo,int gameidx,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta)
 {
 	int i;
 	int outputidx;
@@ -340,6 +397,24 @@ int dMagnetic2_loader_dsk_amstrad_gfx(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 
 
 	game=dMagnetic2_loader_dsk_knownGames[gameidx].game; 
+	// the size first: the header, the index and the pictures
+	if (game==DMAGNETIC2_GAME_PAWN)
+	{
+		outputidx=4+2+dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX4,NULL,0);
+	} else {
+		outputidx=4+4*32;
+		outputidx+=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX5,NULL,0);
+		outputidx+=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX7,NULL,0);
+	}
+	pMeta->real_gfxsize=outputidx;
+	if (pGfxBuf==NULL)	// only the size was requested
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (outputidx>gfxcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 	outputidx=0;
 
 	// this time, start with the header. MaP6
@@ -356,7 +431,7 @@ int dMagnetic2_loader_dsk_amstrad_gfx(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 		// since it is not 32 bit aligned, add 2 extra bytes.
 		pGfxBuf[outputidx]='0';	outputidx+=1;
 		pGfxBuf[outputidx]='0';	outputidx+=1;
-		outputidx+=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX4,&pGfxBuf[outputidx]); 
+		outputidx+=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX4,&pGfxBuf[outputidx],gfxcapacity-outputidx); 
 		// the beginning of the amstrad CPC image file starts with an index
 		// this could be used directly, but now the header has to be taken into account.
 		for (i=0;i<29;i++)	// go over the index for all 29 images
@@ -371,13 +446,13 @@ int dMagnetic2_loader_dsk_amstrad_gfx(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 		int idxoffs;
 		int outputidx1;
 		// TODO: check if more than 0 bytes have been read
-		dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX4,&pGfxBuf[outputidx]); 	// the index is in this file
+		dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX4,&pGfxBuf[outputidx],4*32); 	// the index is in this file
 		outputidx=4+4*32;		// leave room for the header and the index
 
 		outputidx0=outputidx;	
-		outputidx+=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX5,&pGfxBuf[outputidx]); 	// some pictures in this file
+		outputidx+=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX5,&pGfxBuf[outputidx],gfxcapacity-outputidx); 	// some pictures in this file
 		outputidx1=outputidx;	
-		outputidx+=dMagnetic2_loader_dsk_readfile(pTmpBuf,pDskInfo,FILESUFFIX7,&pGfxBuf[outputidx]); 	// some pictures in that file
+		outputidx+=dMagnetic2_loader_dsk_readfile(pImages,pDskInfo,FILESUFFIX7,&pGfxBuf[outputidx],gfxcapacity-outputidx); 	// some pictures in that file
 		idxoffs=4;
 
 		for (i=0;i<32;i++)	// loop over the whole index
@@ -411,7 +486,7 @@ int dMagnetic2_loader_dsk_amstrad_gfx(unsigned char* pTmpBuf,tNewDskInfo* pDskIn
 
 
 ///////////////////////////////
-int dMagnetic2_loader_dsk_find_sector_offsets(unsigned char* pImage,tNewDskInfo* pDskInfo)
+int dMagnetic2_loader_dsk_find_sector_offsets(const unsigned char* pImage,tNewDskInfo* pDskInfo)
 {
 	int i;
 	int tracknum;
@@ -452,10 +527,18 @@ int dMagnetic2_loader_dsk_find_sector_offsets(unsigned char* pImage,tNewDskInfo*
 		idx0=idx;	
 		if (extendedornot)
 		{
+			if (0x34+i>=SIZE_FILEHEADER)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;	// the track size table is in the file header
+			}
 			tracksize=pImage[0x34+i]*256;		// FIXME: or is this correct?
 		}
 		if (tracksize)
 		{
+			if (idx0+SIZE_TRACKHEADER>pDskInfo->size)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;	// the track would be outside of the image
+			}
 			int track0;
 			int side0;
 			int sectorsize;
@@ -495,6 +578,10 @@ int dMagnetic2_loader_dsk_find_sector_offsets(unsigned char* pImage,tNewDskInfo*
 			{
 				return DMAGNETIC2_UNKNOWN_SOURCE;	// sanity check failed
 			}
+			if (idx+sectornum*SIZE_SECTORHEADER>pDskInfo->size)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;	// the sector headers would be outside of the image
+			}
 			/// this concludes the track header. now come the sector header(s)
 			for (j=0;j<sectornum;j++)
 			{
@@ -532,17 +619,24 @@ int dMagnetic2_loader_dsk_find_sector_offsets(unsigned char* pImage,tNewDskInfo*
 			}
 			for (j=0;j<sectornum;j++)
 			{
-				pDskInfo->offsets[sectorcnt]=idx0+pDskInfo->baseoffset+SIZE_TRACKHEADER+order[j]*sectorsize;
+				int offset;
+				offset=idx0+SIZE_TRACKHEADER+order[j]*sectorsize;
+				if (sectorcnt>=MAX_SECTORNUMPERDISK || offset+sectorsize>pDskInfo->size)
+				{
+					return DMAGNETIC2_UNKNOWN_SOURCE;	// the sectors are being read from the image directly. they have to be inside of it.
+				}
+				pDskInfo->offsets[sectorcnt]=offset;
 				sectorcnt++;
 			}
 			idx=idx0+tracksize;	// advance to the next track
 		}
 
 	}
+	pDskInfo->sectorcnt=sectorcnt;
 	return DMAGNETIC2_OK;
 }
 
-int dMagnetic2_loader_dsk_directory_new(unsigned char* pImage,tNewDskInfo* pDskInfo,int amstrad0spectrum1,int *pGameidx)
+int dMagnetic2_loader_dsk_directory_new(const unsigned char* pImage,tNewDskInfo* pDskInfo,int amstrad0spectrum1,int *pGameidx)
 {
 	int directorysector;
 	int blocksize;
@@ -602,10 +696,16 @@ int dMagnetic2_loader_dsk_directory_new(unsigned char* pImage,tNewDskInfo* pDskI
 	}
 
 	pDskInfo->entrycnt=0;
+	pDskInfo->directorysector=directorysector;
+	pDskInfo->sectorsperblock=blocksize/pDskInfo->sectorsize;	// one "block" from the directory entry contains n sectors
 	// at this point, the location of the directory is known. it can be read.
 	for (i=0;i<(blocksize/pDskInfo->sectorsize)*2;i++)
 	{	
 		int j;
+		if (directorysector+i>=pDskInfo->sectorcnt)
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
 		
 		for (j=0;j<pDskInfo->sectorsize;j+=SIZE_DIRENTRY)
 		{
@@ -614,7 +714,7 @@ int dMagnetic2_loader_dsk_directory_new(unsigned char* pImage,tNewDskInfo* pDskI
 			tDirEntry *pDir;
 
 			validfilename=0;
-			idx=pDskInfo->offsets[directorysector+i]+j-pDskInfo->baseoffset;
+			idx=pDskInfo->offsets[directorysector+i]+j;
 			pDir=&pDskInfo->direntries[pDskInfo->entrycnt];
 			pDir->userID=pImage[idx];
 			if (pDir->userID<=15)		// entry is a filename/pointer
@@ -656,28 +756,6 @@ int dMagnetic2_loader_dsk_directory_new(unsigned char* pImage,tNewDskInfo* pDskI
 				}
 				if (validfilename)	// when the name matches the game
 				{
-					int n;
-					// one "block" from the directory entry contains n sectors
-					n=blocksize/pDskInfo->sectorsize;
-					pDir->offsetscnt=MAXBLOCKS*n;
-					for (k=0;k<MAXBLOCKS;k++)
-					{
-						int m;
-						if (pDir->blocks[k]==0)
-						{
-							for (m=0;m<n;m++)
-							{
-								pDir->offsets[k*n+m]=-1;		// mark as invalid
-							}
-						} else {
-							for (m=0;m<n;m++)
-							{
-								int sector;
-								sector=pDir->blocks[k]*n+m+directorysector;
-								pDir->offsets[k*n+m]=pDskInfo->offsets[sector];		// calculate the "real" offset
-							}
-						}							
-					}
 					pDskInfo->entrycnt++;	// only count the filenames which are part of the game
 				}
 			}
@@ -689,7 +767,6 @@ int dMagnetic2_loader_dsk_directory_new(unsigned char* pImage,tNewDskInfo* pDskI
 	}
 	return DMAGNETIC2_OK;	
 }
-#define	TODOSIZE	65536		// Some files are packed and need to be unhuffed. They are being loaded into the tmpbuffer
 
 int dMagnetic2_loader_dsk_getsize(int *pBytes)
 {
@@ -697,34 +774,50 @@ int dMagnetic2_loader_dsk_getsize(int *pBytes)
 	*pBytes=2*DSK_MAX_IMAGESIZE+TODOSIZE;// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
 	return DMAGNETIC2_OK;
 }
+// the images start with "MV - CPC" or "EXTENDED", and their size varies a little.
+int dMagnetic2_loader_dsk_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	int i;
+	if (!pSniff->present[0])
+	{
+		return 0;
+	}
+	for (i=0;i<2;i++)
+	{
+		if (pSniff->present[i])
+		{
+			if (pSniff->size[i]>=0 && (pSniff->size[i]<DSK_MIN_IMAGESIZE || pSniff->size[i]>DSK_MAX_IMAGESIZE))
+			{
+				return 0;
+			}
+			if (!SNIFF_HEADER_IS(pSniff,i,"M",1) && !SNIFF_HEADER_IS(pSniff,i,"E",1))
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
 
 
-int dMagnetic2_loader_dsk(
-		char* filename1,char* filename2,
+int dMagnetic2_loader_dsk_images(
+		tdMagnetic2_loader_image* pImages,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int amstrad0spectrum1,
 		int nodoc)
 {
-
-// TODO: find out, if the disk images come in in the correct order (is it important??)
-// TODO: autodetection, if amstrad or spectrum
 	int i;
-	int n;
 	int retval;
 	int diskcnt;
 	int gameidx;
+	const unsigned char* pDisks[MAX_DISKS]={NULL};
 	tNewDskInfo	dskInfo[MAX_DISKS];
-	
-	FILE *f;
-
-
-	memset(dskInfo,0,sizeof(tNewDskInfo));
-
-	// check the important output buffers
-	if (tmpsize<2*DSK_MAX_IMAGESIZE+TODOSIZE)	// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
+	memset(dskInfo,0,sizeof(dskInfo));
+	// the packed files are being unpacked in the tmp buffer, behind the part which holds images that could not be mapped
+	if (tmpsize<2*DSK_MAX_IMAGESIZE+TODOSIZE)
 	{
 		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
 	}
@@ -732,104 +825,109 @@ int dMagnetic2_loader_dsk(
 	{
 		return DMAGNETIC2_ERROR_NULLPTR;
 	}
-
 	pMeta->game=DMAGNETIC2_GAME_NONE;
 	pMeta->source=DMAGNETIC2_SOURCE_NONE;
 	pMeta->version=-1;
 	pMeta->real_magsize=0;
 	pMeta->real_gfxsize=0;
 	diskcnt=0;
-
-	if (filename1==NULL)
+	gameidx=-1;
+	for (i=0;i<MAX_DISKS;i++)
 	{
-		return DMAGNETIC2_UNKNOWN_SOURCE;
-	}
-	f=fopen(filename1,"rb");
-	if (f==NULL)
-	{
-		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-	}
-	n=fread(&pTmpBuf[0],sizeof(char),DSK_MAX_IMAGESIZE+1,f);
-	fclose(f);
-	dskInfo[diskcnt].size=n;	
-	dskInfo[diskcnt].baseoffset=0;
-	dskInfo[diskcnt].size=n;
-	diskcnt++;
-	if (n>DSK_MAX_IMAGESIZE || n<DSK_MIN_IMAGESIZE)
-	{
-		return DMAGNETIC2_UNKNOWN_SOURCE;
-	}
-	if (filename2!=NULL)
-	{
-		f=fopen(filename2,"rb");
-		if (f==NULL)
-		{
-			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
-		}
-		n=fread(&pTmpBuf[DSK_MAX_IMAGESIZE],sizeof(char),DSK_MAX_IMAGESIZE+1,f);
-		fclose(f);
-		dskInfo[diskcnt].size=n;
-		dskInfo[diskcnt].baseoffset=DSK_MAX_IMAGESIZE;
-		dskInfo[diskcnt].size=n;
-		diskcnt++;
-		if (n>DSK_MAX_IMAGESIZE || n<DSK_MIN_IMAGESIZE)
+		if (pImages[i].pData!=NULL)
 		{
+			if (pImages[i].len>DSK_MAX_IMAGESIZE || pImages[i].len<DSK_MIN_IMAGESIZE)
+			{
+				return DMAGNETIC2_UNKNOWN_SOURCE;
+			}
+			pDisks[diskcnt]=pImages[i].pData;
+			dskInfo[diskcnt].size=pImages[i].len;
+			diskcnt++;
+		} else if (i==0) {
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
 	}
 	// at this point, either one or both of the image files are in memory
 	for (i=0;i<diskcnt;i++)
 	{
-		retval=dMagnetic2_loader_dsk_find_sector_offsets(&pTmpBuf[i*DSK_MAX_IMAGESIZE],&dskInfo[i]);
+		retval=dMagnetic2_loader_dsk_find_sector_offsets(pDisks[i],&dskInfo[i]);
 		if (retval!=DMAGNETIC2_OK)
 		{
 			return retval;
 		}
-
-		retval=dMagnetic2_loader_dsk_directory_new(&pTmpBuf[i*DSK_MAX_IMAGESIZE],&dskInfo[i],amstrad0spectrum1,&gameidx);
+		retval=dMagnetic2_loader_dsk_directory_new(pDisks[i],&dskInfo[i],amstrad0spectrum1,&gameidx);
 		if (retval!=DMAGNETIC2_OK)
 		{
 			return retval;
 		}
 	}
-
 	if (gameidx<0 || gameidx>=NUM_GAMES)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
-
 	pMeta->game=dMagnetic2_loader_dsk_knownGames[gameidx].game;		// TODO: Myth/Fish detection
 	pMeta->version=dMagnetic2_loader_dsk_knownGames[gameidx].version;
 	pMeta->source=amstrad0spectrum1?DMAGNETIC2_SOURCE_SPECTRUM:DMAGNETIC2_SOURCE_AMSTRAD_CPC;
-	if (pMagBuf!=NULL)
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	if (amstrad0spectrum1)
 	{
-		if (amstrad0spectrum1)
-		{
-			retval=dMagnetic2_loader_dsk_spectrum_mag(pTmpBuf,dskInfo,gameidx,pMagBuf,pMeta,nodoc);
-		} else {
-			retval=dMagnetic2_loader_dsk_amstrad_mag(pTmpBuf,dskInfo,gameidx,pMagBuf,pMeta,nodoc);
-		}
-		if (retval!=DMAGNETIC2_OK)
-		{
-			return retval;
-		}
+		retval=dMagnetic2_loader_dsk_spectrum_mag(pDisks,pTmpBuf,dskInfo,gameidx,pMagBuf,magcapacity,pMeta,nodoc);
+	} else {
+		retval=dMagnetic2_loader_dsk_amstrad_mag(pDisks,pTmpBuf,dskInfo,gameidx,pMagBuf,magcapacity,pMeta,nodoc);
 	}
-	if (pGfxBuf!=NULL)
+	if (retval!=DMAGNETIC2_OK && retval!=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL)
 	{
-		if (amstrad0spectrum1)
-		{
-			retval=DMAGNETIC2_OK;		// no pictures. sorry!
-		} else {
-			retval=dMagnetic2_loader_dsk_amstrad_gfx(pTmpBuf,dskInfo,gameidx,pGfxBuf,pMeta);
-
-		}
-		if (retval!=DMAGNETIC2_OK)
+		return retval;
+	}
+	if (!amstrad0spectrum1)		// no pictures on the spectrum. sorry!
+	{
+		int gfxretval;
+		gfxretval=dMagnetic2_loader_dsk_amstrad_gfx(pDisks,dskInfo,gameidx,pGfxBuf,gfxcapacity,pMeta);
+		if (retval==DMAGNETIC2_OK)
 		{
-			return retval;
+			retval=gfxretval;
 		}
 	}
-	
-
-	return DMAGNETIC2_OK;
+	return retval;
+}
+int dMagnetic2_loader_dsk(
+		char* filename1,char* filename2,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int amstrad0spectrum1,
+		int nodoc)
+{
+// TODO: find out, if the disk images come in in the correct order (is it important??)
+// TODO: autodetection, if amstrad or spectrum
+	tdMagnetic2_loader_image images[MAX_DISKS];
+	int retval;
+	// check the important output buffers
+	if (tmpsize<2*DSK_MAX_IMAGESIZE+TODOSIZE)	// should be large enough for two disk images. and a spare byte for a trick to determine the correct file size
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (pMeta==NULL || pTmpBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	if (filename1==NULL)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	// map the images. the tmpbuf is only needed when that is not possible.
+	retval=dMagnetic2_loader_shared_openimage(&images[0],filename1,&pTmpBuf[0],DSK_MAX_IMAGESIZE);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
+	retval=dMagnetic2_loader_shared_openimage(&images[1],filename2,&pTmpBuf[DSK_MAX_IMAGESIZE],DSK_MAX_IMAGESIZE);
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_loader_dsk_images(images,pTmpBuf,tmpsize,pMagBuf,magcapacity,pGfxBuf,gfxcapacity,pMeta,amstrad0spectrum1,nodoc);
+		dMagnetic2_loader_shared_closeimage(&images[1]);
+	}
+	dMagnetic2_loader_shared_closeimage(&images[0]);
+	return retval;
 }
-
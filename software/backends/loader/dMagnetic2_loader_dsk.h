@@ -28,12 +28,23 @@
 #define	DMAGNETIC2_LOADER_DSK_H
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_dsk_getsize(int *pBytes);
+int dMagnetic2_loader_dsk_sniff(tdMagnetic2_loader_sniff* pSniff);
+// the disk images have already been opened
+int dMagnetic2_loader_dsk_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pTmpBuf,int tmpsize,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta,
+		int amstrad0spectrum1,
+		int nodoc);
 int dMagnetic2_loader_dsk(
 		char* filename1,char* filename2,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int amstrad0spectrum1,
 		int nodoc);
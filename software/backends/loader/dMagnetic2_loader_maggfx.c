@@ -33,7 +33,9 @@
 #include "dMagnetic2_loader.h"
 #include "dMagnetic2_loader_shared.h"
 
-void dMagnetic2_loader_maggfx_detect_game(unsigned char *pMagBuf,tdMagnetic2_game_meta *pMeta)
+#define	MAGHEADER_SIZE	14	// the version is the last field needed from the header
+
+void dMagnetic2_loader_maggfx_detect_game(const unsigned char *pMagBuf,tdMagnetic2_game_meta *pMeta)
 {
 	pMeta->source=DMAGNETIC2_SOURCE_MAGGFX;
 	pMeta->version=READ_INT16BE(pMagBuf,12);		// the verion is stored in bytes 12..13 of the header
@@ -41,20 +43,154 @@ void dMagnetic2_loader_maggfx_detect_game(unsigned char *pMagBuf,tdMagnetic2_gam
 	pMeta->source=DMAGNETIC2_SOURCE_MAGGFX;
 }
 
+// returns the size of the file, up to maxsize bytes. the file is only being read when it fits into the output buffer.
+// a file without a size, like a pipe, could not be probed. it is being rejected with -1.
+static int dMagnetic2_loader_maggfx_fread(unsigned char* pOutput,int capacity,int maxsize,FILE *f)
+{
+	long n;
+	if (fseek(f,0L,SEEK_END)!=0)
+	{
+		return -1;
+	}
+	n=ftell(f);
+	if (n<0)
+	{
+		return -1;
+	}
+	if (n>maxsize)
+	{
+		n=maxsize;
+	}
+	if (pOutput!=NULL && n<=capacity)
+	{
+		rewind(f);
+		n=fread(pOutput,sizeof(char),n,f);
+	}
+	return (int)n;
+}
 int dMagnetic2_loader_maggfx_getsize(int *pBytes)
 {
 	*pBytes=0;	// no tmp buffer needed
 	return DMAGNETIC2_OK;
 }
+// the first file has to be a .mag or a .gfx file. the second one just needs a header.
+int dMagnetic2_loader_maggfx_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	if (!pSniff->present[0])
+	{
+		return 0;
+	}
+	if (!SNIFF_HEADER_IS(pSniff,0,"MaSc",4) && !SNIFF_HEADER_IS(pSniff,0,"MaP",3))
+	{
+		return 0;
+	}
+	if (pSniff->present[1] && pSniff->headerlen[1]>=0 && pSniff->headerlen[1]<4)
+	{
+		return 0;
+	}
+	return 1;
+}
+// the files have already been opened. the first one has to be the .mag or the .gfx file, the second one is optional.
+int dMagnetic2_loader_maggfx_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta)
+{
+	int i;
+	int n;
+	int retval;
+	int detected_mag;
+	int detected_gfx;
+	unsigned char magheader[MAGHEADER_SIZE]={0};
+	// check the important output buffers
+	if (pMeta==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+
+	pMeta->game=DMAGNETIC2_GAME_NONE;
+	pMeta->source=DMAGNETIC2_SOURCE_NONE;
+	pMeta->version=-1;
+	pMeta->real_magsize=0;
+	pMeta->real_gfxsize=0;
+
+	if (pImages[0].pData==NULL)
+	{
+		return DMAGNETIC2_UNKNOWN_SOURCE;
+	}
+	detected_mag=-1;
+	detected_gfx=-1;
+	for (i=0;i<2;i++)
+	{
+		const unsigned char* pHeader=pImages[i].pData;
+		if (pHeader==NULL)
+		{
+			continue;
+		}
+		if (pImages[i].len<4)
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+		if (pHeader[0]=='M' && pHeader[1]=='a' && pHeader[2]=='S' && pHeader[3]=='c') 
+		{
+			detected_mag=i;
+		}
+		else if (pHeader[0]=='M' && pHeader[1]=='a' && pHeader[2]=='P')
+		{
+			detected_gfx=i;
+		}
+		else	// the file did not start with the correct magic word.
+		{
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+	}
+	// here, it is established that the file(s) work.
+	// a buffer which is too small is not written. the size is being reported anyway.
+	retval=DMAGNETIC2_OK;
+	if (detected_mag>=0)
+	{
+		n=pImages[detected_mag].len;
+		if (n>DMAGNETIC2_MAX_MAGSIZE) n=DMAGNETIC2_MAX_MAGSIZE;
+		if (pMagBuf!=NULL && n>magcapacity)
+		{
+			retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
+		else if (pMagBuf!=NULL)
+		{
+			memcpy(pMagBuf,pImages[detected_mag].pData,n);
+		}
+		pMeta->real_magsize=n;
+		memcpy(magheader,pImages[detected_mag].pData,(n<MAGHEADER_SIZE)?n:MAGHEADER_SIZE);
+		dMagnetic2_loader_maggfx_detect_game(magheader,pMeta);
+	}
+	if (detected_gfx>=0)
+	{
+		n=pImages[detected_gfx].len;
+		if (n>DMAGNETIC2_MAX_GFXSIZE) n=DMAGNETIC2_MAX_GFXSIZE;
+		if (pGfxBuf!=NULL && n>gfxcapacity)
+		{
+			retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
+		else if (pGfxBuf!=NULL)
+		{
+			memcpy(pGfxBuf,pImages[detected_gfx].pData,n);
+		}
+		pMeta->real_gfxsize=n;
+	}
+	return retval;
+}
 int dMagnetic2_loader_maggfx(
 		char* filename1,char* filename2,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta)
 		
 {
 	char header[4];			// read the header
+	unsigned char magheader[MAGHEADER_SIZE]={0};
 	int n;
+	int retval;
 	int detected_mag;
 	int detected_gfx;
 	FILE *f;
@@ -134,6 +270,8 @@ int dMagnetic2_loader_maggfx(
 		}
 	}
 	// here, it is established that the file(s) work.
+	// a buffer which is too small is not written. the size is being reported anyway.
+	retval=DMAGNETIC2_OK;
 	f=NULL;
 	if (detected_mag==1)
 	{
@@ -145,10 +283,20 @@ int dMagnetic2_loader_maggfx(
 	}
 	if (f)
 	{
-		n=fread(pMagBuf,sizeof(char),DMAGNETIC2_MAX_MAGSIZE,f);
+		n=fread(magheader,sizeof(char),MAGHEADER_SIZE,f);
+		rewind(f);
+		n=dMagnetic2_loader_maggfx_fread(pMagBuf,magcapacity,DMAGNETIC2_MAX_MAGSIZE,f);
 		fclose(f);
+		if (n<0)
+		{
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+		if (pMagBuf!=NULL && n>magcapacity)
+		{
+			retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
 		pMeta->real_magsize=n;
-		dMagnetic2_loader_maggfx_detect_game(pMagBuf,pMeta);
+		dMagnetic2_loader_maggfx_detect_game(magheader,pMeta);
 	}
 	f=NULL;
 	if (detected_gfx==1)
@@ -161,11 +309,19 @@ int dMagnetic2_loader_maggfx(
 	}
 	if (f)
 	{
-		n=fread(pGfxBuf,sizeof(char),DMAGNETIC2_MAX_GFXSIZE,f);
+		n=dMagnetic2_loader_maggfx_fread(pGfxBuf,gfxcapacity,DMAGNETIC2_MAX_GFXSIZE,f);
 		fclose(f);
+		if (n<0)
+		{
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+		if (pGfxBuf!=NULL && n>gfxcapacity)
+		{
+			retval=DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+		}
 		pMeta->real_gfxsize=n;
 	}
-	return DMAGNETIC2_OK;	
+	return retval;	
 
 
 }
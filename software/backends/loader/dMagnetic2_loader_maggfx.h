@@ -28,11 +28,19 @@
 #define	DMAGNETIC2_LOADER_MAGGFX_H
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_maggfx_getsize(int *pBytes);
+int dMagnetic2_loader_maggfx_sniff(tdMagnetic2_loader_sniff* pSniff);
+// the files have already been opened
+int dMagnetic2_loader_maggfx_images(
+		tdMagnetic2_loader_image* pImages,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
+		tdMagnetic2_game_meta *pMeta);
 int dMagnetic2_loader_maggfx(
 		char* filename1,char* filename2,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta);
 
 #endif
@@ -124,7 +124,28 @@ int dMagnetic2_loader_msdos_identify_game(int disk1size)
 	return gameidx;
 }
 
-int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigned char* pMagBuf,tdMagnetic2_game_meta *pMeta,int gameidx,char filename_postfix,int nodoc)
+// reads up to maxsize bytes from the file, but writes no more than capacity bytes.
+// without an output buffer, or when it is too small, the number of bytes which would have been read is returned.
+static int dMagnetic2_loader_msdos_fread(unsigned char* pOutput,int capacity,int maxsize,FILE *f)
+{
+	long n;
+	if (pOutput!=NULL)
+	{
+		n=fread(pOutput,sizeof(char),(capacity<maxsize)?capacity:maxsize,f);
+		if (n<capacity || capacity>=maxsize)
+		{
+			return (int)n;
+		}
+	}
+	fseek(f,0L,SEEK_END);
+	n=ftell(f);
+	if (n<0)
+	{
+		return 0;
+	}
+	return (n>maxsize)?maxsize:(int)n;
+}
+int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigned char* pMagBuf,int magcapacity,tdMagnetic2_game_meta *pMeta,int gameidx,char filename_postfix,int nodoc)
 {
 	int size_code=0;
 	int size_dict=0;
@@ -150,10 +171,13 @@ int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigne
 	// sometimes this file is huffed. if not, it starts with 0x49 0xfa
 	if (pTmpBuf[0]==0x49 && pTmpBuf[1]==0xfa)
 	{
-		memcpy(&pMagBuf[idx],pTmpBuf,n);
+		if (OUTPUT_FITS(pMagBuf,idx,n,magcapacity)!=NULL)
+		{
+			memcpy(&pMagBuf[idx],pTmpBuf,n);
+		}
 		size_code=n;	
 	} else {
-		size_code=dMagnetic2_loader_shared_unhuffer(pTmpBuf,n,&pMagBuf[idx]);
+		size_code=dMagnetic2_loader_shared_unhuffer(pTmpBuf,n,OUTPUT_AT(pMagBuf,idx),OUTPUT_ROOM(idx,magcapacity));
 	}
 	idx+=size_code;
 
@@ -165,7 +189,7 @@ int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigne
 	{
 		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
 	}
-	size_string1=fread(&pMagBuf[idx],sizeof(char),MAX_SIZE_STRING1,f);
+	size_string1=dMagnetic2_loader_msdos_fread(OUTPUT_AT(pMagBuf,idx),OUTPUT_ROOM(idx,magcapacity),MAX_SIZE_STRING1,f);
 	fclose(f);
 	idx+=size_string1;
 
@@ -176,7 +200,7 @@ int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigne
 	{
 		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
 	}
-	size_string2=fread(&pMagBuf[idx],sizeof(char),MAX_SIZE_STRING2,f);
+	size_string2=dMagnetic2_loader_msdos_fread(OUTPUT_AT(pMagBuf,idx),OUTPUT_ROOM(idx,magcapacity),MAX_SIZE_STRING2,f);
 	fclose(f);
 	idx+=size_string2;
 
@@ -191,9 +215,19 @@ int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigne
 			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
 		}
 		n=fread(pTmpBuf,sizeof(char),MAX_SIZE_DICT,f);
-		size_dict=dMagnetic2_loader_shared_unhuffer(pTmpBuf,n,&pMagBuf[idx]);
+		fclose(f);
+		size_dict=dMagnetic2_loader_shared_unhuffer(pTmpBuf,n,OUTPUT_AT(pMagBuf,idx),OUTPUT_ROOM(idx,magcapacity));
 	}	
 	idx+=size_dict;
+	pMeta->real_magsize=idx;	
+	if (pMagBuf==NULL)	// only the size was requested
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (idx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 
 	if (nodoc)
 	{
@@ -207,13 +241,12 @@ int dMagnetic2_loader_msdos_mkmag(char* filename1,unsigned char* pTmpBuf,unsigne
 	}
 	if (dMagnetic2_loader_msdos_gameInfo[gameidx].game==DMAGNETIC2_GAME_MYTH && pMagBuf[0x314a]==0x66) pMagBuf[0x314a]=0x60;	// final touch
 	dMagnetic2_loader_shared_addmagheader(pMagBuf,idx,dMagnetic2_loader_msdos_gameInfo[gameidx].version,size_code,size_string1,size_string2,size_dict,-1);
-	pMeta->real_magsize=idx;	
 
 	return DMAGNETIC2_OK;
 }
 	
 
-int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta,int gameidx,char filename_postfix)
+int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta,int gameidx,char filename_postfix)
 {
 	int n;
 	int idx;
@@ -234,7 +267,11 @@ int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigne
 	// then the DISK2.PIX file
 
 	idx=0;
-	pGfxBuf[idx++]='M';pGfxBuf[idx++]='a';pGfxBuf[idx++]='P';pGfxBuf[idx++]='3';
+	if (OUTPUT_FITS(pGfxBuf,idx,16,gfxcapacity)!=NULL)
+	{
+		pGfxBuf[idx+0]='M';pGfxBuf[idx+1]='a';pGfxBuf[idx+2]='P';pGfxBuf[idx+3]='3';
+	}
+	idx+=4;
 	snprintf((char*)pTmpBuf,MAX_FILENAME_LEN-1,"%s/%s4%c",filename1,dMagnetic2_loader_msdos_gameInfo[gameidx].prefix,filename_postfix);
 	// start by reading the index
 	f=fopen((char*)pTmpBuf,"rb");
@@ -245,7 +282,7 @@ int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigne
 	idx+=4;		// leave some room for the size of the index
 	idx+=4;		// leave some room for the size of the DISK1.PIX file
 	idx+=4;		// leave some room for the size of the DISK2.PIX file
-	n=fread(&pGfxBuf[idx],sizeof(char),256+1,f);	
+	n=dMagnetic2_loader_msdos_fread(OUTPUT_AT(pGfxBuf,idx),OUTPUT_ROOM(idx,gfxcapacity),256+1,f);	
 	fclose(f);
 	if (n!=256)		// check if the expected filesize matches
 	{
@@ -261,7 +298,7 @@ int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigne
 	{
 		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
 	}
-	n=fread(&pGfxBuf[idx],sizeof(char),dMagnetic2_loader_msdos_gameInfo[gameidx].disk1size+1,f);
+	n=dMagnetic2_loader_msdos_fread(OUTPUT_AT(pGfxBuf,idx),OUTPUT_ROOM(idx,gfxcapacity),dMagnetic2_loader_msdos_gameInfo[gameidx].disk1size+1,f);
 	fclose(f);
 	if (n!=dMagnetic2_loader_msdos_gameInfo[gameidx].disk1size)
 	{
@@ -280,7 +317,7 @@ int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigne
 		{
 			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
 		}
-		n=fread(&pGfxBuf[idx],sizeof(char),dMagnetic2_loader_msdos_gameInfo[gameidx].disk2size+1,f);
+		n=dMagnetic2_loader_msdos_fread(OUTPUT_AT(pGfxBuf,idx),OUTPUT_ROOM(idx,gfxcapacity),dMagnetic2_loader_msdos_gameInfo[gameidx].disk2size+1,f);
 		fclose(f);
 		if (n!=dMagnetic2_loader_msdos_gameInfo[gameidx].disk2size)
 		{
@@ -291,11 +328,17 @@ int dMagnetic2_loader_msdos_mkgfx(char* filename1,unsigned char* pTmpBuf,unsigne
 	}
 
 
-	WRITE_INT32BE(pGfxBuf, 4,size_index);
-	WRITE_INT32BE(pGfxBuf, 8,size_disk1);
-	WRITE_INT32BE(pGfxBuf,12,size_disk2);
-
 	pMeta->real_gfxsize=idx;
+	if (pGfxBuf!=NULL && idx>gfxcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+	if (pGfxBuf!=NULL)
+	{
+		WRITE_INT32BE(pGfxBuf, 4,size_index);
+		WRITE_INT32BE(pGfxBuf, 8,size_disk1);
+		WRITE_INT32BE(pGfxBuf,12,size_disk2);
+	}
 
 	return DMAGNETIC2_OK;
 
@@ -306,11 +349,40 @@ int dMagnetic2_loader_msdos_getsize(int *pBytes)
 	*pBytes=MAX_FILENAME_LEN+MAX_SIZE_READ;
 	return DMAGNETIC2_OK;
 }
+// the game is a directory
+int dMagnetic2_loader_msdos_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	return pSniff->present[0] && pSniff->isdir[0];
+}
+typedef struct _tdMagnetic2_loader_msdos_job
+{
+	char* filename1;
+	unsigned char* pTmpBuf;
+	unsigned char* pMagBuf;
+	int magcapacity;
+	unsigned char* pGfxBuf;
+	int gfxcapacity;
+	tdMagnetic2_game_meta *pMeta;
+	int gameidx;
+	char filename_postfix;
+	int nodoc;
+} tdMagnetic2_loader_msdos_job;
+static int dMagnetic2_loader_msdos_magjob(void* pArg)
+{
+	tdMagnetic2_loader_msdos_job* pJob=(tdMagnetic2_loader_msdos_job*)pArg;
+	return dMagnetic2_loader_msdos_mkmag(pJob->filename1,pJob->pTmpBuf,pJob->pMagBuf,pJob->magcapacity,pJob->pMeta,pJob->gameidx,pJob->filename_postfix,pJob->nodoc);
+}
+static int dMagnetic2_loader_msdos_gfxjob(void* pArg)
+{
+	tdMagnetic2_loader_msdos_job* pJob=(tdMagnetic2_loader_msdos_job*)pArg;
+	// the .mag is using the beginning of the tmp buffer for the code. the .gfx only needs room for the filenames.
+	return dMagnetic2_loader_msdos_mkgfx(pJob->filename1,&pJob->pTmpBuf[MAX_SIZE_CODE],pJob->pGfxBuf,pJob->gfxcapacity,pJob->pMeta,pJob->gameidx,pJob->filename_postfix);
+}
 int dMagnetic2_loader_msdos(
 		char* filename1,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta,
 		int nodoc)
 {
@@ -318,9 +390,11 @@ int dMagnetic2_loader_msdos(
 	int gameidx;
 	char filename_postfix;	// some releases of the games have a . at the end of the filename. this can cause problems on some unix systems. 
 	FILE *f;
+	tdMagnetic2_loader_msdos_job job;
+	tdMagnetic2_loader_job jobs[2];
 	// check the important output buffers
 //	if (tmpsize<MAX_FILENAME_LEN)	
-	if (tmpsize<MAX_SIZE_CODE)	
+	if (tmpsize<MAX_SIZE_CODE+MAX_FILENAME_LEN)	// the .gfx is built with the filenames after the code
 	{
 		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
 	}
@@ -376,23 +450,21 @@ int dMagnetic2_loader_msdos(
 
 	// the game has been identified. The game sections are actually stored in files. 
 	// those files can be opened and read.
-	if (pMagBuf!=NULL)
-	{
-		int retval;
-		retval=dMagnetic2_loader_msdos_mkmag(filename1,pTmpBuf,pMagBuf,pMeta,gameidx,filename_postfix,nodoc);
-		if (retval!=DMAGNETIC2_OK)
-		{
-			return retval;
-		}
-	}
-	if (pGfxBuf!=NULL)
-	{
-		int retval;
-		retval=dMagnetic2_loader_msdos_mkgfx(filename1,pTmpBuf,pGfxBuf,pMeta,gameidx,filename_postfix);
-		if (retval!=DMAGNETIC2_OK)
-		{
-			return retval;
-		}
-	}
-	return DMAGNETIC2_OK;
+	// the .mag and the .gfx are in different files. they can be read at the same time.
+	job.filename1=filename1;
+	job.pTmpBuf=pTmpBuf;
+	job.pMagBuf=pMagBuf;
+	job.magcapacity=magcapacity;
+	job.pGfxBuf=pGfxBuf;
+	job.gfxcapacity=gfxcapacity;
+	job.pMeta=pMeta;
+	job.gameidx=gameidx;
+	job.filename_postfix=filename_postfix;
+	job.nodoc=nodoc;
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	jobs[0].pFunc=dMagnetic2_loader_msdos_magjob;
+	jobs[0].pArg=&job;
+	jobs[1].pFunc=dMagnetic2_loader_msdos_gfxjob;
+	jobs[1].pArg=&job;
+	return dMagnetic2_loader_shared_runjobs(jobs,2);
 }
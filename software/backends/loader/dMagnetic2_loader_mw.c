@@ -27,6 +27,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "dMagnetic2_shared.h"			// for the macros
 #include "dMagnetic2_errorcodes.h"		// for the error codes
 
@@ -163,60 +166,89 @@ int dMagnetic2_loader_mw_substitute_tworsc(char* filename1,char *pFilename,int n
 	
 }
 
-int dMagnetic2_loader_mw_sizes(unsigned char* pTmpBuf,char* filename1,int *pSizes,int *gameidx)
+// the .RSC files are being treated as one continuous resource. every one of them is opened only once:
+// mapped when possible. otherwise, the file stays open, and is being read from with pread(), so
+// that the .mag and the .gfx can be read at the same time.
+typedef struct _tdMagnetic2_loader_mw_rsc
+{
+	tdMagnetic2_loader_image images[MAX_NUM_RSC_FILES];
+	int fds[MAX_NUM_RSC_FILES];	// -1 when the file has been mapped, or when it does not exist
+	int sizes[MAX_NUM_RSC_FILES];
+} tdMagnetic2_loader_mw_rsc;
+void dMagnetic2_loader_mw_closersc(tdMagnetic2_loader_mw_rsc* pRsc)
+{
+	int i;
+	for (i=0;i<MAX_NUM_RSC_FILES;i++)
+	{
+		dMagnetic2_loader_shared_closeimage(&pRsc->images[i]);
+		if (pRsc->fds[i]>=0)
+		{
+			close(pRsc->fds[i]);
+		}
+		pRsc->fds[i]=-1;
+		pRsc->sizes[i]=0;
+	}
+}
+int dMagnetic2_loader_mw_openrsc(unsigned char* pTmpBuf,char* filename1,tdMagnetic2_loader_mw_rsc* pRsc,int *gameidx)
 {
 	int i;
 	int sum;
 	int retval;
 	int gameidx_int;
 	char *pFilename;
-	FILE *f;
 	pFilename=(char*)pTmpBuf;
 	gameidx_int=-1;
 	sum=0;
+	memset(pRsc,0,sizeof(tdMagnetic2_loader_mw_rsc));
+	for (i=0;i<MAX_NUM_RSC_FILES;i++)
+	{
+		pRsc->fds[i]=-1;
+	}
 	for (i=0;i<MAX_NUM_RSC_FILES;i++)
 	{
 		int n;
 		retval=dMagnetic2_loader_mw_substitute_tworsc(filename1,pFilename,i,&gameidx_int);
 		if (retval!=DMAGNETIC2_OK)
 		{
+			dMagnetic2_loader_mw_closersc(pRsc);
 			return DMAGNETIC2_UNKNOWN_SOURCE;
 		}
-		f=fopen(pFilename,"rb");
 		n=0;
-		if (f!=NULL)
+		// without a fallback buffer, the image is either mapped, or not opened at all.
+		if (dMagnetic2_loader_shared_openimage(&pRsc->images[i],pFilename,NULL,SIZE_RSC_FILE)==DMAGNETIC2_OK)
 		{
-			fseek(f,0,SEEK_END);
-			n=(int)ftell(f);
-			if (n>SIZE_RSC_FILE)	// easy sanity check.
+			n=pRsc->images[i].len;
+		} else {
+			struct stat st;
+			pRsc->fds[i]=open(pFilename,O_RDONLY);
+			if (pRsc->fds[i]>=0 && fstat(pRsc->fds[i],&st)==0)
 			{
-				return DMAGNETIC2_UNKNOWN_SOURCE;
+				n=(st.st_size>SIZE_RSC_FILE)?SIZE_RSC_FILE+1:(int)st.st_size;
 			}
 		}
-		pSizes[i]=n;
+		if (n>SIZE_RSC_FILE)	// easy sanity check.
+		{
+			dMagnetic2_loader_mw_closersc(pRsc);
+			return DMAGNETIC2_UNKNOWN_SOURCE;
+		}
+		pRsc->sizes[i]=n;
 		sum+=n;
 	}
-	if (gameidx_int==-1)
-	{
-		return DMAGNETIC2_UNKNOWN_SOURCE;
-	}
-	if (sum!=dMagnetic2_loader_mw_gameinfo[gameidx_int].rscsize)
+	if (gameidx_int==-1 || sum!=dMagnetic2_loader_mw_gameinfo[gameidx_int].rscsize)
 	{
+		dMagnetic2_loader_mw_closersc(pRsc);
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 	*gameidx=gameidx_int;
 	return DMAGNETIC2_OK;
 }
-int dMagnetic2_loader_mw_readresource(unsigned char* pTmpBuf,char* filename1,int *sizes,int offset,unsigned char* pOutput,int length)
+int dMagnetic2_loader_mw_readresource(tdMagnetic2_loader_mw_rsc* pRsc,int offset,unsigned char* pOutput,int length)
 {
 	int i;
-	char *pFilename;
-	FILE *f;
 	int sum;
 	int offset_in_rsc;
 	int rsc_file;
 	int output_idx;
-	pFilename=(char*)pTmpBuf;
 
 	sum=0;
 	rsc_file=-1;
@@ -228,26 +260,41 @@ int dMagnetic2_loader_mw_readresource(unsigned char* pTmpBuf,char* filename1,int
 			offset_in_rsc=offset-sum;
 			rsc_file=i;
 		}
-		sum+=sizes[i];
+		sum+=pRsc->sizes[i];
 	}
 	if (rsc_file==-1 || offset_in_rsc==-1)
 	{
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
+	if (pOutput==NULL)	// only the size is being counted
+	{
+		return DMAGNETIC2_OK;
+	}
 	output_idx=0;
-	while (length)
+	while (length>0)
 	{
 		int n;
-		int retval;
-		retval=dMagnetic2_loader_mw_substitute_tworsc(filename1,pFilename,rsc_file,NULL);
-		if (retval!=DMAGNETIC2_OK)
+		n=0;
+		if (pRsc->images[rsc_file].pData!=NULL)
 		{
-			return retval;
+			n=pRsc->sizes[rsc_file]-offset_in_rsc;
+			if (n>length)
+			{
+				n=length;
+			}
+			if (n>0)
+			{
+				memcpy(&pOutput[output_idx],&pRsc->images[rsc_file].pData[offset_in_rsc],n);
+			}
+		}
+		else if (pRsc->fds[rsc_file]>=0)
+		{
+			n=pread(pRsc->fds[rsc_file],&pOutput[output_idx],length,offset_in_rsc);
+		}
+		if (n<0)
+		{
+			n=0;
 		}
-		f=fopen(pFilename,"rb");
-		fseek(f,offset_in_rsc,SEEK_SET);
-		n=fread(&pOutput[output_idx],sizeof(char),length,f);
-		fclose(f);
 
 		// keep on reading in the next file, if necessary
 		length=length-n;
@@ -257,7 +304,7 @@ int dMagnetic2_loader_mw_readresource(unsigned char* pTmpBuf,char* filename1,int
 
 		// make sure that this loop terminates
 		if (rsc_file==MAX_NUM_RSC_FILES) length=0;
-		else if (sizes[rsc_file]==0) length=0;
+		else if (pRsc->sizes[rsc_file]==0) length=0;
 		
 	}
 	return DMAGNETIC2_OK;
@@ -277,7 +324,7 @@ int dMagnetic2_loader_mw_parsedirentry(unsigned char* tmp2buf,tEntry *pEntry)
 	return DMAGNETIC2_OK;
 }
 
-int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned char* pMagBuf,tdMagnetic2_game_meta *pMeta,int *sizes)
+int dMagnetic2_loader_mw_mkmag(tdMagnetic2_loader_mw_rsc* pRsc,unsigned char* pMagBuf,int magcapacity,tdMagnetic2_game_meta *pMeta)
 {
 	unsigned char tmp2buf[32];
 	int diroffset;
@@ -296,7 +343,7 @@ int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned c
 	
 
 	// step one: find the directory. It is stored in the very first 4 bytes.
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,0,tmp2buf,4);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,0,tmp2buf,4);
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
@@ -305,7 +352,7 @@ int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned c
 
 	// now the position of the directory inside the .RSC files is known.	
 //int dMagnetic2_loader_mw_parsedirentry(unsigned char* tmp2buf,tEntry *pEntry)
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,2);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,2);
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
@@ -328,7 +375,7 @@ int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned c
 	for (i=0;i<num_entries;i++)
 	{
 		tEntry entry;
-		retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,DIR_ENTRY_SIZE);
+		retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,DIR_ENTRY_SIZE);
 		if (retval!=DMAGNETIC2_OK)
 		{
 			return retval;
@@ -373,34 +420,43 @@ int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned c
 		return DMAGNETIC2_UNKNOWN_SOURCE;
 	}
 	magidx=42;	
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,codeoffs,&pMagBuf[magidx],codesize);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,codeoffs,OUTPUT_FITS(pMagBuf,magidx,codesize,magcapacity),codesize);
 	magidx+=codesize;
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
 	}
 
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,text1offs,&pMagBuf[magidx],text1size);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,text1offs,OUTPUT_FITS(pMagBuf,magidx,text1size,magcapacity),text1size);
 	magidx+=text1size;
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
 	}
 
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,dictoffs,&pMagBuf[magidx],dictsize);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,dictoffs,OUTPUT_FITS(pMagBuf,magidx,dictsize,magcapacity),dictsize);
 	magidx+=dictsize;
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
 	}
 
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,wtaboffs,&pMagBuf[magidx],wtabsize);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,wtaboffs,OUTPUT_FITS(pMagBuf,magidx,wtabsize,magcapacity),wtabsize);
 	magidx+=wtabsize;
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
 	}
 
+	pMeta->real_magsize=magidx;
+	if (pMagBuf==NULL)	// only the size was requested
+	{
+		return DMAGNETIC2_OK;
+	}
+	if (magidx>magcapacity)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 	if (wonderland)		// finishing touch
 	{
 		if (READ_INT16BE(pMagBuf,0x67a2)==0xa62c)
@@ -419,11 +475,10 @@ int dMagnetic2_loader_mw_mkmag(unsigned char* pTmpBuf,char* filename1,unsigned c
 		text2size=text1size+dictsize-0xe000;
 		text1size=0xe000;
 	}
-	pMeta->real_magsize=magidx;
 	retval=dMagnetic2_loader_shared_addmagheader(pMagBuf,magidx,4,codesize,text1size,text2size,wtabsize,huffmanidx);
 	return retval;
 }
-int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta,int *sizes)
+int dMagnetic2_loader_mw_mkgfx(tdMagnetic2_loader_mw_rsc* pRsc,unsigned char* pTmpBuf,char* filename1,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta)
 {
 	int i;
 	int imagecnt1,imagecnt2;
@@ -437,7 +492,7 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 #define	MAXIMAGES	230	// actually 226, but who's counting..
 		
 	// step one: find the directory. It is stored in the very first 4 bytes.
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,0,tmp2buf,4);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,0,tmp2buf,4);
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
@@ -446,7 +501,7 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 
 	// now the position of the directory inside the .RSC files is known.	
 //int dMagnetic2_loader_mw_parsedirentry(unsigned char* tmp2buf,tEntry *pEntry)
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,2);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,2);
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
@@ -461,7 +516,10 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 #define	SIZE_TREE	609
 	pictureidx=(MAXIMAGES+1+2)*(GFXDIRENTRYSIZE)+HEADERSIZE+MARGIN;		// reserve some bytes in the beginning of the gfx buffer for the directory. add two entries for the title screen at the end, when possible
 	gfxdiridx=HEADERSIZE+2;
-	memset(pGfxBuf,0,pictureidx);
+	if (OUTPUT_FITS(pGfxBuf,0,pictureidx,gfxcapacity)!=NULL)
+	{
+		memset(pGfxBuf,0,pictureidx);
+	}
 
 
 	// the pictures are stored in two parts in the rsc file: the tree, and the actual picture, called "Animation". 
@@ -474,7 +532,7 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 		tEntry entry;
 		// read one entry from the directory
 		// 
-		retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset+i*DIR_ENTRY_SIZE,tmp2buf,DIR_ENTRY_SIZE);
+		retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset+i*DIR_ENTRY_SIZE,tmp2buf,DIR_ENTRY_SIZE);
 		if (retval!=DMAGNETIC2_OK)
 		{
 			return retval;
@@ -487,14 +545,17 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 		if (entry.type==TYPE_ANIMATION)	// this is a picture
 		{
 			// prepare the gfx dir entry
-			memcpy(&pGfxBuf[gfxdiridx+0],entry.name,6);	
-			WRITE_INT32LE(pGfxBuf,gfxdiridx+ 6,pictureidx);	// the offset within the gfx buffer
-			WRITE_INT32LE(pGfxBuf,gfxdiridx+10,SIZE_TREE+entry.length);	// the size within the gfxbuffer. The tree is always 609 bytes 
+			if (OUTPUT_FITS(pGfxBuf,gfxdiridx,GFXDIRENTRYSIZE,gfxcapacity)!=NULL)
+			{
+				memcpy(&pGfxBuf[gfxdiridx+0],entry.name,6);	
+				WRITE_INT32LE(pGfxBuf,gfxdiridx+ 6,pictureidx);	// the offset within the gfx buffer
+				WRITE_INT32LE(pGfxBuf,gfxdiridx+10,SIZE_TREE+entry.length);	// the size within the gfxbuffer. The tree is always 609 bytes 
+			}
 			gfxdiridx+=GFXDIRENTRYSIZE;
 
 			// load the actual picture from the RSC
 			// leave some room at the beginning for the tree (which is being added in the second pass)
-			retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,entry.offset,&pGfxBuf[SIZE_TREE+pictureidx],entry.length);
+			retval=dMagnetic2_loader_mw_readresource(pRsc,entry.offset,OUTPUT_FITS(pGfxBuf,SIZE_TREE+pictureidx,entry.length,gfxcapacity),entry.length);
 			if (retval!=DMAGNETIC2_OK)
 			{
 				return retval;
@@ -521,14 +582,26 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 			if (f!=NULL)
 			{
 				int n;
-				n=fread(&pGfxBuf[pictureidx],sizeof(char),MAX_TITLE_FILESIZE,f);
+				fseek(f,0L,SEEK_END);
+				n=(int)ftell(f);
+				if (n<0) n=0;
+				if (n>MAX_TITLE_FILESIZE) n=MAX_TITLE_FILESIZE;
+				if (OUTPUT_FITS(pGfxBuf,pictureidx,n,gfxcapacity)!=NULL)
+				{
+					fseek(f,0L,SEEK_SET);
+					n=fread(&pGfxBuf[pictureidx],sizeof(char),n,f);
+				}
 				fclose(f);
 
 				if (n!=0)
 				{
-					memcpy(&pGfxBuf[gfxdiridx+0],names[i],6);	
-					WRITE_INT32LE(pGfxBuf,gfxdiridx+ 6,pictureidx);	// the offset within the gfx buffer
-					WRITE_INT32LE(pGfxBuf,gfxdiridx+10,n);	// the size within the gfxbuffer. 
+					if (OUTPUT_FITS(pGfxBuf,gfxdiridx,GFXDIRENTRYSIZE,gfxcapacity)!=NULL)
+					{
+						memcpy(&pGfxBuf[gfxdiridx+0],names[i],6);	
+						WRITE_INT32LE(pGfxBuf,gfxdiridx+ 6,pictureidx);	// the offset within the gfx buffer
+						WRITE_INT32LE(pGfxBuf,gfxdiridx+10,n);	// the size within the gfxbuffer. 
+					}
+					pictureidx+=n;	// the title screens are part of the gfx buffer, too
 					imagecnt1++;
 					imagecnt2++;
 					gfxdiridx+=GFXDIRENTRYSIZE;
@@ -536,6 +609,16 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 			}
 		}
 	}
+	if (pGfxBuf==NULL)	// only the size was requested. the trees from pass 2 are being placed in front of the pictures, which have already been counted.
+	{
+		pMeta->real_gfxsize=pictureidx;
+		return DMAGNETIC2_OK;
+	}
+	if (pictureidx>gfxcapacity)
+	{
+		pMeta->real_gfxsize=pictureidx;
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
 	WRITE_INT32LE(pGfxBuf,gfxdiridx,0x23232323);
 
 
@@ -546,7 +629,7 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 		tEntry entry;
 		// read one entry from the directory
 		// 
-		retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset+i*DIR_ENTRY_SIZE,tmp2buf,DIR_ENTRY_SIZE);
+		retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset+i*DIR_ENTRY_SIZE,tmp2buf,DIR_ENTRY_SIZE);
 		if (retval!=DMAGNETIC2_OK)
 		{
 			return retval;
@@ -581,12 +664,12 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 					offset=READ_INT32LE(pGfxBuf,diridx+6);
 				}
 			}
-			if (idx==-1)
+			if (idx==-1 || offset+entry.length>gfxcapacity)
 			{
 				return DMAGNETIC2_UNKNOWN_SOURCE;
 			}
 			// load the actual tree from the RSC
-			retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,entry.offset,&pGfxBuf[offset],entry.length);
+			retval=dMagnetic2_loader_mw_readresource(pRsc,entry.offset,&pGfxBuf[offset],entry.length);
 			if (retval!=DMAGNETIC2_OK)
 			{
 				return retval;
@@ -607,8 +690,6 @@ int dMagnetic2_loader_mw_mkgfx(unsigned char* pTmpBuf,char* filename1,unsigned c
 	// picturenum++;
 
 
-	WRITE_INT32LE(pGfxBuf,pictureidx,0x42424242);
-
 	pGfxBuf[0]='M';
 	pGfxBuf[1]='a';
 	pGfxBuf[2]='P';
@@ -625,19 +706,53 @@ int dMagnetic2_loader_mw_getsize(int *pBytes)
 	*pBytes=SIZE_RSC_FILE+1+FILENAME_LENGTH_MAX;	// large enough to load a full rsc file and some tricks with the filename
 	return DMAGNETIC2_OK;
 }
+// the filename has to point to TWO.RSC
+int dMagnetic2_loader_mw_sniff(tdMagnetic2_loader_sniff* pSniff)
+{
+	char filename[FILENAME_LENGTH_MAX+1];
+	if (!pSniff->present[0])
+	{
+		return 0;
+	}
+	return dMagnetic2_loader_mw_substitute_tworsc(pSniff->filename[0],filename,0,NULL)==DMAGNETIC2_OK;
+}
 
+typedef struct _tdMagnetic2_loader_mw_job
+{
+	tdMagnetic2_loader_mw_rsc* pRsc;
+	unsigned char* pTmpBuf;
+	char* filename1;
+	unsigned char* pMagBuf;
+	int magcapacity;
+	unsigned char* pGfxBuf;
+	int gfxcapacity;
+	tdMagnetic2_game_meta *pMeta;
+} tdMagnetic2_loader_mw_job;
+static int dMagnetic2_loader_mw_magjob(void* pArg)
+{
+	tdMagnetic2_loader_mw_job* pJob=(tdMagnetic2_loader_mw_job*)pArg;
+	return dMagnetic2_loader_mw_mkmag(pJob->pRsc,pJob->pMagBuf,pJob->magcapacity,pJob->pMeta);
+}
+static int dMagnetic2_loader_mw_gfxjob(void* pArg)
+{
+	tdMagnetic2_loader_mw_job* pJob=(tdMagnetic2_loader_mw_job*)pArg;
+	// the tmp buffer only holds the filenames of the title screens.
+	return dMagnetic2_loader_mw_mkgfx(pJob->pRsc,pJob->pTmpBuf,pJob->filename1,pJob->pGfxBuf,pJob->gfxcapacity,pJob->pMeta);
+}
 int dMagnetic2_loader_mw(
 		char* filename1,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta)
 {
-	int sizes[MAX_NUM_RSC_FILES];
+	tdMagnetic2_loader_mw_rsc rsc;
 	int retval;
 	int gameidx;
+	tdMagnetic2_loader_mw_job job;
+	tdMagnetic2_loader_job jobs[2];
 
-	if (tmpsize<FILENAME_LENGTH_MAX)
+	if (tmpsize<FILENAME_LENGTH_MAX)	// for the filenames
 	{
 		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
 	}
@@ -653,8 +768,8 @@ int dMagnetic2_loader_mw(
 	pMeta->real_gfxsize=0;
 
 
-	// first: identify the game. and collect the size of the .rsc files.
-	retval=dMagnetic2_loader_mw_sizes(pTmpBuf,filename1,sizes,&gameidx);	
+	// first: identify the game. and open all the .rsc files.
+	retval=dMagnetic2_loader_mw_openrsc(pTmpBuf,filename1,&rsc,&gameidx);	
 	if (retval!=DMAGNETIC2_OK)
 	{
 		return retval;
@@ -665,27 +780,23 @@ int dMagnetic2_loader_mw(
 
 
 
-	if (pMagBuf!=NULL)
-	{
-		int retval;
-		retval=dMagnetic2_loader_mw_mkmag(pTmpBuf,filename1,pMagBuf,pMeta,sizes);
-		if (retval!=DMAGNETIC2_OK)
-		{
-			return retval;
-		}
-	}
-
-	if (pGfxBuf!=NULL)
-	{
-		int retval;
-		retval=dMagnetic2_loader_mw_mkgfx(pTmpBuf,filename1,pGfxBuf,pMeta,sizes);
-		if (retval!=DMAGNETIC2_OK)
-		{
-			return retval;
-		}
-	}
-
-	return DMAGNETIC2_OK;
+	// the .mag and the .gfx are different resources. they can be read at the same time.
+	job.pRsc=&rsc;
+	job.pTmpBuf=pTmpBuf;
+	job.filename1=filename1;
+	job.pMagBuf=pMagBuf;
+	job.magcapacity=magcapacity;
+	job.pGfxBuf=pGfxBuf;
+	job.gfxcapacity=gfxcapacity;
+	job.pMeta=pMeta;
+	// a missing output buffer is not written. its size is being reported anyway. so is the size of a buffer which was too small.
+	jobs[0].pFunc=dMagnetic2_loader_mw_magjob;
+	jobs[0].pArg=&job;
+	jobs[1].pFunc=dMagnetic2_loader_mw_gfxjob;
+	jobs[1].pArg=&job;
+	retval=dMagnetic2_loader_shared_runjobs(jobs,2);
+	dMagnetic2_loader_mw_closersc(&rsc);
+	return retval;
 }
 
 #ifdef	EXPERIMENTAL_CODE
@@ -696,26 +807,33 @@ int dMagnetic2_loader_mw_printdir(char* filename1,
 	unsigned char tmp2buf[DIR_ENTRY_SIZE];
 	int retval;
 	int gameidx;
-	int sizes[10];
+	tdMagnetic2_loader_mw_rsc rsc;
+	tdMagnetic2_loader_mw_rsc* pRsc=&rsc;
 	int i;
 	int diroffset;
 	int num_entries;
 
-	retval=dMagnetic2_loader_mw_sizes(pTmpBuf,filename1,sizes,&gameidx);
+	retval=dMagnetic2_loader_mw_openrsc(pTmpBuf,filename1,pRsc,&gameidx);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
 
 	// step one: find the directory. It is stored in the very first 4 bytes.
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,0,tmp2buf,4);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,0,tmp2buf,4);
 	if (retval!=DMAGNETIC2_OK)
 	{
+		dMagnetic2_loader_mw_closersc(pRsc);
 		return retval;
 	}
 	diroffset=READ_INT32LE(tmp2buf,0);
 
 	// now the position of the directory inside the .RSC files is known.	
 //int dMagnetic2_loader_mw_parsedirentry(unsigned char* tmp2buf,tEntry *pEntry)
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,2);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,2);
 	if (retval!=DMAGNETIC2_OK)
 	{
+		dMagnetic2_loader_mw_closersc(pRsc);
 		return retval;
 	}
 	num_entries=READ_INT16LE(tmp2buf,0);
@@ -724,19 +842,22 @@ int dMagnetic2_loader_mw_printdir(char* filename1,
 	for (i=0;i<num_entries;i++)
 	{
 		tEntry entry;
-		retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,DIR_ENTRY_SIZE);
+		retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,DIR_ENTRY_SIZE);
 		if (retval!=DMAGNETIC2_OK)
 		{
+			dMagnetic2_loader_mw_closersc(pRsc);
 			return retval;
 		}
 		retval=dMagnetic2_loader_mw_parsedirentry(tmp2buf,&entry);
 		if (retval!=DMAGNETIC2_OK)
 		{
+			dMagnetic2_loader_mw_closersc(pRsc);
 			return retval;
 		}
 		printf("%4d>  %04X @%08x  %6d bytes [%-6s].%d\n",i,entry.unknown,entry.offset,entry.length,entry.name,(int)entry.type);
 		diroffset+=(DIR_ENTRY_SIZE);
 	}
+	dMagnetic2_loader_mw_closersc(pRsc);
 	return retval;	
 }
 
@@ -746,26 +867,33 @@ int dMagnetic2_loader_mw_extractall(char* filename1,
 	unsigned char tmp2buf[DIR_ENTRY_SIZE];
 	int retval;
 	int gameidx;
-	int sizes[10];
+	tdMagnetic2_loader_mw_rsc rsc;
+	tdMagnetic2_loader_mw_rsc* pRsc=&rsc;
 	int i;
 	int diroffset;
 	int num_entries;
 
-	retval=dMagnetic2_loader_mw_sizes(pTmpBuf,filename1,sizes,&gameidx);
+	retval=dMagnetic2_loader_mw_openrsc(pTmpBuf,filename1,pRsc,&gameidx);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return retval;
+	}
 
 	// step one: find the directory. It is stored in the very first 4 bytes.
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,0,tmp2buf,4);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,0,tmp2buf,4);
 	if (retval!=DMAGNETIC2_OK)
 	{
+		dMagnetic2_loader_mw_closersc(pRsc);
 		return retval;
 	}
 	diroffset=READ_INT32LE(tmp2buf,0);
 
 	// now the position of the directory inside the .RSC files is known.	
 //int dMagnetic2_loader_mw_parsedirentry(unsigned char* tmp2buf,tEntry *pEntry)
-	retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,2);
+	retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,2);
 	if (retval!=DMAGNETIC2_OK)
 	{
+		dMagnetic2_loader_mw_closersc(pRsc);
 		return retval;
 	}
 	num_entries=READ_INT16LE(tmp2buf,0);
@@ -774,21 +902,23 @@ int dMagnetic2_loader_mw_extractall(char* filename1,
 	for (i=0;i<num_entries;i++)
 	{
 		tEntry entry;
-		retval=dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,diroffset,tmp2buf,DIR_ENTRY_SIZE);
+		retval=dMagnetic2_loader_mw_readresource(pRsc,diroffset,tmp2buf,DIR_ENTRY_SIZE);
 		if (retval!=DMAGNETIC2_OK)
 		{
+			dMagnetic2_loader_mw_closersc(pRsc);
 			return retval;
 		}
 		retval=dMagnetic2_loader_mw_parsedirentry(tmp2buf,&entry);
 		if (retval!=DMAGNETIC2_OK)
 		{
+			dMagnetic2_loader_mw_closersc(pRsc);
 			return retval;
 		}
 		printf("%4d>  %04X @%08x  %6d bytes [%-6s].%d\n",i,entry.unknown,entry.offset,entry.length,entry.name,(int)entry.type);
 		{
 			FILE *f;
 			char filename[20];
-			dMagnetic2_loader_mw_readresource(pTmpBuf,filename1,sizes,entry.offset,&pTmpBuf[500000],entry.length);
+			dMagnetic2_loader_mw_readresource(pRsc,entry.offset,&pTmpBuf[500000],entry.length);
 
 
 			snprintf(filename,20,"extract_%s.%02d",entry.name,(int)entry.type);
@@ -798,6 +928,7 @@ int dMagnetic2_loader_mw_extractall(char* filename1,
 		}
 		diroffset+=(DIR_ENTRY_SIZE);
 	}
+	dMagnetic2_loader_mw_closersc(pRsc);
 	return retval;	
 }
 
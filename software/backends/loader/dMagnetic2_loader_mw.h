@@ -29,13 +29,15 @@
 
 
 #include "dMagnetic2_loader.h"
+#include "dMagnetic2_loader_shared.h"
 int dMagnetic2_loader_mw_getsize(int *pBytes);
+int dMagnetic2_loader_mw_sniff(tdMagnetic2_loader_sniff* pSniff);
 
 int dMagnetic2_loader_mw(
 		char* filename1,
 		unsigned char* pTmpBuf,int tmpsize,
-		unsigned char* pMagBuf,
-		unsigned char* pGfxBuf,
+		unsigned char* pMagBuf,int magcapacity,
+		unsigned char* pGfxBuf,int gfxcapacity,
 		tdMagnetic2_game_meta *pMeta);
 
 #endif
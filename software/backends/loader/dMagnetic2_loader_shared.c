@@ -25,6 +25,14 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef	DMAGNETIC2_LOADER_THREADS
+#include <pthread.h>
+#endif
 #include "dMagnetic2_errorcodes.h"
 #include "dMagnetic2_shared.h"
 #include "dMagnetic2_loader_shared.h"
@@ -35,56 +43,150 @@
 // within the tree, there are branches and terminal symbols.
 // the terminal symbols have bit 7 set, and are thus smaller than 8 bit.
 // to be able to encode full 8 bit bytes, 4 symbols are being combined into 3 bytes.
-int dMagnetic2_loader_shared_unhuffer(unsigned char* input,int length,unsigned char* output)
+// the decoder looks up UNHUFFER_LOOKUPBITS bits at a time in a table, which is being built from the tree.
+// each entry holds the number of bits it consumed, and either a terminal symbol or the branch in which
+// the lookup ended. codes which are longer than the table are being followed one bit at a time.
+#define	UNHUFFER_LOOKUPBITS	10
+#define	UNHUFFER_BRANCH(entry)	((entry)&0xff)
+#define	UNHUFFER_BITS(entry)	((entry)>>8)
+#define	UNHUFFER_ENTRY(bits,value)	(((bits)<<8)|(value))
+
+static void dMagnetic2_loader_shared_unhuffer_fill(unsigned short* pTable,int prefix,int bits,unsigned short entry)
+{
+	int i;
+	int first;
+	int cnt;
+	first=prefix<<(UNHUFFER_LOOKUPBITS-bits);
+	cnt=1<<(UNHUFFER_LOOKUPBITS-bits);
+	for (i=0;i<cnt;i++)
+	{
+		pTable[first+i]=entry;
+	}
+}
+static void dMagnetic2_loader_shared_unhuffer_table(const unsigned char* input,int treesize,unsigned short* pTable)
+{
+	int stack_node[UNHUFFER_LOOKUPBITS+1];
+	int stack_prefix[UNHUFFER_LOOKUPBITS+1];
+	int stack_bits[UNHUFFER_LOOKUPBITS+1];
+	int sp;
+
+	// walk the tree depth-first, starting at the root.
+	sp=0;
+	stack_node[sp]=0;
+	stack_prefix[sp]=0;
+	stack_bits[sp]=0;
+	sp++;
+	while (sp)
+	{
+		int node;
+		int prefix;
+		int bits;
+		int bit;
+
+		sp--;
+		node=stack_node[sp];
+		prefix=stack_prefix[sp];
+		bits=stack_bits[sp];
+		for (bit=0;bit<2;bit++)
+		{
+			unsigned char branch;
+			branch=input[(bit?1:2)+2*node];
+			if (branch&0x80)
+			{
+				dMagnetic2_loader_shared_unhuffer_fill(pTable,(prefix<<1)|bit,bits+1,UNHUFFER_ENTRY(bits+1,branch));
+			} else if (bits+1==UNHUFFER_LOOKUPBITS || 2*branch>treesize) {
+				// the table is full, or the branch is outside of the tree. (damaged images)
+				// either way, the rest is being decoded bit by bit.
+				dMagnetic2_loader_shared_unhuffer_fill(pTable,(prefix<<1)|bit,bits+1,UNHUFFER_ENTRY(bits+1,branch));
+			} else {
+				stack_node[sp]=branch;
+				stack_prefix[sp]=(prefix<<1)|bit;
+				stack_bits[sp]=bits+1;
+				sp++;
+			}
+		}
+	}
+}
+int dMagnetic2_loader_shared_unhuffer(const unsigned char* input,int length,unsigned char* output,int maxlen)
 {
+	unsigned short table[1<<UNHUFFER_LOOKUPBITS];
+	unsigned char symbols[4];
+	unsigned long long bitbuf;	// the next bits from the stream, MSB first
+	int bitcnt;
 	int outputidx;
-	unsigned char byte;
-	unsigned char mask;
 	int bitidx;
 	int treesize;
 	int treeidx;
 	int threecnt;
+	int i;
 
-	treeidx=0;
 	treesize=input[0];
 	bitidx=3+treesize;	// start decoding the bitstream directly after the tree
+	if (bitidx>=length)
+	{
+		return 0;
+	}
+	dMagnetic2_loader_shared_unhuffer_table(input,treesize,table);
+
+	treeidx=0;
 	threecnt=0;
 	outputidx=0;
-	mask=0;
-	byte=0;
-	while (bitidx<length || mask)
+	bitbuf=0;
+	bitcnt=0;
+	while (1)
 	{
-		unsigned char branch1,branch0;
 		unsigned char branch;
-
-		branch1=input[1+2*treeidx];
-		branch0=input[2+2*treeidx];
-		if (mask==0)
+		while (bitcnt<=56 && bitidx<length)
+		{
+			bitbuf|=((unsigned long long)input[bitidx++])<<(56-bitcnt);
+			bitcnt+=8;
+		}
+		if (bitcnt==0)
 		{
-			mask=0x80;
-			byte=input[bitidx++];
+			break;
+		}
+		branch=0;
+		if (treeidx==0 && UNHUFFER_BITS(table[bitbuf>>(64-UNHUFFER_LOOKUPBITS)])<=bitcnt)	// at the root, and enough bits left for the table
+		{
+			unsigned short entry;
+			entry=table[bitbuf>>(64-UNHUFFER_LOOKUPBITS)];
+			bitbuf<<=UNHUFFER_BITS(entry);
+			bitcnt-=UNHUFFER_BITS(entry);
+			branch=UNHUFFER_BRANCH(entry);
+		} else {
+			branch=(bitbuf>>63)?input[1+2*treeidx]:input[2+2*treeidx];
+			bitbuf<<=1;
+			bitcnt--;
 		}
-		branch=(byte&mask)?branch1:branch0;
-		mask>>=1;
 
 		if (branch&0x80)	// the branch was a terminal symbol.
 		{
-			branch&=0x7f;
-			if (threecnt==3)	// this is the fourth symbol. distribute the bits within this symbol to the previous three.
+			symbols[threecnt++]=branch&0x7f;
+			if (threecnt==4)	// this is the fourth symbol. distribute the bits within this symbol to the previous three.
 			{
-				output[outputidx-3]|=((branch>>4)&0x3)<<6;
-				output[outputidx-2]|=((branch>>2)&0x3)<<6;
-				output[outputidx-1]|=((branch>>0)&0x3)<<6;
+				if (output!=NULL && outputidx+3<=maxlen)
+				{
+					output[outputidx+0]=symbols[0]|(((symbols[3]>>4)&0x3)<<6);
+					output[outputidx+1]=symbols[1]|(((symbols[3]>>2)&0x3)<<6);
+					output[outputidx+2]=symbols[2]|(((symbols[3]>>0)&0x3)<<6);
+				}
+				outputidx+=3;
 				threecnt=0;
-			} else {
-				output[outputidx++]=branch;
-				threecnt++;
 			}
 			treeidx=0;
 		} else {
 			treeidx=branch;	// follow the branch
 		}
 	}
+	// the stream might end in the middle of a group.
+	for (i=0;i<threecnt;i++)
+	{
+		if (output!=NULL && outputidx<maxlen)
+		{
+			output[outputidx]=symbols[i];
+		}
+		outputidx++;
+	}
 	return outputidx;
 }
 
@@ -135,7 +237,7 @@ int dMagnetic2_loader_shared_addmagheader(unsigned char* magbuf,int magsize,int
 }
 #define	BLOCKSIZE	256
 #define	MAXPIVOT	8
-int dMagnetic2_loader_shared_descramble(unsigned char* inptr,unsigned char* outptr,int pivot,unsigned char *lastchar,int rle)
+int dMagnetic2_loader_shared_descramble(const unsigned char* inptr,unsigned char* outptr,int maxlen,int pivot,unsigned char *lastchar,int rle)
 {
 
 	unsigned char tmp[BLOCKSIZE];
@@ -178,10 +280,18 @@ int dMagnetic2_loader_shared_descramble(unsigned char* inptr,unsigned char* outp
 		{
 			for (j=0;j<tmp[i]-1;j++)
 			{
-				outptr[outcnt++]=0;
+				if (outptr!=NULL && outcnt<maxlen)
+				{
+					outptr[outcnt]=0;
+				}
+				outcnt++;
 			}
 		} else {
-			outptr[outcnt++]=tmp[i];
+			if (outptr!=NULL && outcnt<maxlen)
+			{
+				outptr[outcnt]=tmp[i];
+			}
+			outcnt++;
 		}
 		lc=tmp[i];
 	}
@@ -192,3 +302,118 @@ int dMagnetic2_loader_shared_descramble(unsigned char* inptr,unsigned char* outp
 	return outcnt;
 }
 
+// the disk images are mapped read-only, and the decoders work on the mapping directly.
+// like the fread() before, at most maxlen+1 bytes are being made available. so a len
+// of maxlen+1 means that the file was too big.
+// when the file can not be mapped (a pipe, or an empty file), it is being read into
+// pFallbackBuf instead, which has to hold maxlen+1 bytes.
+int dMagnetic2_loader_shared_openimage(tdMagnetic2_loader_image* pImage,char* filename,unsigned char* pFallbackBuf,int maxlen)
+{
+	FILE *f;
+	memset(pImage,0,sizeof(tdMagnetic2_loader_image));
+	if (filename==NULL)
+	{
+		return DMAGNETIC2_OK;
+	}
+#ifndef	DMAGNETIC2_LOADER_NO_MMAP
+	{
+		int fd;
+		struct stat st;
+		fd=open(filename,O_RDONLY);
+		if (fd<0)
+		{
+			return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+		}
+		if (fstat(fd,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0)
+		{
+			size_t maplen;
+			void *pMap;
+			maplen=((size_t)st.st_size>(size_t)maxlen+1)?(size_t)maxlen+1:(size_t)st.st_size;
+			pMap=mmap(NULL,maplen,PROT_READ,MAP_PRIVATE,fd,0);
+			if (pMap!=MAP_FAILED)
+			{
+				close(fd);
+				pImage->pData=(const unsigned char*)pMap;
+				pImage->len=(int)maplen;
+				pImage->pMapping=pMap;
+				pImage->mappinglen=maplen;
+				return DMAGNETIC2_OK;
+			}
+		}
+		close(fd);
+	}
+#endif
+	if (pFallbackBuf==NULL)
+	{
+		return DMAGNETIC2_ERROR_NULLPTR;
+	}
+	f=fopen(filename,"rb");
+	if (f==NULL)
+	{
+		return DMAGNETIC2_UNABLE_TO_OPEN_FILE;
+	}
+	pImage->len=fread(pFallbackBuf,sizeof(char),maxlen+1,f);
+	fclose(f);
+	pImage->pData=pFallbackBuf;
+	return DMAGNETIC2_OK;
+}
+void dMagnetic2_loader_shared_closeimage(tdMagnetic2_loader_image* pImage)
+{
+	if (pImage->pMapping!=NULL)
+	{
+		munmap(pImage->pMapping,pImage->mappinglen);
+	}
+	memset(pImage,0,sizeof(tdMagnetic2_loader_image));
+}
+#ifdef	DMAGNETIC2_LOADER_THREADS
+static void* dMagnetic2_loader_shared_jobthread(void* pArg)
+{
+	tdMagnetic2_loader_job* pJob=(tdMagnetic2_loader_job*)pArg;
+	pJob->retval=pJob->pFunc(pJob->pArg);
+	return NULL;
+}
+#endif
+int dMagnetic2_loader_shared_runjobs(tdMagnetic2_loader_job* pJobs,int jobcnt)
+{
+	int i;
+#ifdef	DMAGNETIC2_LOADER_THREADS
+	pthread_t threads[DMAGNETIC2_LOADER_MAXJOBS];
+	int started[DMAGNETIC2_LOADER_MAXJOBS]={0};
+#endif
+	if (jobcnt>DMAGNETIC2_LOADER_MAXJOBS)
+	{
+		return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL;
+	}
+#ifdef	DMAGNETIC2_LOADER_THREADS
+	for (i=1;i<jobcnt;i++)
+	{
+		started[i]=(pthread_create(&threads[i],NULL,dMagnetic2_loader_shared_jobthread,&pJobs[i])==0);
+	}
+	for (i=0;i<jobcnt;i++)
+	{
+		if (started[i])
+		{
+			pthread_join(threads[i],NULL);
+		} else {	// the first job, or a thread could not be started
+			pJobs[i].retval=pJobs[i].pFunc(pJobs[i].pArg);
+		}
+	}
+#else
+	for (i=0;i<jobcnt;i++)
+	{
+		pJobs[i].retval=pJobs[i].pFunc(pJobs[i].pArg);
+		if (pJobs[i].retval!=DMAGNETIC2_OK)	// no need to do the rest
+		{
+			return pJobs[i].retval;
+		}
+	}
+#endif
+	for (i=0;i<jobcnt;i++)
+	{
+		if (pJobs[i].retval!=DMAGNETIC2_OK)
+		{
+			return pJobs[i].retval;
+		}
+	}
+	return DMAGNETIC2_OK;
+}
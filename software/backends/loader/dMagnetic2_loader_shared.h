@@ -27,10 +27,70 @@
 #ifndef DMAGNETIC2_LOADER_SHARED_H
 #define	DMAGNETIC2_LOADER_SHARED_H
 
+#include <stddef.h>
+#include "dMagnetic2_metrics_shared.h"
 
-int dMagnetic2_loader_shared_unhuffer(unsigned char* input,int length,unsigned char* output);
+
+// the unhuffer and the descrambler return the number of bytes they produced. with a NULL output, they only count them.
+// this is how the loaders find out the sizes of the .mag and .gfx without writing them.
+#define	OUTPUT_AT(pBuf,idx)	(((pBuf)==NULL)?NULL:&(pBuf)[idx])
+// the output buffers come with their capacities. a part which would not fit is only counted, as if the buffer was NULL.
+// the loader then returns DMAGNETIC2_ERROR_BUFFER_TOO_SMALL, before it reads or writes the buffer again.
+// the unhuffer and the descrambler do not know their output size in advance. they stop writing after maxlen bytes.
+#define	OUTPUT_FITS(pBuf,idx,len,capacity)	(((pBuf)==NULL || (idx)+(len)>(capacity))?NULL:&(pBuf)[idx])
+#define	OUTPUT_ROOM(idx,capacity)	(((capacity)>(idx))?((capacity)-(idx)):0)
+int dMagnetic2_loader_shared_unhuffer(const unsigned char* input,int length,unsigned char* output,int maxlen);
 int dMagnetic2_loader_shared_addmagheader(unsigned char* magbuf,int magsize,int version,int codesize,int string1size,int string2size,int dictsize,int huffmantreeidx);
-int dMagnetic2_loader_shared_descramble(unsigned char* inptr,unsigned char* outptr,int pivot,unsigned char *lastchar,int rle);
+int dMagnetic2_loader_shared_descramble(const unsigned char* inptr,unsigned char* outptr,int maxlen,int pivot,unsigned char *lastchar,int rle);
 int dMagnetic2_loader_shared_prbs_descrambler(unsigned char* outputbuf,int len,unsigned short startvalue,unsigned short increment);
 
+// a read-only view of one input file. either mapped, or read into a part of the tmp buffer.
+typedef struct _tdMagnetic2_loader_image
+{
+	const unsigned char* pData;	// NULL when no filename was given
+	int len;
+	void* pMapping;			// NULL when the file has not been mapped
+	size_t mappinglen;
+} tdMagnetic2_loader_image;
+int dMagnetic2_loader_shared_openimage(tdMagnetic2_loader_image* pImage,char* filename,unsigned char* pFallbackBuf,int maxlen);
+void dMagnetic2_loader_shared_closeimage(tdMagnetic2_loader_image* pImage);
+
+// independent parts of a conversion, like building the .mag and the .gfx images. they run one after the other,
+// or, with DMAGNETIC2_LOADER_THREADS, concurrently. the first job stays in the calling thread.
+#define	DMAGNETIC2_LOADER_MAXJOBS	4
+typedef struct _tdMagnetic2_loader_job
+{
+	int (*pFunc)(void* pArg);
+	void* pArg;
+	int retval;
+} tdMagnetic2_loader_job;
+// returns the first error, in the order of the jobs
+int dMagnetic2_loader_shared_runjobs(tdMagnetic2_loader_job* pJobs,int jobcnt);
+
+// what is known about the input files before any loader reads them: their sizes and the first bytes.
+// the sub-loaders use it to rule themselves out. a size or header of -1 is unknown, and can not rule out anything.
+#define	DMAGNETIC2_LOADER_SNIFF_FILES		3
+#define	DMAGNETIC2_LOADER_SNIFF_HEADERSIZE	16
+typedef struct _tdMagnetic2_loader_sniff
+{
+	char* filename[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int present[DMAGNETIC2_LOADER_SNIFF_FILES];	// a filename was given
+	int isdir[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int size[DMAGNETIC2_LOADER_SNIFF_FILES];
+	int headerlen[DMAGNETIC2_LOADER_SNIFF_FILES];
+	unsigned char header[DMAGNETIC2_LOADER_SNIFF_FILES][DMAGNETIC2_LOADER_SNIFF_HEADERSIZE];
+} tdMagnetic2_loader_sniff;
+#define	SNIFF_SIZE_IS(pSniff,i,n)	((pSniff)->size[i]<0 || (pSniff)->size[i]==(n))
+#define	SNIFF_HEADER_IS(pSniff,i,magic,len)	((pSniff)->headerlen[i]<0 || ((pSniff)->headerlen[i]>=(len) && memcmp((pSniff)->header[i],(magic),(len))==0))
+
+// the counters for the whole process, see dMagnetic2_loader_metrics.c
+typedef struct _tdMagnetic2_loader_metrics_atomic
+{
+	tdMagnetic2_metrics_histogram_atomic attempts[DMAGNETIC2_METRICS_LOADERS];
+	atomic_ullong loaded[DMAGNETIC2_METRICS_LOADERS];
+	atomic_ullong cache_hits;
+	atomic_ullong cache_misses;
+} tdMagnetic2_loader_metrics_atomic;
+extern tdMagnetic2_loader_metrics_atomic dMagnetic2_loader_metrics;
+
 #endif
@@ -0,0 +1,108 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_METRICS_SHARED_H
+#define	DMAGNETIC2_METRICS_SHARED_H
+
+#include "dMagnetic2_metrics.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+// the counters behind dMagnetic2_metrics.h. every library has its own set of them.
+
+typedef struct _tdMagnetic2_metrics_histogram_atomic
+{
+	atomic_ullong count;
+	atomic_ullong sum_us;
+	atomic_ullong buckets[DMAGNETIC2_METRICS_BUCKETS];
+} tdMagnetic2_metrics_histogram_atomic;
+
+#ifdef	DMAGNETIC2_NO_METRICS
+#define	METRICS_ADD(x,n)		{(void)(n);}
+#define	METRICS_NOW()			0
+#define	METRICS_HISTOGRAM(pHist,us)	{(void)(us);}
+#else
+#define	METRICS_ADD(x,n)		atomic_fetch_add_explicit(&(x),(n),memory_order_relaxed)
+#define	METRICS_NOW()			dMagnetic2_metrics_now_us()
+#define	METRICS_HISTOGRAM(pHist,us)	dMagnetic2_metrics_histogram_add((pHist),(us))
+#endif
+#define	METRICS_LOAD(x)			atomic_load_explicit(&(x),memory_order_relaxed)
+
+static inline unsigned long long dMagnetic2_metrics_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ((unsigned long long)ts.tv_sec)*1000000ULL+ts.tv_nsec/1000;
+}
+static inline void dMagnetic2_metrics_histogram_add(tdMagnetic2_metrics_histogram_atomic* pHist,unsigned long long us)
+{
+	int i;
+	i=0;
+	while (i<DMAGNETIC2_METRICS_BUCKETS-1 && (1ULL<<i)<=us)
+	{
+		i++;
+	}
+	atomic_fetch_add_explicit(&(pHist->count),1,memory_order_relaxed);
+	atomic_fetch_add_explicit(&(pHist->sum_us),us,memory_order_relaxed);
+	atomic_fetch_add_explicit(&(pHist->buckets[i]),1,memory_order_relaxed);
+}
+static inline void dMagnetic2_metrics_histogram_get(tdMagnetic2_metrics_histogram_atomic* pHist,tdMagnetic2_metrics_histogram* pOut)
+{
+	int i;
+	pOut->count=METRICS_LOAD(pHist->count);
+	pOut->sum_us=METRICS_LOAD(pHist->sum_us);
+	for (i=0;i<DMAGNETIC2_METRICS_BUCKETS;i++)
+	{
+		pOut->buckets[i]=METRICS_LOAD(pHist->buckets[i]);
+	}
+}
+
+// appending to a text buffer. idx keeps counting after an overflow, so the caller can detect it.
+#define	METRICS_PRINTF(pBuf,bufsize,idx,...)	{	\
+	int n;	\
+	n=snprintf(((idx)<(bufsize))?&(pBuf)[(idx)]:NULL,((idx)<(bufsize))?(bufsize)-(idx):0,__VA_ARGS__);	\
+	(idx)+=n;	\
+}
+// the buckets are cumulative in the text format
+static inline int dMagnetic2_metrics_histogram_text(char* pBuf,int bufsize,int idx,const char* name,const char* label,tdMagnetic2_metrics_histogram* pHist)
+{
+	unsigned long long sum;
+	int i;
+	sum=0;
+	for (i=0;i<DMAGNETIC2_METRICS_BUCKETS-1;i++)
+	{
+		sum+=pHist->buckets[i];
+		METRICS_PRINTF(pBuf,bufsize,idx,"%s_bucket{%s,le=\"%llu\"} %llu\n",name,label,(1ULL<<i)-1,sum);
+	}
+	METRICS_PRINTF(pBuf,bufsize,idx,"%s_bucket{%s,le=\"+Inf\"} %llu\n",name,label,pHist->count);
+	METRICS_PRINTF(pBuf,bufsize,idx,"%s_sum{%s} %llu\n",name,label,pHist->sum_us);
+	METRICS_PRINTF(pBuf,bufsize,idx,"%s_count{%s} %llu\n",name,label,pHist->count);
+	return idx;
+}
+
+#endif
@@ -0,0 +1,52 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_CATALOG_H
+#define	DMAGNETIC2_CATALOG_H
+
+#include "dMagnetic2_loader.h"
+
+// the catalog loads every installed game once, and keeps the mag and gfx buffers for the
+// whole process. sessions attach to a game by its id: the mag buffer is shared between all of
+// the engine handles playing it, the gfx buffer between all of the graphics handles.
+//
+// the buffers are packed into the memory given to dMagnetic2_catalog_init(). the temporary
+// buffer is only needed while games are being added, and can be released afterwards.
+// the catalog itself is read only after the last dMagnetic2_catalog_add(), so it can be used
+// from several threads at once.
+
+#define	DMAGNETIC2_CATALOG_MAX_GAMES	32
+
+int dMagnetic2_catalog_getsize(int *pSize_handle,int *pSize_tmpbuf);	// the minimum size of the handle, without any game in it
+int dMagnetic2_catalog_init(void *pHandle,int size,void *pTmpBuf);
+int dMagnetic2_catalog_add(void *pHandle,char* filename1,char* filename2,char* filename3,int nodoc,int *pId);
+
+int dMagnetic2_catalog_get_count(void *pHandle,int *pCnt);
+int dMagnetic2_catalog_find(void *pHandle,edMagnetic2_game game,int *pId);
+int dMagnetic2_catalog_get_game(void *pHandle,int id,unsigned char** ppMagBuf,unsigned char** ppGfxBuf,int *pGfxSize,tdMagnetic2_game_meta *pMeta);
+
+#endif
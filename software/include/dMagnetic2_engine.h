@@ -47,7 +47,12 @@
 
 // API functions for initialization
 
+// games writing into their dictionary get a private copy of it, right behind the handle. dMagnetic2_engine_get_size()
+// is enough for every game, dMagnetic2_engine_get_size_for_mag() returns the size for this particular one.
+// the handle remembers the size of the first game set after dMagnetic2_engine_init(). setting another one with a larger
+// dictionary returns DMAGNETIC2_ERROR_BUFFER_TOO_SMALL.
 int dMagnetic2_engine_get_size(int *pBytes);
+int dMagnetic2_engine_get_size_for_mag(unsigned char* pMagBuf,int *pBytes);
 int dMagnetic2_engine_init(void *pHandle);
 int dMagnetic2_engine_set_mag(void *pHandle,unsigned char* pMagBuf);
 //int dMagnetic2_engine_set_sections(void* pHandle,int memsize,unsigned char *pMem,int dictsize,unsigned char *pDict, int string1size,unsigned char *pString1,int string2size,unsigned char* pString2);
@@ -64,6 +69,39 @@ int dMagnetic2_engine_get_filename(void* pHandle,char** ppFilename);
 int dMagnetic2_engine_save_game(void* pHandle,int *pSize,void* pContext);
 int dMagnetic2_engine_load_game(void* pHandle,int pSize,void* pContext);
 
+// API functions for cooperative scheduling
+// dMagnetic2_engine_step() runs the game for at most quantum iterations (traps included, 0 means no limit), and
+// returns earlier when the caller has something to do. *pYield tells why it returned. all the state is in the handle,
+// so a single thread can take turns with many sessions, from an event loop or a coroutine.
+//   YIELD_QUANTUM: the quantum has expired. call again.
+//   YIELD_INPUT: the game is waiting for input. call dMagnetic2_engine_new_input() first.
+//   YIELD_OUTPUT: the output buffer is filling up. call dMagnetic2_engine_get_text() first, otherwise it will not continue.
+//   YIELD_PICTURE: a NEW_PICTURE flag has been set. the next one is only reported once it has been picked up.
+#define	DMAGNETIC2_ENGINE_YIELD_NONE		0
+#define	DMAGNETIC2_ENGINE_YIELD_QUANTUM		(1<<0)
+#define	DMAGNETIC2_ENGINE_YIELD_INPUT		(1<<1)
+#define	DMAGNETIC2_ENGINE_YIELD_OUTPUT		(1<<2)
+#define	DMAGNETIC2_ENGINE_YIELD_PICTURE		(1<<3)
+#define	DMAGNETIC2_ENGINE_YIELD_ALL		(DMAGNETIC2_ENGINE_YIELD_QUANTUM|DMAGNETIC2_ENGINE_YIELD_INPUT|DMAGNETIC2_ENGINE_YIELD_OUTPUT|DMAGNETIC2_ENGINE_YIELD_PICTURE)
+#define	DMAGNETIC2_ENGINE_OUTPUT_RESERVE	1024	// YIELD_OUTPUT when fewer bytes than this are left in the output buffer
+int dMagnetic2_engine_step(void* pHandle,int quantum,unsigned int* pYield,unsigned int* pStatus);
+
+// API functions for idle sessions
+// dMagnetic2_engine_hibernate() stores the state of the session in pBuf. (*pSize is the size of the buffer, and returns the
+// number of bytes used. with pBuf==NULL, only the size is returned.) afterwards, only the first DMAGNETIC2_SIZE_HIBERNATED
+// bytes of the handle are in use, the rest of it can be freed or reused. the stub reports that it is waiting for input.
+// when the rest of the handle, pBuf and the mag buffer are still there, the next call to dMagnetic2_engine_new_input()
+// resumes the session automatically. every other call on the stub fails until the session has been resumed.
+// dMagnetic2_engine_resume() restores a session explicitly into a handle with the full size for this game. this can
+// be the same memory again, or another handle, for example after pBuf has been read from a file.
+#define	DMAGNETIC2_SIZE_HIBERNATED		64
+int dMagnetic2_engine_hibernate(void* pHandle,int *pSize,void* pBuf);
+int dMagnetic2_engine_resume(void* pHandle,unsigned char* pMagBuf,int size,void* pBuf);
+
+// API functions for comparing sessions
+// two sessions with the same state hash will react the same way to the same input.
+int dMagnetic2_engine_get_statehash(void* pHandle,unsigned long long *pHash);
+
 // API functions for configuration
 int dMagnetic2_engine_configure(void* pHandle,int* todo);
 
@@ -0,0 +1,66 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_ENGINE_MEMO_H
+#define	DMAGNETIC2_ENGINE_MEMO_H
+
+#include "dMagnetic2_engine.h"
+
+// the memo cache remembers how the game has reacted to an input line. when another session
+// (or the same one, after a restart) is in the same state and enters the same line, the
+// recorded output and the changes to the state are applied, without running the virtual machine.
+//
+// the cache lives in a buffer provided by the caller, and never grows beyond it. when it is full,
+// it is flushed. it can be shared between all the sessions playing the same game, but it is not
+// thread safe.
+//
+// dMagnetic2_engine_memo_step() replaces dMagnetic2_engine_new_input() followed by
+// dMagnetic2_engine_process(). it only takes a single line, ending with '\n'. when the session
+// is not idle (the text or the title have not been fetched, save or load is pending), the line is
+// just passed on to the engine.
+
+#define	DMAGNETIC2_ENGINE_MEMO_MINSIZE	(256*1024)
+
+typedef struct _tdMagnetic2_engine_memo_stats
+{
+	unsigned int lookups;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int bypassed;		// the session was not in a state which could be cached
+	unsigned int recorded;
+	unsigned int flushes;
+	int entries;
+	int bytesused;
+	int bytesavailable;
+} tdMagnetic2_engine_memo_stats;
+
+int dMagnetic2_engine_memo_init(void* pMemo,int size);
+int dMagnetic2_engine_memo_flush(void* pMemo);
+int dMagnetic2_engine_memo_step(void* pMemo,void* pHandle,int len,char* pInput,unsigned int* pStatus);
+int dMagnetic2_engine_memo_get_stats(void* pMemo,tdMagnetic2_engine_memo_stats* pStats);
+
+#endif
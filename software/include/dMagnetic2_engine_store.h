@@ -0,0 +1,58 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_ENGINE_STORE_H
+#define	DMAGNETIC2_ENGINE_STORE_H
+
+#include "dMagnetic2_engine.h"
+
+// the session store keeps many engine handles in one file, which is mapped into memory.
+// every slot holds one handle, and the engine is running directly on top of it. after the
+// host has been restarted, the file is opened again, and the sessions continue where they
+// have been left. no saving, no loading, no replaying of the inputs.
+//
+// the file is in the native format of the machine, and it belongs to one game. opening it
+// with a different mag buffer, with a build of the engine whose handle layout differs, or on a system with a
+// different page size, is refused. attaching a slot whose state is out of range returns DMAGNETIC2_UNKNOWN_SOURCE.
+// hibernated handles can not be kept in the store.
+
+#define	DMAGNETIC2_ENGINE_STORE_SLOT_FREE	0
+#define	DMAGNETIC2_ENGINE_STORE_SLOT_USED	1
+
+int dMagnetic2_engine_store_get_size(int *pBytes);
+int dMagnetic2_engine_store_init(void *pStore);
+// open an existing file, or create a new one with slots empty slots. (slots is ignored for existing files)
+int dMagnetic2_engine_store_open(void *pStore,char* filename,int slots,unsigned char* pMagBuf);
+int dMagnetic2_engine_store_get_slotcnt(void *pStore,int *pSlots);
+int dMagnetic2_engine_store_get_slotstate(void *pStore,int slot,int *pState);
+// returns the engine handle in the slot, ready to be used with the dMagnetic2_engine_ functions. a free slot is started as a new game.
+int dMagnetic2_engine_store_attach(void *pStore,int slot,void **ppHandle);
+int dMagnetic2_engine_store_release(void *pStore,int slot);
+int dMagnetic2_engine_store_sync(void *pStore);
+int dMagnetic2_engine_store_close(void *pStore);
+
+#endif
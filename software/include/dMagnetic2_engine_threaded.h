@@ -0,0 +1,65 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef	DMAGNETIC2_ENGINE_THREADED_H
+#define	DMAGNETIC2_ENGINE_THREADED_H
+
+#include "dMagnetic2_engine.h"
+
+// the threaded wrapper runs the engine in a thread of its own.
+// the frontend hands over its input lines, and receives the output as events. both directions
+// are single-producer/single-consumer ring buffers, so neither side has to wait for the other.
+// 
+// the file descriptor from dMagnetic2_engine_threaded_get_fd() becomes readable whenever new
+// events are available. it can be added to a select/poll/epoll loop. after it has become
+// readable, call dMagnetic2_engine_threaded_get_event() until it reports DMAGNETIC2_ENGINE_STATUS_NONE.
+//
+// the event types are the DMAGNETIC2_ENGINE_STATUS_ flags, one per event:
+//   NEW_TEXT, NEW_TITLE, NEW_PICTURE_NAME, SAVE, LOAD: the text/title/name/filename is in the buffer.
+//   NEW_PICTURE_NUM: the picture number is the value.
+//   WAITING_FOR_INPUT, RESTART, QUIT: no payload.
+//   ERROR: the engine has stopped. the value is the return code from dMagnetic2_engine_process().
+//
+// the handle has to be aligned to DMAGNETIC2_ENGINE_THREADED_ALIGNMENT bytes, since the ring buffer
+// indices are kept on cache lines of their own. malloc() is not enough, use aligned_alloc() or posix_memalign().
+
+#define	DMAGNETIC2_ENGINE_THREADED_EVENT_ERROR		(1<<16)
+#define	DMAGNETIC2_ENGINE_THREADED_ALIGNMENT		64	// one cache line
+#define	DMAGNETIC2_ENGINE_THREADED_SIZE_EVENTBUF	(DMAGNETIC2_SIZE_OUTPUTBUF+1)	// big enough for every payload
+
+// API functions for initialization
+int dMagnetic2_engine_threaded_get_size(int *pBytes);
+int dMagnetic2_engine_threaded_init(void *pHandle);
+int dMagnetic2_engine_threaded_set_mag(void *pHandle,unsigned char* pMagBuf);
+
+// API functions for running the game
+int dMagnetic2_engine_threaded_start(void *pHandle);
+int dMagnetic2_engine_threaded_stop(void *pHandle);
+int dMagnetic2_engine_threaded_get_fd(void *pHandle,int *pFd);
+int dMagnetic2_engine_threaded_new_input(void *pHandle,int len,char* pInput,int *pCnt);
+int dMagnetic2_engine_threaded_get_event(void *pHandle,unsigned int *pType,int *pValue,char* pBuf,int bufsize);
+
+#endif
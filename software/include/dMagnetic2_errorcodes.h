@@ -40,5 +40,8 @@
 #define	DMAGNETIC2_ERROR_WRONG_PICTUREFORMAT	-3
 #define	DMAGNETIC2_UNABLE_TO_OPEN_FILE		-4
 #define	DMAGNETIC2_ERROR_NULLPTR		-5
+#define	DMAGNETIC2_ERROR_STORE_MISMATCH		-6
+#define	DMAGNETIC2_ERROR_INVALID_SLOT		-7
+#define	DMAGNETIC2_ERROR_NO_RESOURCES		-8
 
 #endif
@@ -0,0 +1,58 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_INSTANCE_H
+#define	DMAGNETIC2_INSTANCE_H
+
+#include "dMagnetic2_loader.h"
+
+// an instance is one game, with its engine and its graphics, placed in one block of memory.
+// instead of querying the sizes of the engine, the loader and the graphics, and allocating
+// the handles, the temporary buffers and the maximum sized mag and gfx buffers separately,
+// the caller only provides the arena.
+//
+// while the game is being loaded, the arena is used for the loader. afterwards, the mag and the
+// gfx buffer are moved to the end of the handles, with their real sizes. the memory from
+// *pUsed onwards is no longer needed, and can be given back (for example with munmap() or madvise()).
+//
+// an arena of *pSize_load bytes can load any game. a smaller one needs the sizes from dMagnetic2_instance_probe(),
+// which only needs *pSize_probe bytes. the probe decodes the images as well, so the game is decoded twice.
+// a probed arena can be initialized again with the reported size, or a new one can be allocated.
+// files which have grown since the probe make the load return DMAGNETIC2_ERROR_BUFFER_TOO_SMALL, without writing past the arena.
+//
+// the arena has to be aligned to DMAGNETIC2_INSTANCE_ALIGNMENT bytes. the handles are pointing into
+// the arena, so it must not be moved.
+
+#define	DMAGNETIC2_INSTANCE_ALIGNMENT	64	// one cache line
+
+int dMagnetic2_instance_getsize(int *pSize_probe,int *pSize_load);
+int dMagnetic2_instance_init(void *pArena,int size);
+int dMagnetic2_instance_probe(void *pArena,char* filename1,char* filename2,char* filename3,int nodoc,tdMagnetic2_game_meta *pProbed,int *pSize_arena);
+int dMagnetic2_instance_load(void *pArena,char* filename1,char* filename2,char* filename3,int nodoc,tdMagnetic2_game_meta *pProbed,int *pUsed);	// pProbed==NULL: the maximum sizes
+int dMagnetic2_instance_get_handles(void *pArena,void** ppEngine,void** ppGraphics,tdMagnetic2_game_meta *pMeta);
+
+#endif
@@ -57,8 +57,9 @@ typedef enum _edMagnetic2_source
 
 
 
-#define	DMAGNETIC2_MAX_MAGSIZE		(1<<20)		// TODO
-#define	DMAGNETIC2_MAX_GFXSIZE		(4<<20)		// TODO
+// the worst case for any game. dMagnetic2_loader_probe() reports the exact sizes.
+#define	DMAGNETIC2_MAX_MAGSIZE		(1<<20)
+#define	DMAGNETIC2_MAX_GFXSIZE		(4<<20)
 
 typedef struct _tdMagnetic2_game_meta
 {
@@ -73,6 +74,25 @@ typedef struct _tdMagnetic2_game_meta
 
 int dMagnetic2_loader_getsize(int * size_handle,int* size_tmpbuf);
 int dMagnetic2_loader_init(void *pHandle,void *pTmpBuf);
+// optional: a directory in which the converted images are kept. loading the same images again
+// just maps the result, instead of decoding them. NULL turns it off. the string has to stay valid.
+// .mag/.gfx files are never cached, since they are already the result. neither are the MS-DOS and
+// Magnetic Windows releases, because the other files in their directories are not part of the key.
+// (for those, a lookup might still be counted as a miss in the metrics, but nothing is stored.)
+int dMagnetic2_loader_set_cachedir(void *pHandle,char* cachedir);
 
-int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filename3,unsigned char* pMagBuf, unsigned char* pGfxBuf,tdMagnetic2_game_meta *pMeta,int nodoc);
+// a NULL pMagBuf or pGfxBuf is not written, but its real size is being reported in the meta data anyway.
+// the capacities are the sizes of the buffers. when a game does not fit, DMAGNETIC2_ERROR_BUFFER_TOO_SMALL
+// is returned, and the real sizes are being reported as well.
+int dMagnetic2_loader(void *pHandle,char* filename1,char* filename2,char* filename3,unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta,int nodoc);
+// finds the game and the exact sizes of the .mag and the .gfx, without writing them. buffers of those sizes
+// are large enough for dMagnetic2_loader(). when the files grow in between, it returns DMAGNETIC2_ERROR_BUFFER_TOO_SMALL.
+// the .mag/.gfx files have to be seekable for this.
+int dMagnetic2_loader_probe(void *pHandle,char* filename1,char* filename2,char* filename3,tdMagnetic2_game_meta *pMeta,int nodoc);
+// the same, but for images which are already in memory. a NULL buffer means no file.
+int dMagnetic2_loader_buffers(void *pHandle,
+		const unsigned char* pBuf1,int len1,
+		const unsigned char* pBuf2,int len2,
+		const unsigned char* pBuf3,int len3,
+		unsigned char* pMagBuf,int magcapacity,unsigned char* pGfxBuf,int gfxcapacity,tdMagnetic2_game_meta *pMeta,int nodoc);
 #endif
@@ -0,0 +1,94 @@
+//
+// BSD 2-Clause License
+//
+// Copyright (c) 2024, dettus@dettus.net
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef	DMAGNETIC2_METRICS_H
+#define	DMAGNETIC2_METRICS_H
+
+// the libraries keep some counters and histograms for the whole process.
+// dMagnetic2_*_get_metrics() returns a snapshot of them. dMagnetic2_*_metrics_text() writes the
+// same snapshot in the text format of prometheus, so a local collector can scrape it.
+// the counters are updated with relaxed atomic operations, and they can be disabled at compile
+// time with -DDMAGNETIC2_NO_METRICS.
+
+#define	DMAGNETIC2_METRICS_BUCKETS	20	// bucket i counts the durations below 2^i microseconds. the last one counts the rest
+
+typedef struct _tdMagnetic2_metrics_histogram
+{
+	unsigned long long count;
+	unsigned long long sum_us;
+	unsigned long long buckets[DMAGNETIC2_METRICS_BUCKETS];
+} tdMagnetic2_metrics_histogram;
+
+// the engine
+typedef struct _tdMagnetic2_engine_metrics
+{
+	unsigned long long instructions;	// steps of the 68000, without the traps. a fused sequence counts as one
+	unsigned long long traps_a[256];	// line-A traps, by the lower byte of the opcode
+	unsigned long long traps_f;		// line-F traps
+	unsigned long long output_bytes;
+	unsigned long long input_waits;
+} tdMagnetic2_engine_metrics;
+
+// the loader. every attempt of a sub-loader is measured, also the ones which did not recognize the files.
+typedef enum _edMagnetic2_metrics_loader
+{
+	DMAGNETIC2_METRICS_LOADER_APPLEII=0,
+	DMAGNETIC2_METRICS_LOADER_ARCHIMEDES,
+	DMAGNETIC2_METRICS_LOADER_ATARIXL,
+	DMAGNETIC2_METRICS_LOADER_C64,
+	DMAGNETIC2_METRICS_LOADER_DSK_AMSTRAD,
+	DMAGNETIC2_METRICS_LOADER_DSK_SPECTRUM,
+	DMAGNETIC2_METRICS_LOADER_MAGGFX,
+	DMAGNETIC2_METRICS_LOADER_MSDOS,
+	DMAGNETIC2_METRICS_LOADER_MW,
+	DMAGNETIC2_METRICS_LOADERS
+} edMagnetic2_metrics_loader;
+
+typedef struct _tdMagnetic2_loader_metrics
+{
+	tdMagnetic2_metrics_histogram attempts[DMAGNETIC2_METRICS_LOADERS];
+	unsigned long long loaded[DMAGNETIC2_METRICS_LOADERS];		// the sub-loader which returned the game
+	unsigned long long cache_hits;		// the converted images were found in the cache directory
+	unsigned long long cache_misses;
+} tdMagnetic2_loader_metrics;
+
+// the graphics. the decoding time is by format: NONE, GFX1, GFX2, MSDOS, MAGWIN, C64, AMSTRAD_CPC, ATARI_XL, APPLE_II
+#define	DMAGNETIC2_METRICS_FORMATS	9
+typedef struct _tdMagnetic2_graphics_metrics
+{
+	tdMagnetic2_metrics_histogram decode[DMAGNETIC2_METRICS_FORMATS];
+	unsigned long long animation_frames;
+} tdMagnetic2_graphics_metrics;
+
+int dMagnetic2_engine_get_metrics(tdMagnetic2_engine_metrics *pMetrics);
+int dMagnetic2_engine_metrics_text(char* pBuf,int bufsize,int *pLen);
+int dMagnetic2_loader_get_metrics(tdMagnetic2_loader_metrics *pMetrics);
+int dMagnetic2_loader_metrics_text(char* pBuf,int bufsize,int *pLen);
+int dMagnetic2_graphics_get_metrics(tdMagnetic2_graphics_metrics *pMetrics);
+int dMagnetic2_graphics_metrics_text(char* pBuf,int bufsize,int *pLen);
+
+#endif
@@ -35,3 +35,10 @@
 cc -g -o engine_runmag.app engine_runmag.c -I../../software/backends -I../../software/include -I../../software/backends/engine -L../../software/backends/engine -ldmagnetic2_engine
 
 
+cc -g -o engine_threaded.app engine_threaded.c -I../../software/backends -I../../software/include -I../../software/backends/engine -L../../software/backends/engine -ldmagnetic2_engine -lpthread
+
+
+cc -g -o engine_hibernate.app engine_hibernate.c -I../../software/backends -I../../software/include -I../../software/backends/engine -I../../software/backends/shared -L../../software/backends/engine -ldmagnetic2_engine
+cc -g -o engine_store.app engine_store.c -I../../software/backends -I../../software/include -I../../software/backends/engine -I../../software/backends/shared -L../../software/backends/engine -ldmagnetic2_engine
+cc -g -o engine_memo.app engine_memo.c -I../../software/backends -I../../software/include -I../../software/backends/engine -I../../software/backends/shared -L../../software/backends/engine -ldmagnetic2_engine
+cc -g -o engine_step.app engine_step.c -I../../software/backends -I../../software/include -I../../software/backends/engine -I../../software/backends/shared -L../../software/backends/engine -ldmagnetic2_engine
@@ -0,0 +1,181 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_handle.h"
+
+// a session is hibernated and resumed, explicitly into another handle and lazily on the stub.
+// both have to continue exactly like the original. a damaged state has to be rejected.
+
+unsigned char magbuf[1<<20];
+unsigned char otherbuf[1<<20];
+unsigned char blob[1<<21];
+char* commands[]={"look\n","inventory\n","examine me\n","north\n","south\n"};
+#define	COMMANDS	(sizeof(commands)/sizeof(char*))
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+void newgame(void* handle,unsigned char* pMagBuf)
+{
+	unsigned int status;
+	char* pText;
+	dMagnetic2_engine_init(handle);
+	dMagnetic2_engine_set_mag(handle,pMagBuf);
+	dMagnetic2_engine_process(handle,0,&status);
+	dMagnetic2_engine_get_text(handle,&pText);
+}
+int command(void* handle,char* pInput,char* pOutput)
+{
+	unsigned int status;
+	char* pText;
+	int retval;
+	int cnt;
+	retval=dMagnetic2_engine_new_input(handle,strlen(pInput),pInput,&cnt);
+	if (retval==DMAGNETIC2_OK)
+	{
+		retval=dMagnetic2_engine_process(handle,0,&status);
+	}
+	pOutput[0]=0;
+	if (retval==DMAGNETIC2_OK)
+	{
+		dMagnetic2_engine_get_text(handle,&pText);
+		strncpy(pOutput,pText,DMAGNETIC2_SIZE_OUTPUTBUF);
+	}
+	return retval;
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f;
+	static char output1[DMAGNETIC2_SIZE_OUTPUTBUF+1];
+	static char output2[DMAGNETIC2_SIZE_OUTPUTBUF+1];
+	void *handle1;
+	void *handle2;
+	unsigned long long hash1,hash2;
+	unsigned int status;
+	int size;
+	int blobsize;
+	int retval;
+	int i;
+	int n;
+
+	if (argc!=2)
+	{
+		fprintf(stderr,"please run with %s INPUT.mag\n",argv[0]);
+		return 1;
+	}
+	f=fopen(argv[1],"rb");
+	if (f==NULL)
+	{
+		fprintf(stderr,"unable to open %s\n",argv[1]);
+		return 1;
+	}
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	printf("read %d bytes\n",n);
+
+	dMagnetic2_engine_get_size(&size);
+	handle1=malloc(size);
+	handle2=malloc(size);
+
+	newgame(handle1,magbuf);
+	for (i=0;i<COMMANDS;i++)
+	{
+		command(handle1,commands[i],output1);
+	}
+	dMagnetic2_engine_get_statehash(handle1,&hash1);
+
+	// the round trip into another handle
+	blobsize=0;
+	retval=dMagnetic2_engine_hibernate(handle1,&blobsize,NULL);
+	printf("hibernated size: %d bytes\n",blobsize);
+	check(retval==DMAGNETIC2_OK && blobsize>0 && blobsize<=sizeof(blob),"size query");
+	n=blobsize-1;
+	check(dMagnetic2_engine_hibernate(handle1,&n,blob)==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL,"buffer one byte short");
+	n=sizeof(blob);
+	check(dMagnetic2_engine_hibernate(handle1,&n,blob)==DMAGNETIC2_OK && n==blobsize,"hibernated");
+	check(dMagnetic2_engine_process(handle1,0,&status)==DMAGNETIC2_OK && status==DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT,"the stub is waiting for input");
+	memset(handle2,0xaa,size);
+	check(dMagnetic2_engine_resume(handle2,magbuf,blobsize,blob)==DMAGNETIC2_OK,"resumed into another handle");
+	dMagnetic2_engine_get_statehash(handle2,&hash2);
+	check(hash1==hash2,"same state hash");
+
+	// the lazy resume: the stub continues with the next input
+	memset(((unsigned char*)handle1)+DMAGNETIC2_SIZE_HIBERNATED,0x55,size-DMAGNETIC2_SIZE_HIBERNATED);
+	retval=DMAGNETIC2_OK;
+	for (i=0;i<COMMANDS;i++)
+	{
+		retval|=command(handle1,commands[COMMANDS-1-i],output1);
+		retval|=command(handle2,commands[COMMANDS-1-i],output2);
+		if (strcmp(output1,output2))
+		{
+			retval=-1;
+		}
+	}
+	check(retval==DMAGNETIC2_OK,"resumed lazily, the same output");
+	dMagnetic2_engine_get_statehash(handle1,&hash1);
+	dMagnetic2_engine_get_statehash(handle2,&hash2);
+	check(hash1==hash2,"same state hash");
+
+	// damaged states
+	n=sizeof(blob);
+	dMagnetic2_engine_hibernate(handle1,&n,blob);
+	memcpy(otherbuf,magbuf,sizeof(magbuf));
+	otherbuf[42]^=0x01;
+	check(dMagnetic2_engine_resume(handle2,otherbuf,blobsize,blob)!=DMAGNETIC2_OK,"another .mag");
+	check(dMagnetic2_engine_resume(handle2,magbuf,blobsize-1,blob)!=DMAGNETIC2_OK,"truncated");
+	blob[12]^=0x01;
+	check(dMagnetic2_engine_resume(handle2,magbuf,blobsize,blob)==DMAGNETIC2_UNKNOWN_SOURCE,"damaged header");
+	blob[12]^=0x01;
+	check(dMagnetic2_engine_resume(handle2,magbuf,blobsize,blob)==DMAGNETIC2_OK,"undamaged again");
+
+	newgame(handle1,magbuf);
+	((tdMagnetic2_engine_handle*)handle1)->game_context.linea.input_used=DMAGNETIC2_SIZE_INPUTBUF;
+	n=sizeof(blob);
+	dMagnetic2_engine_hibernate(handle1,&n,blob);
+	check(dMagnetic2_engine_resume(handle2,magbuf,n,blob)==DMAGNETIC2_UNKNOWN_SOURCE,"input read position out of bounds");
+	newgame(handle1,magbuf);
+	((tdMagnetic2_engine_handle*)handle1)->outputlevel=DMAGNETIC2_SIZE_OUTPUTBUF+1;
+	n=sizeof(blob);
+	dMagnetic2_engine_hibernate(handle1,&n,blob);
+	check(dMagnetic2_engine_resume(handle2,magbuf,n,blob)==DMAGNETIC2_UNKNOWN_SOURCE,"output level out of bounds");
+
+	free(handle2);
+	free(handle1);
+	printf("%d failures\n",failures);
+	return failures;
+}
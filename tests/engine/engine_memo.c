@@ -0,0 +1,165 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_memo.h"
+
+// two sessions in the same state get the same commands. the first one has to miss the memo,
+// the second one has to hit it, and both have to match a session without the memo.
+
+unsigned char magbuf[1<<20];
+char* commands[]={"look\n","inventory\n","examine me\n","north\n"};
+#define	COMMANDS	(sizeof(commands)/sizeof(char*))
+#define	MEMOSIZE	(1<<22)
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+void newgame(void* handle)
+{
+	unsigned int status;
+	char* pText;
+	dMagnetic2_engine_init(handle);
+	dMagnetic2_engine_set_mag(handle,magbuf);
+	dMagnetic2_engine_process(handle,0,&status);
+	dMagnetic2_engine_get_text(handle,&pText);
+}
+// the memo only records a step when the text and the title have been picked up
+void pickup(void* handle,unsigned int status,char* pOutput)
+{
+	char* pText;
+	if (status&DMAGNETIC2_ENGINE_STATUS_NEW_TITLE)
+	{
+		dMagnetic2_engine_get_title(handle,&pText);
+	}
+	dMagnetic2_engine_get_text(handle,&pText);
+	strcat(pOutput,pText);
+}
+// with the memo
+int session(void* pMemo,void* handle,char* pOutput,unsigned long long *pHash)
+{
+	unsigned int status;
+	int retval;
+	int i;
+	pOutput[0]=0;
+	newgame(handle);
+	retval=DMAGNETIC2_OK;
+	for (i=0;i<COMMANDS;i++)
+	{
+		retval|=dMagnetic2_engine_memo_step(pMemo,handle,strlen(commands[i]),commands[i],&status);
+		pickup(handle,status,pOutput);
+	}
+	dMagnetic2_engine_get_statehash(handle,pHash);
+	return retval;
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f;
+	static char output1[1<<16];
+	static char output2[1<<16];
+	static char reference[1<<16];
+	tdMagnetic2_engine_memo_stats stats;
+	void *pMemo;
+	void *handle;
+	unsigned long long hash1,hash2,hash3;
+	unsigned int status;
+	int size;
+	int retval;
+	int cnt;
+	int i;
+	int n;
+
+	if (argc!=2)
+	{
+		fprintf(stderr,"please run with %s INPUT.mag\n",argv[0]);
+		return 1;
+	}
+	f=fopen(argv[1],"rb");
+	if (f==NULL)
+	{
+		fprintf(stderr,"unable to open %s\n",argv[1]);
+		return 1;
+	}
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	printf("read %d bytes\n",n);
+
+	dMagnetic2_engine_get_size(&size);
+	handle=malloc(size);
+	pMemo=malloc(MEMOSIZE);
+	check(dMagnetic2_engine_memo_init(pMemo,DMAGNETIC2_ENGINE_MEMO_MINSIZE-1)==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL,"memo one byte short");
+	check(dMagnetic2_engine_memo_init(pMemo,MEMOSIZE)==DMAGNETIC2_OK,"memo initialized");
+
+	retval=session(pMemo,handle,output1,&hash1);
+	dMagnetic2_engine_memo_get_stats(pMemo,&stats);
+	printf("STATS>    lookups:%u hits:%u misses:%u bypassed:%u recorded:%u entries:%d\n",stats.lookups,stats.hits,stats.misses,stats.bypassed,stats.recorded,stats.entries);
+	check(retval==DMAGNETIC2_OK && stats.hits==0 && stats.misses==COMMANDS && stats.recorded==COMMANDS,"the first session misses");
+
+	retval=session(pMemo,handle,output2,&hash2);
+	dMagnetic2_engine_memo_get_stats(pMemo,&stats);
+	printf("STATS>    lookups:%u hits:%u misses:%u bypassed:%u recorded:%u entries:%d\n",stats.lookups,stats.hits,stats.misses,stats.bypassed,stats.recorded,stats.entries);
+	check(retval==DMAGNETIC2_OK && stats.hits==COMMANDS && stats.misses==COMMANDS,"the second session hits");
+
+	// the same without the memo
+	newgame(handle);
+	reference[0]=0;
+	for (i=0;i<COMMANDS;i++)
+	{
+		dMagnetic2_engine_new_input(handle,strlen(commands[i]),commands[i],&cnt);
+		dMagnetic2_engine_process(handle,0,&status);
+		pickup(handle,status,reference);
+	}
+	dMagnetic2_engine_get_statehash(handle,&hash3);
+	check(strcmp(output1,reference)==0 && hash1==hash3,"the miss is like a session without the memo");
+	check(strcmp(output2,reference)==0 && hash2==hash3,"the hit is like a session without the memo");
+
+	// pending input can not be looked up
+	newgame(handle);
+	dMagnetic2_engine_new_input(handle,strlen(commands[0]),commands[0],&cnt);
+	dMagnetic2_engine_memo_step(pMemo,handle,strlen(commands[1]),commands[1],&status);
+	dMagnetic2_engine_memo_get_stats(pMemo,&stats);
+	check(stats.bypassed==1 && stats.hits==COMMANDS,"pending input bypasses the memo");
+
+	check(dMagnetic2_engine_memo_flush(pMemo)==DMAGNETIC2_OK,"flushed");
+	dMagnetic2_engine_memo_get_stats(pMemo,&stats);
+	check(stats.entries==0,"no entries");
+
+	free(pMemo);
+	free(handle);
+	printf("%d failures\n",failures);
+	return failures;
+}
@@ -0,0 +1,168 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+
+// a session is run in small quanta with dMagnetic2_engine_step(), picking up whatever it yields.
+// it has to end up like a session which is run with dMagnetic2_engine_process().
+
+unsigned char magbuf[1<<20];
+unsigned char blob[1<<21];
+char* commands[]={"look\n","inventory\n","examine me\n","north\n","south\n"};
+#define	COMMANDS	(sizeof(commands)/sizeof(char*))
+#define	QUANTUM		100
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+// runs until the game is waiting for input. returns the number of calls
+int steps(void* handle,char* pOutput,int *pRetval)
+{
+	unsigned int yield;
+	unsigned int status;
+	char* pText;
+	int picnum;
+	int calls;
+	calls=0;
+	do
+	{
+		*pRetval=dMagnetic2_engine_step(handle,QUANTUM,&yield,&status);
+		calls++;
+		if (yield&DMAGNETIC2_ENGINE_YIELD_OUTPUT)
+		{
+			dMagnetic2_engine_get_text(handle,&pText);
+			strcat(pOutput,pText);
+		}
+		if (yield&DMAGNETIC2_ENGINE_YIELD_PICTURE)
+		{
+			dMagnetic2_engine_get_picture_num(handle,&picnum);
+			dMagnetic2_engine_get_picture_name(handle,&pText);
+		}
+	} while (*pRetval==DMAGNETIC2_OK && !(yield&DMAGNETIC2_ENGINE_YIELD_INPUT) && !(status&(DMAGNETIC2_ENGINE_STATUS_QUIT|DMAGNETIC2_ENGINE_STATUS_RESTART)));
+	dMagnetic2_engine_get_text(handle,&pText);
+	strcat(pOutput,pText);
+	return calls;
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f;
+	static char output1[1<<16];
+	static char output2[1<<16];
+	void *handle1;
+	void *handle2;
+	unsigned long long hash1,hash2;
+	unsigned int yield;
+	unsigned int status;
+	char* pText;
+	int size;
+	int retval;
+	int stepped;
+	int calls;
+	int cnt;
+	int i;
+	int n;
+
+	if (argc!=2)
+	{
+		fprintf(stderr,"please run with %s INPUT.mag\n",argv[0]);
+		return 1;
+	}
+	f=fopen(argv[1],"rb");
+	if (f==NULL)
+	{
+		fprintf(stderr,"unable to open %s\n",argv[1]);
+		return 1;
+	}
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	printf("read %d bytes\n",n);
+
+	dMagnetic2_engine_get_size(&size);
+	handle1=malloc(size);
+	handle2=malloc(size);
+	dMagnetic2_engine_init(handle1);
+	dMagnetic2_engine_set_mag(handle1,magbuf);
+	dMagnetic2_engine_init(handle2);
+	dMagnetic2_engine_set_mag(handle2,magbuf);
+
+	output1[0]=0;
+	output2[0]=0;
+	calls=steps(handle1,output1,&retval);
+	printf("STEPS>    %d calls until the first input\n",calls);
+	check(retval==DMAGNETIC2_OK,"stepped to the first input");
+	dMagnetic2_engine_process(handle2,0,&status);
+	dMagnetic2_engine_get_text(handle2,&pText);
+	strcat(output2,pText);
+
+	retval=dMagnetic2_engine_step(handle1,QUANTUM,&yield,&status);
+	check(retval==DMAGNETIC2_OK && yield==DMAGNETIC2_ENGINE_YIELD_INPUT && (status&DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT),"waiting for input, without running");
+
+	dMagnetic2_engine_new_input(handle1,strlen(commands[0]),commands[0],&cnt);
+	retval=dMagnetic2_engine_step(handle1,1,&yield,&status);
+	check(retval==DMAGNETIC2_OK && yield==DMAGNETIC2_ENGINE_YIELD_QUANTUM,"a quantum of 1");
+	retval=DMAGNETIC2_OK;
+
+	for (i=0;i<COMMANDS;i++)
+	{
+		if (i)
+		{
+			dMagnetic2_engine_new_input(handle1,strlen(commands[i]),commands[i],&cnt);
+		}
+		steps(handle1,output1,&stepped);
+		retval|=stepped;
+		dMagnetic2_engine_new_input(handle2,strlen(commands[i]),commands[i],&cnt);
+		dMagnetic2_engine_process(handle2,0,&status);
+		dMagnetic2_engine_get_text(handle2,&pText);
+		strcat(output2,pText);
+	}
+	check(retval==DMAGNETIC2_OK,"stepped through the commands");
+	dMagnetic2_engine_get_statehash(handle1,&hash1);
+	dMagnetic2_engine_get_statehash(handle2,&hash2);
+	check(strcmp(output1,output2)==0,"the same output as dMagnetic2_engine_process()");
+	check(hash1==hash2,"the same state hash");
+
+	// a hibernated session is waiting for input as well
+	n=sizeof(blob);
+	dMagnetic2_engine_hibernate(handle1,&n,blob);
+	retval=dMagnetic2_engine_step(handle1,QUANTUM,&yield,&status);
+	check(retval==DMAGNETIC2_OK && yield==DMAGNETIC2_ENGINE_YIELD_INPUT,"hibernated session");
+
+	free(handle2);
+	free(handle1);
+	printf("%d failures\n",failures);
+	return failures;
+}
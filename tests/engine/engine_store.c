@@ -0,0 +1,204 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_store.h"
+#include "dMagnetic2_engine_handle.h"
+
+// two sessions are played in a store, which is closed and opened again halfway through.
+// they have to continue exactly like a session which has never been interrupted.
+
+unsigned char magbuf[1<<20];
+unsigned char otherbuf[1<<20];
+char* commands[]={"look\n","inventory\n","examine me\n","north\n","south\n","east\n","west\n","score\n"};
+#define	COMMANDS	(sizeof(commands)/sizeof(char*))
+#define	SLOTS		4
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+void command(void* handle,char* pInput,char* pOutput)
+{
+	unsigned int status;
+	char* pText;
+	int cnt;
+	dMagnetic2_engine_new_input(handle,strlen(pInput),pInput,&cnt);
+	dMagnetic2_engine_process(handle,0,&status);
+	dMagnetic2_engine_get_text(handle,&pText);
+	strcat(pOutput,pText);
+}
+// the slots start after the first page of the file. the page size is @28 in the header
+void damageslot(char* filename,int slot,int value)
+{
+	FILE *f;
+	unsigned int header[8];
+	f=fopen(filename,"r+b");
+	fread(header,sizeof(int),8,f);
+	fseek(f,header[7]+slot*header[3]+offsetof(tdMagnetic2_engine_handle,outputlevel),SEEK_SET);
+	fwrite(&value,sizeof(int),1,f);
+	fclose(f);
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f;
+	static char output[2][1<<16];
+	static char reference[1<<16];
+	void *pStore;
+	void *handle[2];
+	void *refhandle;
+	unsigned long long hash1,hash2;
+	unsigned int status;
+	char* pText;
+	int size;
+	int state;
+	int retval;
+	int slot;
+	int i;
+	int n;
+
+	if (argc!=3)
+	{
+		fprintf(stderr,"please run with %s INPUT.mag STOREFILE\n",argv[0]);
+		return 1;
+	}
+	f=fopen(argv[1],"rb");
+	if (f==NULL)
+	{
+		fprintf(stderr,"unable to open %s\n",argv[1]);
+		return 1;
+	}
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	printf("read %d bytes\n",n);
+	remove(argv[2]);
+
+	dMagnetic2_engine_store_get_size(&size);
+	pStore=malloc(size);
+
+	// the first half
+	dMagnetic2_engine_store_init(pStore);
+	retval=dMagnetic2_engine_store_open(pStore,argv[2],SLOTS,magbuf);
+	check(retval==DMAGNETIC2_OK,"new store");
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return failures;
+	}
+	retval=DMAGNETIC2_OK;
+	for (slot=0;slot<2;slot++)
+	{
+		output[slot][0]=0;
+		retval|=dMagnetic2_engine_store_attach(pStore,slot,&handle[slot]);
+		dMagnetic2_engine_process(handle[slot],0,&status);
+		dMagnetic2_engine_get_text(handle[slot],&pText);
+	}
+	check(retval==DMAGNETIC2_OK,"new sessions attached");
+	for (i=0;i<COMMANDS/2;i++)
+	{
+		for (slot=0;slot<2;slot++)
+		{
+			command(handle[slot],commands[(i+slot)%COMMANDS],output[slot]);
+		}
+	}
+	check(dMagnetic2_engine_store_sync(pStore)==DMAGNETIC2_OK,"synced");
+	check(dMagnetic2_engine_store_close(pStore)==DMAGNETIC2_OK,"closed");
+
+	// the second half
+	dMagnetic2_engine_store_init(pStore);
+	check(dMagnetic2_engine_store_open(pStore,argv[2],SLOTS,magbuf)==DMAGNETIC2_OK,"opened again");
+	dMagnetic2_engine_store_get_slotstate(pStore,1,&state);
+	check(state==DMAGNETIC2_ENGINE_STORE_SLOT_USED,"slot 1 is in use");
+	dMagnetic2_engine_store_get_slotstate(pStore,2,&state);
+	check(state==DMAGNETIC2_ENGINE_STORE_SLOT_FREE,"slot 2 is free");
+	retval=DMAGNETIC2_OK;
+	for (slot=0;slot<2;slot++)
+	{
+		retval|=dMagnetic2_engine_store_attach(pStore,slot,&handle[slot]);
+	}
+	check(retval==DMAGNETIC2_OK,"sessions attached again");
+	for (i=COMMANDS/2;i<COMMANDS;i++)
+	{
+		for (slot=0;slot<2;slot++)
+		{
+			command(handle[slot],commands[(i+slot)%COMMANDS],output[slot]);
+		}
+	}
+
+	// the same without the store
+	dMagnetic2_engine_get_size(&size);
+	refhandle=malloc(size);
+	for (slot=0;slot<2;slot++)
+	{
+		dMagnetic2_engine_init(refhandle);
+		dMagnetic2_engine_set_mag(refhandle,magbuf);
+		dMagnetic2_engine_process(refhandle,0,&status);
+		dMagnetic2_engine_get_text(refhandle,&pText);
+		reference[0]=0;
+		for (i=0;i<COMMANDS;i++)
+		{
+			command(refhandle,commands[(i+slot)%COMMANDS],reference);
+		}
+		dMagnetic2_engine_get_statehash(refhandle,&hash1);
+		dMagnetic2_engine_get_statehash(handle[slot],&hash2);
+		check(strcmp(output[slot],reference)==0 && hash1==hash2,"continued like an uninterrupted session");
+	}
+	free(refhandle);
+
+	check(dMagnetic2_engine_store_release(pStore,1)==DMAGNETIC2_OK,"released slot 1");
+	dMagnetic2_engine_store_get_slotstate(pStore,1,&state);
+	check(state==DMAGNETIC2_ENGINE_STORE_SLOT_FREE,"slot 1 is free");
+	dMagnetic2_engine_store_close(pStore);
+
+	// another game
+	memcpy(otherbuf,magbuf,sizeof(magbuf));
+	otherbuf[42]^=0x01;
+	dMagnetic2_engine_store_init(pStore);
+	check(dMagnetic2_engine_store_open(pStore,argv[2],SLOTS,otherbuf)==DMAGNETIC2_ERROR_STORE_MISMATCH,"another .mag");
+
+	// a damaged slot is not attached, the others are
+	damageslot(argv[2],0,DMAGNETIC2_SIZE_OUTPUTBUF+1);
+	dMagnetic2_engine_store_init(pStore);
+	dMagnetic2_engine_store_open(pStore,argv[2],SLOTS,magbuf);
+	check(dMagnetic2_engine_store_attach(pStore,0,&handle[0])==DMAGNETIC2_UNKNOWN_SOURCE,"damaged slot");
+	check(dMagnetic2_engine_store_attach(pStore,2,&handle[1])==DMAGNETIC2_OK,"another slot");
+	dMagnetic2_engine_store_close(pStore);
+
+	remove(argv[2]);
+	free(pStore);
+	printf("%d failures\n",failures);
+	return failures;
+}
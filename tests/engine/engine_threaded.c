@@ -0,0 +1,126 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_engine_threaded.h"
+
+
+unsigned char magbuf[1<<20];
+
+int main(int argc,char** argv)
+{
+	FILE *f;
+	char inputbuf[256];
+	char eventbuf[DMAGNETIC2_ENGINE_THREADED_SIZE_EVENTBUF];
+	void *handle;
+	struct pollfd fds[2];
+	unsigned int type;
+	int value;
+	int quit;
+	int retval;
+	int n;
+	if (argc!=2)
+	{
+		fprintf(stderr,"please run with %s INPUT.mag\n",argv[0]);
+		return 1;
+	}
+
+	f=fopen(argv[1],"rb");
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	printf("read %d bytes\n",n);
+
+
+	dMagnetic2_engine_threaded_get_size(&n);
+	printf("allocating %d bytes\n",n);
+	n=(n+DMAGNETIC2_ENGINE_THREADED_ALIGNMENT-1)&~(DMAGNETIC2_ENGINE_THREADED_ALIGNMENT-1);	// aligned_alloc() wants a multiple of the alignment
+	handle=aligned_alloc(DMAGNETIC2_ENGINE_THREADED_ALIGNMENT,n);
+
+	printf("initializing\n");fflush(stdout);
+	retval=dMagnetic2_engine_threaded_init(handle);
+	printf("retval:%d\n",retval);
+	
+	printf("loading .mag\n");fflush(stdout);
+	dMagnetic2_engine_threaded_set_mag(handle,magbuf);
+
+	printf("=[ running ]====================================================================\n");
+	dMagnetic2_engine_threaded_start(handle);
+	fds[0].fd=STDIN_FILENO;
+	fds[0].events=POLLIN;
+	dMagnetic2_engine_threaded_get_fd(handle,&fds[1].fd);
+	fds[1].events=POLLIN;
+	quit=0;
+	do
+	{
+		poll(fds,2,-1);
+		if (fds[0].revents&(POLLIN|POLLHUP))	// the input does not have to wait for the engine
+		{
+			int cnt;
+			if (fgets(inputbuf,sizeof(inputbuf),stdin)==NULL)
+			{
+				quit=1;
+			} else {
+				retval=dMagnetic2_engine_threaded_new_input(handle,strlen(inputbuf),inputbuf,&cnt);
+				printf("--> retval:%d cnt:%d\n",retval,cnt);
+			}
+		}
+		if (fds[1].revents&POLLIN)
+		{
+			do
+			{
+				retval=dMagnetic2_engine_threaded_get_event(handle,&type,&value,eventbuf,sizeof(eventbuf));
+				switch (type)
+				{
+					case DMAGNETIC2_ENGINE_STATUS_NONE: break;
+					case DMAGNETIC2_ENGINE_STATUS_NEW_TITLE:	printf("\x1b[1;37;41mTITLE[%s]\x1b[0m\n",eventbuf);break;
+					case DMAGNETIC2_ENGINE_STATUS_NEW_TEXT:		printf("\x1b[1;37;42mNEW TEXT[%s]\x1b[0m\n",eventbuf);break;
+					case DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NUM:	printf("\x1b[1;37;43mNEW PICTURE NUMBER%d\x1b[0m\n",value);break;
+					case DMAGNETIC2_ENGINE_STATUS_NEW_PICTURE_NAME:	printf("\x1b[1;37;43mNEW PICTURE NAME[%s]\x1b[0m\n",eventbuf);break;
+					case DMAGNETIC2_ENGINE_STATUS_WAITING_FOR_INPUT:printf("\x1b[1;37;44mWAITING FOR INPUT\x1b[0m\n");break;
+					case DMAGNETIC2_ENGINE_STATUS_QUIT:
+					case DMAGNETIC2_ENGINE_STATUS_RESTART:
+					case DMAGNETIC2_ENGINE_THREADED_EVENT_ERROR:
+						printf("event %08X value:%d\n",type,value);
+						quit=1;
+						break;
+					default:
+						printf("event %08X value:%d [%s]\n",type,value,eventbuf);
+						break;
+				}
+				fflush(stdout);
+			} while (retval==DMAGNETIC2_OK && type!=DMAGNETIC2_ENGINE_STATUS_NONE);
+		}
+	} while (!quit);
+	dMagnetic2_engine_threaded_stop(handle);
+	free(handle);
+	return 0;
+}
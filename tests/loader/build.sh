@@ -32,4 +32,24 @@
   make clean
   make
 )
-cc -g -o loader_mkmaggfx.app loader_mkmaggfx.c -I../../software/backends -I../../software/include -I../../software/backends/loader -L../../software/backends/loader -ldmagnetic2_loader
+(
+  cd ../../software/backends/engine
+  make clean
+  make
+)
+(
+  cd ../../software/backends/graphics
+  make clean
+  make
+)
+(
+  cd ../../software/backends/instance
+  make clean
+  make
+)
+cc -g -o loader_mkmaggfx.app loader_mkmaggfx.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/loader -ldmagnetic2_loader
+cc -g -o loader_unhuffer.app loader_unhuffer.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/loader -ldmagnetic2_loader
+cc -g -o loader_probe.app loader_probe.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/loader -ldmagnetic2_loader
+cc -g -o loader_cache.app loader_cache.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/loader -ldmagnetic2_loader
+cc -g -o loader_catalog.app loader_catalog.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/loader -ldmagnetic2_loader
+cc -g -o loader_instance.app loader_instance.c -I../../software/backends -I../../software/include -I../../software/backends/loader -I../../software/backends/shared -L../../software/backends/instance -L../../software/backends/loader -L../../software/backends/engine -L../../software/backends/graphics -ldmagnetic2_instance -ldmagnetic2_loader -ldmagnetic2_engine -ldmagnetic2_graphics -lpthread
@@ -0,0 +1,142 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_metrics.h"
+
+// loading the same images twice with a cache directory: the second load has to be a hit,
+// with the same result as a load without the cache. .mag/.gfx files, and the directories
+// of the MS-DOS and Magnetic Windows releases are not cached.
+
+unsigned char magbuf[DMAGNETIC2_MAX_MAGSIZE];
+unsigned char gfxbuf[DMAGNETIC2_MAX_GFXSIZE];
+unsigned char magbuf2[DMAGNETIC2_MAX_MAGSIZE];
+unsigned char gfxbuf2[DMAGNETIC2_MAX_GFXSIZE];
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+
+int main(int argc,char** argv)
+{
+	char* filename[3]={NULL,NULL,NULL};
+	tdMagnetic2_game_meta meta,cached,probed;
+	tdMagnetic2_loader_metrics before,after;
+	unsigned char* pShort;
+	void* hLoader;
+	void* pTmpBuf;
+	int size_handle;
+	int size_tmpbuf;
+	int retval;
+	int cacheable;
+	int i;
+
+	if (argc<3 || argc>5)
+	{
+		fprintf(stderr,"please run with %s CACHEDIR FILENAME1 [FILENAME2 [FILENAME3]]\n",argv[0]);
+		return 1;
+	}
+	for (i=2;i<argc;i++)
+	{
+		filename[i-2]=argv[i];
+	}
+	dMagnetic2_loader_getsize(&size_handle,&size_tmpbuf);
+	hLoader=malloc(size_handle);
+	pTmpBuf=malloc(size_tmpbuf);
+
+	// the reference, without the cache
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,0);
+	printf("GAME>     [%s] [%s] mag:%d gfx:%d\n",meta.game_name,meta.source_name,meta.real_magsize,meta.real_gfxsize);
+	check(retval==DMAGNETIC2_OK,"load without the cache");
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return 1;
+	}
+	cacheable=(meta.source!=DMAGNETIC2_SOURCE_MAGGFX && meta.source!=DMAGNETIC2_SOURCE_MSDOS && meta.source!=DMAGNETIC2_SOURCE_MW);
+
+	// the first load with the cache might find an entry from an earlier run already. afterwards, there is one.
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	dMagnetic2_loader_set_cachedir(hLoader,argv[1]);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf2,sizeof(magbuf2),gfxbuf2,sizeof(gfxbuf2),&cached,0);
+	check(retval==DMAGNETIC2_OK && cached.real_magsize==meta.real_magsize && cached.real_gfxsize==meta.real_gfxsize,"first load with the cache");
+
+	// a probe does not write an entry, but it may be answered from one
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	dMagnetic2_loader_set_cachedir(hLoader,argv[1]);
+	retval=dMagnetic2_loader_probe(hLoader,filename[0],filename[1],filename[2],&probed,0);
+	check(retval==DMAGNETIC2_OK && probed.real_magsize==meta.real_magsize && probed.real_gfxsize==meta.real_gfxsize,"probe with the cache");
+
+	memset(magbuf2,0,sizeof(magbuf2));
+	memset(gfxbuf2,0,sizeof(gfxbuf2));
+	dMagnetic2_loader_get_metrics(&before);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	dMagnetic2_loader_set_cachedir(hLoader,argv[1]);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf2,sizeof(magbuf2),gfxbuf2,sizeof(gfxbuf2),&cached,0);
+	dMagnetic2_loader_get_metrics(&after);
+	check(retval==DMAGNETIC2_OK && cached.game==meta.game && cached.source==meta.source && cached.version==meta.version,"second load with the cache");
+	check(cached.real_magsize==meta.real_magsize && cached.real_gfxsize==meta.real_gfxsize
+		&& memcmp(magbuf2,magbuf,meta.real_magsize)==0 && memcmp(gfxbuf2,gfxbuf,meta.real_gfxsize)==0,"same images as without the cache");
+#ifndef	DMAGNETIC2_NO_METRICS
+	if (cacheable)
+	{
+		check(after.cache_hits==before.cache_hits+1,"it was a hit");
+	} else {
+		check(after.cache_hits==before.cache_hits,"the source is not cached");
+	}
+#endif
+
+	// a hit which does not fit into the buffer is refused, with the real sizes
+	pShort=malloc(meta.real_magsize);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	dMagnetic2_loader_set_cachedir(hLoader,argv[1]);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],pShort,meta.real_magsize-1,gfxbuf2,sizeof(gfxbuf2),&cached,0);
+	check(retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL && cached.real_magsize==meta.real_magsize,"mag buffer one byte short");
+	free(pShort);
+
+	// the key covers the whole contents. the same names with nodoc set are a different entry
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,1);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	dMagnetic2_loader_set_cachedir(hLoader,argv[1]);
+	retval|=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf2,sizeof(magbuf2),gfxbuf2,sizeof(gfxbuf2),&cached,1);
+	check(retval==DMAGNETIC2_OK && cached.real_magsize==meta.real_magsize && memcmp(magbuf2,magbuf,meta.real_magsize)==0,"nodoc is part of the key");
+
+	free(pTmpBuf);
+	free(hLoader);
+	printf("%d failures\n",failures);
+	return failures;
+}
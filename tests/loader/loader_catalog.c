@@ -0,0 +1,137 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_catalog.h"
+
+// every argument is one game, its files separated by commas. the catalog has to hold the
+// same images as a plain load, and find them again by the game.
+
+unsigned char magbuf[DMAGNETIC2_MAX_MAGSIZE];
+unsigned char gfxbuf[DMAGNETIC2_MAX_GFXSIZE];
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+void splitnames(char* arg,char** filename)
+{
+	int i;
+	filename[0]=arg;
+	filename[1]=filename[2]=NULL;
+	for (i=1;i<3;i++)
+	{
+		filename[i]=strchr(filename[i-1],',');
+		if (filename[i]==NULL)
+		{
+			break;
+		}
+		*filename[i]=0;
+		filename[i]++;
+	}
+}
+
+int main(int argc,char** argv)
+{
+	char* filename[3];
+	tdMagnetic2_game_meta meta,catmeta;
+	unsigned char* pMag;
+	unsigned char* pGfx;
+	void* hCatalog;
+	void* pCatTmp;
+	void* hLoader;
+	void* pTmpBuf;
+	int size_catalog;
+	int size_cattmp;
+	int size_handle;
+	int size_tmpbuf;
+	int gfxsize;
+	int retval;
+	int id;
+	int cnt;
+	int i;
+
+	if (argc<2)
+	{
+		fprintf(stderr,"please run with %s GAME1 [GAME2 ...]    (GAME=FILENAME1[,FILENAME2[,FILENAME3]])\n",argv[0]);
+		return 1;
+	}
+	dMagnetic2_loader_getsize(&size_handle,&size_tmpbuf);
+	hLoader=malloc(size_handle);
+	pTmpBuf=malloc(size_tmpbuf);
+	dMagnetic2_catalog_getsize(&size_catalog,&size_cattmp);
+	hCatalog=malloc(size_catalog+(argc-1)*(DMAGNETIC2_MAX_MAGSIZE+DMAGNETIC2_MAX_GFXSIZE));
+	pCatTmp=malloc(size_cattmp);
+	check(dMagnetic2_catalog_init(hCatalog,size_catalog-1,pCatTmp)==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL,"handle one byte short");
+	dMagnetic2_catalog_init(hCatalog,size_catalog+(argc-1)*(DMAGNETIC2_MAX_MAGSIZE+DMAGNETIC2_MAX_GFXSIZE),pCatTmp);
+
+	for (i=1;i<argc;i++)
+	{
+		splitnames(argv[i],filename);
+		dMagnetic2_loader_init(hLoader,pTmpBuf);
+		retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,0);
+		printf("GAME>     [%s] [%s] mag:%d gfx:%d\n",meta.game_name,meta.source_name,meta.real_magsize,meta.real_gfxsize);
+		retval|=dMagnetic2_catalog_add(hCatalog,filename[0],filename[1],filename[2],0,&id);
+		check(retval==DMAGNETIC2_OK && id==i-1,"added");
+		if (retval!=DMAGNETIC2_OK)
+		{
+			continue;
+		}
+		retval=dMagnetic2_catalog_get_game(hCatalog,id,&pMag,&pGfx,&gfxsize,&catmeta);
+		check(retval==DMAGNETIC2_OK && catmeta.game==meta.game && catmeta.source==meta.source
+			&& catmeta.real_magsize==meta.real_magsize && gfxsize==meta.real_gfxsize,"same meta data as a plain load");
+		check(memcmp(pMag,magbuf,meta.real_magsize)==0 && (gfxsize==0 || memcmp(pGfx,gfxbuf,gfxsize)==0),"same images as a plain load");
+		retval=dMagnetic2_catalog_find(hCatalog,meta.game,&id);
+		dMagnetic2_catalog_get_game(hCatalog,id,NULL,NULL,NULL,&catmeta);
+		check(retval==DMAGNETIC2_OK && catmeta.game==meta.game,"found by the game");
+	}
+	dMagnetic2_catalog_get_count(hCatalog,&cnt);
+	check(cnt==argc-1,"count");
+	check(dMagnetic2_catalog_get_game(hCatalog,cnt,NULL,NULL,NULL,&catmeta)==DMAGNETIC2_MISSING_IMAGE,"unknown id");
+
+	// a catalog which is full refuses the game, and keeps the others
+	dMagnetic2_catalog_init(hCatalog,size_catalog,pCatTmp);
+	// filename[] still holds the names of the last game
+	retval=dMagnetic2_catalog_add(hCatalog,filename[0],filename[1],filename[2],0,&id);
+	dMagnetic2_catalog_get_count(hCatalog,&cnt);
+	check(retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL && cnt==0,"no room for the images");
+
+	free(pCatTmp);
+	free(hCatalog);
+	free(pTmpBuf);
+	free(hLoader);
+	printf("%d failures\n",failures);
+	return failures;
+}
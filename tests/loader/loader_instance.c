@@ -0,0 +1,175 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+#include "dMagnetic2_engine.h"
+#include "dMagnetic2_instance.h"
+
+// both layouts of an instance: the arena for any game, and the one with the probed sizes.
+// when a .mag file grows after the probe, loading it must not write past the arena.
+
+unsigned char magbuf[DMAGNETIC2_MAX_MAGSIZE];
+unsigned char gfxbuf[DMAGNETIC2_MAX_GFXSIZE];
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+// the arena is allocated with the exact size, rounded up to the alignment
+void* newarena(int size)
+{
+	return aligned_alloc(DMAGNETIC2_INSTANCE_ALIGNMENT,(size+DMAGNETIC2_INSTANCE_ALIGNMENT-1)&~(DMAGNETIC2_INSTANCE_ALIGNMENT-1));
+}
+// the handles have to be usable, and they have to hold the same game as a plain load
+void checkhandles(void* pArena,tdMagnetic2_game_meta* pMeta)
+{
+	tdMagnetic2_game_meta meta;
+	void* hEngine;
+	void* hGraphics;
+	unsigned int status;
+	int retval;
+	retval=dMagnetic2_instance_get_handles(pArena,&hEngine,&hGraphics,&meta);
+	check(retval==DMAGNETIC2_OK && meta.game==pMeta->game && meta.real_magsize==pMeta->real_magsize && meta.real_gfxsize==pMeta->real_gfxsize,"  the handles hold the game");
+	check(((unsigned long)hEngine%DMAGNETIC2_INSTANCE_ALIGNMENT)==0 && ((unsigned long)hGraphics%DMAGNETIC2_INSTANCE_ALIGNMENT)==0,"  the handles are aligned");
+	retval=dMagnetic2_engine_process(hEngine,1,&status);
+	check(retval==DMAGNETIC2_OK,"  the engine runs");
+}
+int copyfile(char* src,char* dst,int extra)
+{
+	FILE *f;
+	int n;
+	f=fopen(src,"rb");
+	if (f==NULL)
+	{
+		return 0;
+	}
+	n=fread(magbuf,sizeof(char),sizeof(magbuf),f);
+	fclose(f);
+	memset(&magbuf[n],0,extra);
+	f=fopen(dst,"wb");
+	fwrite(magbuf,sizeof(char),n+extra,f);
+	fclose(f);
+	return 1;
+}
+
+int main(int argc,char** argv)
+{
+	char* filename[3]={NULL,NULL,NULL};
+	tdMagnetic2_game_meta meta,probed;
+	void* hLoader;
+	void* pTmpBuf;
+	void* pArena;
+	int size_handle;
+	int size_tmpbuf;
+	int size_probe;
+	int size_load;
+	int size_arena;
+	int used;
+	int retval;
+	int i;
+
+	if (argc<2 || argc>4)
+	{
+		fprintf(stderr,"please run with %s FILENAME1 [FILENAME2 [FILENAME3]]\n",argv[0]);
+		return 1;
+	}
+	for (i=1;i<argc;i++)
+	{
+		filename[i-1]=argv[i];
+	}
+	dMagnetic2_loader_getsize(&size_handle,&size_tmpbuf);
+	hLoader=malloc(size_handle);
+	pTmpBuf=malloc(size_tmpbuf);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,0);
+	printf("GAME>     [%s] [%s] mag:%d gfx:%d\n",meta.game_name,meta.source_name,meta.real_magsize,meta.real_gfxsize);
+	if (retval!=DMAGNETIC2_OK)
+	{
+		printf("loader returned %d\n",retval);
+		return 1;
+	}
+
+	dMagnetic2_instance_getsize(&size_probe,&size_load);
+	printf("SIZES>    probe:%d load:%d\n",size_probe,size_load);
+	check(size_probe<size_load,"the probe needs less");
+
+	// the worst case
+	pArena=newarena(size_load);
+	check(dMagnetic2_instance_init(pArena,size_probe-1)==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL,"arena one byte short");
+	dMagnetic2_instance_init(pArena,size_load);
+	retval=dMagnetic2_instance_load(pArena,filename[0],filename[1],filename[2],0,NULL,&used);
+	printf("WORST>    used:%d\n",used);
+	check(retval==DMAGNETIC2_OK && used<=size_load,"loaded into the arena for any game");
+	checkhandles(pArena,&meta);
+	free(pArena);
+
+	// the probe first, then the exact size
+	pArena=newarena(size_probe);
+	dMagnetic2_instance_init(pArena,size_probe);
+	retval=dMagnetic2_instance_probe(pArena,filename[0],filename[1],filename[2],0,&probed,&size_arena);
+	check(retval==DMAGNETIC2_OK && probed.real_magsize==meta.real_magsize && probed.real_gfxsize==meta.real_gfxsize,"probed");
+	free(pArena);
+	pArena=newarena(size_arena);
+	dMagnetic2_instance_init(pArena,size_arena);
+	retval=dMagnetic2_instance_load(pArena,filename[0],filename[1],filename[2],0,&probed,&used);
+	printf("EXACT>    arena:%d used:%d\n",size_arena,used);
+	check(retval==DMAGNETIC2_OK && used<=size_arena,"loaded into the probed arena");
+	checkhandles(pArena,&meta);
+	free(pArena);
+
+	// the .mag file grows after the probe
+	if (meta.source==DMAGNETIC2_SOURCE_MAGGFX && filename[0]!=NULL && filename[1]!=NULL)
+	{
+		copyfile(filename[0],"instance_grown.mag",0);
+		copyfile(filename[1],"instance_grown.gfx",0);
+		pArena=newarena(size_probe);
+		dMagnetic2_instance_init(pArena,size_probe);
+		retval=dMagnetic2_instance_probe(pArena,"instance_grown.mag","instance_grown.gfx",NULL,0,&probed,&size_arena);
+		free(pArena);
+		copyfile(filename[0],"instance_grown.mag",4096);
+		pArena=newarena(size_arena);
+		dMagnetic2_instance_init(pArena,size_arena);
+		retval=dMagnetic2_instance_load(pArena,"instance_grown.mag","instance_grown.gfx",NULL,0,&probed,&used);
+		check(retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL,"the file has grown since the probe");
+		free(pArena);
+		remove("instance_grown.mag");
+		remove("instance_grown.gfx");
+	}
+
+	free(pTmpBuf);
+	free(hLoader);
+	printf("%d failures\n",failures);
+	return failures;
+}
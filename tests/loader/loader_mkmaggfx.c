@@ -88,7 +88,7 @@ int main(int argc,char** argv)
 		return 1;
 	}
 
-	retval=dMagnetic2_loader(hLoader,filename1,filename2,filename3,magbuf,gfxbuf,&meta,0);
+	retval=dMagnetic2_loader(hLoader,filename1,filename2,filename3,magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,0);
 	printf("%d;",retval);
 	printf("%s;",meta.game_name);
 	printf("%s;",meta.source_name);
@@ -0,0 +1,174 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "dMagnetic2_errorcodes.h"
+#include "dMagnetic2_loader.h"
+
+// the probe has to report the sizes of a full load. buffers with exactly those sizes are enough,
+// one byte less is refused. dMagnetic2_loader_buffers() has to return the same as the files.
+
+unsigned char magbuf[DMAGNETIC2_MAX_MAGSIZE];
+unsigned char gfxbuf[DMAGNETIC2_MAX_GFXSIZE];
+
+int failures=0;
+void check(int cond,char* what)
+{
+	printf("%-50s %s\n",what,cond?"PASS":"FAIL");
+	if (!cond)
+	{
+		failures++;
+	}
+}
+// NULL for directories and missing names. the caller frees the buffer
+unsigned char* readfile(char* filename,int *pLen)
+{
+	struct stat st;
+	unsigned char* pBuf;
+	FILE *f;
+	*pLen=0;
+	if (filename==NULL || stat(filename,&st)!=0 || !S_ISREG(st.st_mode))
+	{
+		return NULL;
+	}
+	pBuf=malloc(st.st_size+1);
+	f=fopen(filename,"rb");
+	if (f==NULL)
+	{
+		free(pBuf);
+		return NULL;
+	}
+	*pLen=fread(pBuf,sizeof(char),st.st_size,f);
+	fclose(f);
+	return pBuf;
+}
+
+int main(int argc,char** argv)
+{
+	char* filename[3]={NULL,NULL,NULL};
+	unsigned char* pImage[3]={NULL,NULL,NULL};
+	int len[3]={0,0,0};
+	tdMagnetic2_game_meta meta,probed,exact,shortmeta,bufmeta;
+	unsigned char *pExactMag,*pExactGfx,*pShort;
+	void* hLoader;
+	void* pTmpBuf;
+	int size_handle;
+	int size_tmpbuf;
+	int retval;
+	int directory;
+	int i;
+
+	if (argc<2 || argc>4)
+	{
+		fprintf(stderr,"please run with %s FILENAME1 [FILENAME2 [FILENAME3]]\n",argv[0]);
+		return 1;
+	}
+	for (i=1;i<argc;i++)
+	{
+		filename[i-1]=argv[i];
+	}
+	dMagnetic2_loader_getsize(&size_handle,&size_tmpbuf);
+	hLoader=malloc(size_handle);
+	pTmpBuf=malloc(size_tmpbuf);
+
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],magbuf,sizeof(magbuf),gfxbuf,sizeof(gfxbuf),&meta,0);
+	printf("GAME>     [%s] [%s] mag:%d gfx:%d\n",meta.game_name,meta.source_name,meta.real_magsize,meta.real_gfxsize);
+	check(retval==DMAGNETIC2_OK,"full load");
+	if (retval!=DMAGNETIC2_OK)
+	{
+		return 1;
+	}
+
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader_probe(hLoader,filename[0],filename[1],filename[2],&probed,0);
+	check(retval==DMAGNETIC2_OK && probed.game==meta.game && probed.source==meta.source && probed.version==meta.version,"probe finds the same game");
+	check(probed.real_magsize==meta.real_magsize && probed.real_gfxsize==meta.real_gfxsize,"probe reports the same sizes");
+
+	// the buffers have exactly the probed sizes. the allocations are not rounded up, so a tool like valgrind sees every byte too many.
+	pExactMag=malloc(probed.real_magsize);
+	pExactGfx=malloc(probed.real_gfxsize?probed.real_gfxsize:1);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],pExactMag,probed.real_magsize,pExactGfx,probed.real_gfxsize,&exact,0);
+	check(retval==DMAGNETIC2_OK && exact.real_magsize==meta.real_magsize && exact.real_gfxsize==meta.real_gfxsize,"load into the probed sizes");
+	check(memcmp(pExactMag,magbuf,meta.real_magsize)==0 && memcmp(pExactGfx,gfxbuf,meta.real_gfxsize)==0,"same images as the full load");
+
+	// as if the files had grown since the probe
+	pShort=malloc(meta.real_magsize);
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],pShort,meta.real_magsize-1,pExactGfx,probed.real_gfxsize,&shortmeta,0);
+	check(retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL && shortmeta.real_magsize==meta.real_magsize,"mag buffer one byte short");
+	free(pShort);
+	if (meta.real_gfxsize>0)
+	{
+		pShort=malloc(meta.real_gfxsize);
+		dMagnetic2_loader_init(hLoader,pTmpBuf);
+		retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],pExactMag,probed.real_magsize,pShort,meta.real_gfxsize-1,&shortmeta,0);
+		check(retval==DMAGNETIC2_ERROR_BUFFER_TOO_SMALL && shortmeta.real_gfxsize==meta.real_gfxsize,"gfx buffer one byte short");
+		free(pShort);
+	}
+
+	// a NULL buffer is not written, but its size is reported
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],NULL,0,pExactGfx,probed.real_gfxsize,&shortmeta,0);
+	check(retval==DMAGNETIC2_OK && shortmeta.real_magsize==meta.real_magsize && memcmp(pExactGfx,gfxbuf,meta.real_gfxsize)==0,"without a mag buffer");
+	dMagnetic2_loader_init(hLoader,pTmpBuf);
+	retval=dMagnetic2_loader(hLoader,filename[0],filename[1],filename[2],pExactMag,probed.real_magsize,NULL,0,&shortmeta,0);
+	check(retval==DMAGNETIC2_OK && shortmeta.real_gfxsize==meta.real_gfxsize && memcmp(pExactMag,magbuf,meta.real_magsize)==0,"without a gfx buffer");
+
+	// the same images, from memory. the MS-DOS and Magnetic Windows releases are directories, they need the files.
+	directory=0;
+	for (i=0;i<3;i++)
+	{
+		pImage[i]=readfile(filename[i],&len[i]);
+		if (filename[i]!=NULL && pImage[i]==NULL)
+		{
+			directory=1;
+		}
+	}
+	if (!directory && meta.source!=DMAGNETIC2_SOURCE_MW)
+	{
+		memset(pExactMag,0,probed.real_magsize);
+		memset(pExactGfx,0,probed.real_gfxsize);
+		dMagnetic2_loader_init(hLoader,pTmpBuf);
+		retval=dMagnetic2_loader_buffers(hLoader,pImage[0],len[0],pImage[1],len[1],pImage[2],len[2],pExactMag,probed.real_magsize,pExactGfx,probed.real_gfxsize,&bufmeta,0);
+		check(retval==DMAGNETIC2_OK && bufmeta.game==meta.game && bufmeta.real_magsize==meta.real_magsize && bufmeta.real_gfxsize==meta.real_gfxsize,"from memory");
+		check(memcmp(pExactMag,magbuf,meta.real_magsize)==0 && memcmp(pExactGfx,gfxbuf,meta.real_gfxsize)==0,"same images from memory");
+	}
+	for (i=0;i<3;i++)
+	{
+		free(pImage[i]);
+	}
+	free(pExactMag);
+	free(pExactGfx);
+	free(pTmpBuf);
+	free(hLoader);
+	printf("%d failures\n",failures);
+	return failures;
+}
@@ -0,0 +1,401 @@
+//
+// BSD 2-Clause License
+// 
+// Copyright (c) 2024, dettus@dettus.net
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dMagnetic2_loader_shared.h"
+
+// this test compares the table driven unhuffer against the original bit-by-bit decoder.
+// it covers synthetic code, dictionary and picture streams, every short bitstream for a set of
+// trees, damaged trees, and any file given on the command line. (for example the MS-DOS files ending with 1 or 0)
+
+#define	MAX_INPUT	(1<<20)
+#define	MAX_OUTPUT	(2<<20)
+#define	MAX_PAYLOAD	(64<<10)
+
+unsigned char inbuf[MAX_INPUT+512];	// the reference decoder might read a damaged tree beyond the input
+unsigned char outref[MAX_OUTPUT];
+unsigned char outnew[MAX_OUTPUT];
+unsigned char payload[MAX_PAYLOAD];
+
+// this is the original decoder, one bit per iteration.
+int reference_unhuffer(const unsigned char* input,int length,unsigned char* output)
+{
+	int outputidx;
+	unsigned char byte;
+	unsigned char mask;
+	int bitidx;
+	int treesize;
+	int treeidx;
+	int threecnt;
+
+	treeidx=0;
+	treesize=input[0];
+	bitidx=3+treesize;
+	threecnt=0;
+	outputidx=0;
+	mask=0;
+	byte=0;
+	while (bitidx<length || mask)
+	{
+		unsigned char branch1,branch0;
+		unsigned char branch;
+
+		branch1=input[1+2*treeidx];
+		branch0=input[2+2*treeidx];
+		if (mask==0)
+		{
+			mask=0x80;
+			byte=input[bitidx++];
+		}
+		branch=(byte&mask)?branch1:branch0;
+		mask>>=1;
+
+		if (branch&0x80)
+		{
+			branch&=0x7f;
+			if (threecnt==3)
+			{
+				output[outputidx-3]|=((branch>>4)&0x3)<<6;
+				output[outputidx-2]|=((branch>>2)&0x3)<<6;
+				output[outputidx-1]|=((branch>>0)&0x3)<<6;
+				threecnt=0;
+			} else {
+				output[outputidx++]=branch;
+				threecnt++;
+			}
+			treeidx=0;
+		} else {
+			treeidx=branch;
+		}
+	}
+	return outputidx;
+}
+
+int compare(const char* name,int length)
+{
+	int len_ref;
+	int len_new;
+	int i;
+	int maxlen;
+
+	maxlen=8*length+16;	// at most one symbol per bit
+	if (maxlen>MAX_OUTPUT) maxlen=MAX_OUTPUT;
+	memset(outref,0,maxlen);
+	memset(outnew,0xff,maxlen);	// the new decoder must not rely on a cleared output buffer
+	len_ref=reference_unhuffer(inbuf,length,outref);
+	// with a smaller output buffer, the length is the same, but nothing is written beyond it.
+	len_new=dMagnetic2_loader_shared_unhuffer(inbuf,length,outnew,len_ref/2);
+	if (len_ref!=len_new)
+	{
+		printf("FAIL %s: clamped length %d, expected %d\n",name,len_new,len_ref);
+		return 1;
+	}
+	for (i=len_ref/2;i<len_ref;i++)
+	{
+		if (outnew[i]!=0xff)
+		{
+			printf("FAIL %s: byte %d was written beyond %d\n",name,i,len_ref/2);
+			return 1;
+		}
+	}
+	memset(outnew,0xff,maxlen);
+	len_new=dMagnetic2_loader_shared_unhuffer(inbuf,length,outnew,MAX_OUTPUT);
+	if (len_ref!=len_new)
+	{
+		printf("FAIL %s: length %d, expected %d\n",name,len_new,len_ref);
+		return 1;
+	}
+	for (i=0;i<len_ref;i++)
+	{
+		if (outref[i]!=outnew[i])
+		{
+			printf("FAIL %s: byte %d is %02X, expected %02X\n",name,i,outnew[i],outref[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// build a huffman tree for the 64 symbols, and write it into the input buffer.
+// the codes are returned MSB first.
+int codes[64];
+int codelens[64];
+int mktree(const int* freqs)
+{
+	int weight[128];
+	int left[128];		// bit 1
+	int right[128];		// bit 0
+	int alive[128];
+	int nodeidx[128];
+	int order[128];
+	int cnt;
+	int i;
+	int n;
+	int root;
+	int head,tail;
+	int treesize;
+
+	cnt=0;
+	for (i=0;i<64;i++)
+	{
+		weight[i]=freqs[i]+1;
+		alive[i]=1;
+		left[i]=right[i]=-1;
+	}
+	cnt=64;
+	root=0;
+	for (n=0;n<63;n++)
+	{
+		int a=-1,b=-1;
+		for (i=0;i<cnt;i++)
+		{
+			if (!alive[i]) continue;
+			if (a==-1 || weight[i]<weight[a]) {b=a;a=i;}
+			else if (b==-1 || weight[i]<weight[b]) b=i;
+		}
+		alive[a]=alive[b]=0;
+		weight[cnt]=weight[a]+weight[b];
+		left[cnt]=a;
+		right[cnt]=b;
+		alive[cnt]=1;
+		root=cnt;
+		cnt++;
+	}
+	// number the internal nodes breadth first, the root is 0.
+	head=tail=0;
+	order[tail++]=root;
+	while (head<tail)
+	{
+		int node=order[head];
+		nodeidx[node]=head;
+		head++;
+		if (left[node]>=64) order[tail++]=left[node];
+		if (right[node]>=64) order[tail++]=right[node];
+	}
+	treesize=2*tail-2;
+	inbuf[0]=treesize;
+	for (i=0;i<tail;i++)
+	{
+		int node=order[i];
+		inbuf[1+2*i]=(left[node]<64)?(0x80|left[node]):nodeidx[left[node]];
+		inbuf[2+2*i]=(right[node]<64)?(0x80|right[node]):nodeidx[right[node]];
+	}
+	// collect the codes
+	for (i=0;i<64;i++)
+	{
+		int node=i;
+		int code=0;
+		int len=0;
+		while (node!=root)
+		{
+			int j;
+			for (j=64;j<cnt;j++)
+			{
+				if (left[j]==node) {code|=1<<len;break;}
+				if (right[j]==node) break;
+			}
+			len++;
+			node=j;
+		}
+		codes[i]=code;
+		codelens[i]=len;
+	}
+	return 3+treesize;
+}
+
+// encode the payload with the tree, 4 symbols for every 3 bytes.
+int encode(int bitstart,int payloadlen)
+{
+	int bitpos;
+	int i;
+	bitpos=bitstart*8;
+	memset(&inbuf[bitstart],0,MAX_INPUT-bitstart);
+	for (i=0;i<payloadlen;i++)
+	{
+		int sym[2];
+		int n=1;
+		int j;
+		sym[0]=payload[i]&0x3f;
+		if ((i%3)==2)
+		{
+			sym[1]=((payload[i-2]>>6)<<4)|((payload[i-1]>>6)<<2)|(payload[i]>>6);
+			n=2;
+		}
+		for (j=0;j<n;j++)
+		{
+			int k;
+			for (k=codelens[sym[j]]-1;k>=0;k--)
+			{
+				if ((codes[sym[j]]>>k)&1) inbuf[bitpos/8]|=0x80>>(bitpos%8);
+				bitpos++;
+			}
+		}
+	}
+	return (bitpos+7)/8;
+}
+
+int test_stream(const char* name,int payloadlen)
+{
+	int freqs[64];
+	int bitstart;
+	int length;
+	int i;
+	int retval;
+
+	memset(freqs,0,sizeof(freqs));
+	for (i=0;i<payloadlen;i++)
+	{
+		freqs[payload[i]&0x3f]++;
+	}
+	bitstart=mktree(freqs);
+	length=encode(bitstart,payloadlen);
+	retval=compare(name,length);
+	// since the payload was a multiple of 3 bytes, it should have been restored as well
+	if (!retval && (payloadlen%3)==0 && memcmp(outnew,payload,payloadlen))
+	{
+		printf("FAIL %s: payload was not restored\n",name);
+		retval=1;
+	}
+	return retval;
+}
+
+int main(int argc,char** argv)
+{
+	int errors;
+	int i,j;
+	int len;
+	char name[64];
+
+	errors=0;
+	srand(42);
+
+	// code: 68000 instructions, with a lot of zeros and a few favourites
+	for (i=0;i<MAX_PAYLOAD-1;i++)
+	{
+		int r=rand()%16;
+		payload[i]=(r<6)?0x00:(r<9)?0x4e:(r<11)?0x75:rand()&0xff;
+	}
+	for (len=0;len<=MAX_PAYLOAD-1;len=len*2+1)
+	{
+		snprintf(name,sizeof(name),"code %d",len);
+		errors+=test_stream(name,len);
+	}
+	// dictionary: upper case words, the last letter has bit 7 set
+	for (i=0;i<MAX_PAYLOAD-1;i++)
+	{
+		int r=rand()%8;
+		payload[i]=('A'+rand()%26)|((r==0)?0x80:0x00);
+	}
+	for (len=0;len<=MAX_PAYLOAD-1;len=len*2+1)
+	{
+		snprintf(name,sizeof(name),"dictionary %d",len);
+		errors+=test_stream(name,len);
+	}
+	// pictures: long runs of the same value
+	for (i=0;i<MAX_PAYLOAD-1;)
+	{
+		int run=1+rand()%64;
+		unsigned char c=rand()&0xff;
+		for (j=0;j<run && i<MAX_PAYLOAD-1;j++)
+		{
+			payload[i++]=c;
+		}
+	}
+	for (len=0;len<=MAX_PAYLOAD-1;len=len*2+1)
+	{
+		snprintf(name,sizeof(name),"picture %d",len);
+		errors+=test_stream(name,len);
+	}
+	// every bitstream of up to 2 bytes, with a balanced tree, a skewed tree and a chain of 127 branches.
+	for (i=0;i<3;i++)
+	{
+		int bitstart;
+		int freqs[64];
+		int k;
+
+		if (i==0)
+		{
+			for (k=0;k<64;k++) freqs[k]=100;
+			bitstart=mktree(freqs);
+		} else if (i==1) {
+			for (k=0;k<64;k++) freqs[k]=1<<(k/3);
+			bitstart=mktree(freqs);
+		} else {
+			inbuf[0]=252;
+			for (k=0;k<127;k++)
+			{
+				inbuf[1+2*k]=0x80|(k&0x7f);
+				inbuf[2+2*k]=(k==126)?0xff:k+1;
+			}
+			bitstart=3+252;
+		}
+		for (k=0;k<=0x1ffff;k++)
+		{
+			if (k>=0x10000) inbuf[bitstart]=k&0xff;
+			else {inbuf[bitstart]=k>>8;inbuf[bitstart+1]=k&0xff;}
+			snprintf(name,sizeof(name),"exhaustive tree %d stream %05x",i,k);
+			len=bitstart+((k>=0x10000)?1:2);
+			if (k==0x1ffff) len=bitstart;	// and the empty stream
+			errors+=compare(name,len);
+		}
+	}
+	// damaged trees: random branches, which might point outside of the tree
+	for (i=0;i<2000;i++)
+	{
+		len=1+rand()%4096;
+		for (j=0;j<len+512;j++)
+		{
+			inbuf[j]=rand()&0xff;
+		}
+		snprintf(name,sizeof(name),"damaged %d",i);
+		errors+=compare(name,len);
+	}
+	// and any file from the command line
+	for (i=1;i<argc;i++)
+	{
+		FILE *f;
+		f=fopen(argv[i],"rb");
+		if (f==NULL)
+		{
+			printf("unable to open [%s]\n",argv[i]);
+			errors++;
+			continue;
+		}
+		memset(inbuf,0,sizeof(inbuf));
+		len=fread(inbuf,sizeof(char),MAX_INPUT,f);
+		fclose(f);
+		errors+=compare(argv[i],len);
+	}
+	if (errors)
+	{
+		printf("%d errors\n",errors);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -28,6 +28,9 @@
 # 
 # 
 
+echo ">>> unhuffer <<<"
+./loader_unhuffer.app games/msdos/*/*1 games/msdos/*/*0
+
 echo ">>> maggfx <<<"
 ./loader_mkmaggfx.app games/ccorrupt.mag games/ccorrupt.gfx
 ./loader_mkmaggfx.app games/cguild2.mag games/cguild2.gfx
@@ -146,3 +149,39 @@ echo ">>> spectrum +3 <<<"
 ./loader_mkmaggfx.app games/spectrum/guild.dsk
 
 
+
+
+echo ">>> probe <<<"
+./loader_probe.app games/pawn.mag games/pawn.gfx
+./loader_probe.app games/amstradcpc/PAWN1.DSK games/amstradcpc/PAWN2.DSK
+./loader_probe.app games/atarixl/Pawn_side1.ATR games/atarixl/Pawn_side2.ATR
+./loader_probe.app "games/appleii/CorruptionA(dosVol114).2mg" "games/appleii/CorruptionB(dosVol115).2mg" "games/appleii/CorruptionC(dosVol116).2mg"
+./loader_probe.app games/archimedes/fish.adf
+./loader_probe.app games/d64/pawn1.d64 games/d64/pawn2.d64
+./loader_probe.app games/magneticwindows/Wonder/TWO.RSC
+./loader_probe.app games/msdos/pawn/
+./loader_probe.app games/spectrum/The_pawn.dsk
+
+echo ">>> cache <<<"
+rm -rf cache
+mkdir -p cache
+./loader_cache.app cache games/pawn.mag games/pawn.gfx
+./loader_cache.app cache games/amstradcpc/PAWN1.DSK games/amstradcpc/PAWN2.DSK
+./loader_cache.app cache games/atarixl/Pawn_side1.ATR games/atarixl/Pawn_side2.ATR
+./loader_cache.app cache "games/appleii/CorruptionA(dosVol114).2mg" "games/appleii/CorruptionB(dosVol115).2mg" "games/appleii/CorruptionC(dosVol116).2mg"
+./loader_cache.app cache games/archimedes/fish.adf
+./loader_cache.app cache games/d64/pawn1.d64 games/d64/pawn2.d64
+./loader_cache.app cache games/magneticwindows/Wonder/TWO.RSC
+./loader_cache.app cache games/msdos/pawn/
+./loader_cache.app cache games/spectrum/The_pawn.dsk
+rm -rf cache
+
+echo ">>> catalog <<<"
+./loader_catalog.app games/pawn.mag,games/pawn.gfx games/d64/pawn1.d64,games/d64/pawn2.d64 games/archimedes/fish.adf games/msdos/pawn/ games/magneticwindows/Wonder/TWO.RSC
+
+echo ">>> instance <<<"
+./loader_instance.app games/pawn.mag games/pawn.gfx
+./loader_instance.app games/d64/pawn1.d64 games/d64/pawn2.d64
+./loader_instance.app games/archimedes/fish.adf
+./loader_instance.app games/msdos/pawn/
+./loader_instance.app games/magneticwindows/Wonder/TWO.RSC